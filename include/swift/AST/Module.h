@@ -30,6 +30,7 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -881,6 +882,29 @@ private:
   /// this source file so far.
   llvm::MD5 InterfaceHash;
 
+public:
+  /// The interface-contributing tokens of a top-level declaration: their
+  /// hash, and the distinct tokens, which name the other declarations of the
+  /// file it may refer to.
+  struct DeclInterfaceState {
+    llvm::MD5 Hash;
+    llvm::StringSet<> Tokens;
+  };
+
+private:
+  /// The interface of the top-level declaration currently being parsed, if
+  /// any.
+  Optional<DeclInterfaceState> CurrentDeclInterface;
+
+  /// The hash of the interface-contributing tokens of each top-level
+  /// declaration, which lets the driver tell which of the names this file
+  /// provides actually changed.
+  llvm::DenseMap<const Decl *, std::string> DeclFingerprints;
+
+  /// The distinct interface tokens of the top-level declarations, by
+  /// fingerprint.
+  llvm::StringMap<llvm::StringSet<>> DeclInterfaceTokens;
+
   /// \brief The ID for the memory buffer containing this file's source.
   ///
   /// May be -1, to indicate no association with a buffer.
@@ -1077,12 +1101,48 @@ public:
 
   void recordInterfaceToken(StringRef token) {
     assert(!token.empty());
-    InterfaceHash.update(token);
     // Add null byte to separate tokens.
     uint8_t a[1] = {0};
+    InterfaceHash.update(token);
     InterfaceHash.update(a);
+    if (CurrentDeclInterface) {
+      CurrentDeclInterface->Hash.update(token);
+      CurrentDeclInterface->Hash.update(a);
+      CurrentDeclInterface->Tokens.insert(token);
+    }
   }
 
+  /// Starts hashing the interface tokens of a top-level declaration on their
+  /// own, in addition to the hash of the whole file.
+  ///
+  /// \returns the state of any enclosing declaration's interface, which must
+  /// be passed back to #endDeclInterfaceHash.
+  Optional<DeclInterfaceState> beginDeclInterfaceHash() {
+    Optional<DeclInterfaceState> outer = std::move(CurrentDeclInterface);
+    CurrentDeclInterface = DeclInterfaceState();
+    return outer;
+  }
+
+  /// Records the hash started by #beginDeclInterfaceHash as the fingerprint
+  /// of \p decls, which are the declarations that were parsed in the
+  /// meantime.
+  void endDeclInterfaceHash(ArrayRef<Decl *> decls,
+                            Optional<DeclInterfaceState> outer);
+
+  /// Returns the fingerprint of the top-level declaration containing \p D,
+  /// or an empty string if it doesn't have one.
+  ///
+  /// Two parses of a declaration have the same fingerprint if they have the
+  /// same interface tokens.
+  StringRef getDeclFingerprint(const Decl *D) const;
+
+  /// Returns the distinct interface tokens of the top-level declaration
+  /// containing \p D, or null if it doesn't have a fingerprint.
+  ///
+  /// The tokens include the names of the other declarations of the file
+  /// which the declaration's interface may refer to.
+  const llvm::StringSet<> *getDeclInterfaceTokens(const Decl *D) const;
+
   const llvm::MD5 &getInterfaceHashState() { return InterfaceHash; }
   void setInterfaceHashState(const llvm::MD5 &state) { InterfaceHash = state; }
 
@@ -18,6 +18,8 @@
 #ifndef SWIFT_AST_SILOPTIONS_H
 #define SWIFT_AST_SILOPTIONS_H
 
+#include "llvm/Support/Regex.h"
+#include <memory>
 #include <string>
 #include <climits>
 
@@ -30,6 +32,10 @@ public:
 
   /// The number of threads for multi-threaded code generation.
   int NumThreads = 0;
+
+  /// Run function-local SIL passes on NumThreads threads, each working on
+  /// different functions.
+  bool ParallelFunctionPasses = false;
   
   enum LinkingMode {
     /// Skip SIL linking.
@@ -98,6 +104,17 @@ public:
   /// Emit a mapping of profile counters for use in coverage.
   bool EmitProfileCoverageMapping = false;
 
+  /// The profile to read execution counts from, or empty if none.
+  std::string UseProfile;
+
+  /// Selects the passes whose remarks about optimizations they did are
+  /// printed (-Rpass).
+  std::shared_ptr<llvm::Regex> OptRemarkPassed;
+
+  /// Selects the passes whose remarks about optimizations they didn't do are
+  /// printed (-Rpass-missed).
+  std::shared_ptr<llvm::Regex> OptRemarkMissed;
+
   /// Should we use a pass pipeline passed in via a json file? Null by default.
   StringRef ExternalPassPipelineFilename;
 };
@@ -0,0 +1,61 @@
+//===--- CompileServerProtocol.h - Compile server messages ------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// The messages exchanged between a TaskQueue and a compile server ('swift
+// -compile-server <socket>') over a local stream socket. The server keeps
+// frontend state which doesn't depend on the inputs of a job, such as the
+// loaded modules and the Clang importer, and runs each job in a forked copy
+// of it.
+//
+// For each task, the client connects and sends a request:
+//
+//   u32         RequestSignature
+//   u32         size of the payload
+//   u32         number of strings in the command line
+//   char x N    payload: the command line (the working directory, the
+//               executable and the arguments of the task), then the task's
+//               environment as NAME=VALUE strings, each string terminated by
+//               a NUL character
+//
+// The first byte carries the file descriptor to which the task's output
+// (both stdout and stderr) should be written, as SCM_RIGHTS ancillary data.
+//
+// The server only accepts connections from processes of its own user.
+//
+// The server answers with an i32, the process ID of the job, or
+// DeclinedPid if the client should run the task itself. Once the job has
+// exited, the server sends its wait status as an i32 and closes the
+// connection.
+//
+// All integers are in host byte order.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_BASIC_COMPILESERVERPROTOCOL_H
+#define SWIFT_BASIC_COMPILESERVERPROTOCOL_H
+
+#include <cstdint>
+
+namespace swift {
+namespace compile_server {
+  /// The first word of a request: "SWC2".
+  const uint32_t RequestSignature = 0x53574332;
+
+  /// The largest payload the server accepts.
+  const uint32_t MaxPayloadSize = 1 << 20;
+
+  /// Sent instead of a process ID if the server won't run the task.
+  const int32_t DeclinedPid = -1;
+} // end namespace compile_server
+} // end namespace swift
+
+#endif
@@ -122,6 +122,11 @@ namespace swift {
     /// \brief Enable the iterative type checker.
     bool IterativeTypeChecker = false;
 
+    /// Only validate the members of structs, enums and classes from other
+    /// files which their layout or vtable depends on, and the rest when they
+    /// are referenced.
+    bool LazyMemberValidation = true;
+
     /// Debug the generic signatures computed by the archetype builder.
     bool DebugGenericSignatures = false;
 
@@ -21,6 +21,7 @@
 #include <functional>
 #include <memory>
 #include <queue>
+#include <string>
 
 namespace swift {
 namespace sys {
@@ -46,6 +47,13 @@ class TaskQueue {
   /// The number of tasks to execute in parallel.
   unsigned NumberOfParallelTasks;
 
+  /// The socket of a compile server to which frontend tasks are sent, if any.
+  std::string CompileServerSocket;
+
+  /// Whether a frontend task run with -num-threads takes a jobserver token
+  /// for each thread.
+  bool JobserverTokensForThreads = false;
+
 public:
   /// \brief Create a new TaskQueue instance.
   ///
@@ -113,6 +121,26 @@ public:
   /// parallel
   unsigned getNumberOfParallelTasks() const;
 
+  /// \brief Sends tasks which run the Swift frontend to the compile server
+  /// listening on \p SocketPath, rather than spawning them.
+  ///
+  /// A task still runs locally if the server can't be reached or declines it.
+  /// This has no effect on systems which don't support a compile server.
+  void setCompileServerSocket(StringRef SocketPath) {
+    CompileServerSocket = SocketPath.str();
+  }
+
+  /// \brief Makes each frontend task which is run with -num-threads take a
+  /// token for each of its threads from the jobserver of an enclosing make,
+  /// rather than one.
+  ///
+  /// The jobserver is used whenever MAKEFLAGS names one, on systems which
+  /// support it, to bound the number of tasks running across all the
+  /// processes make has started.
+  void setJobserverTokensForThreads(bool Value = true) {
+    JobserverTokensForThreads = Value;
+  }
+
   /// \brief Adds a task to the TaskQueue.
   ///
   /// \param ExecPath the path to the executable which the task should execute
@@ -139,7 +167,7 @@ public:
 
   /// Returns true if there are any tasks that have been queued but have not
   /// yet been executed.
-  bool hasRemainingTasks() {
+  virtual bool hasRemainingTasks() {
     return !QueuedTasks.empty();
   }
 };
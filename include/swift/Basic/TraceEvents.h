@@ -0,0 +1,87 @@
+//===--- TraceEvents.h - Chrome trace event recording -----------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Records a timeline of what a process spends its time on (-trace-output),
+// in the trace event format read by chrome://tracing and similar viewers.
+//
+// A trace is a JSON array with one complete ("X") event per line. Timestamps
+// are in microseconds since the Unix epoch, so that the traces of the driver
+// and the frontends it runs line up once the driver has merged them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_BASIC_TRACEEVENTS_H
+#define SWIFT_BASIC_TRACEEVENTS_H
+
+#include "swift/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <system_error>
+
+namespace swift {
+namespace trace {
+
+/// Starts writing the events of this process to \p Path, under the name
+/// \p ProcessName.
+std::error_code startRecording(StringRef Path, StringRef ProcessName);
+
+/// Finishes the trace started by startRecording.
+void stopRecording();
+
+/// Returns true if events are being recorded.
+bool isRecording();
+
+/// Returns the current time in microseconds since the Unix epoch.
+uint64_t now();
+
+/// Records that this thread spent \p Start to \p End on \p Name, which
+/// belongs to \p Category. \p Detail, if present, says what it worked on.
+void recordEvent(StringRef Category, StringRef Name, uint64_t Start,
+                 uint64_t End, StringRef Detail = StringRef());
+
+/// Records an event on behalf of the process \p Pid, such as a job the driver
+/// ran, with the name \p ProcessName.
+void recordProcessEvent(int64_t Pid, StringRef ProcessName,
+                        StringRef Category, StringRef Name, uint64_t Start,
+                        uint64_t End);
+
+/// Copies the events of another trace written by startRecording, e.g. by a
+/// subprocess, into this one.
+void appendEventsFromFile(StringRef Path);
+
+/// Records the time between its construction and destruction as an event.
+///
+/// The strings aren't copied, and have to outlive the Scope.
+class Scope {
+  StringRef Category;
+  StringRef Name;
+  StringRef Detail;
+  uint64_t Start;
+
+public:
+  Scope(StringRef Category, StringRef Name, StringRef Detail = StringRef())
+    : Category(Category), Name(Name), Detail(Detail),
+      Start(isRecording() ? now() : 0) {}
+
+  ~Scope() {
+    if (Start != 0)
+      recordEvent(Category, Name, Start, now(), Detail);
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+} // end namespace trace
+} // end namespace swift
+
+#endif
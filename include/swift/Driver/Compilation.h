@@ -127,6 +127,22 @@ private:
   /// rebuilt.
   bool ShowIncrementalBuildDecisions = false;
 
+  /// The socket of the compile server which should run frontend jobs, if any.
+  std::string CompileServerSocket;
+
+  /// When running under a make jobserver, whether frontend jobs take a token
+  /// for each of their -num-threads.
+  bool JobserverCountsThreads = false;
+
+  /// The file to which a trace of the build should be written, if any.
+  std::string TraceOutputPath;
+
+  /// When the driver started, in trace time (see swift::trace::now()).
+  uint64_t TraceStartTime = 0;
+
+  /// The directory of the cache of compile job outputs, if any.
+  std::string OutputCachePath;
+
   static const Job *unwrap(const std::unique_ptr<const Job> &p) {
     return p.get();
   }
@@ -189,6 +205,25 @@ public:
     ShowIncrementalBuildDecisions = value;
   }
 
+  void setCompileServerSocket(StringRef path) {
+    CompileServerSocket = path.str();
+  }
+
+  void setJobserverCountsThreads(bool value = true) {
+    JobserverCountsThreads = value;
+  }
+
+  /// Writes a trace of the build to \p path, starting at \p startTime,
+  /// which includes the traces of the frontend jobs.
+  void setTraceOutputPath(StringRef path, uint64_t startTime) {
+    TraceOutputPath = path.str();
+    TraceStartTime = startTime;
+  }
+
+  void setOutputCachePath(StringRef path) {
+    OutputCachePath = path.str();
+  }
+
   void setCompilationRecordPath(StringRef path) {
     assert(CompilationRecordPath.empty() && "already set");
     CompilationRecordPath = path;
@@ -0,0 +1,212 @@
+//===--- DependencyFile.h - Swift dependencies files ------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Writing and reading the Swift dependencies (.swiftdeps) files which the
+// frontend emits for each primary file and the driver loads into its
+// DependencyGraph.
+//
+// A dependencies file can be written as YAML, which is easy to read and to
+// write by hand in tests, or in a compact binary form, which the driver can
+// read in place without any parsing or copying. The binary form is:
+//
+//   signature   "SWDB"
+//   u16         major version
+//   u16         minor version
+//   u32         number of strings
+//   u32         size of the string data
+//   u32         string index of the interface hash, or NoString
+//   u32         number of fingerprints
+//   u32 x 9     number of entries of each DependencySection
+//   u32 x N+1   offsets into the string data of the N strings, followed by
+//               the size of the string data
+//   u32 x M     the entries of all sections, in section order
+//   u32 x 2F    the string indices of the name and fingerprint of the F
+//               fingerprinted names, sorted by name
+//   char x S    the string data
+//
+// All integers are little-endian. Each string is stored once, and the string
+// table is sorted, so that the entries of each section, which are sorted by
+// string index, are also sorted by name. An entry is the index of its name in
+// the string table; the top bit is set if the dependency is private (i.e. not
+// cascading). A member entry's name is the mangled name of the type, a NUL
+// character, and the member name.
+//
+// A fingerprint summarizes the interface of the declarations behind a name
+// the file provides. When a file is rebuilt, the driver only needs to
+// propagate the change of names whose fingerprint changed; provided names
+// without a fingerprint are always assumed to have changed.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_DRIVER_DEPENDENCYFILE_H
+#define SWIFT_DRIVER_DEPENDENCYFILE_H
+
+#include "swift/Basic/LLVM.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace swift {
+
+/// The sections of a Swift dependencies file, in file order.
+enum class DependencySection : uint8_t {
+  ProvidesTopLevel,
+  ProvidesNominal,
+  ProvidesMember,
+  ProvidesDynamicLookup,
+  DependsTopLevel,
+  DependsMember,
+  DependsNominal,
+  DependsDynamicLookup,
+  DependsExternal,
+};
+
+enum : unsigned { NumDependencySections = 9 };
+
+/// Returns the YAML key of the given section, e.g. "provides-top-level".
+StringRef getDependencySectionName(DependencySection section);
+
+/// Returns true if entries of the given section name a member of a type.
+static inline bool isMemberDependencySection(DependencySection section) {
+  return section == DependencySection::ProvidesMember ||
+         section == DependencySection::DependsMember;
+}
+
+namespace binary_swiftdeps {
+  /// The first bytes of a binary dependencies file.
+  const char Signature[] = { 'S', 'W', 'D', 'B' };
+
+  /// Incremented for changes which older readers can't handle.
+  const uint16_t VersionMajor = 2;
+  /// Incremented for compatible changes.
+  const uint16_t VersionMinor = 0;
+
+  /// The string index of an absent string.
+  const uint32_t NoString = ~0U;
+
+  /// Set in an entry for a private (non-cascading) dependency.
+  const uint32_t PrivateFlag = 1U << 31;
+
+  /// The size of the fixed part of the header.
+  const size_t HeaderSize =
+    sizeof(Signature) + 2 * sizeof(uint16_t) +
+    (4 + NumDependencySections) * sizeof(uint32_t);
+} // end namespace binary_swiftdeps
+
+/// Collects the contents of a Swift dependencies file and writes it in one
+/// of the two formats.
+class DependencyFileWriter {
+  struct Entry {
+    std::string Name;
+    bool IsCascading;
+  };
+
+  std::vector<Entry> Sections[NumDependencySections];
+
+  /// Sections which are written out even if they are empty.
+  bool IsPresent[NumDependencySections] = {};
+
+  /// The fingerprints of provided names, in the order the names were first
+  /// given one.
+  std::vector<std::pair<std::string, std::string>> Fingerprints;
+  llvm::StringMap<unsigned> FingerprintIndices;
+
+  std::string InterfaceHash;
+
+public:
+  /// Writes the given section even if it has no entries. Sections which
+  /// have entries are always written.
+  void addSection(DependencySection section) {
+    IsPresent[unsigned(section)] = true;
+  }
+
+  void addEntry(DependencySection section, StringRef name,
+                bool isCascading = true) {
+    assert(!isMemberDependencySection(section) && "use addMemberEntry");
+    addSection(section);
+    Sections[unsigned(section)].push_back({name.str(), isCascading});
+  }
+
+  /// Adds an entry for the member \p member of the type with mangled name
+  /// \p mangledBaseName. An empty member name stands for all members.
+  void addMemberEntry(DependencySection section, StringRef mangledBaseName,
+                      StringRef member, bool isCascading = true);
+
+  /// Records \p fingerprint for the provided name \p name. If the name is
+  /// given several fingerprints (say, for overloads), they are combined.
+  ///
+  /// An empty fingerprint stands for a declaration which doesn't have one;
+  /// its name is then written without a fingerprint.
+  void addFingerprint(StringRef name, StringRef fingerprint);
+
+  /// Records \p fingerprint for the member \p member of the type with mangled
+  /// name \p mangledBaseName.
+  void addMemberFingerprint(StringRef mangledBaseName, StringRef member,
+                            StringRef fingerprint);
+
+  void setInterfaceHash(StringRef hash) { InterfaceHash = hash.str(); }
+
+  /// Writes the file as YAML, with the entries in the order they were added.
+  void writeYAML(raw_ostream &out) const;
+
+  /// Writes the file in the binary format.
+  void writeBinary(raw_ostream &out) const;
+};
+
+/// Reads a binary Swift dependencies file in place. The buffer must outlive
+/// the reader and all strings returned by it.
+class BinaryDependencyFileReader {
+  uint32_t NumStrings = 0;
+  uint32_t InterfaceHashIndex = binary_swiftdeps::NoString;
+  uint32_t NumFingerprints = 0;
+  uint32_t SectionSizes[NumDependencySections] = {};
+  const char *StringOffsets = nullptr;
+  const char *Entries = nullptr;
+  const char *Fingerprints = nullptr;
+  const char *StringData = nullptr;
+
+  StringRef getString(uint32_t index) const;
+
+public:
+  /// Returns true if \p data starts with the binary signature. Anything else
+  /// is assumed to be YAML.
+  static bool isBinary(StringRef data);
+
+  /// Checks the header and the bounds of all tables.
+  ///
+  /// \returns true on error, false on success
+  bool initialize(StringRef data);
+
+  /// Calls \p fn with the name and cascading flag of each entry of the given
+  /// section, stopping early if it returns false.
+  ///
+  /// \returns false if \p fn stopped the iteration or an entry is malformed
+  bool forEachEntry(DependencySection section,
+                    llvm::function_ref<bool(StringRef, bool)> fn) const;
+
+  /// Calls \p fn with each fingerprinted name and its fingerprint, stopping
+  /// early if it returns false.
+  ///
+  /// \returns false if \p fn stopped the iteration or an entry is malformed
+  bool forEachFingerprint(
+      llvm::function_ref<bool(StringRef, StringRef)> fn) const;
+
+  /// Returns the interface hash, or an empty string if there is none.
+  StringRef getInterfaceHash() const;
+};
+
+} // end namespace swift
+
+#endif
@@ -90,6 +90,14 @@ private:
   struct ProvidesEntryTy {
     std::string name;
     DependencyMaskTy kindMask;
+
+    /// The fingerprint of the declarations behind the name as of the last
+    /// load, or empty if the name didn't have one.
+    std::string fingerprint;
+
+    /// Whether the last load of the node changed this entry: the name is new,
+    /// has gone away, or has a different (or no) fingerprint.
+    bool hasChanged;
   };
   static_assert(std::is_move_constructible<ProvidesEntryTy>::value, "");
 
@@ -129,6 +137,10 @@ private:
   /// \sa SourceFile::getInterfaceHash
   llvm::DenseMap<const void *, std::string> InterfaceHashes;
 
+  /// Nodes whose last loaded file gave a fingerprint for every name it
+  /// provides.
+  llvm::SmallPtrSet<const void *, 16> FullyFingerprinted;
+
   LoadResult loadFromBuffer(const void *node, llvm::MemoryBuffer &buffer);
 
   // FIXME: We should be able to use llvm::mapped_iterator for this, but
@@ -182,6 +194,11 @@ protected:
     return Marked.count(node);
   }
 
+  bool hasFingerprints(const void *node) const {
+    assert(Provides.count(node) && "node is not in the graph");
+    return FullyFingerprinted.count(node);
+  }
+
 public:
   llvm::iterator_range<StringSetIterator> getExternalDependencies() const {
     return llvm::make_range(StringSetIterator(ExternalDependencies.begin()),
@@ -243,6 +260,10 @@ public:
   /// ("depends") are not cleared; new dependencies are considered additive.
   ///
   /// If \p node has already been marked, only its outgoing edges are updated.
+  ///
+  /// If the file gives fingerprints for the names \p node provides, the
+  /// entries whose fingerprint is the same as in the previous load are
+  /// considered unchanged, and are not followed when \p node is next marked.
   LoadResult loadFromPath(T node, StringRef path) {
     return DependencyGraphImpl::loadFromPath(Traits::getAsVoidPointer(node),
                                              path);
@@ -277,6 +298,10 @@ public:
   /// Nodes that are only reachable through "non-cascading" edges are added to
   /// the \p visited set, but are \em not added to the graph's marked set.
   ///
+  /// Only the entries of \p node's "provides" set which changed in its last
+  /// load are followed (see #loadFromPath); all entries of the nodes reached
+  /// from there are.
+  ///
   /// If you want to see how each node gets added to \p visited, pass a local
   /// MarkTracer instance to \p tracer.
   template <unsigned N>
@@ -312,6 +337,17 @@ public:
   bool isMarked(T node) const {
     return DependencyGraphImpl::isMarked(Traits::getAsVoidPointer(node));
   }
+
+  /// Returns true if the last file loaded for \p node gave a fingerprint for
+  /// every name it provides.
+  ///
+  /// For such a node, it's worth waiting until the node has been rebuilt to
+  /// find out which of its dependents are affected, rather than marking
+  /// all of them up front.
+  bool hasFingerprints(T node) const {
+    return
+        DependencyGraphImpl::hasFingerprints(Traits::getAsVoidPointer(node));
+  }
 };
 
 } // end namespace swift
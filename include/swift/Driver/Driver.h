@@ -104,6 +104,13 @@ public:
 
   /// Returns true if multi-threading is enabled.
   bool isMultiThreading() const { return numThreads > 0; }
+
+  /// In batch mode, the number of frontend jobs among which the Swift input
+  /// files are split. Zero means one job per file.
+  unsigned BatchCount = 0;
+
+  /// Returns true if a frontend job may compile several primary files.
+  bool isBatchMode() const { return BatchCount > 0; }
   
   /// The name of the module which we are building.
   std::string ModuleName;
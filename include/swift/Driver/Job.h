@@ -48,6 +48,17 @@ class CommandOutput {
 
   llvm::SmallDenseMap<types::ID, std::string, 4> AdditionalOutputsMap;
 
+  /// In a batch compile job, the auxiliary outputs of each primary input, in
+  /// the order of BaseInputs.
+  SmallVector<llvm::SmallDenseMap<types::ID, std::string, 4>, 1>
+    PerInputOutputsMaps;
+
+  /// In a batch compile job, the file which maps the primary inputs to their
+  /// auxiliary outputs for the frontend, and the map to write to it before
+  /// the job runs.
+  std::string SupplementaryOutputFileMapPath;
+  std::string SupplementaryOutputFileMapContents;
+
 public:
   CommandOutput(types::ID PrimaryOutputType)
       : PrimaryOutputType(PrimaryOutputType) { }
@@ -75,6 +86,37 @@ public:
 
   const std::string &getAnyOutputForType(types::ID type) const;
 
+  /// Marks this as the output of a batch compile job, which has separate
+  /// auxiliary outputs for each primary output. Must be called after all
+  /// primary outputs have been added.
+  void setIsBatch() { PerInputOutputsMaps.resize(BaseInputs.size()); }
+  bool isBatch() const { return !PerInputOutputsMaps.empty(); }
+
+  /// Sets the auxiliary output of the given type for the primary input at
+  /// \p Index. Outside of batch jobs this is the same as
+  /// setAdditionalOutputForType.
+  void setAdditionalOutputForType(types::ID type, StringRef OutputFilename,
+                                  unsigned Index);
+
+  /// Returns the auxiliary output of the given type for the primary input at
+  /// \p Index. Outside of batch jobs this is the same as
+  /// getAdditionalOutputForType.
+  const std::string &getAdditionalOutputForType(types::ID type,
+                                                unsigned Index) const;
+
+  StringRef getSupplementaryOutputFileMapPath() const {
+    return SupplementaryOutputFileMapPath;
+  }
+  StringRef getSupplementaryOutputFileMapContents() const {
+    return SupplementaryOutputFileMapContents;
+  }
+  void setSupplementaryOutputFileMap(StringRef Path, StringRef Contents) {
+    SupplementaryOutputFileMapPath = Path;
+    SupplementaryOutputFileMapContents = Contents;
+  }
+
+  unsigned getNumBaseInputs() const { return BaseInputs.size(); }
+
   StringRef getBaseInput(int Index) const { return BaseInputs[Index]; }
 };
 
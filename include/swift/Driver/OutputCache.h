@@ -0,0 +1,144 @@
+//===--- OutputCache.h - Content-addressed cache of job outputs -*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// A local cache of the outputs of compile jobs (-output-cache-path), keyed by
+// the contents of everything the job reads rather than by modification times,
+// so that a job which has run before with the same inputs in the same place,
+// say before switching branches back and forth or after a clean build,
+// doesn't need to run again.
+//
+// Only builds in the same directory share entries. The outputs record
+// absolute paths (the dependencies file lists every file the job read, and
+// the debug info names the working directory), so an entry made in another
+// checkout would point the restored outputs at that checkout.
+//
+// Which modules a job imports is only known once it has run, so the cache
+// has two levels. The input key hashes the compiler, the working directory,
+// the job's arguments (with the output paths left out) and the contents of
+// the source files. It names a manifest, which lists the modules and headers
+// the job loaded last time with the hashes of their contents. If they all
+// still match, the manifest's entry holds the outputs.
+//
+// The cache directory holds, for input key K and entry E:
+//
+//   K.manifest   the entry E on the first line, then one line for each
+//                dependency: the MD5 of its contents, a space, and its path
+//   E.<output>   each output of the job, named by its type (e.g. "object")
+//                and, for primary outputs, its index
+//   E.output     the text the job printed
+//
+// Files are written under a temporary name and renamed into place, and the
+// manifest is written last, so concurrent builds may share a cache.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_DRIVER_OUTPUTCACHE_H
+#define SWIFT_DRIVER_OUTPUTCACHE_H
+
+#include "swift/Basic/LLVM.h"
+#include "swift/Basic/TaskQueue.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace swift {
+namespace driver {
+  class Job;
+
+class OutputCache {
+  /// The directory holding the cache.
+  std::string Directory;
+
+  /// The source files of the compilation, which every compile job may read.
+  std::vector<std::string> InputFiles;
+
+  /// The hashes of the contents of the files read so far. A file is only read
+  /// once per build.
+  llvm::StringMap<std::string> FileHashes;
+
+  /// Identifies the compiler, so that a new compiler doesn't reuse the
+  /// outputs of an old one.
+  std::string CompilerIdentity;
+
+  /// Returns the MD5 of the contents of \p path, or an empty string if it
+  /// can't be read.
+  StringRef hashFile(StringRef path);
+
+  /// Returns the path of the file \p name in the cache directory.
+  std::string getPath(StringRef name) const;
+
+  /// Collects the files other than its inputs which \p cmd read, from its
+  /// dependencies output.
+  ///
+  /// \returns true if they couldn't be determined
+  bool collectDependencies(const Job &cmd,
+                           std::vector<std::string> &dependencies) const;
+
+public:
+  OutputCache(StringRef directory, ArrayRef<std::string> inputFiles);
+
+  /// Returns the input key of \p cmd, or an empty string if its outputs
+  /// can't be cached.
+  ///
+  /// Only compile jobs which list the files they read in a dependencies or
+  /// Swift dependencies output are cached.
+  std::string computeInputKey(const Job &cmd);
+
+  /// Restores the outputs of \p cmd from the cache, and sets \p output to the
+  /// text it printed.
+  ///
+  /// \returns true on a cache hit, false if \p cmd has to run
+  bool restore(StringRef inputKey, const Job &cmd, std::string &output);
+
+  /// Stores the outputs of \p cmd, which has just run successfully and
+  /// printed \p output.
+  void store(StringRef inputKey, const Job &cmd, StringRef output);
+};
+
+/// A TaskQueue which restores the outputs of a compile job from an
+/// OutputCache instead of running it, if possible, and stores the outputs of
+/// the jobs it does run.
+///
+/// The context of each task must be its Job. A restored task is reported
+/// through the began and finished callbacks like any other task.
+class CachingTaskQueue : public sys::TaskQueue {
+  OutputCache &Cache;
+
+  /// The input keys of the queued tasks which may be stored.
+  llvm::DenseMap<void *, std::string> InputKeys;
+
+  /// Tasks which have been restored, and the text they printed, in the order
+  /// they were added.
+  std::deque<std::pair<void *, std::string>> RestoredTasks;
+
+public:
+  CachingTaskQueue(OutputCache &Cache, unsigned NumberOfParallelTasks = 0)
+    : TaskQueue(NumberOfParallelTasks), Cache(Cache) {}
+
+  virtual void addTask(const char *ExecPath, ArrayRef<const char *> Args,
+                       ArrayRef<const char *> Env = llvm::None,
+                       void *Context = nullptr);
+
+  virtual bool
+  execute(TaskBeganCallback Began = TaskBeganCallback(),
+          TaskFinishedCallback Finished = TaskFinishedCallback(),
+          TaskSignalledCallback Signalled = TaskSignalledCallback());
+
+  virtual bool hasRemainingTasks();
+};
+
+} // end namespace driver
+} // end namespace swift
+
+#endif
@@ -33,9 +33,8 @@ class OutputFileMap {
 private:
   llvm::StringMap<TypeToPathMap> InputToOutputsMap;
 
-  OutputFileMap() {}
-
 public:
+  OutputFileMap() {}
   ~OutputFileMap() = default;
 
   /// Loads an OutputFileMap from the given \p Path, if possible.
@@ -55,6 +54,16 @@ public:
   /// Get the map of outputs for a single compile product.
   const TypeToPathMap *getOutputMapForSingleOutput() const;
 
+  /// Set the map of outputs for the given \p Input, replacing any existing
+  /// entry.
+  void setOutputMapForInput(StringRef Input, TypeToPathMap Map) {
+    InputToOutputsMap[Input] = std::move(Map);
+  }
+
+  /// Write the OutputFileMap to the given \p os in the JSON format which
+  /// loadFromBuffer accepts.
+  void write(llvm::raw_ostream &os) const;
+
   /// Dump the OutputFileMap to the given \p os.
   void dump(llvm::raw_ostream &os, bool Sort = false) const;
 
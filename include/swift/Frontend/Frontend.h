@@ -292,7 +292,10 @@ class CompilerInstance {
   std::unique_ptr<SILModule> TheSILModule;
 
   DependencyTracker *DepTracker = nullptr;
-  ReferencedNameTracker *NameTracker = nullptr;
+
+  /// The name trackers of the primary source files, in the order of
+  /// PrimaryBufferIDs.
+  SmallVector<ReferencedNameTracker *, 1> NameTrackers;
 
   Module *MainModule = nullptr;
   SerializedModuleLoader *SML = nullptr;
@@ -311,13 +314,26 @@ class CompilerInstance {
 
   enum : unsigned { NO_SUCH_BUFFER = ~0U };
   unsigned MainBufferID = NO_SUCH_BUFFER;
-  unsigned PrimaryBufferID = NO_SUCH_BUFFER;
 
-  SourceFile *PrimarySourceFile = nullptr;
+  /// The buffers of the primary inputs, in the order of
+  /// FrontendOptions::PrimaryInputs. Empty when compiling the whole module.
+  SmallVector<unsigned, 1> PrimaryBufferIDs;
+
+  /// The source files of the primary inputs, in the order of
+  /// PrimaryBufferIDs. An entry is null until its file has been created, or
+  /// if the primary input is not a source file.
+  SmallVector<SourceFile *, 1> PrimarySourceFiles;
 
   void createSILModule(bool WholeModule = false);
   void setPrimarySourceFile(SourceFile *SF);
 
+  /// Returns true if the given buffer is one of the primary inputs.
+  bool isPrimaryBuffer(unsigned BufferID) const;
+
+  /// Returns true if output is generated for the whole module, because no
+  /// primary input is a source buffer.
+  bool isWholeModule() const;
+
 public:
   SourceManager &getSourceMgr() { return SourceMgr; }
 
@@ -336,7 +352,7 @@ public:
   }
 
   void setDependencyTracker(DependencyTracker *DT) {
-    assert(!Context && "must be called before setup()");
+    assert(!Context && "must be called before setupContext()");
     DepTracker = DT;
   }
   DependencyTracker *getDependencyTracker() {
@@ -344,11 +360,17 @@ public:
   }
 
   void setReferencedNameTracker(ReferencedNameTracker *tracker) {
-    assert(!PrimarySourceFile && "must be called before performSema()");
-    NameTracker = tracker;
+    setReferencedNameTrackers(tracker);
   }
   ReferencedNameTracker *getReferencedNameTracker() {
-    return NameTracker;
+    return NameTrackers.empty() ? nullptr : NameTrackers.front();
+  }
+
+  /// Sets one name tracker for each primary input, in the order of
+  /// FrontendOptions::PrimaryInputs.
+  void setReferencedNameTrackers(ArrayRef<ReferencedNameTracker *> trackers) {
+    assert(!getPrimarySourceFile() && "must be called before performSema()");
+    NameTrackers.assign(trackers.begin(), trackers.end());
   }
 
   /// Set the SIL module for this compilation instance.
@@ -386,10 +408,35 @@ public:
 
   /// Gets the SourceFile which is the primary input for this CompilerInstance.
   /// \returns the primary SourceFile, or nullptr if there is no primary input
-  SourceFile *getPrimarySourceFile() { return PrimarySourceFile; }
+  SourceFile *getPrimarySourceFile() const {
+    return PrimarySourceFiles.empty() ? nullptr : PrimarySourceFiles.front();
+  }
+
+  /// Gets the SourceFiles of all primary inputs, in the order of
+  /// FrontendOptions::PrimaryInputs. An entry is null if that primary input
+  /// is not a source file.
+  ArrayRef<SourceFile *> getPrimarySourceFiles() const {
+    return PrimarySourceFiles;
+  }
 
   /// \brief Returns true if there was an error during setup.
-  bool setup(const CompilerInvocation &Invocation);
+  bool setup(const CompilerInvocation &Invocation) {
+    return setupContext(Invocation) || setupInputs(Invocation);
+  }
+
+  /// Creates the ASTContext and the module loaders, including the Clang
+  /// importer, for \p Invocation, without reading any of its inputs.
+  ///
+  /// \returns true if there was an error
+  bool setupContext(const CompilerInvocation &Invocation);
+
+  /// Reads the inputs of \p Invocation. The context must have been set up
+  /// with an invocation which differs from this one only in its inputs and
+  /// outputs, which lets the compile server set up a context once and reuse
+  /// it for many jobs.
+  ///
+  /// \returns true if there was an error
+  bool setupInputs(const CompilerInvocation &Invocation);
 
   /// Parses and type-checks all input files.
   void performSema();
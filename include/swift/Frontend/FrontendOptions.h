@@ -74,6 +74,12 @@ public:
   /// be generated for the whole module.
   Optional<SelectedInput> PrimaryInput;
 
+  /// All inputs for which output should be generated, in command-line order.
+  /// PrimaryInput is the first of them. With more than one, the frontend is
+  /// in batch mode: it type-checks all of them together and then emits the
+  /// outputs of each one separately.
+  std::vector<SelectedInput> PrimaryInputs;
+
   /// The kind of input on which the frontend should operate.
   InputFileKind InputKind = InputFileKind::IFK_Swift;
 
@@ -106,15 +112,30 @@ public:
   /// frontend invocation.
   std::string SerializedDiagnosticsPath;
 
+  /// The path to which we should write the optimization record.
+  std::string OptRecordPath;
+
   /// The path to which we should output a Make-style dependencies file.
   std::string DependenciesFilePath;
 
   /// The path to which we should output a Swift reference dependencies file.
   std::string ReferenceDependenciesFilePath;
 
+  /// Write the Swift reference dependencies file in the binary format rather
+  /// than as YAML.
+  bool BinaryReferenceDependencies = false;
+
   /// The path to which we should output a fixits as source edits.
   std::string FixitsOutputPath;
 
+  /// The path to which we should write a timeline of the compilation, as
+  /// trace events.
+  std::string TraceOutputPath;
+
+  /// In batch mode, an output file map which names the supplementary outputs
+  /// (dependencies, module files) of each primary input.
+  std::string SupplementaryOutputFileMapPath;
+
   /// Arguments which should be passed in immediate mode.
   std::vector<std::string> ImmediateArgv;
 
@@ -233,6 +254,9 @@ public:
   /// Indicates whether the RequestedAction will immediately run code.
   bool actionIsImmediate() const;
 
+  /// Indicates whether more than one -primary-file was given.
+  bool isBatchMode() const { return PrimaryInputs.size() > 1; }
+
   void forAllOutputPaths(std::function<void(const std::string &)> fn) const;
   
   /// Gets the name of the specified output filename.
@@ -226,6 +226,23 @@ extern "C" void swift_release(HeapObject *object);
 /// count reaches zero, the object is destroyed
 extern "C" void swift_release_n(HeapObject *object, uint32_t n);
 
+/// Increments the retain count of an object without atomic operations.
+///
+/// The compiler only emits calls to this when it has proven that the
+/// object cannot be accessed from any other thread.
+///
+/// \param object - may be null, in which case this is a no-op
+extern "C" void swift_nonatomic_retain(HeapObject *object);
+extern "C" void swift_nonatomic_retain_n(HeapObject *object, uint32_t n);
+
+/// Decrements the retain count of an object without atomic operations. If
+/// the retain count reaches zero, the object is destroyed as in
+/// swift_release.
+///
+/// \param object - may be null, in which case this is a no-op
+extern "C" void swift_nonatomic_release(HeapObject *object);
+extern "C" void swift_nonatomic_release_n(HeapObject *object, uint32_t n);
+
 /// ObjC compatibility. Never call this.
 extern "C" size_t swift_retainCount(HeapObject *object);
 extern "C" size_t swift_weakRetainCount(HeapObject *object);
@@ -400,9 +417,18 @@ extern "C" void swift_retainUnowned(HeapObject *value);
 /// Aborts if the object has been deallocated.
 extern "C" void swift_checkUnowned(HeapObject *value);
 
+struct WeakReferenceEntry;
+
 /// A weak reference value object.  This is ABI.
+///
+/// If the runtime is built with weak reference side tables, a weak reference
+/// to a native object holds the object's side-table entry rather than the
+/// object itself.
 struct WeakReference {
-  HeapObject *Value;
+  union {
+    HeapObject *Value;
+    WeakReferenceEntry *Entry;
+  };
 };
 
 /// Initialize a weak reference.
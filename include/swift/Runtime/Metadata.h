@@ -35,17 +35,17 @@
 namespace swift {
 
 /// A bump pointer for metadata allocations. Since metadata is (currently)
-/// never released, it does not support deallocation. This allocator by itself
-/// is not thread-safe; in concurrent uses, allocations must be guarded by
-/// a lock, such as the per-metadata-cache lock used to guard metadata
-/// instantiations. All allocations are pointer-aligned.
+/// never released, it does not support deallocation. This allocator is
+/// thread-safe: the bump pointer is advanced with a compare-and-swap, so
+/// metadata caches can instantiate entries for different keys concurrently.
+/// All allocations are pointer-aligned.
 class MetadataAllocator {
   /// Address of the next available space. The allocator grabs a page at a time,
   /// so the need for a new page can be determined by page alignment.
   ///
   /// Initializing to -1 instead of nullptr ensures that the first allocation
   /// triggers a page allocation since it will always span a "page" boundary.
-  char *next = (char*)(~(uintptr_t)0U);
+  std::atomic<char *> next{(char*)(~(uintptr_t)0U)};
   
 public:
   MetadataAllocator() = default;
@@ -2088,6 +2088,23 @@ struct GenericMetadata {
   }
 };
 
+/// A record of generic metadata that the compiler instantiated ahead of time.
+///
+/// The metadata is the address point of a complete cache entry for the
+/// pattern, laid out the way the runtime lays out the entries it allocates:
+///
+///   const void *Arguments[pattern->NumKeyArguments];
+///   const void *Next;
+///   const Metadata *Value;
+///   size_t NumArguments;
+///   char MetadataBytes[pattern->MetadataSize];
+///
+/// The entry is used in place, so it must be writable.
+struct PrespecializedMetadataRecord {
+  GenericMetadata *Pattern;
+  Metadata *Instance;
+};
+
 /// The structure of a protocol conformance record.
 ///
 /// This contains enough static information to recover the witness table for a
@@ -2768,6 +2785,15 @@ extern "C"
 void swift_registerProtocolConformances(const ProtocolConformanceRecord *begin,
                                         const ProtocolConformanceRecord *end);
   
+/// Register a block of prespecialized metadata records. Each one is added to
+/// the cache of its pattern the next time a generic metadata lookup misses,
+/// unless the cache has an entry for the same arguments by then.  The records
+/// must stay valid for the lifetime of the process.
+extern "C"
+void swift_registerPrespecializedMetadata(
+                                     const PrespecializedMetadataRecord *begin,
+                                     const PrespecializedMetadataRecord *end);
+
 /// FIXME: This doesn't belong in the runtime.
 extern "C" void swift_printAny(OpaqueValue *value, const Metadata *type);
 
@@ -0,0 +1,93 @@
+//===--- Stats.h - Runtime statistics ---------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Swift runtime functions for reading the counters and timing histograms
+// that the runtime keeps when it is built with SWIFT_RUNTIME_ENABLE_STATS.
+//
+// The counters are kept per thread and summed up when they are read. If the
+// SWIFT_RUNTIME_STATS environment variable is set to a non-zero value, the
+// statistics are printed to stderr when the process exits.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_RUNTIME_STATS_H
+#define SWIFT_RUNTIME_STATS_H
+
+#include <cstdint>
+
+namespace swift {
+
+/// The runtime event counters, in the order of RuntimeStats.def.
+enum class RuntimeCounter : unsigned {
+#define RUNTIME_COUNTER(Name, Description) Name,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+/// The runtime timers, in the order of RuntimeStats.def.
+enum class RuntimeTimer : unsigned {
+#define RUNTIME_TIMER(Name, Description) Name,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+enum : unsigned {
+  NumRuntimeCounters = 0
+#define RUNTIME_COUNTER(Name, Description) + 1
+#include "swift/Runtime/RuntimeStats.def"
+  ,
+  NumRuntimeTimers = 0
+#define RUNTIME_TIMER(Name, Description) + 1
+#include "swift/Runtime/RuntimeStats.def"
+  ,
+  /// Bucket i of a timer counts operations which took less than 2^(i+1)
+  /// nanoseconds and, except for bucket 0, at least 2^i nanoseconds. The last
+  /// bucket also counts everything slower.
+  NumRuntimeTimerBuckets = 32
+};
+
+/// Returns true if the runtime was built to keep statistics. If it was not,
+/// all counters and timers read as zero.
+extern "C" bool swift_stats_isEnabled();
+
+/// Returns the number of counters.
+extern "C" unsigned swift_stats_getNumCounters();
+
+/// Returns the name of the given counter, or null if the index is out of
+/// range.
+extern "C" const char *swift_stats_getCounterName(unsigned counter);
+
+/// Returns the value of the given counter, summed over all threads.
+extern "C" uint64_t swift_stats_getCounter(unsigned counter);
+
+/// Returns the number of timers.
+extern "C" unsigned swift_stats_getNumTimers();
+
+/// Returns the name of the given timer, or null if the index is out of range.
+extern "C" const char *swift_stats_getTimerName(unsigned timer);
+
+/// Returns the number of histogram buckets of each timer.
+extern "C" unsigned swift_stats_getNumTimerBuckets();
+
+/// Returns the number of timed operations in the given histogram bucket,
+/// summed over all threads.
+extern "C" uint64_t swift_stats_getTimerBucket(unsigned timer,
+                                               unsigned bucket);
+
+/// Sets all counters and timers back to zero. Events which other threads
+/// record while the statistics are being reset may be lost.
+extern "C" void swift_stats_reset();
+
+/// Prints all non-zero counters and timers to stderr.
+extern "C" void swift_stats_dump();
+
+} // end namespace swift
+
+#endif
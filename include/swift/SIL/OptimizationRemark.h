@@ -0,0 +1,210 @@
+//===--- OptimizationRemark.h - Remarks from SIL optimizations --*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Optimization remarks say what a SIL optimization did at a place in the
+// source, e.g. that a call was inlined, or why it didn't, e.g. that an
+// allocation stays on the heap because it escapes.
+//
+// Remarks are written to the optimization record of the module
+// (-save-optimization-record-path), one YAML document per remark in the
+// format of LLVM's optimization records:
+//
+//   --- !Missed
+//   Pass:            sil-inliner
+//   Name:            TooCostly
+//   DebugLoc:        { File: 'main.swift', Line: 12, Column: 7 }
+//   Function:        _TF4main3runFT_T_
+//   Args:
+//     - Callee:          'main.update () -> ()'
+//     - String:          ' was not inlined: cost '
+//     - Cost:            '120'
+//   ...
+//
+// The remarks of the passes whose name matches -Rpass (for things which were
+// done) or -Rpass-missed (for things which weren't) are also printed.
+//
+// A pass may miss the same optimization each time it runs, e.g. the inliner
+// rejects a call in each of its iterations and in each place of the pass
+// pipeline where it runs. A missed remark is only emitted the first time.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_SIL_OPTIMIZATIONREMARK_H
+#define SWIFT_SIL_OPTIMIZATIONREMARK_H
+
+#include "swift/Basic/SourceLoc.h"
+#include "swift/SIL/SILInstruction.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+
+namespace swift {
+
+class SILFunction;
+class SILModule;
+class SILOptions;
+class SourceManager;
+
+namespace OptRemark {
+
+/// One piece of the message of a remark. Pieces other than plain strings have
+/// a key, under which they appear in the optimization record.
+struct Argument {
+  std::string Key;
+  std::string Val;
+
+  Argument(StringRef Str) : Key("String"), Val(Str) {}
+  Argument(const char *Str) : Key("String"), Val(Str) {}
+  Argument(StringRef Key, StringRef Val) : Key(Key), Val(Val) {}
+  Argument(StringRef Key, unsigned N);
+  /// Names \p F by its demangled name.
+  Argument(StringRef Key, SILFunction *F);
+  Argument(StringRef Key, SILType Ty);
+};
+
+enum class RemarkKind {
+  /// The optimization was done.
+  Passed,
+  /// The optimization wasn't done.
+  Missed,
+};
+
+/// A remark about the instruction it is constructed with, whose message is
+/// built up with operator<<.
+class Remark {
+  RemarkKind Kind;
+  StringRef Identifier;
+  SILInstruction *Inst;
+  StringRef PassName;
+
+  friend class Emitter;
+
+protected:
+  SmallVector<Argument, 4> Args;
+
+  Remark(RemarkKind Kind, StringRef Identifier, SILInstruction &I)
+    : Kind(Kind), Identifier(Identifier), Inst(&I) {}
+
+public:
+  RemarkKind getKind() const { return Kind; }
+
+  /// A name for the kind of thing the remark says, such as "Inlined".
+  StringRef getIdentifier() const { return Identifier; }
+
+  StringRef getPassName() const { return PassName; }
+  SILInstruction *getInstruction() const { return Inst; }
+  ArrayRef<Argument> getArgs() const { return Args; }
+
+  /// Returns the message: the values of the arguments, run together.
+  std::string getMessage() const;
+};
+
+/// Gives a remark an operator<< which returns the remark as its own class,
+/// so that a remark built in a single expression keeps its kind.
+template <typename DerivedT>
+class RemarkBase : public Remark {
+protected:
+  RemarkBase(RemarkKind Kind, StringRef Identifier, SILInstruction &I)
+    : Remark(Kind, Identifier, I) {}
+
+public:
+  DerivedT &operator<<(Argument A) {
+    Args.push_back(std::move(A));
+    return *static_cast<DerivedT *>(this);
+  }
+};
+
+/// A remark that the optimization was done.
+struct RemarkPassed : public RemarkBase<RemarkPassed> {
+  static const RemarkKind Kind = RemarkKind::Passed;
+  RemarkPassed(StringRef Identifier, SILInstruction &I)
+    : RemarkBase(Kind, Identifier, I) {}
+};
+
+/// A remark that the optimization wasn't done, and why.
+struct RemarkMissed : public RemarkBase<RemarkMissed> {
+  static const RemarkKind Kind = RemarkKind::Missed;
+  RemarkMissed(StringRef Identifier, SILInstruction &I)
+    : RemarkBase(Kind, Identifier, I) {}
+};
+
+/// Where the remarks of a module go: to the optimization record, and to
+/// llvm::errs() for the passes selected with -Rpass and -Rpass-missed.
+///
+/// Passes running on several threads may emit remarks at the same time.
+class RemarkStreamer {
+  SourceManager &SM;
+  const SILOptions &Options;
+  std::unique_ptr<llvm::raw_ostream> RecordOS;
+  llvm::sys::Mutex Lock;
+
+  /// The missed remarks emitted so far, by pass, identifier, function,
+  /// location and message.
+  llvm::StringSet<> EmittedMissed;
+
+  /// Returns true if \p R is a missed remark which was emitted before.
+  bool isRepeatedMissed(const Remark &R);
+
+  void writeRecord(const Remark &R);
+  void print(const Remark &R);
+
+public:
+  RemarkStreamer(SourceManager &SM, const SILOptions &Options)
+    : SM(SM), Options(Options) {}
+
+  /// Writes all remarks from now on to \p OS, in addition to printing the
+  /// ones selected by the options.
+  void setRecordStream(std::unique_ptr<llvm::raw_ostream> OS) {
+    RecordOS = std::move(OS);
+  }
+
+  /// Returns true if remarks of \p Kind from \p PassName are wanted.
+  bool isEnabled(RemarkKind Kind, StringRef PassName);
+
+  void emit(const Remark &R);
+};
+
+/// Emits the remarks of one pass.
+class Emitter {
+  RemarkStreamer &Streamer;
+  StringRef PassName;
+  bool PassedEnabled;
+  bool MissedEnabled;
+
+  void emitRemark(Remark &R);
+
+public:
+  Emitter(StringRef PassName, SILModule &M);
+
+  bool isEnabled(RemarkKind Kind) const {
+    return Kind == RemarkKind::Passed ? PassedEnabled : MissedEnabled;
+  }
+
+  /// Emits the remark returned by \p RemarkBuilder, which is only called if
+  /// the remark is wanted, so it may take its time.
+  template <typename RemarkBuilderT>
+  void emit(RemarkBuilderT RemarkBuilder) {
+    using RemarkT = decltype(RemarkBuilder());
+    if (!isEnabled(RemarkT::Kind))
+      return;
+    RemarkT R = RemarkBuilder();
+    emitRemark(R);
+  }
+};
+
+} // end namespace OptRemark
+} // end namespace swift
+
+#endif
@@ -47,6 +47,10 @@ private:
   /// The ordered set of instructions in the SILBasicBlock.
   InstListType InstList;
 
+  /// How many times the block ran according to the profile read with
+  /// -profile-use, if it has a counter in the profile.
+  Optional<uint64_t> ExecutionCount;
+
   friend struct llvm::ilist_sentinel_traits<SILBasicBlock>;
   friend struct llvm::ilist_traits<SILBasicBlock>;
   SILBasicBlock() : Parent(0) {}
@@ -78,6 +82,11 @@ public:
   /// Returns true if this BB is the entry BB of its parent.
   bool isEntry() const;
 
+  /// Returns how many times the block ran according to the profile, if known.
+  Optional<uint64_t> getExecutionCount() const { return ExecutionCount; }
+
+  void setExecutionCount(uint64_t Count) { ExecutionCount = Count; }
+
   //===--------------------------------------------------------------------===//
   // SILInstruction List Inspection and Manipulation
   //===--------------------------------------------------------------------===//
@@ -982,13 +982,15 @@ public:
     return insert(new (F.getModule())
                       CopyBlockInst(createSILDebugLocation(Loc), Operand));
   }
-  StrongRetainInst *createStrongRetain(SILLocation Loc, SILValue Operand) {
-    return insert(new (F.getModule())
-                      StrongRetainInst(createSILDebugLocation(Loc), Operand));
-  }
-  StrongReleaseInst *createStrongRelease(SILLocation Loc, SILValue Operand) {
-    return insert(new (F.getModule())
-                      StrongReleaseInst(createSILDebugLocation(Loc), Operand));
+  StrongRetainInst *createStrongRetain(SILLocation Loc, SILValue Operand,
+                                       bool isNonAtomic = false) {
+    return insert(new (F.getModule()) StrongRetainInst(
+        createSILDebugLocation(Loc), Operand, isNonAtomic));
+  }
+  StrongReleaseInst *createStrongRelease(SILLocation Loc, SILValue Operand,
+                                         bool isNonAtomic = false) {
+    return insert(new (F.getModule()) StrongReleaseInst(
+        createSILDebugLocation(Loc), Operand, isNonAtomic));
   }
   StrongRetainAutoreleasedInst *
   createStrongRetainAutoreleased(SILLocation Loc, SILValue Operand) {
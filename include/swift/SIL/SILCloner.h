@@ -1410,7 +1410,8 @@ SILCloner<ImplClass>::visitStrongRetainInst(StrongRetainInst *Inst) {
   getBuilder().setCurrentDebugScope(getOpScope(Inst->getDebugScope()));
   doPostProcess(Inst,
     getBuilder().createStrongRetain(getOpLocation(Inst->getLoc()),
-                                    getOpValue(Inst->getOperand())));
+                                    getOpValue(Inst->getOperand()),
+                                    Inst->isNonAtomic()));
 }
 
 template<typename ImplClass>
@@ -1467,7 +1468,8 @@ SILCloner<ImplClass>::visitStrongReleaseInst(StrongReleaseInst *Inst) {
   getBuilder().setCurrentDebugScope(getOpScope(Inst->getDebugScope()));
   doPostProcess(Inst,
     getBuilder().createStrongRelease(getOpLocation(Inst->getLoc()),
-                                     getOpValue(Inst->getOperand())));
+                                     getOpValue(Inst->getOperand()),
+                                     Inst->isNonAtomic()));
 }
 
 template<typename ImplClass>
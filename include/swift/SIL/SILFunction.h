@@ -20,6 +20,7 @@
 #include "swift/SIL/SILBasicBlock.h"
 #include "swift/SIL/SILLinkage.h"
 #include "llvm/ADT/StringMap.h"
+#include <atomic>
 
 /// The symbol name used for the program entry point function.
 /// FIXME: Hardcoding this is lame.
@@ -131,7 +132,10 @@ private:
 
   /// This is the number of uses of this SILFunction inside the SIL.
   /// It does not include references from debug scopes.
-  unsigned RefCount = 0;
+  ///
+  /// It is atomic because function passes running in parallel may add and
+  /// remove references to the same callee.
+  std::atomic<unsigned> RefCount{0};
 
   /// The function's semantics attribute.
   std::string SemanticsAttr;
@@ -213,14 +217,17 @@ public:
 
   /// Increment the reference count.
   void incrementRefCount() {
-    RefCount++;
-    assert(RefCount != 0 && "Overflow of reference count!");
+    unsigned OldRefCount = RefCount++;
+    assert(OldRefCount + 1 != 0 && "Overflow of reference count!");
+    (void)OldRefCount;
   }
 
   /// Decrement the reference count.
   void decrementRefCount() {
-    assert(RefCount != 0 && "Expected non-zero reference count on decrement!");
-    RefCount--;
+    unsigned OldRefCount = RefCount--;
+    assert(OldRefCount != 0 &&
+           "Expected non-zero reference count on decrement!");
+    (void)OldRefCount;
   }
 
   /// Drops all uses belonging to instructions in this function. The only valid
@@ -493,6 +500,14 @@ public:
   SILBasicBlock &front() { return *begin(); }
   const SILBasicBlock &front() const { return *begin(); }
 
+  /// Returns how many times the function was called according to the profile
+  /// read with -profile-use, if known.
+  Optional<uint64_t> getEntryCount() const {
+    if (empty())
+      return None;
+    return front().getExecutionCount();
+  }
+
   SILBasicBlock *createBasicBlock();
 
   /// Splice the body of \p F into this function at end.
@@ -364,6 +364,22 @@ public:
   void setStackAllocatable() { OnStack = true; }
 };
 
+/// A mixin for reference counting instructions which may be lowered to
+/// non-atomic reference counting operations.
+class NonAtomicRefCountable {
+
+  /// If true, the reference counting operation does not need to be atomic
+  /// because the object is only ever accessed from a single thread.
+  bool NonAtomic = false;
+
+public:
+  NonAtomicRefCountable(bool NonAtomic) : NonAtomic(NonAtomic) { }
+
+  bool isNonAtomic() const { return NonAtomic; }
+
+  void setNonAtomic() { NonAtomic = true; }
+};
+
 /// AllocStackInst - This represents the allocation of an unboxed (i.e., no
 /// reference count) stack memory.  The memory is provided uninitialized.
 class AllocStackInst : public AllocationInst {
@@ -3081,12 +3097,15 @@ public:
 class StrongRetainInst
   : public UnaryInstructionBase<ValueKind::StrongRetainInst,
                                 RefCountingInst,
-                                /*HAS_RESULT*/ false>
+                                /*HAS_RESULT*/ false>,
+    public NonAtomicRefCountable
 {
   friend class SILBuilder;
 
-  StrongRetainInst(SILDebugLocation *DebugLoc, SILValue Operand)
-      : UnaryInstructionBase(DebugLoc, Operand) {}
+  StrongRetainInst(SILDebugLocation *DebugLoc, SILValue Operand,
+                   bool isNonAtomic)
+      : UnaryInstructionBase(DebugLoc, Operand),
+        NonAtomicRefCountable(isNonAtomic) {}
 };
 
 /// StrongRetainAutoreleasedInst - Take ownership of the autoreleased return
@@ -3108,12 +3127,15 @@ class StrongRetainAutoreleasedInst
 /// weak reference counts reach zero.
 class StrongReleaseInst
   : public UnaryInstructionBase<ValueKind::StrongReleaseInst,
-                                RefCountingInst, /*HAS_RESULT*/ false>
+                                RefCountingInst, /*HAS_RESULT*/ false>,
+    public NonAtomicRefCountable
 {
   friend class SILBuilder;
 
-  StrongReleaseInst(SILDebugLocation *DebugLoc, SILValue Operand)
-      : UnaryInstructionBase(DebugLoc, Operand) {}
+  StrongReleaseInst(SILDebugLocation *DebugLoc, SILValue Operand,
+                    bool isNonAtomic)
+      : UnaryInstructionBase(DebugLoc, Operand),
+        NonAtomicRefCountable(isNonAtomic) {}
 };
 
 /// StrongRetainUnownedInst - Increase the strong reference count of an object
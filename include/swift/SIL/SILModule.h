@@ -37,6 +37,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/ilist.h"
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include <functional>
 
@@ -54,6 +55,10 @@ namespace swift {
     class SILGenModule;
   }
 
+  namespace OptRemark {
+    class RemarkStreamer;
+  }
+
 /// \brief A stage of SIL processing.
 enum class SILStage {
   /// \brief "Raw" SIL, emitted by SILGen, but not yet run through guaranteed
@@ -100,6 +105,13 @@ private:
   mutable llvm::BumpPtrAllocator BPA;
   void *TypeListUniquing;
 
+  /// Guards the allocator and the caches which passes running on different
+  /// functions share, while function passes run on several threads.
+  mutable llvm::sys::Mutex SharedStateLock;
+
+  /// True while function passes run on several threads.
+  bool Multithreaded = false;
+
   /// The swift Module associated with this SILModule.
   ModuleDecl *TheSwiftModule;
 
@@ -146,10 +158,12 @@ private:
   CoverageMapListType coverageMaps;
 
   /// This is a cache of intrinsic Function declarations to numeric ID mappings.
-  llvm::DenseMap<Identifier, IntrinsicInfo> IntrinsicIDCache;
+  /// The entries are allocated separately so that references to them stay
+  /// valid while other threads add entries.
+  llvm::DenseMap<Identifier, std::unique_ptr<IntrinsicInfo>> IntrinsicIDCache;
 
   /// This is a cache of builtin Function declarations to numeric ID mappings.
-  llvm::DenseMap<Identifier, BuiltinInfo> BuiltinIDCache;
+  llvm::DenseMap<Identifier, std::unique_ptr<BuiltinInfo>> BuiltinIDCache;
 
   /// This is the set of undef values we've created, for uniquing purposes.
   llvm::DenseMap<SILType, SILUndef *> UndefValues;
@@ -178,6 +192,9 @@ private:
   /// The options passed into this SILModule.
   SILOptions &Options;
 
+  /// Where the optimization remarks about this module go.
+  std::unique_ptr<OptRemark::RemarkStreamer> RemarkStreamer;
+
   // Intentionally marked private so that we need to use 'constructSIL()'
   // to construct a SILModule.
   SILModule(ModuleDecl *M, SILOptions &Options, const DeclContext *associatedDC,
@@ -264,6 +281,10 @@ public:
 
   SILOptions &getOptions() const { return Options; }
 
+  OptRemark::RemarkStreamer &getRemarkStreamer() const {
+    return *RemarkStreamer;
+  }
+
   using iterator = FunctionListType::iterator;
   using const_iterator = FunctionListType::const_iterator;
   FunctionListType &getFunctionList() { return functions; }
@@ -503,9 +524,41 @@ public:
     if (getASTContext().LangOpts.UseMalloc)
       return AlignedAlloc(Size, Align);
 
+    SharedStateGuard Guard(*this);
     return BPA.Allocate(Size, Align);
   }
 
+  /// Locks the allocator and the caches of the module (type lowering, type
+  /// lists and undef values) for its lifetime, if function passes are running
+  /// on several threads. The use lists of the undef values, which all
+  /// functions share, have a lock of their own (see Operand).
+  class SharedStateGuard {
+    llvm::sys::Mutex *Lock;
+
+  public:
+    explicit SharedStateGuard(const SILModule &M)
+      : Lock(M.Multithreaded ? &M.SharedStateLock : nullptr) {
+      if (Lock)
+        Lock->lock();
+    }
+
+    ~SharedStateGuard() {
+      if (Lock)
+        Lock->unlock();
+    }
+
+    SharedStateGuard(const SharedStateGuard &) = delete;
+    SharedStateGuard &operator=(const SharedStateGuard &) = delete;
+  };
+
+  /// Sets whether function passes are running on several threads. This is
+  /// done by the pass manager before it starts and after it has joined them.
+  void setMultithreaded(bool Value) {
+    if (Value != Multithreaded)
+      Operand::setSharingUndefs(Value);
+    Multithreaded = Value;
+  }
+
   /// \brief Looks up the llvm intrinsic ID and type for the builtin function.
   ///
   /// \returns Returns llvm::Intrinsic::not_intrinsic if the function is not an
@@ -23,6 +23,7 @@
 #include "llvm/ADT/PointerUnion.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/Support/raw_ostream.h"
+#include <atomic>
 
 namespace swift {
   class SILTypeList;
@@ -319,6 +320,12 @@ class Operand {
   /// FIXME: this could be space-compressed.
   SILInstruction *Owner;
 
+  /// The number of modules whose functions are being optimized on several
+  /// threads. SILUndef values are the only values shared by the functions of
+  /// a module, so while this isn't zero their use lists are changed under a
+  /// lock.
+  static std::atomic<unsigned> ModulesSharingUndefs;
+
   Operand(SILInstruction *owner) : Owner(owner) {}
   Operand(SILInstruction *owner, SILValue theValue)
       : TheValue(theValue), Owner(owner) {
@@ -381,14 +388,35 @@ public:
   void hoistAddressProjections(SILInstruction *InsertBefore,
                                DominanceInfo *DomTree);
 
+  /// Called by SILModule::setMultithreaded when a module starts or stops
+  /// running function passes on several threads.
+  static void setSharingUndefs(bool Value) {
+    if (Value)
+      ++ModulesSharingUndefs;
+    else
+      --ModulesSharingUndefs;
+  }
+
 private:
+  /// Returns true if this operand's use list may be changed by other threads
+  /// at the same time.
+  bool isSharedUse() const {
+    return TheValue->getKind() == ValueKind::SILUndef &&
+           ModulesSharingUndefs.load(std::memory_order_relaxed) != 0;
+  }
+
+  void removeFromCurrentLocked();
+  void insertIntoCurrentLocked();
+
   void removeFromCurrent() {
     if (!Back) return;
+    if (LLVM_UNLIKELY(isSharedUse())) return removeFromCurrentLocked();
     *Back = NextUse;
     if (NextUse) NextUse->Back = Back;
   }
 
   void insertIntoCurrent() {
+    if (LLVM_UNLIKELY(isSharedUse())) return insertIntoCurrentLocked();
     Back = &TheValue->FirstUse;
     NextUse = TheValue->FirstUse;
     if (NextUse) NextUse->Back = &NextUse;
@@ -15,6 +15,7 @@
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Mutex.h"
 #include <vector>
 
 #ifndef SWIFT_SILANALYSIS_ANALYSIS_H
@@ -110,6 +111,11 @@ namespace swift {
     /// Return True if this analysis is locked and should not be invalidated.
     bool isLocked() { return invalidationLock; }
 
+    /// Return True if the analysis only holds information about individual
+    /// functions, which is computed from the function alone. Function passes
+    /// running in parallel on different functions may use such an analysis.
+    virtual bool isFunctionAnalysis() const { return false; }
+
     /// Invalidate all information in this analysis.
     virtual void invalidate(InvalidationKind K) {}
 
@@ -141,6 +147,9 @@ namespace swift {
     /// Maps functions to their analysis provider.
     StorageTy Storage;
 
+    /// Guards Storage while function passes run in parallel.
+    mutable llvm::sys::Mutex StorageLock;
+
     /// Construct a new empty analysis for a specific function \p F.
     virtual AnalysisTy *newFunctionAnalysis(SILFunction *F) = 0;
 
@@ -159,15 +168,27 @@ namespace swift {
       // Check that the analysis can handle this function.
       verifyFunction(F);
 
-      auto &it = Storage.FindAndConstruct(F);
-      if (!it.second)
-        it.second = newFunctionAnalysis(F);
-      return it.second;
+      {
+        llvm::sys::ScopedLock Locked(StorageLock);
+        auto it = Storage.find(F);
+        if (it != Storage.end() && it->second)
+          return it->second;
+      }
+
+      // Compute the analysis without holding the lock. Only the pass working
+      // on F asks for it, so no one else can compute it at the same time.
+      AnalysisTy *A = newFunctionAnalysis(F);
+      llvm::sys::ScopedLock Locked(StorageLock);
+      Storage[F] = A;
+      return A;
     }
 
+    virtual bool isFunctionAnalysis() const override { return true; }
+
     virtual void invalidate(SILAnalysis::InvalidationKind K) override {
       if (!shouldInvalidate(K)) return;
 
+      llvm::sys::ScopedLock Locked(StorageLock);
       for (auto D : Storage)
         delete D.second;
 
@@ -178,6 +199,7 @@ namespace swift {
                             SILAnalysis::InvalidationKind K) override {
       if (!shouldInvalidate(K)) return;
 
+      llvm::sys::ScopedLock Locked(StorageLock);
       auto &it = Storage.FindAndConstruct(F);
       if (it.second) {
         delete it.second;
@@ -199,6 +221,7 @@ namespace swift {
     /// This is not meant to be overridden by subclasses. See "void
     /// verify(AnalysisTy *A)".
     virtual void verify() const override final {
+      llvm::sys::ScopedLock Locked(StorageLock);
       for (auto Iter : Storage) {
         if (!Iter.second)
           continue;
@@ -212,6 +235,7 @@ namespace swift {
     /// This is not meant to be overridden by subclasses. See "void
     /// verify(AnalysisTy *A)".
     virtual void verify(SILFunction *F) const override final {
+      llvm::sys::ScopedLock Locked(StorageLock);
       auto Iter = Storage.find(F);
       if (Iter == Storage.end())
         return;
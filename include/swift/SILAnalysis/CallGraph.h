@@ -359,6 +359,9 @@ public:
     return BottomUpSCCOrder;
   }
 
+  /// Forces recomputation of the bottom-up SCC list.
+  void invalidateBottomUpSCCOrder() { clearBottomUpSCCOrder(); }
+
   /// Forces recomputation of the bottom-up function list.
   void invalidateBottomUpFunctionOrder() { BottomUpFunctionOrder.clear(); }
 
@@ -38,6 +38,9 @@ public:
 
   static bool isSlowPath(const SILBasicBlock *FromBB, const SILBasicBlock *ToBB);
 
+  /// Returns true if \p BB has a count in the profile which says it is cold.
+  static bool isColdInProfile(const SILBasicBlock *BB);
+
   bool isCold(const SILBasicBlock *BB);
 };
 } // end namespace swift
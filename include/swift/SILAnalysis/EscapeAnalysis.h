@@ -18,6 +18,7 @@
 #include "swift/SILAnalysis/Analysis.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/SmallBitVector.h"
 
@@ -27,7 +28,6 @@ namespace swift {
 
 class BasicCalleeAnalysis;
 class CallGraphAnalysis;
-class CallGraph;
 
 /// The EscapeAnalysis provides information if the lifetime of an object exceeds
 /// the scope of a function.
@@ -38,7 +38,8 @@ class CallGraph;
 ///
 /// We compute the escape analysis by building a connection graph for each
 /// function. For the interprocedural analysis the connection graphs are merged
-/// in bottom-up order of the call graph.
+/// in bottom-up order of the call graph. The functions of a call-graph SCC are
+/// merged repeatedly until their summary graphs don't change anymore.
 /// The idea is based on "Escape analysis for Java." by J.-D. Choi, M. Gupta, M.
 /// Serrano, V. C. Sreedhar, and S. Midkiff
 /// http://dx.doi.org/10.1145/320384.320386
@@ -278,6 +279,13 @@ private:
 
     /// Returns true if the node's value escapes from its function.
     bool escapes() const { return getEscapeState() != EscapeState::None; }
+
+    /// Returns true if the node's value escapes to global or unidentified
+    /// memory, and not just to the caller through an argument or the return
+    /// value.
+    bool escapesGlobally() const {
+      return getEscapeState() == EscapeState::Global;
+    }
   };
 
   /// Mapping from nodes in a calleee-graph to nodes in a caller-graph.
@@ -524,7 +532,8 @@ public:
 private:
 
   enum {
-    /// A limit for the interprocedural algorithm.
+    /// A limit for the interprocedural algorithm: the number of times the
+    /// graphs of the functions in a call-graph SCC are merged.
     MaxGraphMerges = 4
   };
 
@@ -540,15 +549,16 @@ private:
     /// The summary graph for the function. It is used when computing the
     /// connection graph of caller functions.
     /// This graph is _not_ be invalidated on invalidation. It is only updated
-    /// when explicitly calling recompute().
+    /// when explicitly calling recompute() or when the connection graph is
+    /// rebuilt.
     ConnectionGraph SummaryGraph;
 
     /// The callsites from which we have to merge the callee graphs.
     llvm::SmallVector<FullApplySite, 8> KnownCallees;
 
-    /// If true, at least one of the callee graphs has changed. We have to merge
-    /// them again.
-    bool NeedMergeCallees = false;
+    /// True if the summary graph includes the effects of all callees, so that
+    /// it can be merged into the graphs of callers.
+    bool SummaryComplete = false;
 
     /// True if the Graph is valid.
     bool Valid = false;
@@ -618,8 +628,12 @@ private:
   /// Sets all operands and results of \p I as global escaping.
   void setAllEscaping(SILInstruction *I, ConnectionGraph *ConGraph);
 
-  /// Merge the graphs of all known callees into this graph.
-  bool mergeAllCallees(FunctionInfo *FInfo, CallGraph &CG);
+  /// Merge the summary graphs of all known callees into this graph.
+  /// Callees with incomplete summary graphs, except the functions in \p SCC,
+  /// are handled like unknown functions.
+  /// Returns true if any of the callees is in \p SCC.
+  bool mergeAllCallees(FunctionInfo *FInfo,
+                       const llvm::SmallPtrSetImpl<SILFunction *> &SCC);
 
   /// Merges the graph of a callee function into the graph of
   /// a caller function, whereas \p FAS is the call-site.
@@ -631,8 +645,14 @@ private:
   bool mergeSummaryGraph(ConnectionGraph *SummaryGraph,
                          ConnectionGraph *Graph);
 
-  /// Set all arguments and return values of all callees to global escaping.
-  void finalizeGraphsConservatively(FunctionInfo *FInfo);
+  /// Set all arguments and return values of all callees in \p SCC to global
+  /// escaping.
+  void finalizeGraphsConservatively(
+      FunctionInfo *FInfo, const llvm::SmallPtrSetImpl<SILFunction *> &SCC);
+
+  /// Rebuilds the invalidated connection graph of a function, using the
+  /// summary graphs of its callees.
+  void rebuildConnectionGraph(FunctionInfo *FInfo);
 
   friend struct ::CGForDotView;
 
@@ -652,7 +672,7 @@ public:
       FInfo = new (Allocator.Allocate()) FunctionInfo(F);
 
     if (!FInfo->Valid)
-      buildConnectionGraphs(FInfo);
+      rebuildConnectionGraph(FInfo);
 
     return &FInfo->Graph;
   }
@@ -59,7 +59,11 @@ class SILPassManager {
 
   /// Set to true when a pass invalidates an analysis.
   bool currentPassHasInvalidated = false;
-  
+
+  /// True while function passes run on several threads, see
+  /// runFunctionPassesInParallel.
+  bool RunningInParallel = false;
+
 public:
   /// C'tor. It creates and registers all analysis passes, which are defined
   /// in Analysis.def.
@@ -72,8 +76,11 @@ public:
   template<typename T>
   T *getAnalysis() {
     for (SILAnalysis *A : Analysis)
-      if (T *R = llvm::dyn_cast<T>(A))
+      if (T *R = llvm::dyn_cast<T>(A)) {
+        assert((!RunningInParallel || R->isFunctionAnalysis()) &&
+               "passes running in parallel may only use function analyses");
         return R;
+      }
 
     llvm_unreachable("Unable to find analysis for requested type.");
   }
@@ -91,6 +98,8 @@ public:
   void invalidateAnalysis(SILAnalysis::InvalidationKind K) {
     assert(K != SILAnalysis::InvalidationKind::Nothing &&
            "Invalidation call must invalidate some trait");
+    assert(!RunningInParallel &&
+           "passes running in parallel may only invalidate their function");
 
     for (auto AP : Analysis)
       if (!AP->isLocked())
@@ -105,6 +114,11 @@ public:
   /// \brief Broadcast the invalidation of the function to all analysis.
   void invalidateAnalysis(SILFunction *F,
                           SILAnalysis::InvalidationKind K) {
+    if (RunningInParallel) {
+      invalidateAnalysisInParallel(F, K);
+      return;
+    }
+
     // Invalidate the analysis (unless they are locked)
     for (auto AP : Analysis)
       if (!AP->isLocked())
@@ -160,6 +174,32 @@ private:
   /// if the pass manager requested to stop the execution
   /// of the optimization cycle (this is a debug feature).
   bool runFunctionPasses(PassList FuncTransforms);
+
+  /// Run the passes in \p FuncTransforms on one function after the other.
+  bool runFunctionPassesSerially(PassList FuncTransforms);
+
+  /// Returns true if function-local passes may run on several threads.
+  bool canRunFunctionPassesInParallel() const;
+
+  /// Run the function-local passes in \p FuncTransforms on the functions of
+  /// the module, on as many threads as SILOptions::NumThreads says.
+  ///
+  /// The functions are handed out in bottom-up order of the call graph: a
+  /// function is only optimized once the functions it calls are done, and
+  /// the functions of a strongly connected component are optimized on one
+  /// thread, so a pass can read the bodies of callees. The module's shared
+  /// state is locked (see SILModule::SharedStateGuard) and the invalidation
+  /// of analyses other than function analyses is deferred until all threads
+  /// are done.
+  void runFunctionPassesInParallel(PassList FuncTransforms);
+
+  /// Run the current thread's instances of the passes on \p F, while
+  /// function passes run in parallel.
+  void runFunctionPassesOnThread(SILFunction &F);
+
+  /// Handles the invalidation of \p F by a pass running in parallel.
+  void invalidateAnalysisInParallel(SILFunction *F,
+                                    SILAnalysis::InvalidationKind K);
 };
 
 } // end namespace swift
@@ -94,6 +94,14 @@ namespace swift {
 
     void injectFunction(SILFunction *Func) { F = Func; }
 
+    /// Returns true if the pass changes nothing but the function it runs on,
+    /// and uses no analyses other than function analyses (see
+    /// SILAnalysis::isFunctionAnalysis). It may read the bodies of the
+    /// functions the function calls, but must not create or erase functions.
+    ///
+    /// Such a pass may run on several functions at once.
+    virtual bool isFunctionLocal() { return false; }
+
   protected:
     SILFunction *getFunction() { return F; }
 
@@ -11,7 +11,9 @@
 //===----------------------------------------------------------------------===//
 //
 // This containts the definition of a cloner class for creating specialized
-// versions of generic functions by substituting concrete types.
+// versions of generic functions by substituting concrete types, either for
+// all of their generic parameters or, in a partial specialization, for some
+// of them.
 //
 //===----------------------------------------------------------------------===//
 
@@ -40,9 +42,10 @@ public:
                 TypeSubstitutionMap &ContextSubs,
                 StringRef NewName,
                 ArrayRef<Substitution> ApplySubs,
-                CloneCollector::CallbackType Callback)
-  : TypeSubstCloner(*initCloned(F, InterfaceSubs, NewName), *F, ContextSubs,
-                    ApplySubs), Callback(Callback) {
+                CloneCollector::CallbackType Callback,
+                bool KeepGenerics = false)
+  : TypeSubstCloner(*initCloned(F, InterfaceSubs, NewName, KeepGenerics), *F,
+                    ContextSubs, ApplySubs), Callback(Callback) {
     assert(F->getDebugScope()->SILFn != getCloned()->getDebugScope()->SILFn);
   }
   /// Clone and remap the types in \p F according to the substitution
@@ -60,6 +63,25 @@ public:
     return SC.getCloned();
   }
 
+  /// Clone \p F, substituting the concrete types in \p InterfaceSubs and
+  /// \p ContextSubs for some of its generic parameters. The clone keeps the
+  /// generic signature and the context generic parameters of \p F, and the
+  /// parameters which aren't substituted stay generic.
+  ///
+  /// \p ApplySubs has one entry for each substitution of a call to \p F,
+  /// which for the parameters that stay generic maps them to themselves.
+  static SILFunction *
+  clonePartially(SILFunction *F, TypeSubstitutionMap &InterfaceSubs,
+                 TypeSubstitutionMap &ContextSubs, StringRef NewName,
+                 ArrayRef<Substitution> ApplySubs,
+                 CloneCollector::CallbackType Callback = nullptr) {
+    GenericCloner SC(F, InterfaceSubs, ContextSubs, NewName, ApplySubs,
+                     Callback, /*KeepGenerics=*/true);
+    SC.populateCloned();
+    SC.cleanUp(SC.getCloned());
+    return SC.getCloned();
+  }
+
 protected:
   // FIXME: We intentionally call SILClonerWithScopes here to ensure
   //        the debug scopes are set correctly for cloned
@@ -78,7 +100,7 @@ protected:
 private:
   static SILFunction *initCloned(SILFunction *Orig,
                                  TypeSubstitutionMap &InterfaceSubs,
-                                 StringRef NewName);
+                                 StringRef NewName, bool KeepGenerics);
   /// Clone the body of the function into the empty function that was created
   /// by initCloned.
   void populateCloned();
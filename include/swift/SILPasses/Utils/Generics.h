@@ -28,6 +28,34 @@
 
 namespace swift {
 
+/// Why a call of a generic function was not specialized.
+enum class SpecializationFailure {
+  /// The callee is excluded from optimization.
+  NotOptimized,
+  /// The body of the callee isn't available.
+  NoBody,
+  /// A substitution refers to the dynamic Self type.
+  DynamicSelf,
+  /// None of the generic parameters is bound to a concrete type.
+  NoConcreteParameter,
+  /// Only some of the generic parameters are bound to concrete types, and
+  /// the callee refers to itself, which partial specialization can't handle.
+  RecursivePartialSpecialization,
+  /// Only some of the generic parameters are bound to concrete types, and
+  /// the callee is itself a partial specialization.
+  AlreadyPartiallySpecialized,
+  /// New specializations aren't created without optimization.
+  OptimizationDisabled,
+};
+
+/// Emits an optimization remark that \p Apply was not specialized, and why.
+void remarkMissedSpecialization(ApplySite Apply, SpecializationFailure Reason);
+
+/// Specializes \p Apply, replacing it with a call of the specialization.
+///
+/// If only some of the substitutions of \p Apply are concrete, the
+/// specialization stays generic over the remaining parameters, and is shared
+/// by all calls which bind the same parameters to the same types.
 ApplySite trySpecializeApplyOfGeneric(ApplySite Apply,
                                       SILFunction *&NewFunction,
                                       CloneCollector &Collector);
@@ -18,13 +18,18 @@
 #ifndef SWIFT_SILPASSES_UTILS_LOOPUTILS_H
 #define SWIFT_SILPASSES_UTILS_LOOPUTILS_H
 
+#include "swift/SIL/Dominance.h"
+#include "swift/SIL/SILCloner.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
 namespace swift {
 
 class SILFunction;
 class SILBasicBlock;
 class SILLoop;
-class DominanceInfo;
 class SILLoopInfo;
+class SILSSAUpdater;
 
 /// Canonicalize the loop for rotation and downstream passes.
 ///
@@ -53,6 +58,53 @@ public:
   virtual void runOnFunction(SILFunction *F) = 0;
 };
 
+/// Checks whether we can build SSA form after cloning the loop \p L for
+/// values of the instruction \p I.
+bool canCloneLoopInst(SILInstruction *I, SILLoop *L);
+
+/// Clone a single exit multiple exit region starting at basic block and ending
+/// in a set of basic blocks. Updates the dominator tree with the cloned blocks.
+/// However, the client needs to update the dominator of the exit blocks.
+class RegionCloner : public SILCloner<RegionCloner> {
+  DominanceInfo &DomTree;
+  SILBasicBlock *StartBB;
+  llvm::SmallPtrSet<SILBasicBlock *, 16> OutsideBBs;
+
+  friend class SILVisitor<RegionCloner>;
+  friend class SILCloner<RegionCloner>;
+
+public:
+  RegionCloner(SILBasicBlock *EntryBB,
+               SmallVectorImpl<SILBasicBlock *> &ExitBlocks, DominanceInfo &DT)
+      : SILCloner<RegionCloner>(*EntryBB->getParent()), DomTree(DT),
+        StartBB(EntryBB), OutsideBBs(ExitBlocks.begin(), ExitBlocks.end()) {}
+
+  SILBasicBlock *cloneRegion();
+
+  llvm::MapVector<SILBasicBlock *, SILBasicBlock *> &getBBMap() { return BBMap; }
+
+  /// Returns the clone of the instruction \p I of the region.
+  SILInstruction *getMappedInst(SILInstruction *I) {
+    return InstructionMap.lookup(I);
+  }
+
+protected:
+  /// Clone the dominator tree from the original region to the cloned region.
+  void fixDomTreeNodes(DominanceInfoNode *OrigNode);
+
+  SILValue remapValue(SILValue V);
+
+  void postProcess(SILInstruction *Orig, SILInstruction *Cloned) {
+    SILCloner<RegionCloner>::postProcess(Orig, Cloned);
+  }
+
+  /// Update SSA form for values that are used outside the region.
+  void updateSSAForValue(SILBasicBlock *OrigBB, SILValue V,
+                         SILSSAUpdater &SSAUp);
+
+  void updateSSAForm();
+};
+
 } // end swift namespace
 
 #endif
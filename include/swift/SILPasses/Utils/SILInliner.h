@@ -70,6 +70,13 @@ private:
   void visitDebugValueInst(DebugValueInst *Inst);
   void visitDebugValueAddrInst(DebugValueAddrInst *Inst);
 
+  /// Gives the blocks cloned from the callee their share of the callee's
+  /// profile counts, for a call which ran \p CallCount times, and takes that
+  /// share out of the callee's own counts. \p ReturnToBB, if not null, is the
+  /// block split off after the call.
+  void scaleProfileCounts(Optional<uint64_t> CallCount,
+                          SILBasicBlock *ReturnToBB);
+
   const SILDebugScope *getOrCreateInlineScope(const SILDebugScope *DS);
 
   void postProcess(SILInstruction *Orig, SILInstruction *Cloned) {
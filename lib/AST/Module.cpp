@@ -1390,6 +1390,62 @@ const clang::Module *Module::findUnderlyingClangModule() {
 // SourceFile Implementation
 //===----------------------------------------------------------------------===//
 
+void SourceFile::endDeclInterfaceHash(ArrayRef<Decl *> decls,
+                                      Optional<DeclInterfaceState> outer) {
+  assert(CurrentDeclInterface && "not hashing a declaration");
+  llvm::MD5::MD5Result result;
+  CurrentDeclInterface->Hash.final(result);
+  SmallString<32> fingerprint;
+  llvm::MD5::stringifyResult(result, fingerprint);
+
+  for (auto *D : decls)
+    DeclFingerprints[D] = fingerprint.str().str();
+
+  // Declarations nested in an active #if block are part of the enclosing
+  // declaration as well.
+  llvm::StringSet<> tokens = std::move(CurrentDeclInterface->Tokens);
+  CurrentDeclInterface = std::move(outer);
+  if (CurrentDeclInterface) {
+    CurrentDeclInterface->Hash.update(fingerprint.str());
+    for (auto &token : tokens)
+      CurrentDeclInterface->Tokens.insert(token.getKey());
+  }
+  DeclInterfaceTokens[fingerprint.str()] = std::move(tokens);
+}
+
+/// Returns the top-level declaration containing \p D, or null.
+static const Decl *getTopLevelDecl(const Decl *D) {
+  while (!D->getDeclContext()->isModuleScopeContext()) {
+    D = D->getDeclContext()->getInnermostDeclarationDeclContext();
+    if (!D)
+      return nullptr;
+  }
+  return D;
+}
+
+StringRef SourceFile::getDeclFingerprint(const Decl *D) const {
+  D = getTopLevelDecl(D);
+  if (!D)
+    return StringRef();
+
+  auto known = DeclFingerprints.find(D);
+  if (known == DeclFingerprints.end())
+    return StringRef();
+  return known->second;
+}
+
+const llvm::StringSet<> *
+SourceFile::getDeclInterfaceTokens(const Decl *D) const {
+  StringRef fingerprint = getDeclFingerprint(D);
+  if (fingerprint.empty())
+    return nullptr;
+
+  auto known = DeclInterfaceTokens.find(fingerprint);
+  if (known == DeclInterfaceTokens.end())
+    return nullptr;
+  return &known->second;
+}
+
 void SourceFile::print(raw_ostream &OS, const PrintOptions &PO) {
   StreamPrinter Printer(OS);
   print(Printer, PO);
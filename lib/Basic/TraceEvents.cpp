@@ -0,0 +1,191 @@
+//===--- TraceEvents.cpp - Chrome trace event recording -------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Basic/TraceEvents.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+using namespace swift;
+
+namespace {
+/// The trace being recorded.
+class Recorder {
+  llvm::sys::Mutex Lock;
+  llvm::raw_fd_ostream OS;
+  bool IsFirstEvent = true;
+
+public:
+  const int64_t Pid;
+
+  Recorder(StringRef Path, std::error_code &EC, int64_t Pid)
+    : OS(Path, EC, llvm::sys::fs::F_Text), Pid(Pid) {
+    OS << "[\n";
+  }
+
+  ~Recorder() {
+    OS << "\n]\n";
+  }
+
+  /// Writes one event, which must be a JSON object on a single line.
+  void write(StringRef Event) {
+    llvm::sys::ScopedLock L(Lock);
+    if (!IsFirstEvent)
+      OS << ",\n";
+    IsFirstEvent = false;
+    OS << Event;
+  }
+};
+} // end anonymous namespace
+
+static std::unique_ptr<Recorder> CurrentRecorder;
+
+/// The number of threads which have recorded an event so far.
+static std::atomic<unsigned> NumThreads(0);
+
+/// Identifies the current thread in the trace; the first thread to record an
+/// event, normally the main thread, is 1.
+static unsigned getThreadID() {
+  static LLVM_THREAD_LOCAL unsigned ThreadID = 0;
+  if (ThreadID == 0)
+    ThreadID = ++NumThreads;
+  return ThreadID;
+}
+
+static int64_t getProcessID() {
+#if HAVE_UNISTD_H
+  return getpid();
+#else
+  return 0;
+#endif
+}
+
+static void writeEscaped(llvm::raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    switch (C) {
+    case '"': OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if (C < 0x20)
+        OS << "\\u00" << "0123456789abcdef"[C >> 4]
+           << "0123456789abcdef"[C & 0xF];
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+static void writeProcessName(int64_t Pid, StringRef ProcessName) {
+  std::string Event;
+  llvm::raw_string_ostream OS(Event);
+  OS << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << Pid
+     << ",\"args\":{\"name\":";
+  writeEscaped(OS, ProcessName);
+  OS << "}}";
+  CurrentRecorder->write(OS.str());
+}
+
+static void writeEvent(int64_t Pid, unsigned Tid, StringRef Category,
+                       StringRef Name, uint64_t Start, uint64_t End,
+                       StringRef Detail) {
+  std::string Event;
+  llvm::raw_string_ostream OS(Event);
+  OS << "{\"name\":";
+  writeEscaped(OS, Name);
+  OS << ",\"cat\":";
+  writeEscaped(OS, Category);
+  OS << ",\"ph\":\"X\",\"ts\":" << Start << ",\"dur\":"
+     << (End > Start ? End - Start : 0) << ",\"pid\":" << Pid
+     << ",\"tid\":" << Tid;
+  if (!Detail.empty()) {
+    OS << ",\"args\":{\"detail\":";
+    writeEscaped(OS, Detail);
+    OS << "}";
+  }
+  OS << "}";
+  CurrentRecorder->write(OS.str());
+}
+
+std::error_code trace::startRecording(StringRef Path, StringRef ProcessName) {
+  assert(!CurrentRecorder && "already recording");
+  std::error_code EC;
+  int64_t Pid = getProcessID();
+  CurrentRecorder.reset(new Recorder(Path, EC, Pid));
+  if (EC) {
+    CurrentRecorder.reset();
+    return EC;
+  }
+  writeProcessName(Pid, ProcessName);
+  return std::error_code();
+}
+
+void trace::stopRecording() {
+  CurrentRecorder.reset();
+}
+
+bool trace::isRecording() {
+  return CurrentRecorder != nullptr;
+}
+
+uint64_t trace::now() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(
+           system_clock::now().time_since_epoch()).count();
+}
+
+void trace::recordEvent(StringRef Category, StringRef Name, uint64_t Start,
+                        uint64_t End, StringRef Detail) {
+  if (!CurrentRecorder)
+    return;
+  writeEvent(CurrentRecorder->Pid, getThreadID(), Category, Name, Start, End,
+             Detail);
+}
+
+void trace::recordProcessEvent(int64_t Pid, StringRef ProcessName,
+                               StringRef Category, StringRef Name,
+                               uint64_t Start, uint64_t End) {
+  if (!CurrentRecorder)
+    return;
+  writeProcessName(Pid, ProcessName);
+  writeEvent(Pid, 0, Category, Name, Start, End, StringRef());
+}
+
+void trace::appendEventsFromFile(StringRef Path) {
+  if (!CurrentRecorder)
+    return;
+  auto Buffer = llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer)
+    return;
+
+  StringRef Rest = Buffer.get()->getBuffer();
+  while (!Rest.empty()) {
+    StringRef Line;
+    std::tie(Line, Rest) = Rest.split('\n');
+    Line = Line.rtrim(",");
+    if (Line.startswith("{"))
+      CurrentRecorder->write(Line);
+  }
+}
@@ -17,13 +17,16 @@
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/Program.h"
 #include "swift/Basic/TaskQueue.h"
+#include "swift/Basic/TraceEvents.h"
 #include "swift/Basic/Version.h"
 #include "swift/Basic/type_traits.h"
 #include "swift/Driver/Action.h"
 #include "swift/Driver/DependencyGraph.h"
 #include "swift/Driver/Driver.h"
 #include "swift/Driver/Job.h"
+#include "swift/Driver/OutputCache.h"
 #include "swift/Driver/ParseableOutput.h"
+#include "swift/Option/Options.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringExtras.h"
@@ -94,6 +97,16 @@ Job *Compilation::addJob(std::unique_ptr<Job> J) {
   return result;
 }
 
+/// Returns true if the compilation record says that \p Cmd and its dependents
+/// need rebuilding, because the last build of \p Cmd failed or didn't finish.
+static bool isDirtyInRecord(const Job *Cmd) {
+  const auto *compileAction = dyn_cast<CompileJobAction>(&Cmd->getSource());
+  if (!compileAction)
+    return false;
+  return compileAction->getInputInfo().status ==
+      CompileJobAction::InputInfo::NeedsCascadingBuild;
+}
+
 static const Job *findUnfinishedJob(ArrayRef<const Job *> JL,
                                     const CommandSet &FinishedCommands) {
   for (const Job *Cmd : JL) {
@@ -218,13 +231,53 @@ static void writeCompilationRecord(StringRef path, StringRef argsHash,
 int Compilation::performJobsImpl() {
   // Create a TaskQueue for execution.
   std::unique_ptr<TaskQueue> TQ;
-  if (SkipTaskExecution)
+  std::unique_ptr<OutputCache> Cache;
+  if (SkipTaskExecution) {
     TQ.reset(new DummyTaskQueue(NumberOfParallelCommands));
-  else
+  } else if (!OutputCachePath.empty()) {
+    std::vector<std::string> InputFiles;
+    for (const Arg *A : getArgs().filtered(options::OPT_INPUT))
+      InputFiles.push_back(A->getValue());
+    Cache.reset(new OutputCache(OutputCachePath, InputFiles));
+    TQ.reset(new CachingTaskQueue(*Cache, NumberOfParallelCommands));
+  } else
     TQ.reset(new TaskQueue(NumberOfParallelCommands));
+  if (!CompileServerSocket.empty())
+    TQ->setCompileServerSocket(CompileServerSocket);
+  if (JobserverCountsThreads)
+    TQ->setJobserverTokensForThreads();
 
   PerformJobsState State;
 
+  // Record when each job began, to put it in the trace.
+  bool Tracing = !TraceOutputPath.empty() && !SkipTaskExecution;
+  if (Tracing) {
+    if (std::error_code EC = trace::startRecording(TraceOutputPath, "driver")) {
+      Diags.diagnose(SourceLoc(), diag::warn_cannot_write_trace,
+                     TraceOutputPath, EC.message());
+      Tracing = false;
+    } else {
+      trace::recordEvent("driver", "plan build", TraceStartTime, trace::now());
+    }
+  }
+  uint64_t ExecutionStartTime = trace::now();
+  llvm::DenseMap<const Job *, uint64_t> JobStartTimes;
+  auto traceJob = [&](ProcessId Pid, const Job *Cmd) {
+    if (!Tracing)
+      return;
+    std::string Name = Cmd->getSource().getClassName();
+    const CommandOutput &Output = Cmd->getOutput();
+    if (Output.getNumBaseInputs() != 0 && !Output.getBaseInput(0).empty()) {
+      Name += " ";
+      Name += llvm::sys::path::filename(Output.getBaseInput(0));
+      if (Output.getNumBaseInputs() > 1)
+        Name += " (batch)";
+    }
+    trace::recordProcessEvent(Pid, Name, "job",
+                              Cmd->getSource().getClassName(),
+                              JobStartTimes.lookup(Cmd), trace::now());
+  };
+
   using DependencyGraph = DependencyGraph<const Job *>;
   DependencyGraph DepGraph;
   SmallPtrSet<const Job *, 16> DeferredCommands;
@@ -341,7 +394,19 @@ int Compilation::performJobsImpl() {
     // We scheduled all of the files that have actually changed. Now add the
     // files that haven't changed, so that they'll get built in parallel if
     // possible and after the first set of files if it's not.
+    //
+    // If every name a changed file provides has a fingerprint, wait until it
+    // has been rebuilt instead, and only schedule the files which depend on
+    // the names whose fingerprint changed. Such a file is already marked, so
+    // it will cascade when it finishes.
+    //
+    // This doesn't hold for a file whose last build failed or didn't finish:
+    // its dependents may never have been rebuilt against the changes which
+    // were made to it before then, and the fingerprints it is compared with
+    // can't tell.
     for (auto *Cmd : InitialOutOfDateCommands) {
+      if (!isDirtyInRecord(Cmd) && DepGraph.hasFingerprints(Cmd))
+        continue;
       DepGraph.markTransitive(AdditionalOutOfDateCommands, Cmd,
                               IncrementalTracer);
     }
@@ -381,10 +446,13 @@ int Compilation::performJobsImpl() {
   // Set up a callback which will be called immediately after a task has
   // started. This callback may be used to provide output indicating that the
   // task began.
-  auto taskBegan = [this] (ProcessId Pid, void *Context) {
+  auto taskBegan = [&] (ProcessId Pid, void *Context) {
     // TODO: properly handle task began.
     const Job *BeganCmd = (const Job *)Context;
 
+    if (Tracing)
+      JobStartTimes[BeganCmd] = trace::now();
+
     // For verbose output, print out each command as it begins execution.
     if (Level == OutputLevel::Verbose)
       BeganCmd->printCommandLine(llvm::errs());
@@ -400,6 +468,7 @@ int Compilation::performJobsImpl() {
   auto taskFinished = [&] (ProcessId Pid, int ReturnCode, StringRef Output,
                            void *Context) -> TaskFinishedResponse {
     const Job *FinishedCmd = (const Job *)Context;
+    traceJob(Pid, FinishedCmd);
 
     if (Level == OutputLevel::Parseable) {
       // Parseable output was requested.
@@ -478,6 +547,7 @@ int Compilation::performJobsImpl() {
   auto taskSignalled = [&] (ProcessId Pid, StringRef ErrorMsg, StringRef Output,
                             void *Context) -> TaskFinishedResponse {
     const Job *SignalledCmd = (const Job *)Context;
+    traceJob(Pid, SignalledCmd);
 
     if (Level == OutputLevel::Parseable) {
       // Parseable output was requested.
@@ -555,6 +625,17 @@ int Compilation::performJobsImpl() {
                            InputInfo);
   }
 
+  if (Tracing) {
+    trace::recordEvent("driver", "run jobs", ExecutionStartTime, trace::now());
+    for (auto &Cmd : Jobs) {
+      StringRef JobTrace =
+        Cmd->getOutput().getAdditionalOutputForType(types::TY_TraceEvents);
+      if (!JobTrace.empty())
+        trace::appendEventsFromFile(JobTrace);
+    }
+    trace::stopRecording();
+  }
+
   if (Result == 0)
     Result = Diags.hadAnyError();
   return Result;
@@ -587,11 +668,37 @@ int Compilation::performSingleCommand(const Job *Cmd) {
   return ExecuteInPlace(ExecPath, argv);
 }
 
+/// Writes the supplementary output file maps of the batch jobs, whose names
+/// were chosen when the jobs were built.
+/// \returns true on error
+static bool writeSupplementaryOutputFileMaps(const Compilation &C,
+                                             DiagnosticEngine &Diags) {
+  for (const Job *Cmd : C.getJobs()) {
+    const CommandOutput &Output = Cmd->getOutput();
+    StringRef Path = Output.getSupplementaryOutputFileMapPath();
+    if (Path.empty())
+      continue;
+
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::F_None);
+    if (EC) {
+      Diags.diagnose(SourceLoc(), diag::error_opening_output, Path,
+                     EC.message());
+      return true;
+    }
+    OS << Output.getSupplementaryOutputFileMapContents();
+  }
+  return false;
+}
+
 int Compilation::performJobs() {
+  if (writeSupplementaryOutputFileMaps(*this, Diags))
+    return EXIT_FAILURE;
+
   // If we don't have to do any cleanup work, just exec the subprocess.
   if (Level < OutputLevel::Parseable &&
       (SaveTemps || TempFilePaths.empty()) &&
-      CompilationRecordPath.empty() &&
+      CompilationRecordPath.empty() && TraceOutputPath.empty() &&
       Jobs.size() == 1) {
     return performSingleCommand(Jobs.front().get());
   }
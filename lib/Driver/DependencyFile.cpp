@@ -0,0 +1,364 @@
+//===--- DependencyFile.cpp - Swift dependencies files --------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Driver/DependencyFile.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace swift;
+using namespace llvm::support;
+
+StringRef swift::getDependencySectionName(DependencySection section) {
+  switch (section) {
+  case DependencySection::ProvidesTopLevel: return "provides-top-level";
+  case DependencySection::ProvidesNominal: return "provides-nominal";
+  case DependencySection::ProvidesMember: return "provides-member";
+  case DependencySection::ProvidesDynamicLookup:
+    return "provides-dynamic-lookup";
+  case DependencySection::DependsTopLevel: return "depends-top-level";
+  case DependencySection::DependsMember: return "depends-member";
+  case DependencySection::DependsNominal: return "depends-nominal";
+  case DependencySection::DependsDynamicLookup:
+    return "depends-dynamic-lookup";
+  case DependencySection::DependsExternal: return "depends-external";
+  }
+  llvm_unreachable("bad dependency section");
+}
+
+void DependencyFileWriter::addMemberEntry(DependencySection section,
+                                          StringRef mangledBaseName,
+                                          StringRef member, bool isCascading) {
+  assert(isMemberDependencySection(section) && "use addEntry");
+  addSection(section);
+
+  // Smash the type and member names together, the same way the driver keys
+  // its dependency graph.
+  std::string name = mangledBaseName.str();
+  name.push_back('\0');
+  name += member;
+  Sections[unsigned(section)].push_back({std::move(name), isCascading});
+}
+
+void DependencyFileWriter::addFingerprint(StringRef name,
+                                          StringRef fingerprint) {
+  unsigned nextIndex = Fingerprints.size();
+  auto insertResult = FingerprintIndices.insert(std::make_pair(name,
+                                                               nextIndex));
+  if (insertResult.second) {
+    Fingerprints.push_back({name.str(), fingerprint.str()});
+    return;
+  }
+
+  // Combine the fingerprints of all declarations with this name, in the
+  // order they were added. If any of them doesn't have one, the name can't
+  // have one either.
+  std::string &existing = Fingerprints[insertResult.first->getValue()].second;
+  if (existing.empty())
+    return;
+  if (fingerprint.empty()) {
+    existing.clear();
+    return;
+  }
+  llvm::MD5 hash;
+  hash.update(existing);
+  uint8_t separator[1] = {0};
+  hash.update(separator);
+  hash.update(fingerprint);
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> combined;
+  llvm::MD5::stringifyResult(result, combined);
+  existing = combined.str().str();
+}
+
+void DependencyFileWriter::addMemberFingerprint(StringRef mangledBaseName,
+                                                StringRef member,
+                                                StringRef fingerprint) {
+  std::string name = mangledBaseName.str();
+  name.push_back('\0');
+  name += member;
+  addFingerprint(name, fingerprint);
+}
+
+void DependencyFileWriter::writeYAML(raw_ostream &out) const {
+  out << "### Swift dependencies file v0 ###\n";
+
+  for (unsigned i = 0; i != NumDependencySections; ++i) {
+    auto section = DependencySection(i);
+    if (!IsPresent[i])
+      continue;
+
+    // Mangled type names are written as they are; everything else may be an
+    // arbitrary identifier or path.
+    bool isMangledName = section == DependencySection::ProvidesNominal ||
+                         section == DependencySection::DependsNominal;
+
+    out << getDependencySectionName(section) << ":\n";
+    for (const Entry &entry : Sections[i]) {
+      out << "- ";
+      if (!entry.IsCascading)
+        out << "!private ";
+
+      if (isMemberDependencySection(section)) {
+        StringRef base, member;
+        std::tie(base, member) = StringRef(entry.Name).split('\0');
+        out << "[\"" << base << "\", \"";
+        if (!member.empty())
+          out << llvm::yaml::escape(member);
+        out << "\"]\n";
+      } else if (isMangledName) {
+        out << "\"" << entry.Name << "\"\n";
+      } else {
+        out << "\"" << llvm::yaml::escape(entry.Name) << "\"\n";
+      }
+    }
+  }
+
+  // Members are written as ["base", "member", "fingerprint"], everything
+  // else as ["name", "fingerprint"].
+  bool hasFingerprints = std::any_of(Fingerprints.begin(), Fingerprints.end(),
+                                    [](const std::pair<std::string,
+                                                       std::string> &entry) {
+    return !entry.second.empty();
+  });
+  if (hasFingerprints) {
+    out << "fingerprints:\n";
+    for (auto &entry : Fingerprints) {
+      if (entry.second.empty())
+        continue;
+      StringRef base, member;
+      std::tie(base, member) = StringRef(entry.first).split('\0');
+      out << "- [\"" << llvm::yaml::escape(base) << "\", \"";
+      if (base.size() != entry.first.size())
+        out << llvm::yaml::escape(member) << "\", \"";
+      out << entry.second << "\"]\n";
+    }
+  }
+
+  if (!InterfaceHash.empty())
+    out << "interface-hash: \"" << InterfaceHash << "\"\n";
+}
+
+void DependencyFileWriter::writeBinary(raw_ostream &out) const {
+  using namespace binary_swiftdeps;
+
+  // Intern all strings into a sorted table.
+  std::vector<StringRef> strings;
+  for (auto &section : Sections)
+    for (const Entry &entry : section)
+      strings.push_back(entry.Name);
+  for (auto &entry : Fingerprints) {
+    if (entry.second.empty())
+      continue;
+    strings.push_back(entry.first);
+    strings.push_back(entry.second);
+  }
+  if (!InterfaceHash.empty())
+    strings.push_back(InterfaceHash);
+  std::sort(strings.begin(), strings.end());
+  strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+
+  auto getIndex = [&](StringRef str) -> uint32_t {
+    auto iter = std::lower_bound(strings.begin(), strings.end(), str);
+    assert(iter != strings.end() && *iter == str);
+    return iter - strings.begin();
+  };
+
+  // Sort the entries of each section by name, merging duplicates. An entry
+  // which is cascading anywhere is cascading.
+  std::vector<uint32_t> sectionEntries[NumDependencySections];
+  for (unsigned i = 0; i != NumDependencySections; ++i) {
+    SmallVector<std::pair<uint32_t, bool>, 32> indices;
+    for (const Entry &entry : Sections[i])
+      indices.push_back({getIndex(entry.Name), entry.IsCascading});
+    std::sort(indices.begin(), indices.end());
+
+    for (auto &index : indices) {
+      auto &entries = sectionEntries[i];
+      if (!entries.empty() &&
+          (entries.back() & ~PrivateFlag) == index.first) {
+        if (index.second)
+          entries.back() = index.first;
+        continue;
+      }
+      entries.push_back(index.first | (index.second ? 0 : PrivateFlag));
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> fingerprints;
+  for (auto &entry : Fingerprints)
+    if (!entry.second.empty())
+      fingerprints.push_back({getIndex(entry.first), getIndex(entry.second)});
+  std::sort(fingerprints.begin(), fingerprints.end());
+
+  uint32_t stringDataSize = 0;
+  for (StringRef str : strings)
+    stringDataSize += str.size();
+
+  endian::Writer<little> LE(out);
+  out.write(Signature, sizeof(Signature));
+  LE.write<uint16_t>(VersionMajor);
+  LE.write<uint16_t>(VersionMinor);
+  LE.write<uint32_t>(strings.size());
+  LE.write<uint32_t>(stringDataSize);
+  LE.write<uint32_t>(InterfaceHash.empty() ? NoString
+                                           : getIndex(InterfaceHash));
+  LE.write<uint32_t>(fingerprints.size());
+  for (auto &entries : sectionEntries)
+    LE.write<uint32_t>(entries.size());
+
+  uint32_t offset = 0;
+  for (StringRef str : strings) {
+    LE.write<uint32_t>(offset);
+    offset += str.size();
+  }
+  LE.write<uint32_t>(offset);
+
+  for (auto &entries : sectionEntries)
+    for (uint32_t entry : entries)
+      LE.write<uint32_t>(entry);
+
+  for (auto &entry : fingerprints) {
+    LE.write<uint32_t>(entry.first);
+    LE.write<uint32_t>(entry.second);
+  }
+
+  for (StringRef str : strings)
+    out << str;
+}
+
+bool BinaryDependencyFileReader::isBinary(StringRef data) {
+  return data.startswith(StringRef(binary_swiftdeps::Signature,
+                                   sizeof(binary_swiftdeps::Signature)));
+}
+
+bool BinaryDependencyFileReader::initialize(StringRef data) {
+  using namespace binary_swiftdeps;
+
+  if (data.size() < HeaderSize || !isBinary(data))
+    return true;
+
+  const char *cursor = data.data() + sizeof(Signature);
+  auto read16 = [&]() -> uint16_t {
+    auto result = endian::read16le(cursor);
+    cursor += sizeof(uint16_t);
+    return result;
+  };
+  auto read32 = [&]() -> uint32_t {
+    auto result = endian::read32le(cursor);
+    cursor += sizeof(uint32_t);
+    return result;
+  };
+
+  if (read16() != VersionMajor)
+    return true;
+  (void)read16(); // Minor versions are compatible.
+
+  NumStrings = read32();
+  uint32_t stringDataSize = read32();
+  InterfaceHashIndex = read32();
+  if (InterfaceHashIndex != NoString && InterfaceHashIndex >= NumStrings)
+    return true;
+  NumFingerprints = read32();
+
+  uint64_t numEntries = 0;
+  for (auto &size : SectionSizes) {
+    size = read32();
+    numEntries += size;
+  }
+
+  // Check that all tables fit in the file, in 64 bits to avoid overflow.
+  uint64_t tablesSize = (uint64_t(NumStrings) + 1) * sizeof(uint32_t) +
+                        numEntries * sizeof(uint32_t) +
+                        uint64_t(NumFingerprints) * 2 * sizeof(uint32_t) +
+                        stringDataSize;
+  if (HeaderSize + tablesSize > data.size())
+    return true;
+
+  StringOffsets = cursor;
+  Entries = StringOffsets + (uint64_t(NumStrings) + 1) * sizeof(uint32_t);
+  Fingerprints = Entries + numEntries * sizeof(uint32_t);
+  StringData = Fingerprints + uint64_t(NumFingerprints) * 2 * sizeof(uint32_t);
+
+  // Check the string offsets once, so that looking up a string doesn't need
+  // to.
+  uint32_t previous = 0;
+  for (uint32_t i = 0; i <= NumStrings; ++i) {
+    uint32_t offset = endian::read32le(StringOffsets + i * sizeof(uint32_t));
+    if (offset < previous || offset > stringDataSize)
+      return true;
+    previous = offset;
+  }
+  if (previous != stringDataSize)
+    return true;
+
+  return false;
+}
+
+StringRef BinaryDependencyFileReader::getString(uint32_t index) const {
+  assert(index < NumStrings);
+  const char *offsets = StringOffsets + index * sizeof(uint32_t);
+  uint32_t begin = endian::read32le(offsets);
+  uint32_t end = endian::read32le(offsets + sizeof(uint32_t));
+  return StringRef(StringData + begin, end - begin);
+}
+
+bool BinaryDependencyFileReader::forEachEntry(
+    DependencySection section,
+    llvm::function_ref<bool(StringRef, bool)> fn) const {
+  using namespace binary_swiftdeps;
+
+  const char *cursor = Entries;
+  for (unsigned i = 0; i != unsigned(section); ++i)
+    cursor += SectionSizes[i] * sizeof(uint32_t);
+
+  for (uint32_t i = 0, e = SectionSizes[unsigned(section)]; i != e; ++i) {
+    uint32_t entry = endian::read32le(cursor);
+    cursor += sizeof(uint32_t);
+
+    uint32_t index = entry & ~PrivateFlag;
+    if (index >= NumStrings)
+      return false;
+    if (!fn(getString(index), !(entry & PrivateFlag)))
+      return false;
+  }
+  return true;
+}
+
+bool BinaryDependencyFileReader::forEachFingerprint(
+    llvm::function_ref<bool(StringRef, StringRef)> fn) const {
+  const char *cursor = Fingerprints;
+  for (uint32_t i = 0; i != NumFingerprints; ++i) {
+    uint32_t name = endian::read32le(cursor);
+    uint32_t fingerprint = endian::read32le(cursor + sizeof(uint32_t));
+    cursor += 2 * sizeof(uint32_t);
+
+    if (name >= NumStrings || fingerprint >= NumStrings)
+      return false;
+    if (!fn(getString(name), getString(fingerprint)))
+      return false;
+  }
+  return true;
+}
+
+StringRef BinaryDependencyFileReader::getInterfaceHash() const {
+  if (InterfaceHashIndex == binary_swiftdeps::NoString)
+    return StringRef();
+  return getString(InterfaceHashIndex);
+}
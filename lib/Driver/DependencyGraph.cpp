@@ -12,6 +12,7 @@
 
 #include "swift/Driver/DependencyGraph.h"
 #include "swift/Basic/DemangleWrappers.h"
+#include "swift/Driver/DependencyFile.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringSwitch.h"
@@ -48,15 +49,115 @@ using LoadResult = DependencyGraphImpl::LoadResult;
 using DependencyKind = DependencyGraphImpl::DependencyKind;
 using DependencyCallbackTy = LoadResult(StringRef, DependencyKind, bool);
 using InterfaceHashCallbackTy = LoadResult(StringRef);
+using FingerprintCallbackTy = LoadResult(StringRef, StringRef);
+
+static LoadResult
+parseBinaryDependencyFile(StringRef data,
+                          llvm::function_ref<DependencyCallbackTy> providesCallback,
+                          llvm::function_ref<DependencyCallbackTy> dependsCallback,
+                          llvm::function_ref<FingerprintCallbackTy> fingerprintCallback,
+                          llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
+  BinaryDependencyFileReader reader;
+  if (reader.initialize(data))
+    return LoadResult::HadError;
+
+  LoadResult result = LoadResult::UpToDate;
+  auto update = [&result](LoadResult resultUpdate) -> bool {
+    switch (resultUpdate) {
+    case LoadResult::HadError:
+      result = LoadResult::HadError;
+      return false;
+    case LoadResult::UpToDate:
+      return true;
+    case LoadResult::AffectsDownstream:
+      result = LoadResult::AffectsDownstream;
+      return true;
+    }
+    llvm_unreachable("bad load result");
+  };
+
+  for (unsigned i = 0; i != NumDependencySections; ++i) {
+    auto section = DependencySection(i);
+    DependencyKind kind;
+    bool isDepends;
+    switch (section) {
+    case DependencySection::ProvidesTopLevel:
+      kind = DependencyKind::TopLevelName;
+      isDepends = false;
+      break;
+    case DependencySection::ProvidesNominal:
+      kind = DependencyKind::NominalType;
+      isDepends = false;
+      break;
+    case DependencySection::ProvidesMember:
+      kind = DependencyKind::NominalTypeMember;
+      isDepends = false;
+      break;
+    case DependencySection::ProvidesDynamicLookup:
+      kind = DependencyKind::DynamicLookupName;
+      isDepends = false;
+      break;
+    case DependencySection::DependsTopLevel:
+      kind = DependencyKind::TopLevelName;
+      isDepends = true;
+      break;
+    case DependencySection::DependsMember:
+      kind = DependencyKind::NominalTypeMember;
+      isDepends = true;
+      break;
+    case DependencySection::DependsNominal:
+      kind = DependencyKind::NominalType;
+      isDepends = true;
+      break;
+    case DependencySection::DependsDynamicLookup:
+      kind = DependencyKind::DynamicLookupName;
+      isDepends = true;
+      break;
+    case DependencySection::DependsExternal:
+      kind = DependencyKind::ExternalFile;
+      isDepends = true;
+      break;
+    }
+
+    // Member names are already stored as "{MangledBaseName}\0memberName".
+    auto &callback = isDepends ? dependsCallback : providesCallback;
+    bool completed = reader.forEachEntry(section,
+                                         [&](StringRef name, bool isCascading) {
+      return update(callback(name, kind, isCascading));
+    });
+    if (!completed)
+      return LoadResult::HadError;
+  }
+
+  bool completed = reader.forEachFingerprint([&](StringRef name,
+                                                 StringRef fingerprint) {
+    return update(fingerprintCallback(name, fingerprint));
+  });
+  if (!completed)
+    return LoadResult::HadError;
+
+  StringRef interfaceHash = reader.getInterfaceHash();
+  if (!interfaceHash.empty() && !update(interfaceHashCallback(interfaceHash)))
+    return LoadResult::HadError;
+
+  return result;
+}
 
 static LoadResult
 parseDependencyFile(llvm::MemoryBuffer &buffer,
                     llvm::function_ref<DependencyCallbackTy> providesCallback,
                     llvm::function_ref<DependencyCallbackTy> dependsCallback,
+                    llvm::function_ref<FingerprintCallbackTy> fingerprintCallback,
                     llvm::function_ref<InterfaceHashCallbackTy> interfaceHashCallback) {
   namespace yaml = llvm::yaml;
 
-  // FIXME: Switch to a format other than YAML.
+  // The binary format can be read in place; YAML is only used for debugging
+  // and in tests.
+  if (BinaryDependencyFileReader::isBinary(buffer.getBuffer()))
+    return parseBinaryDependencyFile(buffer.getBuffer(), providesCallback,
+                                     dependsCallback, fingerprintCallback,
+                                     interfaceHashCallback);
+
   llvm::SourceMgr SM;
   yaml::Stream stream(buffer.getMemBufferRef(), SM);
   auto I = stream.begin();
@@ -93,6 +194,42 @@ parseDependencyFile(llvm::MemoryBuffer &buffer,
       StringRef valueString = value->getValue(scratch);
       resultUpdate = interfaceHashCallback(valueString);
 
+    } else if (keyString == "fingerprints") {
+      auto *entries = dyn_cast<yaml::SequenceNode>(i->getValue());
+      if (!entries)
+        return LoadResult::HadError;
+
+      // Entries come in the form ["name", "fingerprint"], or, for members,
+      // ["{MangledBaseName}", "memberName", "fingerprint"].
+      resultUpdate = LoadResult::UpToDate;
+      for (yaml::Node &rawEntry : *entries) {
+        auto *entry = dyn_cast<yaml::SequenceNode>(&rawEntry);
+        if (!entry)
+          return LoadResult::HadError;
+
+        SmallVector<yaml::ScalarNode *, 3> parts;
+        for (yaml::Node &rawPart : *entry) {
+          auto *part = dyn_cast<yaml::ScalarNode>(&rawPart);
+          if (!part)
+            return LoadResult::HadError;
+          parts.push_back(part);
+        }
+        if (parts.size() != 2 && parts.size() != 3)
+          return LoadResult::HadError;
+
+        SmallString<64> name;
+        name += parts[0]->getValue(scratch);
+        if (parts.size() == 3) {
+          name.push_back('\0');
+          name += parts[1]->getValue(scratch);
+        }
+
+        resultUpdate = fingerprintCallback(name.str(),
+                                           parts.back()->getValue(scratch));
+        if (resultUpdate == LoadResult::HadError)
+          return LoadResult::HadError;
+      }
+
     } else {
       enum class DependencyDirection : bool {
         Depends,
@@ -206,7 +343,10 @@ parseDependencyFile(llvm::MemoryBuffer &buffer,
 }
 
 LoadResult DependencyGraphImpl::loadFromPath(const void *node, StringRef path) {
-  auto buffer = llvm::MemoryBuffer::getFile(path);
+  // Neither format needs a null terminator, which lets large files be
+  // memory-mapped rather than read.
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*FileSize=*/-1,
+                                            /*RequiresNullTerminator=*/false);
   if (!buffer)
     return LoadResult::HadError;
   return loadFromBuffer(node, *buffer.get());
@@ -222,6 +362,12 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
                                                llvm::MemoryBuffer &buffer) {
   auto &provides = Provides[node];
 
+  // Which of the existing entries the file still provides, and the new
+  // fingerprints, to work out which entries have changed once the whole file
+  // has been read.
+  SmallVector<bool, 32> stillProvided(provides.size(), false);
+  llvm::StringMap<std::string> fingerprints;
+
   auto dependsCallback = [this, node](StringRef name, DependencyKind kind,
                                       bool isCascading) -> LoadResult {
     if (kind == DependencyKind::ExternalFile)
@@ -250,19 +396,28 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
   };
 
   auto providesCallback =
-      [this, node, &provides](StringRef name, DependencyKind kind,
-                              bool isCascading) -> LoadResult {
+      [&provides, &stillProvided](StringRef name, DependencyKind kind,
+                                  bool isCascading) -> LoadResult {
     assert(isCascading);
     auto iter = std::find_if(provides.begin(), provides.end(),
                              [name](const ProvidesEntryTy &entry) -> bool {
       return name == entry.name;
     });
 
-    if (iter == provides.end())
-      provides.push_back({name, kind});
-    else
+    if (iter == provides.end()) {
+      provides.push_back({name, kind, std::string(), true});
+      stillProvided.push_back(true);
+    } else {
       iter->kindMask |= kind;
+      stillProvided[iter - provides.begin()] = true;
+    }
+
+    return LoadResult::UpToDate;
+  };
 
+  auto fingerprintCallback =
+      [&fingerprints](StringRef name, StringRef fingerprint) -> LoadResult {
+    fingerprints[name] = fingerprint;
     return LoadResult::UpToDate;
   };
 
@@ -284,8 +439,33 @@ LoadResult DependencyGraphImpl::loadFromBuffer(const void *node,
     return LoadResult::UpToDate;
   };
 
-  return parseDependencyFile(buffer, providesCallback, dependsCallback,
-                             interfaceHashCallback);
+  LoadResult result = parseDependencyFile(buffer, providesCallback,
+                                          dependsCallback, fingerprintCallback,
+                                          interfaceHashCallback);
+  if (result == LoadResult::HadError)
+    return result;
+
+  // Names which are no longer provided, or which don't have a fingerprint,
+  // are always considered changed.
+  bool allFingerprinted = true;
+  for (size_t i = 0, e = provides.size(); i != e; ++i) {
+    auto &entry = provides[i];
+    std::string fingerprint;
+    if (stillProvided[i]) {
+      fingerprint = fingerprints.lookup(entry.name);
+      if (fingerprint.empty())
+        allFingerprinted = false;
+    }
+    entry.hasChanged = fingerprint.empty() || fingerprint != entry.fingerprint;
+    entry.fingerprint = std::move(fingerprint);
+  }
+
+  if (allFingerprinted && !fingerprints.empty())
+    FullyFingerprinted.insert(node);
+  else
+    FullyFingerprinted.erase(node);
+
+  return result;
 }
 
 void DependencyGraphImpl::markExternal(SmallVectorImpl<const void *> &visited,
@@ -321,12 +501,16 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
   SmallPtrSet<const void *, 16> visitedSet;
 
   auto addDependentsToWorklist = [&](const void *next,
-                                     ArrayRef<MarkTracerImpl::Entry> reason) {
+                                     ArrayRef<MarkTracerImpl::Entry> reason,
+                                     bool onlyChanged) {
     auto allProvided = Provides.find(next);
     if (allProvided == Provides.end())
       return;
 
     for (const auto &provided : allProvided->second) {
+      if (onlyChanged && !provided.hasChanged)
+        continue;
+
       auto allDependents = Dependencies.find(provided.name);
       if (allDependents == Dependencies.end())
         continue;
@@ -338,6 +522,10 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
       allDependents->second.second |= provided.kindMask;
 
       for (const auto &dependent : allDependents->second.first) {
+        // A file's own uses of a changed name need no extra marking: the
+        // frontend folds the fingerprints of the declarations of a file into
+        // those of the declarations of the same file which refer to them, so
+        // the names those provide have changed as well.
         if (dependent.node == next)
           continue;
         auto intersectingKinds = provided.kindMask & dependent.kindMask;
@@ -373,7 +561,7 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
 
   // Always mark through the starting node, even if it's already marked.
   markIntransitive(node);
-  addDependentsToWorklist(node, {});
+  addDependentsToWorklist(node, {}, /*onlyChanged=*/true);
 
   while (!worklist.empty()) {
     auto next = worklist.pop_back_val();
@@ -385,7 +573,7 @@ DependencyGraphImpl::markTransitive(SmallVectorImpl<const void *> &visited,
       continue;
     }
 
-    addDependentsToWorklist(next.Node, next.Reason);
+    addDependentsToWorklist(next.Node, next.Reason, /*onlyChanged=*/false);
     if (!markIntransitive(next.Node))
       continue;
     record(next);
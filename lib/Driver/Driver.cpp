@@ -24,6 +24,7 @@
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/LLVM.h"
 #include "swift/Basic/TaskQueue.h"
+#include "swift/Basic/TraceEvents.h"
 #include "swift/Basic/Version.h"
 #include "swift/Basic/Range.h"
 #include "swift/Driver/Action.h"
@@ -51,6 +52,7 @@
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <memory>
 
 using namespace swift;
@@ -339,6 +341,7 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
   llvm::PrettyStackTraceString CrashInfo("Compilation construction");
 
   llvm::sys::TimeValue StartTime = llvm::sys::TimeValue::now();
+  uint64_t TraceStartTime = trace::now();
 
   std::unique_ptr<InputArgList> ArgList(parseArgStrings(Args.slice(1)));
   if (Diags.hadAnyError())
@@ -509,6 +512,19 @@ std::unique_ptr<Compilation> Driver::buildCompilation(
   if (ShowIncrementalBuildDecisions)
     C->setShowsIncrementalBuildDecisions();
 
+  if (const Arg *A =
+        C->getArgs().getLastArg(options::OPT_compile_server_socket))
+    C->setCompileServerSocket(A->getValue());
+
+  if (C->getArgs().hasArg(options::OPT_jobserver_count_threads))
+    C->setJobserverCountsThreads();
+
+  if (const Arg *A = C->getArgs().getLastArg(options::OPT_trace_output))
+    C->setTraceOutputPath(A->getValue(), TraceStartTime);
+
+  if (const Arg *A = C->getArgs().getLastArg(options::OPT_output_cache_path))
+    C->setOutputCachePath(A->getValue());
+
   // This has to happen after building jobs, because otherwise we won't even
   // emit .swiftdeps files for the next build.
   if (rebuildEverything)
@@ -1039,6 +1055,35 @@ void Driver::buildOutputInfo(const ToolChain &TC, const DerivedArgList &Args,
     OI.ShouldGenerateFixitEdits = true;
   }
 
+  if (OI.CompilerMode == OutputInfo::Mode::StandardCompile &&
+      Args.hasArg(options::OPT_enable_batch_mode)) {
+    // Batch jobs don't support per-file incremental decisions, per-file
+    // diagnostics files or per-file fixits yet.
+    if (const Arg *A = Args.getLastArg(options::OPT_incremental,
+                                       options::OPT_serialize_diagnostics,
+                                       options::OPT_fixit_code,
+                                       options::OPT_embed_bitcode)) {
+      Diags.diagnose(SourceLoc(), diag::warning_batch_mode_ignored,
+                     A->getOption().getPrefixedName());
+    } else {
+      // By default, make one batch for each job that may run in parallel.
+      OI.BatchCount = 1;
+      if (const Arg *A = Args.getLastArg(options::OPT_driver_batch_count)) {
+        if (StringRef(A->getValue()).getAsInteger(10, OI.BatchCount) ||
+            OI.BatchCount == 0) {
+          Diags.diagnose(SourceLoc(), diag::error_invalid_arg_value,
+                         A->getAsString(Args), A->getValue());
+          OI.BatchCount = 1;
+        }
+      } else if (const Arg *A = Args.getLastArg(options::OPT_j)) {
+        // Bad values of -j are diagnosed when building the compilation.
+        if (StringRef(A->getValue()).getAsInteger(10, OI.BatchCount) ||
+            OI.BatchCount == 0)
+          OI.BatchCount = 1;
+      }
+    }
+  }
+
   {
     if (const Arg *A = Args.getLastArg(options::OPT_sdk)) {
       OI.SDKPath = A->getValue();
@@ -1114,6 +1159,13 @@ void Driver::buildActions(const ToolChain &TC,
   switch (OI.CompilerMode) {
   case OutputInfo::Mode::StandardCompile:
   case OutputInfo::Mode::UpdateCode: {
+    // In batch mode the Swift inputs are collected here and split among the
+    // batch compile jobs once all inputs are known. The jobs take the place
+    // of the first Swift input in the module and linker inputs.
+    ActionList BatchInputs;
+    size_t BatchModuleInputsPos = 0;
+    size_t BatchLinkerInputsPos = 0;
+
     for (const InputPair &Input : Inputs) {
       types::ID InputType = Input.first;
       const Arg *InputArg = Input.second;
@@ -1121,6 +1173,15 @@ void Driver::buildActions(const ToolChain &TC,
       std::unique_ptr<Action> Current(new InputAction(*InputArg, InputType));
       switch (InputType) {
       case types::TY_Swift:
+        if (OI.isBatchMode()) {
+          if (BatchInputs.empty()) {
+            BatchModuleInputsPos = AllModuleInputs.size();
+            BatchLinkerInputsPos = AllLinkerInputs.size();
+          }
+          BatchInputs.push_back(Current.release());
+          break;
+        }
+        SWIFT_FALLTHROUGH;
       case types::TY_SIL:
       case types::TY_SIB: {
         // Source inputs always need to be compiled.
@@ -1171,10 +1232,12 @@ void Driver::buildActions(const ToolChain &TC,
       case types::TY_LLVM_IR:
       case types::TY_LLVM_BC:
       case types::TY_SerializedDiagnostics:
+      case types::TY_OptRecord:
       case types::TY_ObjCHeader:
       case types::TY_ClangModuleFile:
       case types::TY_SwiftDeps:
       case types::TY_Remapping:
+      case types::TY_TraceEvents:
         // We could in theory handle assembly or LLVM input, but let's not.
         // FIXME: What about LTO?
         Diags.diagnose(SourceLoc(), diag::error_unexpected_input_file,
@@ -1187,6 +1250,27 @@ void Driver::buildActions(const ToolChain &TC,
         llvm_unreachable("these types should never be inferred");
       }
     }
+
+    if (!BatchInputs.empty()) {
+      // Split the inputs into contiguous runs of nearly equal size, so that
+      // each frontend job gets files which are next to each other on the
+      // command line.
+      size_t NumJobs = std::min<size_t>(OI.BatchCount, BatchInputs.size());
+      ActionList BatchJobs;
+      size_t Begin = 0;
+      for (size_t JobIndex = 0; JobIndex < NumJobs; ++JobIndex) {
+        size_t End = (BatchInputs.size() * (JobIndex + 1)) / NumJobs;
+        auto *CA = new CompileJobAction(OI.CompilerOutputType);
+        for (size_t i = Begin; i < End; ++i)
+          CA->addInput(BatchInputs[i]);
+        BatchJobs.push_back(CA);
+        Begin = End;
+      }
+      AllModuleInputs.insert(AllModuleInputs.begin() + BatchModuleInputsPos,
+                             BatchJobs.begin(), BatchJobs.end());
+      AllLinkerInputs.insert(AllLinkerInputs.begin() + BatchLinkerInputsPos,
+                             BatchJobs.begin(), BatchJobs.end());
+    }
     break;
   }
   case OutputInfo::Mode::SingleCompile: {
@@ -1394,8 +1478,10 @@ void Driver::buildJobs(const ActionList &Actions, const OutputInfo &OI,
           Type != types::TY_dSYM) {
         // Multi-threading compilation has multiple outputs, except those
         // outputs which are produced before the llvm passes (e.g. emit-sil).
-        if (OI.isMultiThreading() && isa<CompileJobAction>(A) &&
-            types::isAfterLLVM(A->getType())) {
+        // A batch compile job has one output per input.
+        if (isa<CompileJobAction>(A) &&
+            ((OI.isMultiThreading() && types::isAfterLLVM(A->getType())) ||
+             OI.isBatchMode())) {
           NumOutputs += A->size();
         } else {
           ++NumOutputs;
@@ -1536,7 +1622,8 @@ static StringRef getOutputFilename(Compilation &C,
 
 static void addAuxiliaryOutput(Compilation &C, CommandOutput &output,
                                types::ID outputType, const OutputInfo &OI,
-                               const TypeToPathMap *outputMap) {
+                               const TypeToPathMap *outputMap,
+                               unsigned index = 0) {
   StringRef outputMapPath;
   if (outputMap) {
     auto iter = outputMap->find(outputType);
@@ -1546,21 +1633,21 @@ static void addAuxiliaryOutput(Compilation &C, CommandOutput &output,
 
   if (!outputMapPath.empty()) {
     // Prefer a path from the OutputMap.
-    output.setAdditionalOutputForType(outputType, outputMapPath);
+    output.setAdditionalOutputForType(outputType, outputMapPath, index);
   } else {
     // Put the auxiliary output file next to the primary output file.
     llvm::SmallString<128> path;
     if (output.getPrimaryOutputType() != types::TY_Nothing)
-      path = output.getPrimaryOutputFilenames()[0];
-    else if (!output.getBaseInput(0).empty())
-      path = llvm::sys::path::stem(output.getBaseInput(0));
+      path = output.getPrimaryOutputFilenames()[index];
+    else if (!output.getBaseInput(index).empty())
+      path = llvm::sys::path::stem(output.getBaseInput(index));
     else
       path = OI.ModuleName;
 
     bool isTempFile = C.isTemporaryFile(path);
     llvm::sys::path::replace_extension(path,
                                        types::getTypeTempSuffix(outputType));
-    output.setAdditionalOutputForType(outputType, path);
+    output.setAdditionalOutputForType(outputType, path, index);
     if (isTempFile)
       C.addTemporaryFile(path);
   }
@@ -1663,14 +1750,19 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
     }
   }
 
+  // In batch mode a compile job may have several primary inputs, each of
+  // which gets its own primary and auxiliary outputs.
+  bool IsBatch = OI.isBatchMode() && isa<CompileJobAction>(JA) &&
+                 InputActions.size() > 1;
+
   std::unique_ptr<CommandOutput> Output(new CommandOutput(JA->getType()));
   llvm::SmallString<128> Buf;
   StringRef OutputFile;
 
-  if (OI.isMultiThreading() && isa<CompileJobAction>(JA) &&
-      types::isAfterLLVM(JA->getType())) {
-    // Multi-threaded compilation: A single frontend command produces multiple
-    // output file: one for each input files.
+  if ((OI.isMultiThreading() && isa<CompileJobAction>(JA) &&
+       types::isAfterLLVM(JA->getType())) || IsBatch) {
+    // Multi-threaded or batch compilation: A single frontend command produces
+    // multiple output file: one for each input files.
     auto OutputFunc = [&](StringRef Input) {
       const TypeToPathMap *OMForInput = nullptr;
       if (OFM)
@@ -1691,6 +1783,8 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
     for (const Job *job : InputJobs) {
       OutputFunc(job->getOutput().getBaseInput(0));
     }
+    if (IsBatch)
+      Output->setIsBatch();
   } else {
     // The common case: there is a single output file.
     OutputFile = getOutputFilename(C, JA, OI, OutputMap, C.getArgs(),
@@ -1699,8 +1793,72 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
     Output->addPrimaryOutput(OutputFile, BaseInput);
   }
 
+  if (IsBatch) {
+    // Choose the auxiliary outputs of each primary input of the batch. The
+    // frontend finds them in a supplementary output file map.
+    OutputFileMap SupplementaryOFM;
+    bool HasSupplementaryOutputs = false;
+    for (unsigned i = 0, e = Output->getNumBaseInputs(); i != e; ++i) {
+      StringRef Input = Output->getBaseInput(i);
+      const TypeToPathMap *OMForInput = nullptr;
+      if (OFM)
+        OMForInput = OFM->getOutputMapForInput(Input);
+
+      if (OI.ShouldGenerateModule &&
+          Output->getPrimaryOutputType() != types::TY_SwiftModuleFile) {
+        addAuxiliaryOutput(C, *Output, types::TY_SwiftModuleFile, OI,
+                           OMForInput, i);
+        addAuxiliaryOutput(C, *Output, types::TY_SwiftModuleDocFile, OI,
+                           OMForInput, i);
+      }
+      if (C.getArgs().hasArg(options::OPT_emit_dependencies))
+        addAuxiliaryOutput(C, *Output, types::TY_Dependencies, OI,
+                           OMForInput, i);
+      // Batch mode is not incremental, but keep the Swift dependencies files
+      // which the output file map asks for up to date, so that a later
+      // incremental build can use them.
+      if (OMForInput && OMForInput->count(types::TY_SwiftDeps))
+        addAuxiliaryOutput(C, *Output, types::TY_SwiftDeps, OI, OMForInput, i);
+      if (C.getArgs().hasArg(options::OPT_save_optimization_record))
+        addAuxiliaryOutput(C, *Output, types::TY_OptRecord, OI, OMForInput, i);
+
+      TypeToPathMap Supplementary;
+      for (types::ID Ty : {types::TY_SwiftModuleFile,
+                           types::TY_SwiftModuleDocFile,
+                           types::TY_Dependencies,
+                           types::TY_SwiftDeps,
+                           types::TY_OptRecord}) {
+        const std::string &Path = Output->getAdditionalOutputForType(Ty, i);
+        if (!Path.empty()) {
+          Supplementary[Ty] = Path;
+          HasSupplementaryOutputs = true;
+        }
+      }
+      SupplementaryOFM.setOutputMapForInput(Input, std::move(Supplementary));
+    }
+
+    if (HasSupplementaryOutputs) {
+      // Only choose the map's name here. The Compilation writes the map when
+      // it runs the job, so that just printing the jobs doesn't.
+      llvm::SmallString<128> MapPath;
+      std::error_code EC =
+          llvm::sys::fs::createTemporaryFile(OI.ModuleName, "json", MapPath);
+      if (EC) {
+        Diags.diagnose(SourceLoc(), diag::error_unable_to_make_temporary_file,
+                       EC.message());
+      } else {
+        std::string MapContents;
+        llvm::raw_string_ostream OS(MapContents);
+        SupplementaryOFM.write(OS);
+        OS.flush();
+        C.addTemporaryFile(MapPath);
+        Output->setSupplementaryOutputFileMap(MapPath, MapContents);
+      }
+    }
+  }
+
   // Choose the swiftmodule output path.
-  if (OI.ShouldGenerateModule && isa<CompileJobAction>(JA) &&
+  if (OI.ShouldGenerateModule && isa<CompileJobAction>(JA) && !IsBatch &&
       Output->getPrimaryOutputType() != types::TY_SwiftModuleFile) {
     StringRef OFMModuleOutputPath;
     if (OutputMap) {
@@ -1751,7 +1909,7 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
   }
 
   // Choose the swiftdoc output path.
-  if (OI.ShouldGenerateModule &&
+  if (OI.ShouldGenerateModule && !IsBatch &&
       (isa<CompileJobAction>(JA) || isa<MergeModuleJobAction>(JA))) {
     StringRef OFMModuleDocOutputPath;
     if (OutputMap) {
@@ -1796,7 +1954,7 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
     }
   }
 
-  if (isa<CompileJobAction>(JA)) {
+  if (isa<CompileJobAction>(JA) && !IsBatch) {
     // Choose the serialized diagnostics output path.
     if (C.getArgs().hasArg(options::OPT_serialize_diagnostics)) {
       addAuxiliaryOutput(C, *Output, types::TY_SerializedDiagnostics, OI,
@@ -1810,6 +1968,11 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
         llvm::sys::fs::remove(OutputPath);
     }
 
+    // Choose the optimization record output path.
+    if (C.getArgs().hasArg(options::OPT_save_optimization_record)) {
+      addAuxiliaryOutput(C, *Output, types::TY_OptRecord, OI, OutputMap);
+    }
+
     // Choose the dependencies file output path.
     if (C.getArgs().hasArg(options::OPT_emit_dependencies)) {
       addAuxiliaryOutput(C, *Output, types::TY_Dependencies, OI, OutputMap);
@@ -1858,6 +2021,24 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
     }
   }
 
+  // Each frontend job records its own trace, which the Compilation merges
+  // into the -trace-output file.
+  if ((isa<CompileJobAction>(JA) || isa<BackendJobAction>(JA) ||
+       isa<MergeModuleJobAction>(JA)) &&
+      C.getArgs().hasArg(options::OPT_trace_output)) {
+    llvm::SmallString<128> TracePath;
+    std::error_code EC =
+        llvm::sys::fs::createTemporaryFile(OI.ModuleName, "trace.json",
+                                           TracePath);
+    if (EC) {
+      Diags.diagnose(SourceLoc(), diag::error_unable_to_make_temporary_file,
+                     EC.message());
+    } else {
+      C.addTemporaryFile(TracePath);
+      Output->setAdditionalOutputForType(types::TY_TraceEvents, TracePath);
+    }
+  }
+
   // 4. Construct a Job which produces the right CommandOutput.
   std::unique_ptr<Job> ownedJob = TC.constructJob(*JA, std::move(InputJobs),
                                                   std::move(Output),
@@ -1914,11 +2095,14 @@ Job *Driver::buildJobsForAction(Compilation &C, const Action *A,
                [] { llvm::outs() << ", "; });
 
     types::forAllTypes([&J](types::ID Ty) {
-      StringRef AdditionalOutput =
-        J->getOutput().getAdditionalOutputForType(Ty);
-      if (!AdditionalOutput.empty()) {
-        llvm::outs() << ", " << types::getTypeName(Ty) << ": \""
-          << AdditionalOutput << '"';
+      const CommandOutput &Output = J->getOutput();
+      unsigned NumOutputs = Output.isBatch() ? Output.getNumBaseInputs() : 1;
+      for (unsigned i = 0; i != NumOutputs; ++i) {
+        StringRef AdditionalOutput = Output.getAdditionalOutputForType(Ty, i);
+        if (!AdditionalOutput.empty()) {
+          llvm::outs() << ", " << types::getTypeName(Ty) << ": \""
+            << AdditionalOutput << '"';
+        }
       }
     });
     llvm::outs() << '}';
@@ -42,6 +42,31 @@ CommandOutput::getAnyOutputForType(types::ID type) const {
   return getAdditionalOutputForType(type);
 }
 
+void CommandOutput::setAdditionalOutputForType(types::ID type,
+                                               StringRef OutputFilename,
+                                               unsigned Index) {
+  if (!isBatch()) {
+    setAdditionalOutputForType(type, OutputFilename);
+    return;
+  }
+  PerInputOutputsMaps[Index][type] = OutputFilename;
+}
+
+const std::string &
+CommandOutput::getAdditionalOutputForType(types::ID type,
+                                          unsigned Index) const {
+  if (!isBatch())
+    return getAdditionalOutputForType(type);
+
+  auto &Map = PerInputOutputsMaps[Index];
+  auto iter = Map.find(type);
+  if (iter != Map.end())
+    return iter->second;
+
+  static const std::string empty;
+  return empty;
+}
+
 static void escapeAndPrintString(llvm::raw_ostream &os, StringRef Str) {
   if (Str.empty()) {
     // Special-case the empty string.
@@ -0,0 +1,418 @@
+//===--- OutputCache.cpp - Content-addressed cache of job outputs ---------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Driver/OutputCache.h"
+#include "swift/Basic/Version.h"
+#include "swift/Driver/Action.h"
+#include "swift/Driver/DependencyGraph.h"
+#include "swift/Driver/Job.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace swift;
+using namespace swift::sys;
+using namespace swift::driver;
+
+/// Bump this when the layout of the cache changes.
+static const char CacheVersion[] = "swift-output-cache-1";
+
+/// Calls \p fn with the name under which each output of \p output is cached
+/// and the path of the output.
+static void
+forEachOutput(const CommandOutput &output,
+              llvm::function_ref<void(StringRef, StringRef)> fn) {
+  StringRef primaryType = types::getTypeName(output.getPrimaryOutputType());
+  ArrayRef<std::string> primaryOutputs = output.getPrimaryOutputFilenames();
+  for (unsigned i = 0, e = primaryOutputs.size(); i != e; ++i)
+    fn((primaryType + "." + llvm::Twine(i)).str(), primaryOutputs[i]);
+
+  types::forAllTypes([&](types::ID type) {
+    // A trace describes one particular run of the job.
+    if (type == types::TY_TraceEvents)
+      return;
+    const std::string &path = output.getAdditionalOutputForType(type);
+    if (!path.empty())
+      fn(types::getTypeName(type), path);
+  });
+}
+
+/// Writes \p contents to \p path under a temporary name, then renames it into
+/// place.
+///
+/// \returns true on error, false on success
+static bool writeFileAtomically(StringRef path, StringRef contents) {
+  SmallString<128> tmpName(path);
+  tmpName += "-%%%%%%";
+  int tmpFD;
+  if (llvm::sys::fs::createUniqueFile(tmpName.str(), tmpFD, tmpName))
+    return true;
+
+  {
+    llvm::raw_fd_ostream out(tmpFD, /*shouldClose=*/true);
+    out << contents;
+    out.flush();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(tmpName.str());
+      return true;
+    }
+  }
+
+  if (llvm::sys::fs::rename(tmpName.str(), path)) {
+    llvm::sys::fs::remove(tmpName.str());
+    return true;
+  }
+  return false;
+}
+
+/// Copies the file \p from to \p to.
+///
+/// \returns true on error, false on success
+static bool copyFile(StringRef from, StringRef to) {
+  auto buffer = llvm::MemoryBuffer::getFile(from);
+  if (!buffer)
+    return true;
+
+  std::error_code EC;
+  llvm::raw_fd_ostream out(to, EC, llvm::sys::fs::F_None);
+  if (EC)
+    return true;
+  out << buffer.get()->getBuffer();
+  out.flush();
+  if (out.has_error()) {
+    out.clear_error();
+    return true;
+  }
+  return false;
+}
+
+static std::string stringifyHash(llvm::MD5 &hash) {
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> str;
+  llvm::MD5::stringifyResult(result, str);
+  return str.str().str();
+}
+
+OutputCache::OutputCache(StringRef directory, ArrayRef<std::string> inputFiles)
+  : Directory(directory.str()), InputFiles(inputFiles.begin(),
+                                           inputFiles.end()),
+    CompilerIdentity(version::getSwiftFullVersion()) {}
+
+StringRef OutputCache::hashFile(StringRef path) {
+  auto known = FileHashes.find(path);
+  if (known != FileHashes.end())
+    return known->getValue();
+
+  std::string result;
+  if (auto buffer = llvm::MemoryBuffer::getFile(path)) {
+    llvm::MD5 hash;
+    hash.update(buffer.get()->getBuffer());
+    result = stringifyHash(hash);
+  }
+  return FileHashes[path] = result;
+}
+
+std::string OutputCache::getPath(StringRef name) const {
+  SmallString<128> path(Directory);
+  llvm::sys::path::append(path, name);
+  return path.str().str();
+}
+
+std::string OutputCache::computeInputKey(const Job &cmd) {
+  if (!isa<CompileJobAction>(cmd.getSource()))
+    return std::string();
+
+  // The outputs of a batch job depend on how the inputs were split up, which
+  // is recorded in a temporary file.
+  const CommandOutput &output = cmd.getOutput();
+  if (output.isBatch())
+    return std::string();
+
+  // Without a list of the modules the job loads, there's no telling when
+  // its outputs are out of date.
+  if (output.getAdditionalOutputForType(types::TY_SwiftDeps).empty() &&
+      output.getAdditionalOutputForType(types::TY_Dependencies).empty())
+    return std::string();
+
+  // Where the outputs go doesn't change what they contain, so don't let it
+  // get in the way of a hit. Outputs written to stdout can't be cached.
+  llvm::StringSet<> outputPaths;
+  bool writesToStdout = false;
+  forEachOutput(output, [&](StringRef name, StringRef path) {
+    outputPaths.insert(path);
+    writesToStdout |= (path == "-");
+  });
+  if (writesToStdout)
+    return std::string();
+
+  // A trace isn't cached, but its path is a temporary file of its own for
+  // every job.
+  StringRef tracePath =
+    output.getAdditionalOutputForType(types::TY_TraceEvents);
+  if (!tracePath.empty())
+    outputPaths.insert(tracePath);
+
+  llvm::MD5 hash;
+  auto addString = [&](StringRef str) {
+    hash.update(str);
+    hash.update(StringRef("", 1));
+  };
+
+  addString(CacheVersion);
+  addString(CompilerIdentity);
+
+  // The same version string may stand for different builds of the compiler.
+  llvm::sys::fs::file_status executableStatus;
+  if (llvm::sys::fs::status(cmd.getExecutable(), executableStatus))
+    return std::string();
+  addString(cmd.getExecutable());
+  addString(std::to_string(executableStatus.getSize()));
+  addString(std::to_string(
+    executableStatus.getLastModificationTime().toEpochTime()));
+
+  // Relative paths, and the paths recorded in the outputs, depend on the
+  // working directory.
+  SmallString<128> workingDirectory;
+  if (llvm::sys::fs::current_path(workingDirectory))
+    return std::string();
+  addString(workingDirectory);
+
+  for (const char *arg : cmd.getArguments())
+    addString(outputPaths.count(arg) ? "<output>" : arg);
+
+  for (const std::string &input : InputFiles) {
+    StringRef inputHash = hashFile(input);
+    if (inputHash.empty())
+      return std::string();
+    addString(input);
+    addString(inputHash);
+  }
+
+  return stringifyHash(hash);
+}
+
+bool OutputCache::collectDependencies(
+    const Job &cmd, std::vector<std::string> &dependencies) const {
+  const CommandOutput &output = cmd.getOutput();
+
+  StringRef swiftDeps = output.getAdditionalOutputForType(types::TY_SwiftDeps);
+  if (!swiftDeps.empty()) {
+    DependencyGraph<const Job *> graph;
+    if (graph.loadFromPath(&cmd, swiftDeps) ==
+          DependencyGraphImpl::LoadResult::HadError)
+      return true;
+    for (StringRef dependency : graph.getExternalDependencies())
+      dependencies.push_back(dependency.str());
+    return false;
+  }
+
+  // Otherwise read the first rule of the Make-style dependencies file; every
+  // rule lists the same files.
+  StringRef makeDeps = output.getAdditionalOutputForType(types::TY_Dependencies);
+  auto buffer = llvm::MemoryBuffer::getFile(makeDeps);
+  if (!buffer)
+    return true;
+
+  StringRef contents = buffer.get()->getBuffer();
+  std::string current;
+  bool seenColon = false;
+  for (size_t i = 0, e = contents.size(); i != e; ++i) {
+    char c = contents[i];
+    if (c == '\\' && i + 1 != e) {
+      current.push_back(contents[++i]);
+      continue;
+    }
+    if (c == '$' && i + 1 != e && contents[i + 1] == '$') {
+      current.push_back('$');
+      ++i;
+      continue;
+    }
+    if (c == ':' && !seenColon) {
+      seenColon = true;
+      current.clear();
+      continue;
+    }
+    if (c == ' ' || c == '\n') {
+      if (seenColon && !current.empty())
+        dependencies.push_back(current);
+      current.clear();
+      if (c == '\n' && seenColon)
+        break;
+      continue;
+    }
+    current.push_back(c);
+  }
+  if (seenColon && !current.empty())
+    dependencies.push_back(current);
+
+  return !seenColon;
+}
+
+bool OutputCache::restore(StringRef inputKey, const Job &cmd,
+                          std::string &output) {
+  auto manifest = llvm::MemoryBuffer::getFile(getPath(inputKey.str() +
+                                                      ".manifest"));
+  if (!manifest)
+    return false;
+
+  StringRef entry, rest;
+  std::tie(entry, rest) = manifest.get()->getBuffer().split('\n');
+  if (entry.empty())
+    return false;
+
+  // Everything the job read last time must be unchanged.
+  while (!rest.empty()) {
+    StringRef line, expectedHash, path;
+    std::tie(line, rest) = rest.split('\n');
+    std::tie(expectedHash, path) = line.split(' ');
+    if (path.empty() || hashFile(path) != expectedHash)
+      return false;
+  }
+
+  // Make sure all outputs are there before overwriting any of them.
+  std::vector<std::pair<std::string, std::string>> copies;
+  forEachOutput(cmd.getOutput(), [&](StringRef name, StringRef path) {
+    copies.push_back({ getPath((entry + "." + name).str()), path.str() });
+  });
+  for (auto &copy : copies)
+    if (!llvm::sys::fs::exists(copy.first))
+      return false;
+  for (auto &copy : copies)
+    if (copyFile(copy.first, copy.second))
+      return false;
+
+  output.clear();
+  if (auto printed = llvm::MemoryBuffer::getFile(getPath(entry.str() +
+                                                         ".output")))
+    output = printed.get()->getBuffer().str();
+  return true;
+}
+
+void OutputCache::store(StringRef inputKey, const Job &cmd,
+                        StringRef output) {
+  std::vector<std::string> dependencies;
+  if (collectDependencies(cmd, dependencies))
+    return;
+
+  std::string manifestBody;
+  for (const std::string &dependency : dependencies) {
+    StringRef dependencyHash = hashFile(dependency);
+    if (dependencyHash.empty() ||
+        dependency.find('\n') != std::string::npos)
+      return;
+    manifestBody += dependencyHash;
+    manifestBody += ' ';
+    manifestBody += dependency;
+    manifestBody += '\n';
+  }
+
+  llvm::MD5 hash;
+  hash.update(inputKey);
+  hash.update(manifestBody);
+  std::string entry = stringifyHash(hash);
+
+  if (llvm::sys::fs::create_directories(Directory))
+    return;
+
+  bool failed = false;
+  forEachOutput(cmd.getOutput(), [&](StringRef name, StringRef path) {
+    if (failed)
+      return;
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    failed = !buffer ||
+             writeFileAtomically(getPath(entry + "." + name.str()),
+                                 buffer.get()->getBuffer());
+  });
+  if (failed || writeFileAtomically(getPath(entry + ".output"), output))
+    return;
+
+  // The manifest makes the entry visible, so it goes last.
+  (void)writeFileAtomically(getPath(inputKey.str() + ".manifest"),
+                            entry + "\n" + manifestBody);
+}
+
+void CachingTaskQueue::addTask(const char *ExecPath,
+                               ArrayRef<const char *> Args,
+                               ArrayRef<const char *> Env, void *Context) {
+  if (Context) {
+    auto *Cmd = static_cast<const Job *>(Context);
+    std::string InputKey = Cache.computeInputKey(*Cmd);
+    if (!InputKey.empty()) {
+      std::string Output;
+      if (Cache.restore(InputKey, *Cmd, Output)) {
+        RestoredTasks.push_back({ Context, std::move(Output) });
+        return;
+      }
+      InputKeys[Context] = std::move(InputKey);
+    }
+  }
+  TaskQueue::addTask(ExecPath, Args, Env, Context);
+}
+
+bool CachingTaskQueue::hasRemainingTasks() {
+  return !RestoredTasks.empty() || TaskQueue::hasRemainingTasks();
+}
+
+bool CachingTaskQueue::execute(TaskBeganCallback Began,
+                               TaskFinishedCallback Finished,
+                               TaskSignalledCallback Signalled) {
+  bool StopExecution = false;
+
+  // Report each restored task as if it had just run successfully. This may
+  // add more tasks, which may be restored in turn.
+  auto reportRestoredTasks = [&] {
+    while (!RestoredTasks.empty() && !StopExecution) {
+      auto Restored = std::move(RestoredTasks.front());
+      RestoredTasks.pop_front();
+      if (Began)
+        Began(0, Restored.first);
+      if (Finished &&
+          Finished(0, 0, Restored.second, Restored.first) ==
+            TaskFinishedResponse::StopExecution)
+        StopExecution = true;
+    }
+  };
+
+  auto FinishedAndStore = [&](ProcessId Pid, int ReturnCode, StringRef Output,
+                              void *Context) -> TaskFinishedResponse {
+    auto Found = InputKeys.find(Context);
+    if (Found != InputKeys.end()) {
+      if (ReturnCode == 0)
+        Cache.store(Found->second, *static_cast<const Job *>(Context), Output);
+      InputKeys.erase(Found);
+    }
+
+    TaskFinishedResponse Response = TaskFinishedResponse::ContinueExecution;
+    if (Finished)
+      Response = Finished(Pid, ReturnCode, Output, Context);
+    else if (ReturnCode != 0)
+      Response = TaskFinishedResponse::StopExecution;
+
+    if (Response == TaskFinishedResponse::StopExecution)
+      return Response;
+    reportRestoredTasks();
+    return StopExecution ? TaskFinishedResponse::StopExecution
+                         : TaskFinishedResponse::ContinueExecution;
+  };
+
+  reportRestoredTasks();
+  if (StopExecution)
+    return true;
+  return TaskQueue::execute(Began, FinishedAndStore, Signalled);
+}
@@ -94,6 +94,28 @@ void OutputFileMap::dump(llvm::raw_ostream &os, bool Sort) const {
   }
 }
 
+void OutputFileMap::write(llvm::raw_ostream &os) const {
+  os << "{\n";
+  bool FirstInput = true;
+  for (auto &InputPair : InputToOutputsMap) {
+    if (!FirstInput)
+      os << ",\n";
+    FirstInput = false;
+    os << "  \"" << llvm::yaml::escape(InputPair.first()) << "\": {";
+
+    bool FirstOutput = true;
+    for (auto &OutputPair : InputPair.second) {
+      if (!FirstOutput)
+        os << ",";
+      FirstOutput = false;
+      os << "\n    \"" << types::getTypeName(OutputPair.first) << "\": \""
+         << llvm::yaml::escape(OutputPair.second) << "\"";
+    }
+    os << "\n  }";
+  }
+  os << "\n}\n";
+}
+
 bool OutputFileMap::parse(std::unique_ptr<llvm::MemoryBuffer> Buffer) {
   llvm::SourceMgr SM;
   llvm::yaml::Stream YAMLStream(Buffer->getMemBufferRef(), SM);
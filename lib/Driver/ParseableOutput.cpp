@@ -132,11 +132,15 @@ public:
         Outputs.push_back(OutputPair(PrimaryOutputType, OutputFileName));
       }
     }
+    const CommandOutput &CmdOutput = Cmd.getOutput();
+    unsigned NumOutputs =
+      CmdOutput.isBatch() ? CmdOutput.getNumBaseInputs() : 1;
     types::forAllTypes([&](types::ID Ty) {
-      const std::string &Output =
-          Cmd.getOutput().getAdditionalOutputForType(Ty);
-      if (!Output.empty())
-        Outputs.push_back(OutputPair(Ty, Output));
+      for (unsigned i = 0; i != NumOutputs; ++i) {
+        const std::string &Output = CmdOutput.getAdditionalOutputForType(Ty, i);
+        if (!Output.empty())
+          Outputs.push_back(OutputPair(Ty, Output));
+      }
     });
   }
 
@@ -25,6 +25,7 @@
 #include "swift/Config.h"
 #include "clang/Basic/Version.h"
 #include "clang/Driver/Util.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Option/Arg.h"
 #include "llvm/Option/ArgList.h"
@@ -40,6 +41,18 @@ using namespace llvm::opt;
 /// The name of the Swift migrator binary.
 static const char * const SWIFT_UPDATE_NAME = "swift-update";
 
+/// Asks a frontend job to record a trace, if the driver gave it a path for
+/// one.
+static void addTraceOutputArg(ArgStringList &Arguments,
+                              const CommandOutput &Output) {
+  const std::string &TracePath =
+    Output.getAdditionalOutputForType(types::TY_TraceEvents);
+  if (!TracePath.empty()) {
+    Arguments.push_back("-trace-output");
+    Arguments.push_back(TracePath.c_str());
+  }
+}
+
 static void addInputsOfType(ArgStringList &Arguments,
                             ArrayRef<const Action *> Inputs,
                             types::ID InputType) {
@@ -54,7 +67,19 @@ static void addInputsOfType(ArgStringList &Arguments,
                             ArrayRef<const Job *> Jobs,
                             types::ID InputType) {
   for (const Job *Cmd : Jobs) {
-    auto &output = Cmd->getOutput().getAnyOutputForType(InputType);
+    const CommandOutput &CmdOutput = Cmd->getOutput();
+    if (CmdOutput.isBatch()) {
+      // A batch compile job has an output of each type for every input.
+      for (unsigned i = 0, e = CmdOutput.getNumBaseInputs(); i != e; ++i) {
+        auto &output = CmdOutput.getPrimaryOutputType() == InputType
+                         ? CmdOutput.getPrimaryOutputFilenames()[i]
+                         : CmdOutput.getAdditionalOutputForType(InputType, i);
+        if (!output.empty())
+          Arguments.push_back(output.c_str());
+      }
+      continue;
+    }
+    auto &output = CmdOutput.getAnyOutputForType(InputType);
     if (!output.empty())
       Arguments.push_back(output.c_str());
   }
@@ -126,6 +151,9 @@ static void addCommonFrontendArgs(const ToolChain &TC,
   inputArgs.AddLastArg(arguments, options::OPT_solver_memory_threshold);
   inputArgs.AddLastArg(arguments, options::OPT_profile_generate);
   inputArgs.AddLastArg(arguments, options::OPT_profile_coverage_mapping);
+  inputArgs.AddLastArg(arguments, options::OPT_profile_use);
+  inputArgs.AddLastArg(arguments, options::OPT_Rpass_EQ);
+  inputArgs.AddLastArg(arguments, options::OPT_Rpass_missed_EQ);
 
   // Pass on any build config options
   inputArgs.AddAllArgs(arguments, options::OPT_D);
@@ -205,10 +233,12 @@ ToolChain::constructInvocation(const CompileJobAction &job,
     case types::TY_SwiftModuleDocFile:
     case types::TY_ClangModuleFile:
     case types::TY_SerializedDiagnostics:
+    case types::TY_OptRecord:
     case types::TY_ObjCHeader:
     case types::TY_Image:
     case types::TY_SwiftDeps:
     case types::TY_Remapping:
+    case types::TY_TraceEvents:
       llvm_unreachable("Output type can never be primary output.");
     case types::TY_INVALID:
       llvm_unreachable("Invalid type ID");
@@ -238,21 +268,23 @@ ToolChain::constructInvocation(const CompileJobAction &job,
   switch (context.OI.CompilerMode) {
   case OutputInfo::Mode::StandardCompile:
   case OutputInfo::Mode::UpdateCode: {
-    assert(context.InputActions.size() == 1 &&
-           "The Swift frontend expects exactly one input (the primary file)!");
+    assert((context.InputActions.size() == 1 ||
+            (context.OI.isBatchMode() && !context.InputActions.empty())) &&
+           "The Swift frontend expects exactly one input (the primary file) "
+           "outside of batch mode!");
 
-    auto *IA = cast<InputAction>(context.InputActions[0]);
-    const Arg &PrimaryInputArg = IA->getInputArg();
-    bool FoundPrimaryInput = false;
+    // In batch mode there is one primary file for each input action.
+    llvm::SmallDenseSet<unsigned, 4> PrimaryInputIndices;
+    for (const Action *A : context.InputActions)
+      PrimaryInputIndices.insert(
+        cast<InputAction>(A)->getInputArg().getIndex());
 
     for (auto *A : make_range(context.Args.filtered_begin(options::OPT_INPUT),
                               context.Args.filtered_end())) {
       // See if this input should be passed with -primary-file.
       // FIXME: This will pick up non-source inputs too, like .o files.
-      if (!FoundPrimaryInput && PrimaryInputArg.getIndex() == A->getIndex()) {
+      if (PrimaryInputIndices.erase(A->getIndex()))
         Arguments.push_back("-primary-file");
-        FoundPrimaryInput = true;
-      }
       Arguments.push_back(A->getValue());
     }
     break;
@@ -325,6 +357,13 @@ ToolChain::constructInvocation(const CompileJobAction &job,
     Arguments.push_back(SerializedDiagnosticsPath.c_str());
   }
 
+  const std::string &OptRecordPath =
+    context.Output.getAdditionalOutputForType(types::TY_OptRecord);
+  if (!OptRecordPath.empty()) {
+    Arguments.push_back("-save-optimization-record-path");
+    Arguments.push_back(OptRecordPath.c_str());
+  }
+
   const std::string &DependenciesPath =
     context.Output.getAdditionalOutputForType(types::TY_Dependencies);
   if (!DependenciesPath.empty()) {
@@ -339,6 +378,13 @@ ToolChain::constructInvocation(const CompileJobAction &job,
     Arguments.push_back(ReferenceDependenciesPath.c_str());
   }
 
+  // The driver loads the binary format much faster in the next incremental
+  // build. Batch jobs may get dependencies paths from their supplementary
+  // output file map.
+  if ((!ReferenceDependenciesPath.empty() || context.Output.isBatch()) &&
+      !context.Args.hasArg(options::OPT_driver_emit_yaml_swiftdeps))
+    Arguments.push_back("-binary-reference-dependencies");
+
   const std::string &FixitsPath =
     context.Output.getAdditionalOutputForType(types::TY_Remapping);
   if (!FixitsPath.empty()) {
@@ -346,12 +392,22 @@ ToolChain::constructInvocation(const CompileJobAction &job,
     Arguments.push_back(FixitsPath.c_str());
   }
 
+  StringRef SupplementaryOutputFileMapPath =
+    context.Output.getSupplementaryOutputFileMapPath();
+  if (!SupplementaryOutputFileMapPath.empty()) {
+    Arguments.push_back("-supplementary-output-file-map");
+    Arguments.push_back(
+      context.Args.MakeArgString(SupplementaryOutputFileMapPath));
+  }
+
   if (context.OI.numThreads > 0) {
     Arguments.push_back("-num-threads");
     Arguments.push_back(
         context.Args.MakeArgString(Twine(context.OI.numThreads)));
   }
 
+  addTraceOutputArg(Arguments, context.Output);
+
   // Add the output file argument if necessary.
   if (context.Output.getPrimaryOutputType() != types::TY_Nothing) {
     for (auto &FileName : context.Output.getPrimaryOutputFilenames()) {
@@ -422,10 +478,12 @@ ToolChain::constructInvocation(const BackendJobAction &job,
     case types::TY_SwiftModuleDocFile:
     case types::TY_ClangModuleFile:
     case types::TY_SerializedDiagnostics:
+    case types::TY_OptRecord:
     case types::TY_ObjCHeader:
     case types::TY_Image:
     case types::TY_SwiftDeps:
     case types::TY_Remapping:
+    case types::TY_TraceEvents:
       llvm_unreachable("Output type can never be primary output.");
     case types::TY_INVALID:
       llvm_unreachable("Invalid type ID");
@@ -499,6 +557,8 @@ ToolChain::constructInvocation(const BackendJobAction &job,
     }
   }
 
+  addTraceOutputArg(Arguments, context.Output);
+
   // Add flags implied by -embed-bitcode.
   Arguments.push_back("-embed-bitcode");
   // Disable all llvm IR level optimizations.
@@ -526,7 +586,7 @@ ToolChain::constructInvocation(const MergeModuleJobAction &job,
   assert(Arguments.size() - origLen >=
          context.Inputs.size() + context.InputActions.size());
   assert((Arguments.size() - origLen == context.Inputs.size() ||
-          !context.InputActions.empty()) &&
+          !context.InputActions.empty() || context.OI.isBatchMode()) &&
          "every input to MergeModule must generate a swiftmodule");
 
   // Tell all files to parse as library, which is necessary to load them as
@@ -549,6 +609,8 @@ ToolChain::constructInvocation(const MergeModuleJobAction &job,
     Arguments.push_back(ObjCHeaderOutputPath.c_str());
   }
 
+  addTraceOutputArg(Arguments, context.Output);
+
   Arguments.push_back("-o");
   Arguments.push_back(
       context.Args.MakeArgString(context.Output.getPrimaryOutputFilename()));
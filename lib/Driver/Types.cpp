@@ -74,6 +74,8 @@ bool types::isTextual(ID Id) {
   case types::TY_LLVM_IR:
   case types::TY_ObjCHeader:
   case types::TY_AutolinkFile:
+  case types::TY_TraceEvents:
+  case types::TY_OptRecord:
     return true;
   case types::TY_Image:
   case types::TY_Object:
@@ -114,10 +116,12 @@ bool types::isAfterLLVM(ID Id) {
   case types::TY_SwiftModuleFile:
   case types::TY_SwiftModuleDocFile:
   case types::TY_SerializedDiagnostics:
+  case types::TY_OptRecord:
   case types::TY_ClangModuleFile:
   case types::TY_SwiftDeps:
   case types::TY_Nothing:
   case types::TY_Remapping:
+  case types::TY_TraceEvents:
     return false;
   case types::TY_INVALID:
     llvm_unreachable("Invalid type ID.");
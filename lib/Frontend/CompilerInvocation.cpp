@@ -116,6 +116,8 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
 
   Opts.DelayedFunctionBodyParsing |= Args.hasArg(OPT_delayed_function_body_parsing);
   Opts.EnableTesting |= Args.hasArg(OPT_enable_testing);
+  Opts.BinaryReferenceDependencies |=
+    Args.hasArg(OPT_binary_reference_dependencies);
 
   Opts.PrintStats |= Args.hasArg(OPT_print_stats);
   Opts.PrintClangStats |= Args.hasArg(OPT_print_clang_stats);
@@ -143,7 +145,10 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
     if (A->getOption().matches(OPT_INPUT)) {
       Opts.InputFilenames.push_back(A->getValue());
     } else if (A->getOption().matches(OPT_primary_file)) {
-      Opts.PrimaryInput = SelectedInput(Opts.InputFilenames.size());
+      SelectedInput Input(Opts.InputFilenames.size());
+      if (!Opts.PrimaryInput.hasValue())
+        Opts.PrimaryInput = Input;
+      Opts.PrimaryInputs.push_back(Input);
       Opts.InputFilenames.push_back(A->getValue());
     } else {
       llvm_unreachable("Unknown input-related argument!");
@@ -287,6 +292,58 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
 
   Opts.OutputFilenames = Args.getAllArgValues(OPT_o);
 
+  if (Opts.isBatchMode()) {
+    switch (Opts.RequestedAction) {
+    case FrontendOptions::NoneAction:
+    case FrontendOptions::DumpParse:
+    case FrontendOptions::DumpInterfaceHash:
+    case FrontendOptions::DumpAST:
+    case FrontendOptions::PrintAST:
+    case FrontendOptions::DumpTypeRefinementContexts:
+    case FrontendOptions::Immediate:
+    case FrontendOptions::REPL:
+      Diags.diagnose(SourceLoc(), diag::error_mode_cannot_batch);
+      return true;
+    case FrontendOptions::Parse:
+    case FrontendOptions::EmitModuleOnly:
+    case FrontendOptions::EmitSILGen:
+    case FrontendOptions::EmitSIL:
+    case FrontendOptions::EmitSIBGen:
+    case FrontendOptions::EmitSIB:
+    case FrontendOptions::EmitIR:
+    case FrontendOptions::EmitBC:
+    case FrontendOptions::EmitAssembly:
+    case FrontendOptions::EmitObject:
+      break;
+    }
+
+    // Each primary input gets the output at the same position.
+    if (Opts.actionHasOutput() &&
+        Opts.OutputFilenames.size() != Opts.PrimaryInputs.size()) {
+      Diags.diagnose(SourceLoc(), diag::error_batch_mode_output_count);
+      return true;
+    }
+
+    // A single path can't name the supplementary outputs of several primary
+    // inputs; they have to come from the supplementary output file map.
+    for (OptSpecifier Opt : { OPT_emit_dependencies_path,
+                              OPT_emit_reference_dependencies_path,
+                              OPT_emit_module_path,
+                              OPT_emit_module_doc_path,
+                              OPT_emit_objc_header,
+                              OPT_emit_objc_header_path,
+                              OPT_save_optimization_record_path }) {
+      if (const Arg *A = Args.getLastArg(Opt)) {
+        Diags.diagnose(SourceLoc(), diag::error_batch_mode_output_path,
+                       A->getOption().getPrefixedName());
+        return true;
+      }
+    }
+  }
+
+  if (const Arg *A = Args.getLastArg(OPT_supplementary_output_file_map))
+    Opts.SupplementaryOutputFileMapPath = A->getValue();
+
   bool UserSpecifiedModuleName = false;
   {
     const Arg *A = Args.getLastArg(OPT_module_name);
@@ -506,6 +563,10 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
                           OPT_serialize_diagnostics,
                           OPT_serialize_diagnostics_path,
                           "dia", false);
+  determineOutputFilename(Opts.OptRecordPath,
+                          OPT_save_optimization_record,
+                          OPT_save_optimization_record_path,
+                          "opt.yaml", false);
   determineOutputFilename(Opts.ObjCHeaderOutputPath,
                           OPT_emit_objc_header,
                           OPT_emit_objc_header_path,
@@ -515,6 +576,10 @@ static bool ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
     Opts.FixitsOutputPath = A->getValue();
   }
 
+  if (const Arg *A = Args.getLastArg(OPT_trace_output)) {
+    Opts.TraceOutputPath = A->getValue();
+  }
+
   bool IsSIB =
     Opts.RequestedAction == FrontendOptions::EmitSIB ||
     Opts.RequestedAction == FrontendOptions::EmitSIBGen;
@@ -685,6 +750,7 @@ static bool ParseLangArgs(LangOptions &Opts, ArgList &Args,
   
   Opts.DebugConstraintSolver |= Args.hasArg(OPT_debug_constraints);
   Opts.IterativeTypeChecker |= Args.hasArg(OPT_iterative_type_checker);
+  Opts.LazyMemberValidation &= !Args.hasArg(OPT_disable_lazy_member_validation);
   Opts.DebugGenericSignatures |= Args.hasArg(OPT_debug_generic_signatures);
 
   Opts.DebuggerSupport |= Args.hasArg(OPT_debugger_support);
@@ -900,6 +966,25 @@ static void PrintArg(raw_ostream &OS, const char *Arg, bool Quote) {
   OS << '"';
 }
 
+/// Parses the pattern of -Rpass or -Rpass-missed, which selects the passes
+/// whose remarks are printed.
+static bool ParseOptRemarkPattern(std::shared_ptr<llvm::Regex> &Pattern,
+                                  OptSpecifier Opt, ArgList &Args,
+                                  DiagnosticEngine &Diags) {
+  const Arg *A = Args.getLastArg(Opt);
+  if (!A)
+    return false;
+
+  Pattern = std::make_shared<llvm::Regex>(A->getValue());
+  std::string Error;
+  if (!Pattern->isValid(Error)) {
+    Diags.diagnose(SourceLoc(), diag::error_invalid_arg_value,
+                   A->getAsString(Args), A->getValue());
+    return true;
+  }
+  return false;
+}
+
 static bool ParseSILArgs(SILOptions &Opts, ArgList &Args,
                          IRGenOptions &IRGenOpts,
                          FrontendOptions &FEOpts,
@@ -988,6 +1073,7 @@ static bool ParseSILArgs(SILOptions &Opts, ArgList &Args,
 
   Opts.EnableARCOptimizations |= !Args.hasArg(OPT_disable_arc_opts);
   Opts.VerifyAll |= Args.hasArg(OPT_sil_verify_all);
+  Opts.ParallelFunctionPasses |= Args.hasArg(OPT_sil_parallel_function_passes);
   Opts.DebugSerialization |= Args.hasArg(OPT_sil_debug_serialization);
   Opts.EmitVerboseSIL |= Args.hasArg(OPT_emit_verbose_sil);
   Opts.PrintInstCounts |= Args.hasArg(OPT_print_inst_counts);
@@ -997,6 +1083,13 @@ static bool ParseSILArgs(SILOptions &Opts, ArgList &Args,
 
   Opts.GenerateProfile |= Args.hasArg(OPT_profile_generate);
   Opts.EmitProfileCoverageMapping |= Args.hasArg(OPT_profile_coverage_mapping);
+  if (const Arg *A = Args.getLastArg(OPT_profile_use))
+    Opts.UseProfile = A->getValue();
+
+  if (ParseOptRemarkPattern(Opts.OptRemarkPassed, OPT_Rpass_EQ, Args, Diags) ||
+      ParseOptRemarkPattern(Opts.OptRemarkMissed, OPT_Rpass_missed_EQ, Args,
+                            Diags))
+    return true;
 
   return false;
 }
@@ -23,6 +23,7 @@
 #include "swift/AST/DiagnosticsSema.h"
 #include "swift/AST/Module.h"
 #include "swift/Basic/SourceManager.h"
+#include "swift/Basic/TraceEvents.h"
 #include "swift/Parse/DelayedParsingCallbacks.h"
 #include "swift/Parse/Lexer.h"
 #include "swift/SIL/SILModule.h"
@@ -32,6 +33,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include <algorithm>
 
 using namespace swift;
 
@@ -45,14 +47,38 @@ void CompilerInstance::createSILModule(bool WholeModule) {
 void CompilerInstance::setPrimarySourceFile(SourceFile *SF) {
   assert(SF);
   assert(MainModule && "main module not created yet");
-  assert(!PrimarySourceFile && "already has a primary source file");
-  assert(PrimaryBufferID == NO_SUCH_BUFFER || !SF->getBufferID().hasValue() ||
-         SF->getBufferID().getValue() == PrimaryBufferID);
-  PrimarySourceFile = SF;
-  PrimarySourceFile->setReferencedNameTracker(NameTracker);
+
+  // A file parsed without any primary input, or one without a buffer, is
+  // the only primary file.
+  unsigned Index = 0;
+  if (!isWholeModule() && SF->getBufferID().hasValue()) {
+    auto I = std::find(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                       SF->getBufferID().getValue());
+    assert(I != PrimaryBufferIDs.end() && "not a primary buffer");
+    Index = I - PrimaryBufferIDs.begin();
+  }
+  if (PrimarySourceFiles.size() <= Index)
+    PrimarySourceFiles.resize(Index + 1);
+  assert(!PrimarySourceFiles[Index] && "already has a primary source file");
+
+  PrimarySourceFiles[Index] = SF;
+  if (Index < NameTrackers.size())
+    SF->setReferencedNameTracker(NameTrackers[Index]);
 }
 
-bool CompilerInstance::setup(const CompilerInvocation &Invok) {
+bool CompilerInstance::isPrimaryBuffer(unsigned BufferID) const {
+  return std::find(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                   BufferID) != PrimaryBufferIDs.end();
+}
+
+bool CompilerInstance::isWholeModule() const {
+  return std::all_of(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                     [](unsigned BufferID) {
+    return BufferID == NO_SUCH_BUFFER;
+  });
+}
+
+bool CompilerInstance::setupContext(const CompilerInvocation &Invok) {
   Invocation = Invok;
 
   // Honor -Xllvm.
@@ -101,6 +127,17 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
   }
 
   Context->addModuleLoader(std::move(clangImporter), /*isClang*/true);
+  return false;
+}
+
+bool CompilerInstance::setupInputs(const CompilerInvocation &Invok) {
+  assert(Context && "must call setupContext() first");
+
+  // The context refers to the language options of the invocation it was set
+  // up with, including any adjustments made for it above.
+  LangOptions LangOpts = Invocation.getLangOptions();
+  Invocation = Invok;
+  Invocation.getLangOptions() = LangOpts;
 
   assert(Lexer::isIdentifier(Invocation.getModuleName()));
 
@@ -121,8 +158,21 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
   if (SILMode)
     Invocation.getLangOptions().EnableAccessControl = false;
 
-  const Optional<SelectedInput> &PrimaryInput =
-    Invocation.getFrontendOptions().PrimaryInput;
+  // Invocations built without the command line may only set PrimaryInput.
+  std::vector<SelectedInput> PrimaryInputs =
+    Invocation.getFrontendOptions().PrimaryInputs;
+  if (PrimaryInputs.empty() && Invocation.getFrontendOptions().PrimaryInput)
+    PrimaryInputs.push_back(*Invocation.getFrontendOptions().PrimaryInput);
+  PrimaryBufferIDs.assign(PrimaryInputs.size(), NO_SUCH_BUFFER);
+
+  // Records BufferID as the buffer of the input at Index, if that input is
+  // primary.
+  auto notePrimaryBuffer = [&](SelectedInput::InputKind Kind, unsigned Index,
+                               unsigned BufferID) {
+    for (unsigned i = 0, e = PrimaryInputs.size(); i != e; ++i)
+      if (PrimaryInputs[i].Kind == Kind && PrimaryInputs[i].Index == Index)
+        PrimaryBufferIDs[i] = BufferID;
+  };
 
   // Add the memory buffers first, these will be associated with a filename
   // and they can replace the contents of an input filename.
@@ -141,8 +191,7 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
       if (SILMode)
         MainBufferID = BufferID;
 
-      if (PrimaryInput && PrimaryInput->isBuffer() && PrimaryInput->Index == i)
-        PrimaryBufferID = BufferID;
+      notePrimaryBuffer(SelectedInput::InputKind::Buffer, i, BufferID);
     }
   }
 
@@ -157,9 +206,8 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
       if (SILMode || (MainMode && filename(File) == "main.swift"))
         MainBufferID = ExistingBufferID.getValue();
 
-      if (PrimaryInput && PrimaryInput->isFilename() &&
-          PrimaryInput->Index == i)
-        PrimaryBufferID = ExistingBufferID.getValue();
+      notePrimaryBuffer(SelectedInput::InputKind::Filename, i,
+                        ExistingBufferID.getValue());
 
       continue; // replaced by a memory buffer.
     }
@@ -200,13 +248,14 @@ bool CompilerInstance::setup(const CompilerInvocation &Invok) {
     if (SILMode || (MainMode && filename(File) == "main.swift"))
       MainBufferID = BufferID;
 
-    if (PrimaryInput && PrimaryInput->isFilename() && PrimaryInput->Index == i)
-      PrimaryBufferID = BufferID;
+    notePrimaryBuffer(SelectedInput::InputKind::Filename, i, BufferID);
   }
 
   // Set the primary file to the code-completion point if one exists.
   if (CodeCompletionBufferID.hasValue())
-    PrimaryBufferID = *CodeCompletionBufferID;
+    PrimaryBufferIDs.assign(1, *CodeCompletionBufferID);
+
+  PrimarySourceFiles.assign(PrimaryBufferIDs.size(), nullptr);
 
   if (MainMode && MainBufferID == NO_SUCH_BUFFER && BufferIDs.size() == 1)
     MainBufferID = BufferIDs.front();
@@ -247,6 +296,7 @@ void CompilerInstance::performSema() {
   case SourceFile::ImplicitModuleImportKind::Builtin:
     break;
   case SourceFile::ImplicitModuleImportKind::Stdlib: {
+    trace::Scope TraceStdlib("frontend", "load standard library");
     ModuleDecl *M = Context->getStdlibModule(true);
 
     if (!M) {
@@ -373,7 +423,7 @@ void CompilerInstance::performSema() {
     MainModule->addFile(*MainFile);
     addAdditionalInitialImports(MainFile);
 
-    if (MainBufferID == PrimaryBufferID)
+    if (isPrimaryBuffer(MainBufferID))
       setPrimarySourceFile(MainFile);
   }
 
@@ -399,17 +449,23 @@ void CompilerInstance::performSema() {
     MainModule->addFile(*NextInput);
     addAdditionalInitialImports(NextInput);
 
-    if (BufferID == PrimaryBufferID)
+    if (isPrimaryBuffer(BufferID))
       setPrimarySourceFile(NextInput);
 
     bool Done;
-    do {
-      // Parser may stop at some erroneous constructions like #else, #endif
-      // or '}' in some cases, continue parsing until we are done
-      parseIntoSourceFile(*NextInput, BufferID, &Done, nullptr,
-                          &PersistentState, DelayedCB.get());
-    } while (!Done);
+    {
+      trace::Scope TraceParse("frontend", "parse", NextInput->getFilename());
+      do {
+        // Parser may stop at some erroneous constructions like #else, #endif
+        // or '}' in some cases, continue parsing until we are done
+        parseIntoSourceFile(*NextInput, BufferID, &Done, nullptr,
+                            &PersistentState, DelayedCB.get());
+      } while (!Done);
+    }
 
+    // This loads the modules the file imports.
+    trace::Scope TraceImports("frontend", "bind names",
+                              NextInput->getFilename());
     performNameBinding(*NextInput);
   }
 
@@ -426,7 +482,7 @@ void CompilerInstance::performSema() {
 
   // Compute the options we want to use for type checking.
   OptionSet<TypeCheckingFlags> TypeCheckOptions;
-  if (PrimaryBufferID == NO_SUCH_BUFFER) {
+  if (isWholeModule()) {
     TypeCheckOptions |= TypeCheckingFlags::DelayWholeModuleChecking;
   }
   if (Invocation.getFrontendOptions().DebugTimeFunctionBodies) {
@@ -438,8 +494,7 @@ void CompilerInstance::performSema() {
 
   // Parse the main file last.
   if (MainBufferID != NO_SUCH_BUFFER) {
-    bool mainIsPrimary =
-      (PrimaryBufferID == NO_SUCH_BUFFER || MainBufferID == PrimaryBufferID);
+    bool mainIsPrimary = isWholeModule() || isPrimaryBuffer(MainBufferID);
 
     SourceFile &MainFile =
       MainModule->getMainSourceFile(Invocation.getSourceFileKind());
@@ -451,10 +506,15 @@ void CompilerInstance::performSema() {
       // after parsing any top level code in a main module, or in SIL mode when
       // there are chunks of swift decls (e.g. imports and types) interspersed
       // with 'sil' definitions.
-      parseIntoSourceFile(MainFile, MainFile.getBufferID().getValue(), &Done,
-                          TheSILModule ? &SILContext : nullptr,
-                          &PersistentState, DelayedCB.get());
+      {
+        trace::Scope TraceParse("frontend", "parse", MainFile.getFilename());
+        parseIntoSourceFile(MainFile, MainFile.getBufferID().getValue(), &Done,
+                            TheSILModule ? &SILContext : nullptr,
+                            &PersistentState, DelayedCB.get());
+      }
       if (mainIsPrimary) {
+        trace::Scope TraceTypeCheck("frontend", "type-check",
+                                    MainFile.getFilename());
         performTypeChecking(MainFile, PersistentState.getTopLevelContext(),
                             TypeCheckOptions, CurTUElem);
       }
@@ -464,16 +524,24 @@ void CompilerInstance::performSema() {
     if (mainIsPrimary && !Context->hadError() &&
         Invocation.getFrontendOptions().PlaygroundTransform)
       performPlaygroundTransform(MainFile, Invocation.getFrontendOptions().PlaygroundHighPerformance);
-    if (!mainIsPrimary)
+    if (!mainIsPrimary) {
+      trace::Scope TraceImports("frontend", "bind names",
+                                MainFile.getFilename());
       performNameBinding(MainFile);
+    }
   }
 
   // Type-check each top-level input besides the main source file.
   for (auto File : MainModule->getFiles())
     if (auto SF = dyn_cast<SourceFile>(File))
-      if (PrimaryBufferID == NO_SUCH_BUFFER || SF == PrimarySourceFile)
+      if (isWholeModule() ||
+          std::count(PrimarySourceFiles.begin(), PrimarySourceFiles.end(),
+                     SF)) {
+        trace::Scope TraceTypeCheck("frontend", "type-check",
+                                    SF->getFilename());
         performTypeChecking(*SF, PersistentState.getTopLevelContext(),
                             TypeCheckOptions);
+      }
 
   // Even if there were no source files, we should still record known
   // protocols.
@@ -488,8 +556,11 @@ void CompilerInstance::performSema() {
   // Perform whole-module type checking.
   if (TypeCheckOptions & TypeCheckingFlags::DelayWholeModuleChecking) {
     for (auto File : MainModule->getFiles())
-      if (auto SF = dyn_cast<SourceFile>(File))
+      if (auto SF = dyn_cast<SourceFile>(File)) {
+        trace::Scope TraceTypeCheck("frontend", "whole-module type-check",
+                                    SF->getFilename());
         performWholeModuleTypeChecking(*SF);
+      }
   }
 }
 
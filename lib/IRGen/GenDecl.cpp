@@ -788,6 +788,12 @@ void IRGenModuleDispatcher::emitProtocolConformances() {
   }
 }
 
+void IRGenModuleDispatcher::emitPrespecializedMetadataRecords() {
+  for (auto &m : *this) {
+    m.second->emitPrespecializedMetadataRecords();
+  }
+}
+
 /// Emit any lazy definitions (of globals or functions or whatever
 /// else) that we require.
 void IRGenModuleDispatcher::emitLazyDefinitions() {
@@ -1915,6 +1921,63 @@ llvm::Constant *IRGenModule::emitProtocolConformances() {
   return var;
 }
 
+bool IRGenModule::addPrespecializedMetadataType(CanType type) {
+  return PrespecializedMetadataTypes.insert(type).second;
+}
+
+void IRGenModule::addPrespecializedMetadataRecord(llvm::Constant *pattern,
+                                                  llvm::Constant *metadata) {
+  PrespecializedMetadataRecords.push_back({pattern, metadata});
+}
+
+/// Emit the list of prespecialized generic metadata and return it.
+///
+/// Each record is a pair of absolute pointers to a generic metadata pattern
+/// and to the address point of a complete cache entry for it.  The section
+/// is writable because the runtime links the entries into its caches.
+llvm::Constant *IRGenModule::emitPrespecializedMetadataRecords() {
+  std::string sectionName;
+  switch (TargetInfo.OutputObjectFormat) {
+  case llvm::Triple::MachO:
+    sectionName = "__DATA, __swift2_prespec, regular, no_dead_strip";
+    break;
+  case llvm::Triple::ELF:
+    sectionName = ".swift2_prespecialized_metadata";
+    break;
+  default:
+    llvm_unreachable("Don't know how to emit prespecialized metadata for "
+                     "the selected object format.");
+  }
+
+  // Do nothing if the list is empty.
+  if (PrespecializedMetadataRecords.empty())
+    return nullptr;
+
+  auto recordTy = llvm::StructType::get(LLVMContext,
+                              { TypeMetadataPatternPtrTy, TypeMetadataPtrTy });
+  auto arrayTy = llvm::ArrayType::get(recordTy,
+                                      PrespecializedMetadataRecords.size());
+
+  SmallVector<llvm::Constant*, 8> elts;
+  for (auto &record : PrespecializedMetadataRecords) {
+    llvm::Constant *recordFields[] = {
+      llvm::ConstantExpr::getBitCast(record.first, TypeMetadataPatternPtrTy),
+      llvm::ConstantExpr::getBitCast(record.second, TypeMetadataPtrTy),
+    };
+    elts.push_back(llvm::ConstantStruct::get(recordTy, recordFields));
+  }
+
+  auto var = new llvm::GlobalVariable(Module, arrayTy,
+                                      /*isConstant*/ false,
+                                      llvm::GlobalValue::PrivateLinkage,
+                                      llvm::ConstantArray::get(arrayTy, elts),
+                                      "prespecialized_metadata_records");
+  var->setSection(sectionName);
+  var->setAlignment(getPointerAlignment().getValue());
+  addUsedGlobal(var);
+  return var;
+}
+
 /// Fetch a global reference to the given Objective-C class.  The
 /// result is of type ObjCClassPtrTy.
 llvm::Constant *IRGenModule::getAddrOfObjCClass(ClassDecl *theClass,
@@ -2255,14 +2318,19 @@ IRGenModule::getAddrOfForeignTypeMetadataCandidate(CanType type) {
   return result;
 }
 
-/// Return the address of a nominal type descriptor.  Right now, this
-/// must always be for purposes of defining it.
+/// Return the address of a nominal type descriptor.
+///
+/// If a definition type is provided, this defines the descriptor with that
+/// type, replacing any forward declaration of it.  Otherwise the result is
+/// a reference of type i8*; prespecialized metadata refers to descriptors
+/// this way, including those of types defined in other modules.  Both cases
+/// use i8 as the default type, so that a forward declaration made before the
+/// definition has the type getAddrOfLLVMVariable expects to replace.
 llvm::Constant *IRGenModule::getAddrOfNominalTypeDescriptor(NominalTypeDecl *D,
                                                   llvm::Type *definitionType) {
-  assert(definitionType && "not defining nominal type descriptor?");
   auto entity = LinkEntity::forNominalTypeDescriptor(D);
   return getAddrOfLLVMVariable(entity, getPointerAlignment(),
-                               definitionType, definitionType,
+                               definitionType, Int8Ty,
                                DebugTypeInfo());
 }
 
@@ -912,6 +912,20 @@ void IRGenFunction::emitRelease(llvm::Value *value) {
   emitUnaryRefCountCall(*this, IGM.getReleaseFn(), value);
 }
 
+/// Emit a non-atomic retain of a native Swift object that is known to be
+/// referenced only from the current thread.
+void IRGenFunction::emitNonAtomicRetain(llvm::Value *value) {
+  if (doesNotRequireRefCounting(value)) return;
+  emitUnaryRefCountCall(*this, IGM.getNonAtomicRetainFn(), value);
+}
+
+/// Emit a non-atomic release of a native Swift object that is known to be
+/// referenced only from the current thread.
+void IRGenFunction::emitNonAtomicRelease(llvm::Value *value) {
+  if (doesNotRequireRefCounting(value)) return;
+  emitUnaryRefCountCall(*this, IGM.getNonAtomicReleaseFn(), value);
+}
+
 /// Fix the lifetime of a live value. This communicates to the LLVM level ARC
 /// optimizer not to touch this value.
 void IRGenFunction::emitFixLifetime(llvm::Value *value) {
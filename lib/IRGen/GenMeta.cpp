@@ -252,6 +252,10 @@ static llvm::Value *emitForeignTypeMetadataRef(IRGenFunction &IGF,
   return call;
 }
 
+static void maybeEmitPrespecializedMetadata(IRGenModule &IGM,
+                                            NominalTypeDecl *theDecl,
+                                            BoundGenericType *type);
+
 /// Returns a metadata reference for a nominal type.
 static llvm::Value *emitNominalMetadataRef(IRGenFunction &IGF,
                                            NominalTypeDecl *theDecl,
@@ -327,6 +331,11 @@ static llvm::Value *emitNominalMetadataRef(IRGenFunction &IGF,
   auto boundGeneric = cast<BoundGenericType>(theType);
   assert(boundGeneric->getDecl() == theDecl);
 
+  // If the arguments are known statically, give the runtime a prebuilt
+  // instance to seed the pattern's cache with.
+  if (!theType->hasArchetype())
+    maybeEmitPrespecializedMetadata(IGF.IGM, theDecl, boundGeneric);
+
   GenericArguments genericArgs;
   genericArgs.collect(IGF, boundGeneric);
   
@@ -4629,6 +4638,228 @@ void irgen::emitEnumMetadata(IRGenModule &IGM, EnumDecl *theEnum) {
                          /*isConstant*/!isPattern, init);
 }
 
+//===----------------------------------------------------------------------===//
+// Prespecialized metadata
+//===----------------------------------------------------------------------===//
+
+namespace {
+  /// An adapter class which turns a struct or enum metadata layout class
+  /// into a builder for the metadata that the type's create function would
+  /// produce for one particular set of generic arguments.
+  ///
+  /// This must lay out exactly the same words as GenericMetadataBuilderBase,
+  /// minus the template header, and is only valid for types whose metadata
+  /// has no dependent fields besides the generic arguments.
+  template <class Impl, class Base>
+  class PrespecializedMetadataBuilderBase : public Base {
+    typedef Base super;
+
+    /// The generic arguments, in the order of the metadata fill ops.
+    ArrayRef<llvm::Constant *> Arguments;
+    unsigned NextArgument = 0;
+
+    /// The offset of the address point in the metadata.
+    Size AddressPoint = Size::invalid();
+
+  protected:
+    IRGenModule &IGM = super::IGM;
+
+    template <class... T>
+    PrespecializedMetadataBuilderBase(IRGenModule &IGM,
+                                      ArrayRef<llvm::Constant *> arguments,
+                                      T &&...args)
+      : super(IGM, std::forward<T>(args)...), Arguments(arguments) {}
+
+  public:
+    void layout() {
+      super::layout();
+
+      // The slot the runtime lazily fills in with the field type vector.
+      this->addWord(
+         llvm::ConstantPointerNull::get(IGM.TypeMetadataPtrTy->getPointerTo()));
+
+      assert(NextArgument == Arguments.size() &&
+             "generic arguments do not match the metadata layout");
+    }
+
+    Size getAddressPoint() const {
+      assert(!AddressPoint.isInvalid() && "address point not noted!");
+      return AddressPoint;
+    }
+
+    void noteAddressPoint() {
+      AddressPoint = this->getNextOffset();
+      super::noteAddressPoint();
+    }
+
+    /// The pattern defines the descriptor; just refer to it.
+    void addNominalTypeDescriptor() {
+      this->addWord(IGM.getAddrOfNominalTypeDescriptor(this->Target, nullptr));
+    }
+
+    /// The pattern defines the shared value witness table; just refer to it.
+    void addValueWitnessTable() {
+      CanType unboundType
+        = this->Target->getDeclaredTypeOfContext()->getCanonicalType();
+      this->addWord(IGM.getAddrOfValueWitnessTable(unboundType));
+    }
+
+    void addGenericArgument(ArchetypeType *type) {
+      this->addWord(Arguments[NextArgument++]);
+    }
+
+    void addGenericWitnessTable(ArchetypeType *type, ProtocolDecl *protocol) {
+      this->addWord(Arguments[NextArgument++]);
+    }
+  };
+
+  class PrespecializedStructMetadataBuilder :
+    public PrespecializedMetadataBuilderBase<PrespecializedStructMetadataBuilder,
+              StructMetadataBuilderBase<PrespecializedStructMetadataBuilder>> {
+  public:
+    PrespecializedStructMetadataBuilder(IRGenModule &IGM,
+                                        StructDecl *theStruct,
+                                        ArrayRef<llvm::Constant *> arguments)
+      : PrespecializedMetadataBuilderBase(IGM, arguments, theStruct) {}
+  };
+
+  class PrespecializedEnumMetadataBuilder :
+    public PrespecializedMetadataBuilderBase<PrespecializedEnumMetadataBuilder,
+              EnumMetadataBuilderBase<PrespecializedEnumMetadataBuilder>> {
+  public:
+    PrespecializedEnumMetadataBuilder(IRGenModule &IGM,
+                                      EnumDecl *theEnum,
+                                      ArrayRef<llvm::Constant *> arguments)
+      : PrespecializedMetadataBuilderBase(IGM, arguments, theEnum) {}
+
+    void addPayloadSize() {
+      llvm_unreachable("fixed-layout enums don't need payload size in metadata");
+    }
+  };
+}
+
+/// If all the generic arguments of the given struct or enum type are known
+/// statically, and the type's create function would not do anything but
+/// copy the pattern and fill in the arguments, emit the metadata it would
+/// produce and record it for the runtime to seed the pattern's cache with.
+///
+/// The metadata is emitted as a complete generic cache entry, with the key
+/// arguments and entry header in front of it, so that the runtime can use it
+/// in place without copying it.
+static void maybeEmitPrespecializedMetadata(IRGenModule &IGM,
+                                            NominalTypeDecl *theDecl,
+                                            BoundGenericType *type) {
+  // Only bother when optimizing. In JIT mode there is no image for the
+  // runtime to find the records in.
+  if (!IGM.Opts.Optimize || IGM.Opts.UseJIT)
+    return;
+
+  // Class metadata depends on the superclass and the Objective-C runtime,
+  // so it is always instantiated at runtime.
+  if (!isa<StructDecl>(theDecl) && !isa<EnumDecl>(theDecl))
+    return;
+
+  // TODO: types nested within generic types
+  if (type->getParent())
+    return;
+
+  CanType canType(type);
+  if (!IGM.addPrespecializedMetadataType(canType))
+    return;
+
+  // If the layout depends on the arguments, the create function has to
+  // compute it.
+  CanType unboundType
+    = theDecl->getDeclaredTypeOfContext()->getCanonicalType();
+  if (hasDependentValueWitnessTable(IGM, unboundType))
+    return;
+
+  // Collect the arguments in the same order as GenericArguments::collect.
+  // Each must be a direct reference to a constant.
+  SmallVector<llvm::Constant *, 8> arguments;
+  auto subs = type->getSubstitutions(/*FIXME:*/nullptr, nullptr);
+  for (auto &sub : subs) {
+    CanType subbed = sub.getReplacement()->getCanonicalType();
+    if (!isa<StructType>(subbed) && !isa<EnumType>(subbed))
+      return;
+    if (subbed->getAnyNominal()->hasClangNode() ||
+        !isTypeMetadataAccessTrivial(IGM, subbed))
+      return;
+    arguments.push_back(IGM.getAddrOfTypeMetadata(subbed, false));
+  }
+  for (auto &sub : subs)
+    if (!tryEmitConstantWitnessTableRefs(IGM, sub, arguments))
+      return;
+
+  llvm::Constant *metadataInit;
+  Size addressPoint;
+  if (auto theStruct = dyn_cast<StructDecl>(theDecl)) {
+    PrespecializedStructMetadataBuilder builder(IGM, theStruct, arguments);
+    builder.layout();
+    metadataInit = builder.getInit();
+    addressPoint = builder.getAddressPoint();
+  } else {
+    auto theEnum = cast<EnumDecl>(theDecl);
+    PrespecializedEnumMetadataBuilder builder(IGM, theEnum, arguments);
+    builder.layout();
+    metadataInit = builder.getInit();
+    addressPoint = builder.getAddressPoint();
+  }
+
+  // Lay out the cache entry:
+  //   const void *Arguments[NumArguments];
+  //   const void *Next;
+  //   const Metadata *Value;
+  //   size_t NumArguments;
+  //   <metadata>
+  SmallVector<llvm::Constant *, 8> keyArguments;
+  for (auto argument : arguments)
+    keyArguments.push_back(
+                   llvm::ConstantExpr::getBitCast(argument, IGM.Int8PtrTy));
+  auto keyArgumentsInit = llvm::ConstantArray::get(
+      llvm::ArrayType::get(IGM.Int8PtrTy, keyArguments.size()), keyArguments);
+
+  auto headerTy = llvm::StructType::get(IGM.LLVMContext,
+                          { IGM.Int8PtrTy, IGM.TypeMetadataPtrTy, IGM.SizeTy });
+  auto entryTy = llvm::StructType::get(IGM.LLVMContext,
+                          { keyArgumentsInit->getType(), headerTy,
+                            metadataInit->getType() });
+
+  // The runtime links the entry into the cache, so it cannot be constant.
+  auto var = new llvm::GlobalVariable(IGM.Module, entryTy,
+                                      /*isConstant*/ false,
+                                      llvm::GlobalValue::PrivateLinkage,
+                                      /*initializer*/ nullptr,
+                                      llvm::Twine("prespecialized_metadata_")
+                                        + theDecl->getName().str());
+  var->setAlignment(IGM.getPointerAlignment().getValue());
+
+  Size metadataOffset = IGM.getPointerSize() * (keyArguments.size() + 3)
+                      + addressPoint;
+  auto metadata = llvm::ConstantExpr::getInBoundsGetElementPtr(IGM.Int8Ty,
+                      llvm::ConstantExpr::getBitCast(var, IGM.Int8PtrTy),
+                      llvm::ConstantInt::get(IGM.Int32Ty,
+                                             metadataOffset.getValue()));
+  metadata = llvm::ConstantExpr::getBitCast(metadata, IGM.TypeMetadataPtrTy);
+
+  llvm::Constant *headerFields[] = {
+    llvm::ConstantPointerNull::get(IGM.Int8PtrTy),
+    metadata,
+    llvm::ConstantInt::get(IGM.SizeTy, keyArguments.size()),
+  };
+  llvm::Constant *entryFields[] = {
+    keyArgumentsInit,
+    llvm::ConstantStruct::get(headerTy, headerFields),
+    metadataInit,
+  };
+  var->setInitializer(llvm::ConstantStruct::get(entryTy, entryFields));
+
+  CanType declaredType = theDecl->getDeclaredType()->getCanonicalType();
+  IGM.addPrespecializedMetadataRecord(
+                   IGM.getAddrOfTypeMetadata(declaredType, /*pattern*/ true),
+                   metadata);
+}
+
 llvm::Value *IRGenFunction::emitObjCSelectorRefLoad(StringRef selector) {
   llvm::Constant *loadSelRef = IGM.getAddrOfObjCSelectorRef(selector);
   llvm::Value *loadSel =
@@ -3160,6 +3160,36 @@ void irgen::emitWitnessTableRefs(IRGenFunction &IGF,
   }
 }
 
+/// Try to produce constant references to the witness tables required for
+/// the given type substitution.  Returns false if any of them cannot be
+/// referenced directly.
+bool irgen::tryEmitConstantWitnessTableRefs(IRGenModule &IGM,
+                                            const Substitution &sub,
+                                       SmallVectorImpl<llvm::Constant*> &out) {
+  auto conformances = sub.getConformances();
+  auto archetypeProtos = sub.getArchetype()->getConformsTo();
+  assert(!conformances.size() || archetypeProtos.size() == conformances.size());
+
+  CanType replType = sub.getReplacement()->getCanonicalType();
+  for (unsigned j = 0, je = archetypeProtos.size(); j != je; ++j) {
+    auto proto = archetypeProtos[j];
+    if (!Lowering::TypeConverter::protocolRequiresWitnessTable(proto))
+      continue;
+
+    auto conformance = conformances.size() ? conformances[j] : nullptr;
+    if (!conformance)
+      return false;
+
+    auto &conformanceI =
+      IGM.getProtocolInfo(proto).getConformance(IGM, proto, conformance);
+    auto wtable = conformanceI.tryGetConstantTable(IGM, replType);
+    if (!wtable)
+      return false;
+    out.push_back(wtable);
+  }
+  return true;
+}
+
 namespace {
   class EmitPolymorphicArguments : public PolymorphicConvention {
     IRGenFunction &IGF;
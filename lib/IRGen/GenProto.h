@@ -127,6 +127,13 @@ namespace irgen {
   void emitWitnessTableRefs(IRGenFunction &IGF, const Substitution &sub,
                             SmallVectorImpl<llvm::Value *> &out);
 
+  /// Try to emit constant references to the witness tables for the
+  /// substituted type in the given substitution.  Returns false if any of
+  /// them requires runtime instantiation.
+  bool tryEmitConstantWitnessTableRefs(IRGenModule &IGM,
+                                       const Substitution &sub,
+                                       SmallVectorImpl<llvm::Constant *> &out);
+
   /// Emit a witness table reference.
   llvm::Value *emitWitnessTableRef(IRGenFunction &IGF,
                                    CanType srcType,
@@ -23,6 +23,7 @@
 #include "swift/SIL/SILModule.h"
 #include "swift/Basic/Dwarf.h"
 #include "swift/Basic/Platform.h"
+#include "swift/Basic/TraceEvents.h"
 #include "swift/ClangImporter/ClangImporter.h"
 #include "swift/LLVMPasses/PassesFwd.h"
 #include "swift/LLVMPasses/Passes.h"
@@ -232,7 +233,11 @@ static bool performLLVM(IRGenOptions &Opts, DiagnosticEngine &Diags,
     RawOS.reset(new raw_svector_ostream(Buffer));
   }
 
-  performLLVMOptimizations(Opts, Module, TargetMachine);
+  {
+    trace::Scope TraceOptimizations("LLVM", "LLVM optimization",
+                                    OutputFilename);
+    performLLVMOptimizations(Opts, Module, TargetMachine);
+  }
 
   legacy::PassManager EmitPasses;
 
@@ -277,6 +282,7 @@ static bool performLLVM(IRGenOptions &Opts, DiagnosticEngine &Diags,
   }
   }
 
+  trace::Scope TraceEmission("LLVM", "LLVM code generation", OutputFilename);
   EmitPasses.run(*Module);
   return false;
 }
@@ -407,6 +413,7 @@ static std::unique_ptr<llvm::Module> performIRGeneration(IRGenOptions &Opts,
                   TargetMachine, SILMod, Opts.getSingleOutputFilename());
 
   initLLVMModule(IGM);
+  uint64_t EmissionStart = trace::now();
   
   // Emit the module contents.
   dispatcher.emitGlobalTopLevel();
@@ -439,6 +446,10 @@ static std::unique_ptr<llvm::Module> performIRGeneration(IRGenOptions &Opts,
   // Okay, emit any definitions that we suddenly need.
   dispatcher.emitLazyDefinitions();
 
+  // Emit the generic metadata we prebuilt, now that all references to it
+  // have been emitted.
+  IGM.emitPrespecializedMetadataRecords();
+
   // Emit symbols for eliminated dead methods.
   IGM.emitVTableStubs();
 
@@ -470,6 +481,8 @@ static std::unique_ptr<llvm::Module> performIRGeneration(IRGenOptions &Opts,
   IGM.finalize();
 
   setModuleFlags(IGM);
+  trace::recordEvent("IRGen", "emit LLVM IR", EmissionStart, trace::now(),
+                     IGM.OutputFilename);
 
   // Bail out if there are any errors.
   if (Ctx.hadError()) return nullptr;
@@ -554,6 +567,7 @@ static void performParallelIRGeneration(IRGenOptions &Opts,
   }
 
   // Emit the module contents.
+  uint64_t EmissionStart = trace::now();
   dispatcher.emitGlobalTopLevel();
   
   for (auto *File : M->getFiles()) {
@@ -574,6 +588,9 @@ static void performParallelIRGeneration(IRGenOptions &Opts,
 
   // Okay, emit any definitions that we suddenly need.
   dispatcher.emitLazyDefinitions();
+
+  // Emit the generic metadata we prebuilt.
+  dispatcher.emitPrespecializedMetadataRecords();
   
  // Emit symbols for eliminated dead methods.
   PrimaryGM->emitVTableStubs();
@@ -648,6 +665,8 @@ static void performParallelIRGeneration(IRGenOptions &Opts,
     IGM->finalize();
     setModuleFlags(*IGM);
   }
+  trace::recordEvent("IRGen", "emit LLVM IR", EmissionStart, trace::now(),
+                     ModuleName);
 
   // Bail out if there are any errors.
   if (Ctx.hadError()) return;
@@ -261,6 +261,8 @@ public:
   void emitRetain(llvm::Value *value, Explosion &explosion);
   void emitRetainCall(llvm::Value *value);
   void emitRelease(llvm::Value *value);
+  void emitNonAtomicRetain(llvm::Value *value);
+  void emitNonAtomicRelease(llvm::Value *value);
   void emitRetainUnowned(llvm::Value *value);
   llvm::Value *emitTryPin(llvm::Value *object);
   void emitUnpin(llvm::Value *handle);
@@ -204,6 +204,9 @@ public:
   /// Emit the protocol conformance records needed by each IR module.
   void emitProtocolConformances();
 
+  /// Emit the prespecialized metadata records needed by each IR module.
+  void emitPrespecializedMetadataRecords();
+
   /// Emit everthing which is reachable from already emitted IR.
   void emitLazyDefinitions();
   
@@ -514,6 +517,13 @@ public:
                                 llvm::Function *fn);
   llvm::Constant *emitProtocolConformances();
 
+  /// Note that the metadata of the given bound generic type is referenced.
+  /// Returns false if it was already noted.
+  bool addPrespecializedMetadataType(CanType type);
+  void addPrespecializedMetadataRecord(llvm::Constant *pattern,
+                                       llvm::Constant *metadata);
+  llvm::Constant *emitPrespecializedMetadataRecords();
+
   llvm::Constant *getOrCreateHelperFunction(StringRef name,
                                             llvm::Type *resultType,
                                             ArrayRef<llvm::Type*> paramTypes,
@@ -550,6 +560,13 @@ private:
   SmallVector<llvm::WeakVH, 4> ObjCCategories;
   /// List of protocol conformances to generate records for.
   SmallVector<NormalProtocolConformance *, 4> ProtocolConformances;
+  /// The bound generic types which have been considered for prespecialized
+  /// metadata.
+  llvm::DenseSet<CanType> PrespecializedMetadataTypes;
+  /// List of (pattern, metadata) pairs of prespecialized metadata to
+  /// generate records for.
+  SmallVector<std::pair<llvm::Constant *, llvm::Constant *>, 4>
+    PrespecializedMetadataRecords;
   /// List of ExtensionDecls corresponding to the generated
   /// categories.
   SmallVector<ExtensionDecl*, 4> ObjCCategoryDecls;
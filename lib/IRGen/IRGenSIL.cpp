@@ -3189,12 +3189,23 @@ void IRGenSILFunction::visitStrongUnpinInst(swift::StrongUnpinInst *i) {
 void IRGenSILFunction::visitStrongRetainInst(swift::StrongRetainInst *i) {
   Explosion lowered = getLoweredExplosion(i->getOperand());
   auto &ti = cast<ReferenceTypeInfo>(getTypeInfo(i->getOperand().getType()));
+  // Only native Swift objects have a non-atomic entry point.
+  if (i->isNonAtomic() &&
+      ti.isSingleSwiftRetainablePointer(ResilienceScope::Component)) {
+    emitNonAtomicRetain(lowered.claimNext());
+    return;
+  }
   ti.retain(*this, lowered);
 }
 
 void IRGenSILFunction::visitStrongReleaseInst(swift::StrongReleaseInst *i) {
   Explosion lowered = getLoweredExplosion(i->getOperand());
   auto &ti = cast<ReferenceTypeInfo>(getTypeInfo(i->getOperand().getType()));
+  if (i->isNonAtomic() &&
+      ti.isSingleSwiftRetainablePointer(ResilienceScope::Component)) {
+    emitNonAtomicRelease(lowered.claimNext());
+    return;
+  }
   ti.release(*this, lowered);
 }
 
@@ -208,6 +208,34 @@ namespace {
       }
     }
   };
+
+  /// To be used at the beginning of a top-level declaration; hashes the
+  /// interface tokens of the declaration on their own and records the result
+  /// as the fingerprint of every declaration parsed in the meantime.
+  struct RecordDeclFingerprint {
+    Parser &TheParser;
+    SmallVectorImpl<Decl *> &Entries;
+    size_t FirstEntry;
+    bool IsRecording = false;
+    Optional<SourceFile::DeclInterfaceState> OuterHashState;
+
+    RecordDeclFingerprint(Parser &P, SmallVectorImpl<Decl *> &Entries)
+      : TheParser(P), Entries(Entries), FirstEntry(Entries.size()) {
+      if (TheParser.IsParsingInterfaceTokens &&
+          TheParser.CurDeclContext->isModuleScopeContext()) {
+        OuterHashState = TheParser.SF.beginDeclInterfaceHash();
+        IsRecording = true;
+      }
+    }
+
+    ~RecordDeclFingerprint() {
+      if (!IsRecording)
+        return;
+      ArrayRef<Decl *> parsed = Entries;
+      TheParser.SF.endDeclInterfaceHash(parsed.slice(FirstEntry),
+                                        std::move(OuterHashState));
+    }
+  };
 }
 
 /// \brief Main entrypoint for the parser.
@@ -1771,6 +1799,8 @@ ParserStatus Parser::parseDecl(SmallVectorImpl<Decl*> &Entries,
   if (isCodeCompletionFirstPass())
     BeginParserPosition = getParserPosition();
 
+  RecordDeclFingerprint Fingerprint(*this, Entries);
+
   SourceLoc tryLoc;
   (void)consumeIf(tok::kw_try, tryLoc);
 
@@ -1929,8 +1929,6 @@ bool SILParser::parseSILInstruction(SILBasicBlock *BB) {
   UNARY_INSTRUCTION(FixLifetime)
   UNARY_INSTRUCTION(CopyBlock)
   UNARY_INSTRUCTION(StrongPin)
-  UNARY_INSTRUCTION(StrongRetain)
-  UNARY_INSTRUCTION(StrongRelease)
   UNARY_INSTRUCTION(StrongRetainAutoreleased)
   UNARY_INSTRUCTION(StrongUnpin)
   UNARY_INSTRUCTION(AutoreleaseReturn)
@@ -1949,6 +1947,20 @@ bool SILParser::parseSILInstruction(SILBasicBlock *BB) {
   UNARY_INSTRUCTION(DebugValueAddr)
 #undef UNARY_INSTRUCTION
 
+  case ValueKind::StrongRetainInst:
+  case ValueKind::StrongReleaseInst: {
+    bool NonAtomic = false;
+    if (parseSILOptional(NonAtomic, *this, "nonatomic") ||
+        parseTypedValueRef(Val, B))
+      return true;
+
+    if (Opcode == ValueKind::StrongRetainInst)
+      ResultVal = B.createStrongRetain(InstLoc, Val, NonAtomic);
+    else
+      ResultVal = B.createStrongRelease(InstLoc, Val, NonAtomic);
+    break;
+  }
+
   case ValueKind::LoadWeakInst: {
     bool isTake = false;
     if (parseSILOptional(isTake, *this, "take") ||
@@ -0,0 +1,143 @@
+//===--- OptimizationRemark.cpp - Remarks from SIL optimizations ----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/SIL/OptimizationRemark.h"
+#include "swift/Basic/Demangle.h"
+#include "swift/Basic/SourceManager.h"
+#include "swift/SIL/SILFunction.h"
+#include "swift/SIL/SILModule.h"
+#include "llvm/ADT/StringExtras.h"
+
+using namespace swift;
+using namespace OptRemark;
+
+Argument::Argument(StringRef Key, unsigned N)
+  : Key(Key), Val(llvm::utostr(N)) {}
+
+Argument::Argument(StringRef Key, SILFunction *F)
+  : Key(Key),
+    Val(Demangle::demangleSymbolAsString(
+          F->getName(),
+          Demangle::DemangleOptions::SimplifiedUIDemangleOptions())) {}
+
+Argument::Argument(StringRef Key, SILType Ty) : Key(Key) {
+  llvm::raw_string_ostream OS(Val);
+  Ty.print(OS);
+}
+
+std::string Remark::getMessage() const {
+  std::string Message;
+  for (const Argument &A : Args)
+    Message += A.Val;
+  return Message;
+}
+
+/// Writes \p Str as a single-quoted YAML scalar.
+static void writeQuoted(llvm::raw_ostream &OS, StringRef Str) {
+  OS << '\'';
+  for (char C : Str) {
+    if (C == '\'')
+      OS << '\'';
+    OS << C;
+  }
+  OS << '\'';
+}
+
+void RemarkStreamer::writeRecord(const Remark &R) {
+  llvm::raw_ostream &OS = *RecordOS;
+  OS << "--- !" << (R.getKind() == RemarkKind::Passed ? "Passed" : "Missed")
+     << '\n';
+  OS << "Pass:            " << R.getPassName() << '\n';
+  OS << "Name:            " << R.getIdentifier() << '\n';
+
+  SourceLoc Loc = R.getInstruction()->getLoc().getSourceLoc();
+  if (Loc.isValid()) {
+    unsigned Line, Column;
+    std::tie(Line, Column) = SM.getLineAndColumn(Loc);
+    OS << "DebugLoc:        { File: ";
+    writeQuoted(OS, SM.getBufferIdentifierForLoc(Loc));
+    OS << ", Line: " << Line << ", Column: " << Column << " }\n";
+  }
+
+  OS << "Function:        " << R.getInstruction()->getFunction()->getName()
+     << '\n';
+  OS << "Args:\n";
+  for (const Argument &A : R.getArgs()) {
+    OS << "  - " << A.Key << ": ";
+    OS.indent(A.Key.size() < 15 ? 15 - A.Key.size() : 0);
+    writeQuoted(OS, A.Val);
+    OS << '\n';
+  }
+  OS << "...\n";
+}
+
+void RemarkStreamer::print(const Remark &R) {
+  llvm::raw_ostream &OS = llvm::errs();
+  SourceLoc Loc = R.getInstruction()->getLoc().getSourceLoc();
+  if (Loc.isValid()) {
+    unsigned Line, Column;
+    std::tie(Line, Column) = SM.getLineAndColumn(Loc);
+    OS << SM.getBufferIdentifierForLoc(Loc) << ':' << Line << ':' << Column
+       << ": ";
+  }
+  OS << "remark: " << R.getMessage() << " [" << R.getPassName() << "]\n";
+}
+
+/// Returns true if \p Pattern is set and matches \p PassName.
+static bool matches(const std::shared_ptr<llvm::Regex> &Pattern,
+                    StringRef PassName) {
+  return Pattern && Pattern->match(PassName);
+}
+
+bool RemarkStreamer::isEnabled(RemarkKind Kind, StringRef PassName) {
+  llvm::sys::ScopedLock L(Lock);
+  if (RecordOS)
+    return true;
+  if (Kind == RemarkKind::Passed)
+    return matches(Options.OptRemarkPassed, PassName);
+  return matches(Options.OptRemarkMissed, PassName);
+}
+
+bool RemarkStreamer::isRepeatedMissed(const Remark &R) {
+  if (R.getKind() != RemarkKind::Missed)
+    return false;
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << R.getPassName() << '\0' << R.getIdentifier() << '\0'
+     << R.getInstruction()->getFunction()->getName() << '\0'
+     << R.getInstruction()->getLoc().getSourceLoc().getOpaquePointerValue()
+     << '\0' << R.getMessage();
+  return !EmittedMissed.insert(OS.str()).second;
+}
+
+void RemarkStreamer::emit(const Remark &R) {
+  llvm::sys::ScopedLock L(Lock);
+  if (isRepeatedMissed(R))
+    return;
+  if (RecordOS)
+    writeRecord(R);
+  bool Selected = R.getKind() == RemarkKind::Passed
+                    ? matches(Options.OptRemarkPassed, R.getPassName())
+                    : matches(Options.OptRemarkMissed, R.getPassName());
+  if (Selected)
+    print(R);
+}
+
+Emitter::Emitter(StringRef PassName, SILModule &M)
+  : Streamer(M.getRemarkStreamer()), PassName(PassName),
+    PassedEnabled(Streamer.isEnabled(RemarkKind::Passed, PassName)),
+    MissedEnabled(Streamer.isEnabled(RemarkKind::Missed, PassName)) {}
+
+void Emitter::emitRemark(Remark &R) {
+  R.PassName = PassName;
+  Streamer.emit(R);
+}
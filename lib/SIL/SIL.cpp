@@ -44,6 +44,7 @@ void ValueBase::replaceAllUsesWith(ValueBase *RHS) {
 
 SILUndef *SILUndef::get(SILType Ty, SILModule *M) {
   // Unique these.
+  SILModule::SharedStateGuard Guard(*M);
   SILUndef *&Entry = M->UndefValues[Ty];
   if (Entry == nullptr)
     Entry = new (*M) SILUndef(Ty);
@@ -124,6 +124,7 @@ SILBasicBlock *SILBasicBlock::splitBasicBlock(iterator I) {
   // Move all of the specified instructions from the original basic block into
   // the new basic block.
   New->InstList.splice(New->end(), InstList, I, end());
+  New->ExecutionCount = ExecutionCount;
   return New;
 }
 
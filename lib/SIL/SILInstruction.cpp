@@ -262,11 +262,13 @@ namespace {
     }
 
     bool visitStrongReleaseInst(const StrongReleaseInst *RHS) {
-      return true;
+      auto *X = cast<StrongReleaseInst>(LHS);
+      return X->isNonAtomic() == RHS->isNonAtomic();
     }
 
     bool visitStrongRetainInst(const StrongRetainInst *RHS) {
-      return true;
+      auto *X = cast<StrongRetainInst>(LHS);
+      return X->isNonAtomic() == RHS->isNonAtomic();
     }
 
     bool visitStrongRetainUnownedInst(const StrongRetainUnownedInst *RHS) {
@@ -13,6 +13,7 @@
 #define DEBUG_TYPE "sil-module"
 #include "swift/SIL/SILModule.h"
 #include "Linker.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SIL/SILDebugScope.h"
 #include "swift/SIL/SILExternalSource.h"
 #include "swift/SIL/SILVisitor.h"
@@ -102,7 +103,10 @@ SILModule::SILModule(Module *SwiftModule, SILOptions &Options,
                      bool wholeModule)
   : TheSwiftModule(SwiftModule), AssociatedDeclContext(associatedDC),
     Stage(SILStage::Raw), Callback(new SILModule::SerializationCallback()),
-    wholeModule(wholeModule), Options(Options), Types(*this) {
+    wholeModule(wholeModule), Options(Options),
+    RemarkStreamer(new OptRemark::RemarkStreamer(
+        SwiftModule->getASTContext().SourceMgr, Options)),
+    Types(*this) {
   TypeListUniquing = new SILTypeListUniquingType();
 }
 
@@ -415,6 +419,7 @@ ArrayRef<SILType> ValueBase::getTypes() const {
 /// be used by SILValue.
 SILTypeList *SILModule::getSILTypeList(ArrayRef<SILType> Types) const {
   assert(Types.size() > 1 && "Shouldn't use type list for 0 or 1 types");
+  SharedStateGuard Guard(*this);
   auto UniqueMap = (SILTypeListUniquingType*)TypeListUniquing;
 
   llvm::FoldingSetNodeID ID;
@@ -440,12 +445,15 @@ SILTypeList *SILModule::getSILTypeList(ArrayRef<SILType> Types) const {
 }
 
 const IntrinsicInfo &SILModule::getIntrinsicInfo(Identifier ID) {
-  unsigned OldSize = IntrinsicIDCache.size();
-  IntrinsicInfo &Info = IntrinsicIDCache[ID];
+  SharedStateGuard Guard(*this);
+  std::unique_ptr<IntrinsicInfo> &Entry = IntrinsicIDCache[ID];
 
   // If the element was is in the cache, return it.
-  if (OldSize == IntrinsicIDCache.size())
-    return Info;
+  if (Entry)
+    return *Entry;
+
+  Entry.reset(new IntrinsicInfo());
+  IntrinsicInfo &Info = *Entry;
 
   // Otherwise, lookup the ID and Type and store them in the map.
   StringRef NameRef = getBuiltinBaseName(getASTContext(), ID.str(), Info.Types);
@@ -456,12 +464,15 @@ const IntrinsicInfo &SILModule::getIntrinsicInfo(Identifier ID) {
 }
 
 const BuiltinInfo &SILModule::getBuiltinInfo(Identifier ID) {
-  unsigned OldSize = BuiltinIDCache.size();
-  BuiltinInfo &Info = BuiltinIDCache[ID];
+  SharedStateGuard Guard(*this);
+  std::unique_ptr<BuiltinInfo> &Entry = BuiltinIDCache[ID];
 
   // If the element was is in the cache, return it.
-  if (OldSize == BuiltinIDCache.size())
-    return Info;
+  if (Entry)
+    return *Entry;
+
+  Entry.reset(new BuiltinInfo());
+  BuiltinInfo &Info = *Entry;
 
   // Otherwise, lookup the ID and Type and store them in the map.
   // Find the matching ID.
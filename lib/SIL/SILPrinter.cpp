@@ -495,10 +495,13 @@ public:
 
     *this << ":";
 
-    if (!BB->pred_empty()) {
+    if (!BB->pred_empty() || BB->getExecutionCount()) {
       PrintState.OS.PadToColumn(50);
-      
-      *this << "// Preds:";
+      *this << "//";
+    }
+
+    if (!BB->pred_empty()) {
+      *this << " Preds:";
 
       // Display the predecessors ids sorted to give a stable use order in the
       // printer's output. This makes diffing large sections of SIL
@@ -510,6 +513,8 @@ public:
       for (auto Id : PredIDs)
         *this << ' ' << Id;
     }
+    if (auto Count = BB->getExecutionCount())
+      *this << " Count: " << *Count;
     *this << '\n';
 
     for (const SILInstruction &I : *BB)
@@ -1237,13 +1242,19 @@ public:
     *this << "copy_block " << getIDAndType(RI->getOperand());
   }
   void visitStrongRetainInst(StrongRetainInst *RI) {
-    *this << "strong_retain " << getIDAndType(RI->getOperand());
+    *this << "strong_retain ";
+    if (RI->isNonAtomic())
+      *this << "[nonatomic] ";
+    *this << getIDAndType(RI->getOperand());
   }
   void visitStrongRetainAutoreleasedInst(StrongRetainAutoreleasedInst *RI) {
     *this << "strong_retain_autoreleased " << getIDAndType(RI->getOperand());
   }
   void visitStrongReleaseInst(StrongReleaseInst *RI) {
-    *this << "strong_release " << getIDAndType(RI->getOperand());
+    *this << "strong_release ";
+    if (RI->isNonAtomic())
+      *this << "[nonatomic] ";
+    *this << getIDAndType(RI->getOperand());
   }
   void visitStrongPinInst(StrongPinInst *PI) {
     *this << "strong_pin " << getIDAndType(PI->getOperand());
@@ -15,6 +15,8 @@
 #include "swift/SIL/SILInstruction.h"
 #include "swift/SIL/SILArgument.h"
 #include "swift/SIL/SILBasicBlock.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
 
 using namespace swift;
 
@@ -41,6 +43,26 @@ void SILValue::replaceAllUsesWith(SILValue V) {
     (**use_begin()).set(V);
 }
 
+std::atomic<unsigned> Operand::ModulesSharingUndefs(0);
+
+/// Guards the use lists of SILUndef values while function passes run on
+/// several threads.
+static llvm::ManagedStatic<llvm::sys::Mutex> UndefUseListLock;
+
+void Operand::removeFromCurrentLocked() {
+  llvm::sys::ScopedLock Guard(*UndefUseListLock);
+  *Back = NextUse;
+  if (NextUse) NextUse->Back = Back;
+}
+
+void Operand::insertIntoCurrentLocked() {
+  llvm::sys::ScopedLock Guard(*UndefUseListLock);
+  Back = &TheValue->FirstUse;
+  NextUse = TheValue->FirstUse;
+  if (NextUse) NextUse->Back = &NextUse;
+  TheValue->FirstUse = this;
+}
+
 static bool isRCIdentityPreservingCast(ValueKind Kind) {
   switch (Kind) {
   case ValueKind::UpcastInst:
@@ -1344,6 +1344,7 @@ const TypeLowering &
 TypeConverter::getTypeLowering(AbstractionPattern origType,
                                Type origSubstType,
                                unsigned uncurryLevel) {
+  SILModule::SharedStateGuard Guard(M);
   CanType substType = origSubstType->getCanonicalType();
   auto key = getTypeKey(origType, substType, uncurryLevel);
   
@@ -1511,6 +1512,7 @@ TypeConverter::getTypeLowering(AbstractionPattern origType,
 }
 
 const TypeLowering &TypeConverter::getTypeLowering(SILType type) {
+  SILModule::SharedStateGuard Guard(M);
   auto loweredType = type.getSwiftRValueType();
   auto key = getTypeKey(AbstractionPattern(loweredType), loweredType, 0);
 
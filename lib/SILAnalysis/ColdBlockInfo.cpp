@@ -15,6 +15,10 @@
 
 using namespace swift;
 
+/// A block which ran less than once for every ColdCountRatio calls of its
+/// function in the profile is cold.
+static const uint64_t ColdCountRatio = 100;
+
 /// Peek through an extract of Bool.value.
 static SILValue getCondition(SILValue C) {
   if (auto *SEI = dyn_cast<StructExtractInst>(C)) {
@@ -100,8 +104,23 @@ bool ColdBlockInfo::isSlowPath(const SILBasicBlock *FromBB, const SILBasicBlock
   return ToBB == ColdTarget;
 }
 
+/// \return true if the profile says that \p BB never ran, or ran rarely
+/// compared to its function.
+bool ColdBlockInfo::isColdInProfile(const SILBasicBlock *BB) {
+  auto Count = BB->getExecutionCount();
+  if (!Count)
+    return false;
+  if (*Count == 0)
+    return true;
+  auto EntryCount = BB->getParent()->getEntryCount();
+  return EntryCount && *Count * ColdCountRatio < *EntryCount;
+}
+
 /// \return true if the given block is dominated by a _slowPath branch hint.
 ///
+/// The count of a block in the profile overrides any branch hints, and so
+/// does the count of the nearest dominator which has one.
+///
 /// Cache all blocks visited to avoid introducing quadratic behavior.
 bool ColdBlockInfo::isCold(const SILBasicBlock *BB) {
   auto I = ColdBlockMap.find(BB);
@@ -118,8 +137,14 @@ bool ColdBlockInfo::isCold(const SILBasicBlock *BB) {
   std::vector<const SILBasicBlock*> DomChain;
   DomChain.push_back(BB);
   bool IsCold = false;
-  Node = Node->getIDom();
-  while (Node) {
+  while (true) {
+    if (DomChain.back()->getExecutionCount()) {
+      IsCold = isColdInProfile(DomChain.back());
+      break;
+    }
+    Node = Node->getIDom();
+    if (!Node)
+      break;
     if (isSlowPath(Node->getBlock(), DomChain.back())) {
       IsCold = true;
       break;
@@ -130,7 +155,6 @@ bool ColdBlockInfo::isCold(const SILBasicBlock *BB) {
       break;
     }
     DomChain.push_back(Node->getBlock());
-    Node = Node->getIDom();
   }
   for (auto *ChainBB : DomChain)
     ColdBlockMap[ChainBB] = IsCold;
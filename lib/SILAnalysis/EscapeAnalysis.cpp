@@ -1233,98 +1233,99 @@ void EscapeAnalysis::recompute() {
 
   CallGraph &CG = CGA->getOrBuildCallGraph();
 
-  // TODO: Remove this workaround when the bottom-up function order is
-  // updated automatically.
-  CG.invalidateBottomUpFunctionOrder();
-
-  auto BottomUpFunctions = CG.getBottomUpFunctionOrder();
-  std::vector<FunctionInfo *> FInfos;
-  FInfos.reserve(BottomUpFunctions.size());
-
-  // First step: create the initial connection graphs for all functions.
-  for (SILFunction *F : BottomUpFunctions) {
-    if (F->isExternalDeclaration())
-      continue;
+  // TODO: Remove this workaround when the bottom-up SCC order is updated
+  // automatically.
+  CG.invalidateBottomUpSCCOrder();
+
+  // Handle one SCC after the other, so that the summary graphs of all callees
+  // outside the current SCC are complete when we merge them.
+  for (CallGraphSCC *SCC : CG.getBottomUpSCCOrder()) {
+    llvm::SmallVector<FunctionInfo *, 4> SCCInfos;
+    llvm::SmallPtrSet<SILFunction *, 4> SCCFunctions;
+
+    // First step: create the initial connection graphs for the functions.
+    for (SILFunction *F : SCC->SCCNodes) {
+      if (F->isExternalDeclaration())
+        continue;
 
-    DEBUG(llvm::dbgs() << "  build initial graph for " << F->getName() << '\n');
+      DEBUG(llvm::dbgs() << "  build initial graph for " << F->getName()
+                         << '\n');
 
-    auto *FInfo = new (Allocator.Allocate()) FunctionInfo(F);
-    Function2Info[F] = FInfo;
-    buildConnectionGraphs(FInfo);
+      auto *FInfo = new (Allocator.Allocate()) FunctionInfo(F);
+      Function2Info[F] = FInfo;
+      buildConnectionGraphs(FInfo);
 
-    FInfos.push_back(FInfo);
-    FInfo->NeedMergeCallees = true;
-  }
-
-  // Second step: propagate the connection graphs up the call tree until it
-  // stabalizes.
-  int Iteration = 0;
-  bool Changed;
-  do {
-    DEBUG(llvm::dbgs() << "iteration " << Iteration << '\n');
-    Changed = false;
-    for (FunctionInfo *FInfo : FInfos) {
-      if (!FInfo->NeedMergeCallees)
-        continue;
-      FInfo->NeedMergeCallees = false;
+      SCCInfos.push_back(FInfo);
+      SCCFunctions.insert(F);
+    }
 
-      // Limit the total number of iterations. First to limit compile time,
-      // second to make sure that the loop terminates. Theoretically this
-      // should alwasy be the case, but who knows?
-      if (Iteration >= MaxGraphMerges) {
-        DEBUG(llvm::dbgs() << "  finalize " <<
+    // Second step: merge the callee graphs. If the functions call each other
+    // we have to repeat this until the summary graphs stabalize.
+    bool IsRecursive = false;
+    for (int Iteration = 0;; ++Iteration) {
+      DEBUG(llvm::dbgs() << "iteration " << Iteration << '\n');
+      bool SummaryChanged = false;
+      for (FunctionInfo *FInfo : SCCInfos) {
+        DEBUG(llvm::dbgs() << "  merge into " <<
               FInfo->Graph.getFunction()->getName() << '\n');
-        finalizeGraphsConservatively(FInfo);
-        continue;
-      }
-
-      DEBUG(llvm::dbgs() << "  merge into " <<
-            FInfo->Graph.getFunction()->getName() << '\n');
 
-      // Merge the callee-graphs into the graph of the current function.
-      if (!mergeAllCallees(FInfo, CG))
-        continue;
-
-      FInfo->Graph.propagateEscapeStates();
+        IsRecursive |= mergeAllCallees(FInfo, SCCFunctions);
+        FInfo->Graph.propagateEscapeStates();
 
-      // Derive the summary graph of the current function. Even if the
-      // complete graph of the function did change, it does not mean that the
-      // summary graph will change.
-      if (!mergeSummaryGraph(&FInfo->SummaryGraph, &FInfo->Graph))
-        continue;
+        // Derive the summary graph of the current function. Even if the
+        // complete graph of the function did change, it does not mean that the
+        // summary graph will change.
+        SummaryChanged |= mergeSummaryGraph(&FInfo->SummaryGraph,
+                                            &FInfo->Graph);
+      }
+      if (!IsRecursive || !SummaryChanged)
+        break;
 
-      // Trigger another graph merging action in all caller functions.
-      auto &CallerSet = CG.getCallerEdges(FInfo->Graph.getFunction());
-      for (CallGraphEdge *CallerEdge : CallerSet) {
-        if (!CallerEdge->canCallUnknownFunction()) {
-          SILFunction *Caller = CallerEdge->getInstruction()->getFunction();
-          FunctionInfo *CallerInfo = Function2Info.lookup(Caller);
-          assert(CallerInfo && "We should have an info for all functions");
-          CallerInfo->NeedMergeCallees = true;
+      // Limit the number of iterations. First to limit compile time, second
+      // to make sure that the loop terminates. Theoretically this should
+      // alwasy be the case, but who knows?
+      if (Iteration + 1 >= MaxGraphMerges) {
+        for (FunctionInfo *FInfo : SCCInfos) {
+          DEBUG(llvm::dbgs() << "  finalize " <<
+                FInfo->Graph.getFunction()->getName() << '\n');
+          finalizeGraphsConservatively(FInfo, SCCFunctions);
         }
+        break;
       }
-      Changed = true;
     }
-    Iteration++;
-  } while (Changed);
+    for (FunctionInfo *FInfo : SCCInfos)
+      FInfo->SummaryComplete = true;
+  }
 
   verify();
 }
 
-bool EscapeAnalysis::mergeAllCallees(FunctionInfo *FInfo, CallGraph &CG) {
-  bool Changed = false;
+bool EscapeAnalysis::mergeAllCallees(
+    FunctionInfo *FInfo, const llvm::SmallPtrSetImpl<SILFunction *> &SCC) {
+  bool CallsIntoSCC = false;
   for (FullApplySite FAS : FInfo->KnownCallees) {
-    auto Callees = CG.getCallees(FAS.getInstruction());
-    assert(!Callees.canCallUnknownFunction() &&
+    // Use the same callees which made it a known callee in
+    // analyzeInstruction(). This includes the implementations of class and
+    // witness methods.
+    auto Callees = BCA->getCalleeList(FAS);
+    assert(!Callees.isIncomplete() &&
            "knownCallees should not contain an unknown function");
     for (SILFunction *Callee : Callees) {
       DEBUG(llvm::dbgs() << "    callee " << Callee->getName() << '\n');
       FunctionInfo *CalleeInfo = Function2Info.lookup(Callee);
-      assert(CalleeInfo && "We should have an info for all functions");
-      Changed |= mergeCalleeGraph(FAS, &FInfo->Graph, &CalleeInfo->SummaryGraph);
+      if (SCC.count(Callee) != 0) {
+        CallsIntoSCC = true;
+      } else if (!CalleeInfo || !CalleeInfo->SummaryComplete) {
+        // The call graph doesn't know about this callee, e.g. because it was
+        // created after the call graph. Be conservative.
+        DEBUG(llvm::dbgs() << "      no complete summary\n");
+        setAllEscaping(FAS.getInstruction(), &FInfo->Graph);
+        continue;
+      }
+      mergeCalleeGraph(FAS, &FInfo->Graph, &CalleeInfo->SummaryGraph);
     }
   }
-  return Changed;
+  return CallsIntoSCC;
 }
 
 bool EscapeAnalysis::mergeCalleeGraph(FullApplySite FAS,
@@ -1383,14 +1384,35 @@ bool EscapeAnalysis::mergeSummaryGraph(ConnectionGraph *SummaryGraph,
 }
 
 
-void EscapeAnalysis::finalizeGraphsConservatively(FunctionInfo *FInfo) {
+void EscapeAnalysis::finalizeGraphsConservatively(
+    FunctionInfo *FInfo, const llvm::SmallPtrSetImpl<SILFunction *> &SCC) {
+  // Only the calls into the SCC are affected. The summary graphs of all other
+  // callees are complete.
   for (FullApplySite FAS : FInfo->KnownCallees) {
-    setAllEscaping(FAS.getInstruction(), &FInfo->Graph);
+    for (SILFunction *Callee : BCA->getCalleeList(FAS)) {
+      if (SCC.count(Callee) != 0) {
+        setAllEscaping(FAS.getInstruction(), &FInfo->Graph);
+        break;
+      }
+    }
   }
   FInfo->Graph.propagateEscapeStates();
   mergeSummaryGraph(&FInfo->SummaryGraph, &FInfo->Graph);
 }
 
+void EscapeAnalysis::rebuildConnectionGraph(FunctionInfo *FInfo) {
+  buildConnectionGraphs(FInfo);
+
+  // The summary graphs of the callees are still valid. A callee without a
+  // complete summary graph, e.g. the function itself if it was never part of
+  // a recompute(), is handled conservatively. Therefore the new summary graph
+  // is complete, too.
+  mergeAllCallees(FInfo, llvm::SmallPtrSet<SILFunction *, 1>());
+  FInfo->Graph.propagateEscapeStates();
+  mergeSummaryGraph(&FInfo->SummaryGraph, &FInfo->Graph);
+  FInfo->SummaryComplete = true;
+}
+
 SILAnalysis *swift::createEscapeAnalysis(SILModule *M) {
   return new EscapeAnalysis(M);
 }
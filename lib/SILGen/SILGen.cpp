@@ -26,6 +26,7 @@
 #include "swift/SIL/SILArgument.h"
 #include "swift/SIL/SILDebugScope.h"
 #include "swift/Subsystems.h"
+#include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/Support/Debug.h"
 #include "ManagedValue.h"
 using namespace swift;
@@ -38,6 +39,15 @@ using namespace Lowering;
 SILGenModule::SILGenModule(SILModule &M, Module *SM, bool makeModuleFragile)
   : M(M), Types(M.Types), SwiftModule(SM), TopLevelSGF(nullptr),
     Profiler(nullptr), makeModuleFragile(makeModuleFragile) {
+  const std::string &ProfilePath = M.getOptions().UseProfile;
+  if (!ProfilePath.empty()) {
+    auto ReaderOrErr = llvm::IndexedInstrProfReader::create(ProfilePath);
+    if (auto EC = ReaderOrErr.getError())
+      diagnose(SourceLoc(), diag::profile_read_error, ProfilePath,
+               EC.message());
+    else
+      ProfileReader = std::move(ReaderOrErr.get());
+  }
 }
 
 SILGenModule::~SILGenModule() {
@@ -59,6 +59,9 @@ public:
   /// disabled.
   std::unique_ptr<SILGenProfiling> Profiler;
 
+  /// The profile read with -profile-use, or null if there is none.
+  std::unique_ptr<llvm::IndexedInstrProfReader> ProfileReader;
+
   /// Mapping from SILDeclRefs to emitted SILFunctions.
   llvm::DenseMap<SILDeclRef, SILFunction*> emittedFunctions;
   /// Mapping from ProtocolConformances to emitted SILWitnessTables.
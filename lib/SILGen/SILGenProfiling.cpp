@@ -20,6 +20,9 @@
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/ProfileData/CoverageMapping.h"
 #include "llvm/ProfileData/CoverageMappingWriter.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
 
 #include <forward_list>
 
@@ -29,7 +32,7 @@ using namespace Lowering;
 ProfilerRAII::ProfilerRAII(SILGenModule &SGM, AbstractFunctionDecl *D)
     : SGM(SGM) {
   const auto &Opts = SGM.M.getOptions();
-  if (!Opts.GenerateProfile)
+  if (!Opts.GenerateProfile && !SGM.ProfileReader)
     return;
   SGM.Profiler =
       llvm::make_unique<SILGenProfiling>(SGM, Opts.EmitProfileCoverageMapping);
@@ -42,51 +45,86 @@ namespace {
 
 /// An ASTWalker that maps ASTNodes to profiling counters.
 struct MapRegionCounters : public ASTWalker {
+  /// The kinds of nodes which get a counter.
+  enum class RegionKind : uint8_t {
+    FunctionBody = 1,
+    IfThen,
+    GuardBody,
+    WhileBody,
+    RepeatWhileBody,
+    ForBody,
+    ForEachBody,
+    Switch,
+    Case,
+    DoCatch,
+    CatchBody,
+    IfExprThen,
+    Closure
+  };
+
   /// The next counter value to assign.
   unsigned NextCounter;
 
   /// The map of statements to counters.
   llvm::DenseMap<ASTNode, unsigned> &CounterMap;
 
+  /// The hash of the kinds of the nodes mapped so far, in order.
+  llvm::MD5 Hash;
+
   MapRegionCounters(llvm::DenseMap<ASTNode, unsigned> &CounterMap)
       : NextCounter(0), CounterMap(CounterMap) {}
 
+  void mapRegion(ASTNode Node, RegionKind Kind) {
+    CounterMap[Node] = NextCounter++;
+    uint8_t KindValue = uint8_t(Kind);
+    Hash.update(llvm::makeArrayRef(&KindValue, 1));
+  }
+
+  /// Returns the function hash, which changes whenever the control flow of
+  /// the function changes so that its counters mean something else.
+  uint64_t getHash() {
+    llvm::MD5::MD5Result Result;
+    Hash.final(Result);
+    return llvm::support::endian::read<uint64_t, llvm::support::little,
+                                       llvm::support::unaligned>(Result);
+  }
+
   bool walkToDeclPre(Decl *D) override {
     if (auto *AFD = dyn_cast<AbstractFunctionDecl>(D))
-      CounterMap[AFD->getBody()] = NextCounter++;
+      mapRegion(AFD->getBody(), RegionKind::FunctionBody);
     return true;
   }
 
   std::pair<bool, Stmt *> walkToStmtPre(Stmt *S) override {
     if (auto *IS = dyn_cast<IfStmt>(S)) {
-      CounterMap[IS->getThenStmt()] = NextCounter++;
+      mapRegion(IS->getThenStmt(), RegionKind::IfThen);
     } else if (auto *US = dyn_cast<GuardStmt>(S)) {
-      CounterMap[US->getBody()] = NextCounter++;
+      mapRegion(US->getBody(), RegionKind::GuardBody);
     } else if (auto *WS = dyn_cast<WhileStmt>(S)) {
-      CounterMap[WS->getBody()] = NextCounter++;
+      mapRegion(WS->getBody(), RegionKind::WhileBody);
     } else if (auto *RWS = dyn_cast<RepeatWhileStmt>(S)) {
-      CounterMap[RWS->getBody()] = NextCounter++;
+      mapRegion(RWS->getBody(), RegionKind::RepeatWhileBody);
     } else if (auto *FS = dyn_cast<ForStmt>(S)) {
-      CounterMap[FS->getBody()] = NextCounter++;
+      mapRegion(FS->getBody(), RegionKind::ForBody);
     } else if (auto *FES = dyn_cast<ForEachStmt>(S)) {
-      CounterMap[FES->getBody()] = NextCounter++;
+      mapRegion(FES->getBody(), RegionKind::ForEachBody);
     } else if (auto *SS = dyn_cast<SwitchStmt>(S)) {
-      CounterMap[SS] = NextCounter++;
+      mapRegion(SS, RegionKind::Switch);
     } else if (auto *CS = dyn_cast<CaseStmt>(S)) {
-      CounterMap[CS] = NextCounter++;
+      mapRegion(CS, RegionKind::Case);
     } else if (auto *DCS = dyn_cast<DoCatchStmt>(S)) {
-      CounterMap[DCS] = NextCounter++;
+      mapRegion(DCS, RegionKind::DoCatch);
     } else if (auto *CS = dyn_cast<CatchStmt>(S)) {
-      CounterMap[CS->getBody()] = NextCounter++;
+      mapRegion(CS->getBody(), RegionKind::CatchBody);
     }
     return {true, S};
   }
 
   std::pair<bool, Expr *> walkToExprPre(Expr *E) override {
     if (auto *IE = dyn_cast<IfExpr>(E))
-      CounterMap[IE->getThenExpr()] = NextCounter++;
+      mapRegion(IE->getThenExpr(), RegionKind::IfExprThen);
     else if (isa<AutoClosureExpr>(E) || isa<ClosureExpr>(E))
-      CounterMap[E] = NextCounter++;
+      mapRegion(E, RegionKind::Closure);
     return {true, E};
   }
 };
@@ -612,8 +650,7 @@ void SILGenProfiling::assignRegionCounters(AbstractFunctionDecl *Root) {
   walkForProfiling(Root, Mapper);
 
   NumRegionCounters = Mapper.NextCounter;
-  // TODO: Mapper needs to calculate a function hash as it goes.
-  FunctionHash = 0x0;
+  FunctionHash = Mapper.getHash();
 
   if (EmitCoverageMapping) {
     CoverageMapping Coverage(SGM.M.getASTContext().SourceMgr);
@@ -621,6 +658,15 @@ void SILGenProfiling::assignRegionCounters(AbstractFunctionDecl *Root) {
     Coverage.emitSourceRegions(SGM.M, CurrentFuncName, FunctionHash,
                                RegionCounterMap);
   }
+
+  // A function which isn't in the profile, or whose counters have changed
+  // since it was collected, gets no counts.
+  if (SGM.ProfileReader) {
+    if (SGM.ProfileReader->getFunctionCounts(CurrentFuncName, FunctionHash,
+                                             RegionCounts) ||
+        RegionCounts.size() != NumRegionCounters)
+      RegionCounts.clear();
+  }
 }
 
 static SILLocation getLocation(ASTNode Node) {
@@ -641,6 +687,13 @@ void SILGenProfiling::emitCounterIncrement(SILGenBuilder &Builder,ASTNode Node){
   assert(CounterIt != RegionCounterMap.end() &&
          "cannot increment non-existent counter");
 
+  if (!RegionCounts.empty() && Builder.hasValidInsertionPoint())
+    Builder.getInsertionBB()->setExecutionCount(
+        RegionCounts[CounterIt->second]);
+
+  if (!SGM.M.getOptions().GenerateProfile)
+    return;
+
   auto Int32Ty = SGM.Types.getLoweredType(BuiltinIntegerType::get(32, C));
   auto Int64Ty = SGM.Types.getLoweredType(BuiltinIntegerType::get(64, C));
 
@@ -17,6 +17,10 @@
 #include "swift/AST/ASTNode.h"
 #include "swift/AST/Stmt.h"
 
+namespace llvm {
+class IndexedInstrProfReader;
+}
+
 namespace swift {
 
 class AbstractFunctionDecl;
@@ -45,6 +49,10 @@ private:
   uint64_t FunctionHash;
   llvm::DenseMap<ASTNode, unsigned> RegionCounterMap;
 
+  /// The current function's counts in the profile read with -profile-use,
+  /// indexed by counter, or empty if it has none.
+  std::vector<uint64_t> RegionCounts;
+
   std::vector<std::tuple<std::string, uint64_t, std::string>> CoverageData;
 
 public:
@@ -57,7 +65,8 @@ public:
   /// Map counters to ASTNodes and set them up for profiling the given function.
   void assignRegionCounters(AbstractFunctionDecl *Root);
 
-  /// Emit SIL to increment the counter for \c Node.
+  /// Emit SIL to increment the counter for \c Node, and give the current block
+  /// the counter's count from the profile.
   void emitCounterIncrement(SILGenBuilder &Builder, ASTNode Node);
 };
 
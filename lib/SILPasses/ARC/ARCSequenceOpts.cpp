@@ -121,8 +121,15 @@ void CodeMotionOrDeleteCallback::processMatchingSet(ARCMatchingSet &MatchSet) {
   }
 
   // Add the old increments to the delete list.
+  bool Moved = !MatchSet.IncrementInsertPts.empty();
   for (SILInstruction *Increment : MatchSet.Increments) {
     Changed = true;
+    Unpaired.erase(Increment);
+    ORE.emit([&] {
+      return OptRemark::RemarkPassed(Moved ? "Moved" : "Removed", *Increment)
+             << (Moved ? "retain moved to its matching release"
+                       : "retain removed together with its matching release");
+    });
     DEBUG(llvm::dbgs() << "    Deleting increment: " << *Increment);
     InstructionsToDelete.push_back(Increment);
     ++NumRefCountOpsRemoved;
@@ -137,6 +144,28 @@ void CodeMotionOrDeleteCallback::processMatchingSet(ARCMatchingSet &MatchSet) {
   }
 }
 
+void CodeMotionOrDeleteCallback::processUnpairedIncrement(
+    SILInstruction *Increment) {
+  if (ORE.isEnabled(OptRemark::RemarkKind::Missed))
+    Unpaired.insert(Increment);
+}
+
+/// Reports the increments in \p F which are still not paired after the last
+/// round of pairing, in the order of the function.
+static void remarkUnpairedIncrements(SILFunction &F,
+                                     UnpairedIncrementSet &Unpaired,
+                                     OptRemark::Emitter &ORE) {
+  if (Unpaired.empty())
+    return;
+  for (auto &BB : F)
+    for (auto &I : BB)
+      if (Unpaired.count(&I))
+        ORE.emit([&] {
+          return OptRemark::RemarkMissed("NotRemoved", I)
+                 << "retain could not be paired with a release";
+        });
+}
+
 //===----------------------------------------------------------------------===//
 //                             Non Loop Optimizer
 //===----------------------------------------------------------------------===//
@@ -145,7 +174,9 @@ static bool processFunctionWithoutLoopSupport(SILFunction &F,
                                               bool FreezePostDomReleases,
                                               AliasAnalysis *AA,
                                               PostOrderAnalysis *POTA,
-                                              RCIdentityFunctionInfo *RCIA) {
+                                              RCIdentityFunctionInfo *RCIA,
+                                              OptRemark::Emitter &ORE,
+                                              UnpairedIncrementSet &Unpaired) {
   // GlobalARCOpts seems to be taking up a lot of compile time when running on
   // globalinit_func. Since that is not *that* interesting from an ARC
   // perspective (i.e. no ref count operations in a loop), disable it on such
@@ -157,7 +188,7 @@ static bool processFunctionWithoutLoopSupport(SILFunction &F,
 
   bool Changed = false;
   BlockARCPairingContext Context(F, AA, POTA, RCIA);
-  CodeMotionOrDeleteCallback Callback;
+  CodeMotionOrDeleteCallback Callback(ORE, Unpaired);
   // Until we do not remove any instructions or have nested increments,
   // decrements...
   while (true) {
@@ -194,7 +225,9 @@ static bool
 processFunctionWithLoopSupport(SILFunction &F, bool FreezePostDomReleases,
                                AliasAnalysis *AA, PostOrderAnalysis *POTA,
                                LoopRegionFunctionInfo *LRFI, SILLoopInfo *LI,
-                               RCIdentityFunctionInfo *RCFI) {
+                               RCIdentityFunctionInfo *RCFI,
+                               OptRemark::Emitter &ORE,
+                               UnpairedIncrementSet &Unpaired) {
   // GlobalARCOpts seems to be taking up a lot of compile time when running on
   // globalinit_func. Since that is not *that* interesting from an ARC
   // perspective (i.e. no ref count operations in a loop), disable it on such
@@ -204,7 +237,7 @@ processFunctionWithLoopSupport(SILFunction &F, bool FreezePostDomReleases,
 
   DEBUG(llvm::dbgs() << "***** Processing " << F.getName() << " *****\n");
 
-  LoopARCPairingContext Context(F, AA, LRFI, LI, RCFI);
+  LoopARCPairingContext Context(F, AA, LRFI, LI, RCFI, ORE, Unpaired);
   return Context.process(FreezePostDomReleases);
 }
 
@@ -222,15 +255,21 @@ class ARCSequenceOpts : public SILFunctionTransform {
     if (!getOptions().EnableARCOptimizations)
       return;
 
+    OptRemark::Emitter ORE(DEBUG_TYPE, F->getModule());
+    llvm::SmallPtrSet<SILInstruction *, 8> Unpaired;
+
     if (!EnableLoopARC) {
       auto *AA = getAnalysis<AliasAnalysis>();
       auto *POTA = getAnalysis<PostOrderAnalysis>();
       auto *RCFI = getAnalysis<RCIdentityAnalysis>()->get(F);
 
-      if (processFunctionWithoutLoopSupport(*F, false, AA, POTA, RCFI)) {
-        processFunctionWithoutLoopSupport(*F, true, AA, POTA, RCFI);
+      if (processFunctionWithoutLoopSupport(*F, false, AA, POTA, RCFI, ORE,
+                                            Unpaired)) {
+        processFunctionWithoutLoopSupport(*F, true, AA, POTA, RCFI, ORE,
+                                          Unpaired);
         invalidateAnalysis(SILAnalysis::InvalidationKind::CallsAndInstructions);
       }
+      remarkUnpairedIncrements(*F, Unpaired, ORE);
       return;
     }
 
@@ -254,10 +293,13 @@ class ARCSequenceOpts : public SILFunctionTransform {
     auto *RCFI = getAnalysis<RCIdentityAnalysis>()->get(F);
     auto *LRFI = getAnalysis<LoopRegionAnalysis>()->get(F);
 
-    if (processFunctionWithLoopSupport(*F, false, AA, POTA, LRFI, LI, RCFI)) {
-      processFunctionWithLoopSupport(*F, true, AA, POTA, LRFI, LI, RCFI);
+    if (processFunctionWithLoopSupport(*F, false, AA, POTA, LRFI, LI, RCFI,
+                                       ORE, Unpaired)) {
+      processFunctionWithLoopSupport(*F, true, AA, POTA, LRFI, LI, RCFI, ORE,
+                                     Unpaired);
       invalidateAnalysis(SILAnalysis::InvalidationKind::CallsAndInstructions);
     }
+    remarkUnpairedIncrements(*F, Unpaired, ORE);
   }
 
   StringRef getName() override { return "ARC Sequence Opts"; }
@@ -391,6 +391,8 @@ bool ARCPairingContext::performMatching(CodeMotionOrDeleteCallback &Callback) {
       // happen here since we may remove instructions that are insertion points
       // for other instructions.
       Callback.processMatchingSet(Set);
+    } else {
+      Callback.processUnpairedIncrement(Increment);
     }
   }
 
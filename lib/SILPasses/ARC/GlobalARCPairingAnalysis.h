@@ -15,9 +15,11 @@
 
 #include "GlobalARCSequenceDataflow.h"
 #include "GlobalLoopARCSequenceDataflow.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SIL/SILValue.h"
 #include "swift/SILPasses/Utils/LoopUtils.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 namespace swift {
 
@@ -72,17 +74,34 @@ struct ARCMatchingSet {
   }
 };
 
+/// The increments which are not paired with a decrement so far.
+using UnpairedIncrementSet = llvm::SmallPtrSetImpl<SILInstruction *>;
+
 class CodeMotionOrDeleteCallback {
   bool Changed = false;
   llvm::SmallVector<SILInstruction *, 16> InstructionsToDelete;
+  OptRemark::Emitter &ORE;
+
+  /// A later round of pairing may still pair one of these increments, so
+  /// they are only reported once the pass is done with the function. Only
+  /// tracked if missed remarks are wanted.
+  UnpairedIncrementSet &Unpaired;
 
 public:
+  CodeMotionOrDeleteCallback(OptRemark::Emitter &ORE,
+                             UnpairedIncrementSet &Unpaired)
+      : ORE(ORE), Unpaired(Unpaired) {}
+
   /// This call should process \p Set and modify any internal state of
   /// ARCMatchingSetCallback given \p Set. This call should not remove any
   /// instructions since any removed instruction might be used as an insertion
   /// point for another retain, release pair.
   void processMatchingSet(ARCMatchingSet &Set);
 
+  /// Called for an increment for which no matching set could be built, i.e.
+  /// which stays where it is.
+  void processUnpairedIncrement(SILInstruction *Increment);
+
   // Delete instructions after we have processed all matching sets so that we do
   // not remove instructions that may be insertion points for other retain,
   // releases.
@@ -145,11 +164,12 @@ struct LoopARCPairingContext : SILLoopVisitor {
 
   LoopARCPairingContext(SILFunction &F, AliasAnalysis *AA,
                         LoopRegionFunctionInfo *LRFI, SILLoopInfo *SLI,
-                        RCIdentityFunctionInfo *RCFI)
+                        RCIdentityFunctionInfo *RCFI, OptRemark::Emitter &ORE,
+                        UnpairedIncrementSet &Unpaired)
       : SILLoopVisitor(&F, SLI), Context(F, RCFI),
         Evaluator(F, AA, LRFI, SLI, RCFI, Context.DecToIncStateMap,
                   Context.IncToDecStateMap),
-        LRFI(LRFI), SLI(SLI), Callback() {}
+        LRFI(LRFI), SLI(SLI), Callback(ORE, Unpaired) {}
 
   bool process(bool FreezePDReleases) {
     FreezePostDomReleases = FreezePDReleases;
@@ -0,0 +1,97 @@
+//===------- NonAtomicRC.cpp - Use non-atomic reference counting ----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "nonatomic-rc"
+#include "swift/SILPasses/Passes.h"
+#include "swift/SILPasses/Transforms.h"
+#include "swift/SILAnalysis/EscapeAnalysis.h"
+#include "swift/SIL/SILInstruction.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Debug.h"
+
+STATISTIC(NumNonAtomicRC, "Number of reference counting operations made "
+                          "non-atomic");
+
+using namespace swift;
+
+namespace {
+
+/// Marks strong_retain and strong_release instructions as [nonatomic] if
+/// the object they operate on cannot be accessed from any other thread.
+///
+/// We only handle objects which are allocated in the current function and
+/// which don't escape it. Such an object is only reachable from the thread
+/// which runs the function. An object which is passed in as an argument might
+/// be shared with other threads by the caller, even if it doesn't escape this
+/// function.
+class NonAtomicRC : public SILFunctionTransform {
+
+public:
+  NonAtomicRC() {}
+
+private:
+  /// Returns true if the object referenced by \p V is a local allocation
+  /// which does not escape the function.
+  bool isThreadLocalObject(EscapeAnalysis::ConnectionGraph *ConGraph,
+                           SILValue V) {
+    SILValue Obj = V.stripCasts();
+    if (!isa<AllocRefInst>(Obj) && !isa<AllocBoxInst>(Obj))
+      return false;
+
+    auto *Node = ConGraph->getNodeOrNull(Obj);
+    return Node && !Node->escapes();
+  }
+
+  /// The entry point to the transformation.
+  void run() override {
+    DEBUG(llvm::dbgs() << "** NonAtomicRC **\n");
+
+    auto *EA = PM->getAnalysis<EscapeAnalysis>();
+    SILFunction *F = getFunction();
+    auto *ConGraph = EA->getConnectionGraph(F);
+    if (!ConGraph)
+      return;
+
+    bool Changed = false;
+    for (auto &BB : *F) {
+      for (auto &I : BB) {
+        if (auto *SRI = dyn_cast<StrongRetainInst>(&I)) {
+          if (!SRI->isNonAtomic() &&
+              isThreadLocalObject(ConGraph, SRI->getOperand())) {
+            DEBUG(llvm::dbgs() << "    make nonatomic: " << *SRI);
+            SRI->setNonAtomic();
+            ++NumNonAtomicRC;
+            Changed = true;
+          }
+        } else if (auto *SRI = dyn_cast<StrongReleaseInst>(&I)) {
+          if (!SRI->isNonAtomic() &&
+              isThreadLocalObject(ConGraph, SRI->getOperand())) {
+            DEBUG(llvm::dbgs() << "    make nonatomic: " << *SRI);
+            SRI->setNonAtomic();
+            ++NumNonAtomicRC;
+            Changed = true;
+          }
+        }
+      }
+    }
+    if (Changed)
+      invalidateAnalysis(SILAnalysis::InvalidationKind::Instructions);
+  }
+
+  StringRef getName() override { return "NonAtomicRC"; }
+};
+
+} // end anonymous namespace
+
+SILTransform *swift::createNonAtomicRC() {
+  return new NonAtomicRC();
+}
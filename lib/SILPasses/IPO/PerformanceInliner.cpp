@@ -14,6 +14,7 @@
 #include "swift/SIL/SILInstruction.h"
 #include "swift/SIL/Dominance.h"
 #include "swift/SIL/SILModule.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SIL/Projection.h"
 #include "swift/SILAnalysis/BasicCalleeAnalysis.h"
 #include "swift/SILAnalysis/CallGraphAnalysis.h"
@@ -70,6 +71,13 @@ namespace {
   
   // Additional benefit for each loop level.
   const unsigned LoopBenefitFactor = 40;
+
+  // With a profile, a call which runs this many times more often than its
+  // caller is worth as much as a call one loop level deeper.
+  const uint64_t ProfiledCallsPerLoopLevel = 8;
+
+  // The most loop levels a call can be worth because of its profiled count.
+  const unsigned MaxProfiledLoopDepth = 4;
   
   // Approximately up to this cost level a function can be inlined without
   // increasing the code size.
@@ -230,6 +238,12 @@ namespace {
     /// B into A.
     llvm::DenseSet<std::pair<StringRef, StringRef>> InlinedFunctions;
 
+    OptRemark::Emitter ORE;
+
+    /// Emits a remark that \p AI was not inlined because of \p Reason.
+    void remarkNotInlined(FullApplySite AI, StringRef Identifier,
+                          StringRef Reason);
+
     SILFunction *getEligibleFunction(FullApplySite AI);
 
     bool isProfitableToInline(FullApplySite AI, unsigned loopDepthOfAI,
@@ -269,9 +283,9 @@ namespace {
 
   public:
     SILPerformanceInliner(int threshold,
-                          InlineSelection WhatToInline)
+                          InlineSelection WhatToInline, SILModule &M)
       : InlineCostThreshold(threshold),
-    WhatToInline(WhatToInline) {}
+    WhatToInline(WhatToInline), ORE(DEBUG_TYPE, M) {}
 
     void inlineDevirtualizeAndSpecialize(SILFunction *WorkItem,
                                          SILModuleTransform *MT,
@@ -542,6 +556,16 @@ bool SILPerformanceInliner::hasInliningCycle(SILFunction *Caller,
   return InlinedBefore;
 }
 
+void SILPerformanceInliner::remarkNotInlined(FullApplySite AI,
+                                             StringRef Identifier,
+                                             StringRef Reason) {
+  ORE.emit([&] {
+    return OptRemark::RemarkMissed(Identifier, *AI.getInstruction())
+           << "'" << OptRemark::Argument("Callee", AI.getCalleeFunction())
+           << "' was not inlined: " << Reason;
+  });
+}
+
 // Returns the callee of an apply_inst if it is basically inlinable.
 SILFunction *SILPerformanceInliner::getEligibleFunction(FullApplySite AI) {
 
@@ -585,12 +609,15 @@ SILFunction *SILPerformanceInliner::getEligibleFunction(FullApplySite AI) {
   if (Callee->getInlineStrategy() == NoInline) {
     DEBUG(llvm::dbgs() << "        FAIL: noinline attribute on " <<
           Callee->getName() << ".\n");
+    remarkNotInlined(AI, "NoInline", "it is marked @inline(never)");
     return nullptr;
   }
   
   if (!Callee->shouldOptimize()) {
     DEBUG(llvm::dbgs() << "        FAIL: optimizations disabled on " <<
           Callee->getName() << ".\n");
+    remarkNotInlined(AI, "NotOptimized",
+                     "it is excluded from optimization");
     return nullptr;
   }
 
@@ -615,6 +642,9 @@ SILFunction *SILPerformanceInliner::getEligibleFunction(FullApplySite AI) {
   if (hasInliningCycle(Caller, Callee)) {
     DEBUG(llvm::dbgs() << "        FAIL: Detected a recursion inlining " <<
           Callee->getName() << ".\n");
+    remarkNotInlined(AI, "InliningCycle",
+                     "it was already inlined into the caller, which is "
+                     "recursive");
     return nullptr;
   }
 
@@ -622,6 +652,8 @@ SILFunction *SILPerformanceInliner::getEligibleFunction(FullApplySite AI) {
   if (Caller->isFragile() && !Callee->isFragile()) {
     DEBUG(llvm::dbgs() << "        FAIL: Can't inline fragile " <<
           Callee->getName() << ".\n");
+    remarkNotInlined(AI, "Fragile",
+                     "the caller is fragile and the callee isn't");
     return nullptr;
   }
   DEBUG(llvm::dbgs() << "        Eligible callee: " <<
@@ -699,6 +731,25 @@ static SILBasicBlock *getTakenBlock(TermInst *term,
   return nullptr;
 }
 
+/// Returns the loop depth which corresponds to how often \p AI ran for each
+/// call of its caller according to the profile, or None if either count is
+/// unknown.
+static Optional<unsigned> getProfiledLoopDepth(FullApplySite AI) {
+  auto CallCount = AI.getParent()->getExecutionCount();
+  auto EntryCount = AI.getFunction()->getEntryCount();
+  if (!CallCount || !EntryCount || *EntryCount == 0)
+    return None;
+
+  uint64_t CallsPerEntry = *CallCount / *EntryCount;
+  unsigned Depth = 0;
+  while (CallsPerEntry >= ProfiledCallsPerLoopLevel &&
+         Depth < MaxProfiledLoopDepth) {
+    CallsPerEntry /= ProfiledCallsPerLoopLevel;
+    ++Depth;
+  }
+  return Depth;
+}
+
 /// Return true if inlining this call site is profitable.
 bool SILPerformanceInliner::isProfitableToInline(FullApplySite AI,
                                               unsigned loopDepthOfAI,
@@ -721,6 +772,9 @@ bool SILPerformanceInliner::isProfitableToInline(FullApplySite AI,
   unsigned CalleeCost = 0;
   unsigned Benefit = InlineCostThreshold > 0 ? InlineCostThreshold :
                                                RemovedCallBenefit;
+  // How often the call actually ran is a better guide than its loop depth.
+  if (auto ProfiledDepth = getProfiledLoopDepth(AI))
+    loopDepthOfAI = *ProfiledDepth;
   Benefit += loopDepthOfAI * LoopBenefitFactor;
   int testThreshold = TestThreshold;
 
@@ -781,6 +835,14 @@ bool SILPerformanceInliner::isProfitableToInline(FullApplySite AI,
   if (CalleeCost > Threshold) {
     DEBUG(llvm::dbgs() << "        NO: Function too big to inline, "
           "cost: " << CalleeCost << ", threshold: " << Threshold << "\n");
+    ORE.emit([&] {
+      return OptRemark::RemarkMissed("TooCostly", *AI.getInstruction())
+             << "'" << OptRemark::Argument("Callee", Callee)
+             << "' was not inlined: cost "
+             << OptRemark::Argument("Cost", CalleeCost)
+             << " exceeds threshold "
+             << OptRemark::Argument("Threshold", Threshold);
+    });
     return false;
   }
   DEBUG(llvm::dbgs() << "        YES: ready to inline, "
@@ -845,9 +907,14 @@ ApplySite SILPerformanceInliner::specializeGenericUpdatingCallGraph(
 
   auto *Callee = Apply.getCalleeFunction();
 
-  if (!Callee || Callee->isExternalDeclaration())
+  if (!Callee)
     return ApplySite();
 
+  if (Callee->isExternalDeclaration()) {
+    remarkMissedSpecialization(Apply, SpecializationFailure::NoBody);
+    return ApplySite();
+  }
+
   auto Filter = [](SILInstruction *I) -> bool {
     return ApplySite::isa(I) != ApplySite();
   };
@@ -1011,7 +1078,8 @@ void SILPerformanceInliner::collectAppliesToInline(
       }
     }
     domOrder.pushChildrenIf(block, [&] (SILBasicBlock *child) {
-      if (ColdBlockInfo::isSlowPath(block, child)) {
+      if (ColdBlockInfo::isSlowPath(block, child) ||
+          ColdBlockInfo::isColdInProfile(child)) {
         // Handle cold blocks separately.
         visitColdBlocks(InitialCandidates, child, DT);
         return false;
@@ -1105,6 +1173,13 @@ bool SILPerformanceInliner::inlineCallsIntoFunction(SILFunction *Caller,
     // Record the name of the inlined function (for cycle detection).
     InlinedFunctionNames.push_back(Callee->getName());
 
+    ORE.emit([&] {
+      return OptRemark::RemarkPassed("Inlined", *AI.getInstruction())
+             << "'" << OptRemark::Argument("Callee", Callee)
+             << "' inlined into '" << OptRemark::Argument("Caller", Caller)
+             << "'";
+    });
+
     auto Success = Inliner.inlineFunction(AI, Args);
     (void) Success;
     // We've already determined we should be able to inline this, so
@@ -1307,7 +1382,7 @@ public:
     }
 
     SILPerformanceInliner Inliner(getOptions().InlineThreshold,
-                                  WhatToInline);
+                                  WhatToInline, *getModule());
 
     BottomUpFunctionOrder BottomUpOrder(*getModule(), BCA);
     auto BottomUpFunctions = BottomUpOrder.getFunctions();
@@ -26,8 +26,10 @@
 #include "swift/SILPasses/Transforms.h"
 #include "swift/SILPasses/Utils/CFG.h"
 #include "swift/SILPasses/Utils/Local.h"
+#include "swift/SILPasses/Utils/LoopUtils.h"
 #include "swift/SILPasses/Utils/SILSSAUpdater.h"
 #include "swift/SIL/Dominance.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SIL/PatternMatch.h"
 #include "swift/SIL/SILArgument.h"
 #include "swift/SIL/SILBuilder.h"
@@ -58,6 +60,13 @@ static llvm::cl::opt<bool> EnableABCOpts("enable-abcopts",
 static llvm::cl::opt<bool> EnableABCHoisting("enable-abc-hoisting",
                                              llvm::cl::init(true));
 
+static llvm::cl::opt<bool> EnableArrayLoopVersioning(
+    "enable-array-loop-versioning", llvm::cl::init(true));
+
+static llvm::cl::opt<unsigned> ArrayLoopVersioningSizeLimit(
+    "array-loop-versioning-size-limit", llvm::cl::init(300),
+    llvm::cl::desc("Don't version loops with more instructions than this"));
+
 
 using ArraySet = llvm::SmallPtrSet<SILValue, 16>;
 // A pair of the array pointer and the array check kind (kCheckIndex or
@@ -961,7 +970,8 @@ static bool hasArrayType(SILValue Value, SILModule &M) {
 static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
                               ABCAnalysis &ABC, InductionAnalysis &IndVars,
                               SILBasicBlock *Preheader, SILBasicBlock *Header,
-                              SILBasicBlock *ExitingBlk) {
+                              SILBasicBlock *ExitingBlk,
+                              OptRemark::Emitter &ORE) {
 
   bool Changed = false;
   auto *CurBB = DTNode->getBlock();
@@ -994,6 +1004,11 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
     // array, which loaded from memory and the memory is not changed in the loop.
     if (!dominates(DT, ArrayVal, Preheader) && ABC.isUnsafe(Array)) {
       DEBUG(llvm::dbgs() << " not a safe array argument " << *Array.getDef());
+      ORE.emit([&] {
+        return OptRemark::RemarkMissed("NotHoisted", *Inst)
+               << "bounds check was not hoisted: the array may change in "
+                  "the loop";
+      });
       continue;
     }
 
@@ -1007,6 +1022,10 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
       assert(ArrayCall.canHoist(Preheader->getTerminator(), DT) &&
              "Must be able to hoist the instruction.");
       Changed = true;
+      ORE.emit([&] {
+        return OptRemark::RemarkPassed("Hoisted", *Inst)
+               << "invariant bounds check hoisted out of the loop";
+      });
       ArrayCall.hoist(Preheader->getTerminator(), DT);
       DEBUG(llvm::dbgs() << " could hoist invariant bounds check: " << *Inst);
       continue;
@@ -1017,6 +1036,11 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
     auto F = AccessFunction::getLinearFunction(ArrayIndex, IndVars);
     if (!F) {
       DEBUG(llvm::dbgs() << " not a linear function " << *Inst);
+      ORE.emit([&] {
+        return OptRemark::RemarkMissed("NotHoisted", *Inst)
+               << "bounds check was not hoisted: the index is not the "
+                  "induction variable";
+      });
       continue;
     }
 
@@ -1027,20 +1051,35 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
       // We can remove the check. This is even possible if the block does not
       // dominate the loop exit block.
       Changed = true;
+      ORE.emit([&] {
+        return OptRemark::RemarkPassed("Removed", *Inst)
+               << "bounds check removed: the loop iterates over the indices "
+                  "of the array";
+      });
       ArrayCall.removeCall();
       DEBUG(llvm::dbgs() << "  Bounds check removed\n");
       continue;
     }
     
     // For hoisting bounds checks the block must dominate the exit block.
-    if (!blockAlwaysExecutes)
+    if (!blockAlwaysExecutes) {
+      ORE.emit([&] {
+        return OptRemark::RemarkMissed("NotHoisted", *Inst)
+               << "bounds check was not hoisted: it is not executed in "
+                  "every iteration";
+      });
       continue;
+    }
 
     // Hoist the access function and the check to the preheader for start and
     // end of the induction.
     assert(ArrayCall.canHoist(Preheader->getTerminator(), DT) &&
            "Must be able to hoist the call");
 
+    ORE.emit([&] {
+      return OptRemark::RemarkPassed("Hoisted", *Inst)
+             << "bounds check hoisted out of the loop";
+    });
     F.hoistCheckToPreheader(ArrayCall, Preheader, DT);
 
     // Remove the old check in the loop and the match the retain with a release.
@@ -1054,7 +1093,7 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
   // Traverse the children in the dominator tree.
   for (auto Child: *DTNode)
     Changed |= hoistChecksInLoop(DT, Child, ABC, IndVars, Preheader,
-                                 Header, ExitingBlk);
+                                 Header, ExitingBlk, ORE);
 
   return Changed;
 }
@@ -1063,7 +1102,8 @@ static bool hoistChecksInLoop(DominanceInfo *DT, DominanceInfoNode *DTNode,
 /// based redundant bounds check removal.
 static bool hoistBoundsChecks(SILLoop *Loop, DominanceInfo *DT, SILLoopInfo *LI,
                               IVInfo &IVs, ArraySet &Arrays,
-                              RCIdentityFunctionInfo *RCIA, bool ShouldVerify) {
+                              RCIdentityFunctionInfo *RCIA, bool ShouldVerify,
+                              OptRemark::Emitter &ORE) {
   auto *Header = Loop->getHeader();
   if (!Header) return false;
 
@@ -1132,13 +1172,39 @@ static bool hoistBoundsChecks(SILLoop *Loop, DominanceInfo *DT, SILLoopInfo *LI,
 
   // Hoist bounds checks.
   Changed |= hoistChecksInLoop(DT, DT->getNode(Header), ABC, IndVars,
-                               Preheader, Header, ExitingBlk);
+                               Preheader, Header, ExitingBlk, ORE);
   if (Changed) {
     Preheader->getParent()->verify();
   }
   return Changed;
 }
 
+/// Collect all arrays in the function. A release is only 'safe' if we know its
+/// deinitializer does not have sideeffects that could cause memory safety
+/// issues. A deinit could deallocate array or put a different array in its
+/// location.
+static void collectReleaseSafeArrays(SILFunction *F,
+                                     RCIdentityFunctionInfo *RCIA,
+                                     DestructorAnalysis *DestAnalysis,
+                                     ArraySet &ReleaseSafeArrays) {
+  for (auto &BB : *F)
+    for (auto &Inst : BB) {
+      ArraySemanticsCall Call(&Inst);
+      if (Call && Call.hasSelf()) {
+        DEBUG(llvm::dbgs() << "Gathering " << *(ApplyInst*)Call);
+        auto rcRoot = RCIA->getRCIdentityRoot(Call.getSelf());
+        // Check the type of the array. We need to have an array element type
+        // that is not calling a deinit function.
+        if (DestAnalysis->mayStoreToMemoryOnDestruction(rcRoot.getType()))
+          continue;
+
+        ReleaseSafeArrays.insert(rcRoot);
+        ReleaseSafeArrays.insert(
+            getArrayStructPointer(ArrayCallKind::kCheckIndex, rcRoot));
+      }
+    }
+}
+
 #ifndef NDEBUG
 static void reportBoundsChecks(SILFunction *F) {
   unsigned NumBCs = 0;
@@ -1197,27 +1263,8 @@ public:
     auto *DestAnalysis = PM->getAnalysis<DestructorAnalysis>();
 
     if (ShouldReportBoundsChecks) { reportBoundsChecks(F); };
-    // Collect all arrays in this function. A release is only 'safe' if we know
-    // its deinitializer does not have sideeffects that could cause memory
-    // safety issues. A deinit could deallocate array or put a different array
-    // in its location.
     ArraySet ReleaseSafeArrays;
-    for (auto &BB : *F)
-      for (auto &Inst : BB) {
-        ArraySemanticsCall Call(&Inst);
-        if (Call && Call.hasSelf()) {
-          DEBUG(llvm::dbgs() << "Gathering " << *(ApplyInst*)Call);
-          auto rcRoot = RCIA->getRCIdentityRoot(Call.getSelf());
-          // Check the type of the array. We need to have an array element type
-          // that is not calling a deinit function.
-          if (DestAnalysis->mayStoreToMemoryOnDestruction(rcRoot.getType()))
-            continue;
-
-          ReleaseSafeArrays.insert(rcRoot);
-          ReleaseSafeArrays.insert(
-              getArrayStructPointer(ArrayCallKind::kCheckIndex, rcRoot));
-        }
-      }
+    collectReleaseSafeArrays(F, RCIA, DestAnalysis, ReleaseSafeArrays);
 
     // Remove redundant checks on a per basic block basis.
     bool Changed = false;
@@ -1227,6 +1274,7 @@ public:
     if (ShouldReportBoundsChecks) { reportBoundsChecks(F); };
 
     bool ShouldVerify = getOptions().VerifyAll;
+    OptRemark::Emitter ORE(DEBUG_TYPE, F->getModule());
 
     if (LI->empty()) {
       DEBUG(llvm::dbgs() << "No loops in " << F->getName() << "\n");
@@ -1246,7 +1294,8 @@ public:
 
         while (!Worklist.empty()) {
           Changed |= hoistBoundsChecks(Worklist.pop_back_val(), DT, LI, IVs,
-                                       ReleaseSafeArrays, RCIA, ShouldVerify);
+                                       ReleaseSafeArrays, RCIA, ShouldVerify,
+                                       ORE);
         }
       }
 
@@ -1264,3 +1313,458 @@ public:
 SILTransform *swift::createABCOpt() {
   return new ABCOpt();
 }
+
+//===----------------------------------------------------------------------===//
+//                          Array Loop Versioning
+//===----------------------------------------------------------------------===//
+
+// Bounds checks which are not executed in every iteration, or whose index is
+// not the induction variable itself, stay in the loop after hoisting. Their
+// cond_fails keep LLVM from vectorizing the loop. We version such a loop: one
+// version has no bounds checks and runs if a check in front of the loop shows
+// that none of them can fail, the original loop runs otherwise.
+//
+//  for i in 0..<n {
+//    if c[i] { a[i + 1] = 0 }
+//  }
+//
+//   ==>
+//
+//  if 0 < n && 0 <= 1 && n + 1 <= a.count {
+//    for i in 0..<n {
+//      if c[i] { a_unchecked[i + 1] = 0 }
+//    }
+//  } else {
+//    for i in 0..<n {
+//      if c[i] { a[i + 1] = 0 }
+//    }
+//  }
+
+namespace {
+
+/// The range of the index of a bounds check in a loop, in terms of values
+/// which are available before the loop.
+///
+/// The index is either an induction variable plus a constant, "a[i + c]", or
+/// an integer zero-extended from a narrower one, "a[Int(byte)]".
+struct IndexRange {
+  /// The induction variable of "a[i + c]".
+  InductionInfo *Ind = nullptr;
+  /// The constant of "a[i + c]".
+  int64_t Offset = 0;
+  /// The overflow checked addition of the constant, if any.
+  BuiltinInst *OffsetAdd = nullptr;
+  /// The bit width of the integer zero-extended to the index.
+  unsigned NarrowWidth = 0;
+
+  operator bool() const { return Ind || NarrowWidth; }
+};
+
+/// A bounds check in a loop which can't fail if the index range is within the
+/// bounds of the array.
+struct VersionedCheck {
+  ApplyInst *Check;
+  IndexRange Range;
+  /// A get_count call on the checked array, which can be copied in front of
+  /// the loop.
+  ApplyInst *Count;
+
+  VersionedCheck(ApplyInst *Check, IndexRange Range, ApplyInst *Count)
+      : Check(Check), Range(Range), Count(Count) {}
+};
+
+} // end anonymous namespace
+
+/// Matches the index \p Idx of a bounds check to an induction variable plus a
+/// constant or to a zero-extended narrow integer.
+static IndexRange getIndexRange(SILValue Idx, InductionAnalysis &IndVars) {
+  IndexRange Range;
+  auto *IndexStruct = dyn_cast<StructInst>(Idx);
+  if (!IndexStruct || IndexStruct->getElements().size() != 1)
+    return Range;
+  SILValue Val = IndexStruct->getElements()[0];
+
+  // "a[Int(byte)]"
+  if (auto *BI = dyn_cast<BuiltinInst>(Val)) {
+    auto ID = BI->getBuiltinInfo().ID;
+    if (ID != BuiltinValueKind::ZExt && ID != BuiltinValueKind::ZExtOrBitCast)
+      return Range;
+    auto *FromTy = dyn_cast<BuiltinIntegerType>(
+        BI->getOperand(0).getType().getSwiftRValueType());
+    auto *ToTy = dyn_cast<BuiltinIntegerType>(
+        BI->getType().getSwiftRValueType());
+    if (!FromTy || !ToTy || !FromTy->isFixedWidth() || !ToTy->isFixedWidth())
+      return Range;
+    unsigned FromWidth = FromTy->getFixedWidth();
+    if (FromWidth < ToTy->getFixedWidth() && FromWidth < 32)
+      Range.NarrowWidth = FromWidth;
+    return Range;
+  }
+
+  // "a[i + c]" or "a[i - c]"
+  if (auto *TEI = dyn_cast<TupleExtractInst>(Val)) {
+    auto *BI = dyn_cast<BuiltinInst>(TEI->getOperand());
+    if (!BI || TEI->getFieldNo() != 0)
+      return Range;
+    auto ID = BI->getBuiltinInfo().ID;
+    if (ID != BuiltinValueKind::SAddOver && ID != BuiltinValueKind::SSubOver)
+      return Range;
+    auto *Lit = dyn_cast<IntegerLiteralInst>(BI->getOperand(1));
+    if (!Lit || Lit->getValue().getMinSignedBits() > 32)
+      return Range;
+    Val = BI->getOperand(0);
+    Range.Offset = Lit->getValue().getSExtValue();
+    if (ID == BuiltinValueKind::SSubOver)
+      Range.Offset = -Range.Offset;
+    Range.OffsetAdd = BI;
+  }
+
+  // "a[i]"
+  if (auto *Arg = dyn_cast<SILArgument>(Val))
+    Range.Ind = IndVars[Arg];
+  return Range;
+}
+
+/// Finds a get_count call on the array with the underlying pointer \p Array
+/// which can be copied to the end of \p Preheader.
+static ApplyInst *findCountCall(SILValue Array, ArrayRef<ApplyInst *> CountCalls,
+                                SILBasicBlock *Preheader, DominanceInfo *DT) {
+  for (auto *AI : CountCalls) {
+    ArraySemanticsCall Count(AI);
+    if (getArrayStructPointer(ArrayCallKind::kGetCount, Count.getSelf()) !=
+        Array)
+      continue;
+    if (Count.canHoist(Preheader->getTerminator(), DT))
+      return AI;
+  }
+  return nullptr;
+}
+
+/// Collects the bounds checks in \p Loop. Returns false if there is a check
+/// which can't be removed by versioning the loop.
+static bool collectVersionedChecks(SILLoop *Loop, SILBasicBlock *Preheader,
+                                   DominanceInfo *DT, ABCAnalysis &ABC,
+                                   InductionAnalysis &IndVars,
+                                   ArrayRef<ApplyInst *> CountCalls,
+                                   SmallVectorImpl<VersionedCheck> &Checks,
+                                   OptRemark::Emitter &ORE) {
+  unsigned NumInsts = 0;
+  for (auto *BB : Loop->getBlocks()) {
+    for (auto &Inst : *BB) {
+      if (++NumInsts > ArrayLoopVersioningSizeLimit) {
+        DEBUG(llvm::dbgs() << " loop is too large to version\n");
+        return false;
+      }
+      if (!canCloneLoopInst(&Inst, Loop)) {
+        DEBUG(llvm::dbgs() << " can't clone " << Inst);
+        return false;
+      }
+
+      ArraySemanticsCall ArrayCall(&Inst);
+      auto Kind = ArrayCall.getKind();
+      if (Kind != ArrayCallKind::kCheckSubscript &&
+          Kind != ArrayCallKind::kCheckIndex)
+        continue;
+
+      auto ArrayVal = ArrayCall.getSelf();
+      SILValue Array = getArrayStructPointer(Kind, ArrayVal);
+      if (!dominates(DT, Array, Preheader) ||
+          (!dominates(DT, ArrayVal, Preheader) && ABC.isUnsafe(Array))) {
+        ORE.emit([&] {
+          return OptRemark::RemarkMissed("NotVersioned", Inst)
+                 << "loop was not versioned on bounds check: the array may "
+                    "change in the loop";
+        });
+        return false;
+      }
+
+      // The indices of other collections, e.g. of an ArraySlice, don't
+      // start at zero.
+      if (!hasArrayType(ArrayVal, Preheader->getModule())) {
+        DEBUG(llvm::dbgs() << " not an array " << Inst);
+        return false;
+      }
+
+      IndexRange Range = getIndexRange(ArrayCall.getIndex(), IndVars);
+      if (!Range) {
+        ORE.emit([&] {
+          return OptRemark::RemarkMissed("NotVersioned", Inst)
+                 << "loop was not versioned on bounds check: the range of "
+                    "the index is unknown";
+        });
+        return false;
+      }
+
+      auto *Count = findCountCall(Array, CountCalls, Preheader, DT);
+      if (!Count || Count->getType() != ArrayCall.getIndex().getType()) {
+        ORE.emit([&] {
+          return OptRemark::RemarkMissed("NotVersioned", Inst)
+                 << "loop was not versioned on bounds check: the count of "
+                    "the array is not available before the loop";
+        });
+        return false;
+      }
+
+      Checks.push_back(VersionedCheck(ArrayCall, Range, Count));
+    }
+  }
+  return true;
+}
+
+/// Returns the builtin integer value of the Int \p IntVal.
+static SILValue getBuiltinIntValue(SILBuilder &B, SILLocation Loc,
+                                   SILValue IntVal) {
+  auto *SD = IntVal.getType().getStructOrBoundGenericStruct();
+  return B.createStructExtract(Loc, IntVal, *SD->getStoredProperties().begin());
+}
+
+/// Creates "Cond && Val".
+static SILValue createAnd(SILBuilder &B, SILLocation Loc, SILValue Cond,
+                          SILValue Val) {
+  return B.createBuiltinBinaryFunction(Loc, "and", Cond.getType(),
+                                       Cond.getType(), {Cond, Val});
+}
+
+/// Creates a signed compare of \p LHS and \p RHS.
+static SILValue createCmp(SILBuilder &B, SILLocation Loc, StringRef Name,
+                          SILValue LHS, SILValue RHS) {
+  auto Int1Ty = SILType::getBuiltinIntegerType(1, B.getASTContext());
+  return B.createBuiltinBinaryFunction(Loc, Name, LHS.getType(), Int1Ty,
+                                       {LHS, RHS});
+}
+
+/// Creates "Val + Offset" and adds the condition that it does not overflow to
+/// \p Cond.
+static SILValue createAddWithoutOverflow(SILBuilder &B, SILLocation Loc,
+                                         SILValue Val, int64_t Offset,
+                                         SILValue &Cond) {
+  if (Offset == 0)
+    return Val;
+
+  auto Int1Ty = SILType::getBuiltinIntegerType(1, B.getASTContext());
+  SILValue Args[] = {Val, B.createIntegerLiteral(Loc, Val.getType(), Offset),
+                     B.createIntegerLiteral(Loc, Int1Ty, 0)};
+  auto *Add =
+      B.createBuiltinBinaryFunctionWithOverflow(Loc, "sadd_with_overflow", Args);
+  auto Overflow = B.createTupleExtract(Loc, Add, 1);
+  auto NoOverflow = B.createBuiltinBinaryFunction(
+      Loc, "xor", Int1Ty, Int1Ty,
+      {Overflow, B.createIntegerLiteral(Loc, Int1Ty, 1)});
+  Cond = createAnd(B, Loc, Cond, NoOverflow);
+  return B.createTupleExtract(Loc, Add, 0);
+}
+
+/// Creates the condition that none of the \p Checks can fail, i.e. that the
+/// index range of each check is within the bounds of its array. The count
+/// calls are copied before \p InsertBefore.
+static SILValue createInBoundsCondition(SILInstruction *InsertBefore,
+                                        ArrayRef<VersionedCheck> Checks,
+                                        DominanceInfo *DT) {
+  SILBuilder B(InsertBefore);
+  SILLocation Loc = InsertBefore->getLoc();
+  auto Int1Ty = SILType::getBuiltinIntegerType(1, B.getASTContext());
+  SILValue Cond = B.createIntegerLiteral(Loc, Int1Ty, 1);
+
+  llvm::DenseMap<ApplyInst *, SILValue> Counts;
+  llvm::SmallPtrSet<InductionInfo *, 4> NonEmptyInds;
+  for (auto &VC : Checks) {
+    SILValue &Count = Counts[VC.Count];
+    if (!Count) {
+      auto *NewCount = ArraySemanticsCall(VC.Count).copyTo(InsertBefore, DT);
+      Count = getBuiltinIntValue(B, Loc, NewCount);
+    }
+
+    const IndexRange &Range = VC.Range;
+    if (Range.NarrowWidth) {
+      // The index is at most 2^width - 1.
+      auto Max = B.createIntegerLiteral(Loc, Count.getType(),
+                                        (int64_t(1) << Range.NarrowWidth) - 1);
+      Cond = createAnd(B, Loc, Cond, createCmp(B, Loc, "cmp_slt", Max, Count));
+      continue;
+    }
+
+    // The induction variable takes the values Start to End - 1 only if
+    // Start < End.
+    InductionInfo *Ind = Range.Ind;
+    if (NonEmptyInds.insert(Ind).second)
+      Cond = createAnd(B, Loc, Cond,
+                       createCmp(B, Loc, "cmp_slt", Ind->Start, Ind->End));
+
+    auto First =
+        createAddWithoutOverflow(B, Loc, Ind->Start, Range.Offset, Cond);
+    auto End = createAddWithoutOverflow(B, Loc, Ind->End, Range.Offset, Cond);
+    auto Zero = B.createIntegerLiteral(Loc, First.getType(), 0);
+    Cond = createAnd(B, Loc, Cond, createCmp(B, Loc, "cmp_sle", Zero, First));
+    Cond = createAnd(B, Loc, Cond, createCmp(B, Loc, "cmp_sle", End, Count));
+  }
+  return Cond;
+}
+
+/// Removes the overflow check of \p Add in the cloned region.
+static void removeClonedOverflowCheck(RegionCloner &Cloner, BuiltinInst *Add) {
+  auto *ClonedAdd = cast<BuiltinInst>(Cloner.getMappedInst(Add));
+  if (auto *CondFail = isOverflowChecked(ClonedAdd))
+    CondFail->eraseFromParent();
+}
+
+/// Clones \p Loop into a version without the bounds checks \p Checks. The
+/// clone runs if none of the checks can fail, the original loop otherwise.
+static void versionLoop(SILLoop *Loop, ArrayRef<VersionedCheck> Checks,
+                        DominanceInfo *DT) {
+  auto *Preheader = Loop->getLoopPreheader();
+
+  // Split of a new empty block for the check which loop to run.
+  SILBuilder B(Preheader);
+  auto *CheckBlock = splitBasicBlockAndBranch(B, Preheader->getTerminator(),
+                                              DT, nullptr);
+
+  SmallVector<SILBasicBlock *, 16> ExitBlocks;
+  Loop->getExitBlocks(ExitBlocks);
+
+  // Collect the exit blocks dominated by the loop - they will be dominated by
+  // the check block.
+  SmallVector<SILBasicBlock *, 16> ExitBlocksDominatedByPreheader;
+  for (auto *ExitBlock : ExitBlocks)
+    if (DT->dominates(CheckBlock, ExitBlock))
+      ExitBlocksDominatedByPreheader.push_back(ExitBlock);
+
+  SILBasicBlock *NewPreheader =
+      splitBasicBlockAndBranch(B, &*CheckBlock->begin(), DT, nullptr);
+
+  // Clone the preheader and the loop. The clone becomes the fast loop.
+  RegionCloner Cloner(NewPreheader, ExitBlocks, *DT);
+  auto *FastPreheader = Cloner.cloneRegion();
+
+  auto *Term = CheckBlock->getTerminator();
+  SILValue IsInBounds = createInBoundsCondition(Term, Checks, DT);
+  SILBuilder(Term).createCondBranch(Term->getLoc(), IsInBounds,
+                                    FastPreheader, NewPreheader);
+  Term->eraseFromParent();
+
+  // Fixup the exit blocks. They are now dominated by the check block.
+  for (auto *BB : ExitBlocksDominatedByPreheader)
+    DT->changeImmediateDominator(DT->getNode(BB), DT->getNode(CheckBlock));
+
+  // Remove the checks in the fast loop. Neither the induction variables nor
+  // the additions of the index offsets can overflow there.
+  for (auto &VC : Checks) {
+    ArraySemanticsCall(Cloner.getMappedInst(VC.Check)).removeCall();
+    if (auto *Ind = VC.Range.Ind)
+      removeClonedOverflowCheck(Cloner, Ind->Inc);
+    if (auto *OffsetAdd = VC.Range.OffsetAdd)
+      removeClonedOverflowCheck(Cloner, OffsetAdd);
+  }
+}
+
+/// Versions the innermost loop \p Loop on the bounds checks which are left in
+/// it, if all of them can be removed in the fast version of the loop.
+static bool versionLoopOnBoundsChecks(SILLoop *Loop, DominanceInfo *DT,
+                                      IVInfo &IVs, ArraySet &Arrays,
+                                      RCIdentityFunctionInfo *RCIA,
+                                      ArrayRef<ApplyInst *> CountCalls,
+                                      OptRemark::Emitter &ORE) {
+  auto *Preheader = Loop->getLoopPreheader();
+  auto *Header = Loop->getHeader();
+  auto *ExitingBlk = Loop->getExitingBlock();
+  auto *ExitBlk = Loop->getExitBlock();
+  if (!Preheader || !ExitingBlk || !ExitBlk || !Loop->getLoopLatch())
+    return false;
+
+  DEBUG(llvm::dbgs() << "Attempting to version " << *Loop);
+
+  ABCAnalysis ABC(true, Arrays, RCIA);
+  for (auto *BB : Loop->getBlocks())
+    ABC.analyseBlock(BB);
+
+  InductionAnalysis IndVars(DT, IVs, Preheader, Header, ExitingBlk, ExitBlk);
+  IndVars.analyse();
+
+  SmallVector<VersionedCheck, 8> Checks;
+  if (!collectVersionedChecks(Loop, Preheader, DT, ABC, IndVars, CountCalls,
+                              Checks, ORE) ||
+      Checks.empty())
+    return false;
+
+  ORE.emit([&] {
+    return OptRemark::RemarkPassed("Versioned", *Checks.front().Check)
+           << "loop versioned without its bounds checks; checks removed: "
+           << OptRemark::Argument("NumChecks", unsigned(Checks.size()));
+  });
+  versionLoop(Loop, Checks, DT);
+  DEBUG(llvm::dbgs() << "  Loop versioned on " << Checks.size()
+                     << " bounds checks\n");
+  return true;
+}
+
+namespace {
+
+/// Version loops on the bounds checks which could not be hoisted out of them.
+class ArrayLoopVersioning : public SILFunctionTransform {
+
+public:
+  ArrayLoopVersioning() {}
+
+  StringRef getName() override { return "SIL Array loop versioning"; }
+
+  void run() override {
+    if (!EnableArrayLoopVersioning)
+      return;
+
+    SILFunction *F = getFunction();
+    auto *LA = PM->getAnalysis<SILLoopAnalysis>();
+    SILLoopInfo *LI = LA->get(F);
+    if (LI->empty())
+      return;
+
+    auto *DA = PM->getAnalysis<DominanceAnalysis>();
+    DominanceInfo *DT = DA->get(F);
+    IVInfo &IVs = *PM->getAnalysis<IVAnalysis>()->get(F);
+    auto *RCIA = getAnalysis<RCIdentityAnalysis>()->get(F);
+    auto *DestAnalysis = PM->getAnalysis<DestructorAnalysis>();
+
+    ArraySet ReleaseSafeArrays;
+    collectReleaseSafeArrays(F, RCIA, DestAnalysis, ReleaseSafeArrays);
+
+    SmallVector<ApplyInst *, 16> CountCalls;
+    for (auto &BB : *F)
+      for (auto &Inst : BB) {
+        ArraySemanticsCall Count(&Inst, "array.get_count");
+        if (Count)
+          CountCalls.push_back(Count);
+      }
+    if (CountCalls.empty())
+      return;
+
+    // Collect the innermost loops up front. The loop info is not updated for
+    // the cloned loops.
+    SmallVector<SILLoop *, 8> InnermostLoops;
+    SmallVector<SILLoop *, 8> Worklist(LI->begin(), LI->end());
+    while (!Worklist.empty()) {
+      auto *L = Worklist.pop_back_val();
+      if (L->getSubLoops().empty())
+        InnermostLoops.push_back(L);
+      Worklist.append(L->begin(), L->end());
+    }
+
+    OptRemark::Emitter ORE(DEBUG_TYPE, F->getModule());
+    bool Changed = false;
+    for (auto *L : InnermostLoops)
+      Changed |= versionLoopOnBoundsChecks(L, DT, IVs, ReleaseSafeArrays, RCIA,
+                                           CountCalls, ORE);
+    if (!Changed)
+      return;
+
+    // The cloned loops may have critical edges.
+    splitAllCriticalEdges(*F, true /* only cond_br terminators*/, DT, nullptr);
+
+    // We preserve the dominator tree. Let's invalidate everything else.
+    DA->lockInvalidation();
+    invalidateAnalysis(SILAnalysis::InvalidationKind::FunctionBody);
+    DA->unlockInvalidation();
+  }
+};
+} // end anonymous namespace
+
+SILTransform *swift::createArrayLoopVersioning() {
+  return new ArrayLoopVersioning();
+}
@@ -20,6 +20,7 @@
 #include "swift/SIL/SILBuilder.h"
 #include "swift/SIL/SILInstruction.h"
 #include "swift/SIL/DebugUtils.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SILAnalysis/ArraySemantic.h"
 #include "swift/SILAnalysis/AliasAnalysis.h"
 #include "swift/SILAnalysis/ARCAnalysis.h"
@@ -31,7 +32,7 @@
 #include "swift/SILPasses/Transforms.h"
 #include "swift/SILPasses/Utils/CFG.h"
 #include "swift/SILPasses/Utils/Local.h"
-#include "swift/SILPasses/Utils/SILSSAUpdater.h"
+#include "swift/SILPasses/Utils/LoopUtils.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
@@ -343,6 +344,7 @@ class COWArrayOpt {
   SILLoop *Loop;
   SILBasicBlock *Preheader;
   DominanceInfo *DomTree;
+  OptRemark::Emitter &ORE;
   bool HasChanged = false;
 
   // Keep track of cold blocks.
@@ -385,12 +387,15 @@ class COWArrayOpt {
   // The address of the array passed to the current make_mutable we are
   // analysing.
   SILValue CurrentArrayAddr;
+
+  // Why the current make_mutable could not be hoisted, for the remark.
+  StringRef NotHoistedReason;
 public:
   COWArrayOpt(RCIdentityFunctionInfo *RCIA, SILLoop *L,
-              DominanceAnalysis *DA)
+              DominanceAnalysis *DA, OptRemark::Emitter &ORE)
       : RCIA(RCIA), Function(L->getHeader()->getParent()), Loop(L),
         Preheader(L->getLoopPreheader()), DomTree(DA->get(Function)),
-        ColdBlocks(DA), CachedSafeLoop(false, false) {}
+        ORE(ORE), ColdBlocks(DA), CachedSafeLoop(false, false) {}
 
   bool run();
 
@@ -1422,6 +1427,7 @@ bool COWArrayOpt::hoistMakeMutable(ArraySemanticsCall MakeMutable) {
 
   if (ArrayAddrBaseBB && !DomTree->dominates(ArrayAddrBaseBB, Preheader)) {
     DEBUG(llvm::dbgs() << "    Skipping Array: does not dominate loop!\n");
+    NotHoistedReason = "the array is not available before the loop";
     return false;
   }
 
@@ -1441,6 +1447,7 @@ bool COWArrayOpt::hoistMakeMutable(ArraySemanticsCall MakeMutable) {
   // Check that the array is a member of an inout argument or return value.
   if (!checkUniqueArrayContainer(ArrayContainer)) {
     DEBUG(llvm::dbgs() << "    Skipping Array: is not unique!\n");
+    NotHoistedReason = "the array may have aliases";
     return false;
   }
 
@@ -1455,8 +1462,10 @@ bool COWArrayOpt::hoistMakeMutable(ArraySemanticsCall MakeMutable) {
       !checkSafeArrayAddressUses(StructUses.StructAddressUsers) ||
       !checkSafeArrayValueUses(StructUses.StructValueUsers) ||
       !checkSafeElementValueUses(StructUses.ElementValueUsers) ||
-      !StructUses.ElementAddressUsers.empty())
+      !StructUses.ElementAddressUsers.empty()) {
+    NotHoistedReason = "the array may be retained or escape in the loop";
     return false;
+  }
 
   hoistMakeMutableAndSelfProjection(MakeMutable,
                                     CurrentArrayAddr != ArrayAddrBase);
@@ -1493,11 +1502,23 @@ bool COWArrayOpt::run() {
       CurrentArrayAddr = MakeMutableCall.getSelf();
       auto HoistedCallEntry = ArrayMakeMutableMap.find(CurrentArrayAddr);
       if (HoistedCallEntry == ArrayMakeMutableMap.end()) {
+        NotHoistedReason = StringRef();
         if (!hoistMakeMutable(MakeMutableCall)) {
           ArrayMakeMutableMap[CurrentArrayAddr] = nullptr;
+          ORE.emit([&] {
+            OptRemark::RemarkMissed R("NotHoisted", *Inst);
+            R << "uniqueness check of array was not hoisted out of the loop";
+            if (!NotHoistedReason.empty())
+              R << ": " << OptRemark::Argument("Reason", NotHoistedReason);
+            return R;
+          });
           continue;
         }
 
+        ORE.emit([&] {
+          return OptRemark::RemarkPassed("Hoisted", *Inst)
+                 << "uniqueness check of array hoisted out of the loop";
+        });
         ArrayMakeMutableMap[CurrentArrayAddr] = MakeMutableCall;
         HasChanged = true;
         continue;
@@ -1548,9 +1569,10 @@ class COWArrayOptPass : public SILFunctionTransform {
     for (auto *L : *LI)
       pushChildren(L);
 
+    OptRemark::Emitter ORE(DEBUG_TYPE, getFunction()->getModule());
     bool HasChanged = false;
     for (auto *L : Loops)
-      HasChanged |= COWArrayOpt(RCIA, L, DA).run();
+      HasChanged |= COWArrayOpt(RCIA, L, DA, ORE).run();
 
       if (HasChanged) {
         invalidateAnalysis(SILAnalysis::InvalidationKind::CallsAndInstructions);
@@ -1649,7 +1671,7 @@ public:
 
         // Can't clone alloc_stack instructions whose dealloc_stack is outside
         // the loop.
-        if (!canCloneInst(&Inst))
+        if (!canCloneLoopInst(&Inst, Loop))
           return false;
 
         ArraySemanticsCall ArrayPropsInst(&Inst, "array.props", true);
@@ -1667,39 +1689,6 @@ public:
 
 private:
 
-  /// Checks whether we can build SSA form after cloning for values of this
-  /// instruction.
-  bool canCloneInst(SILInstruction *I) {
-    // The dealloc_stack of an alloc_stack must be in the loop, otherwise the
-    // dealloc_stack will be fed by a phi node of two alloc_stacks.
-    if (auto *Alloc = dyn_cast<AllocStackInst>(I)) {
-      for (auto *UI : Alloc->getUses())
-        if (auto *Dealloc = dyn_cast<DeallocStackInst>(UI->getUser()))
-          if (!Loop->contains(Dealloc->getParent()))
-            return false;
-    }
-
-    // CodeGen can't build ssa for objc methods.
-    if (auto *Method = dyn_cast<MethodInst>(I))
-      if (Method->getMember().isForeign)
-        for (auto *UI : Method->getUses()) {
-          if (!Loop->contains(UI->getUser()))
-              return false;
-        }
-
-    // We can't have a phi of two openexistential instructions of different UUID.
-    SILInstruction *OEI = dyn_cast<OpenExistentialAddrInst>(I);
-    if (OEI ||
-        (OEI = dyn_cast<OpenExistentialRefInst>(I)) ||
-        (OEI = dyn_cast<OpenExistentialMetatypeInst>(I))) {
-      for (auto *UI : OEI->getUses())
-        if (!Loop->contains(UI->getUser()))
-          return false;
-    }
-
-    return true;
-  }
-
   /// Strip the struct load and the address projection to the location
   /// holding the array struct.
   SILValue stripArrayStructLoad(SILValue V) {
@@ -1920,180 +1909,6 @@ private:
 };
 } // End anonymous namespace.
 
-namespace {
-/// Clone a single exit multiple exit region starting at basic block and ending
-/// in a set of basic blocks. Updates the dominator tree with the cloned blocks.
-/// However, the client needs to update the dominator of the exit blocks.
-class RegionCloner : public SILCloner<RegionCloner> {
-  DominanceInfo &DomTree;
-  SILBasicBlock *StartBB;
-  SmallPtrSet<SILBasicBlock *, 16> OutsideBBs;
-
-  friend class SILVisitor<RegionCloner>;
-  friend class SILCloner<RegionCloner>;
-
-public:
-  RegionCloner(SILBasicBlock *EntryBB,
-               SmallVectorImpl<SILBasicBlock *> &ExitBlocks, DominanceInfo &DT)
-      : SILCloner<RegionCloner>(*EntryBB->getParent()), DomTree(DT),
-        StartBB(EntryBB), OutsideBBs(ExitBlocks.begin(), ExitBlocks.end()) {}
-
-  SILBasicBlock *cloneRegion() {
-    assert (DomTree.getNode(StartBB) != nullptr && "Can't cloned dead code");
-
-    auto CurFun = StartBB->getParent();
-    auto &Mod = CurFun->getModule();
-
-    // We don't want to visit blocks outside of the region. visitSILBasicBlocks
-    // checks BBMap before it clones a block. So we mark exiting blocks as
-    // visited by putting them in the BBMap.
-    for (auto *BB : OutsideBBs)
-      BBMap[BB] = BB;
-
-    // We need to split any edge from a non cond_br basic block leading to a
-    // exit block. After cloning this edge will become critical if it came from
-    // inside the cloned region. The SSAUpdater can't handle critical non
-    // cond_br edges.
-    for (auto *BB : OutsideBBs) {
-      SmallVector<SILBasicBlock*, 8> Preds(BB->getPreds());
-      for (auto *Pred : Preds)
-        if (!isa<CondBranchInst>(Pred->getTerminator()) &&
-            !isa<BranchInst>(Pred->getTerminator()))
-          splitEdgesFromTo(Pred, BB, &DomTree, nullptr);
-    }
-
-    // Create the cloned start basic block.
-    auto *ClonedStartBB = new (Mod) SILBasicBlock(CurFun);
-    BBMap[StartBB] = ClonedStartBB;
-
-    // Clone the arguments.
-    for (auto &Arg : StartBB->getBBArgs()) {
-      SILValue MappedArg =
-          new (Mod) SILArgument(ClonedStartBB, getOpType(Arg->getType()));
-      ValueMap.insert(std::make_pair(Arg, MappedArg));
-    }
-
-    // Clone the instructions in this basic block and recursively clone
-    // successor blocks.
-    getBuilder().setInsertionPoint(ClonedStartBB);
-    visitSILBasicBlock(StartBB);
-
-    // Fix-up terminators.
-    for (auto BBPair : BBMap)
-      if (BBPair.first != BBPair.second) {
-        getBuilder().setInsertionPoint(BBPair.second);
-        visit(BBPair.first->getTerminator());
-      }
-
-    // Add dominator tree nodes for the new basic blocks.
-    fixDomTreeNodes(DomTree.getNode(StartBB));
-
-    // Update SSA form for values used outside of the copied region.
-    updateSSAForm();
-    return ClonedStartBB;
-  }
-
-  llvm::MapVector<SILBasicBlock *, SILBasicBlock *> &getBBMap() { return BBMap; }
-
-protected:
-  /// Clone the dominator tree from the original region to the cloned region.
-  void fixDomTreeNodes(DominanceInfoNode *OrigNode) {
-    auto *BB = OrigNode->getBlock();
-    auto MapIt = BBMap.find(BB);
-    // Outside the cloned region.
-    if (MapIt == BBMap.end())
-      return;
-
-    auto *ClonedBB = MapIt->second;
-    // Exit blocks (BBMap[BB] == BB) end the recursion.
-    if (ClonedBB == BB)
-      return;
-
-    auto *OrigDom = OrigNode->getIDom();
-    assert(OrigDom);
-
-    if (BB == StartBB) {
-      // The cloned start node shares the same dominator as the original node.
-      auto *ClonedNode = DomTree.addNewBlock(ClonedBB, OrigDom->getBlock());
-      (void) ClonedNode;
-      assert(ClonedNode);
-    } else {
-      // Otherwise, map the dominator structure using the mapped block.
-      auto *OrigDomBB = OrigDom->getBlock();
-      assert(BBMap.count(OrigDomBB) && "Must have visited dominating block");
-      auto *MappedDomBB = BBMap[OrigDomBB];
-      assert(MappedDomBB);
-      DomTree.addNewBlock(ClonedBB, MappedDomBB);
-    }
-
-    for (auto *Child : *OrigNode)
-      fixDomTreeNodes(Child);
-  }
-
-  SILValue remapValue(SILValue V) {
-    if (auto *BB = V.getDef()->getParentBB()) {
-      if (!DomTree.dominates(StartBB, BB)) {
-        // Must be a value that dominates the start basic block.
-        assert(DomTree.dominates(BB, StartBB) &&
-               "Must dominated the start of the cloned region");
-        return V;
-      }
-    }
-    return SILCloner<RegionCloner>::remapValue(V);
-  }
-
-  void postProcess(SILInstruction *Orig, SILInstruction *Cloned) {
-    SILCloner<RegionCloner>::postProcess(Orig, Cloned);
-  }
-
-  /// Update SSA form for values that are used outside the region.
-  void updateSSAForValue(SILBasicBlock *OrigBB, SILValue V,
-                         SILSSAUpdater &SSAUp) {
-    // Collect outside uses.
-    SmallVector<UseWrapper, 16> UseList;
-    for (auto Use : V.getUses())
-      if (OutsideBBs.count(Use->getUser()->getParent()) ||
-          !BBMap.count(Use->getUser()->getParent())) {
-        UseList.push_back(UseWrapper(Use));
-      }
-    if (UseList.empty())
-      return;
-
-    // Update SSA form.
-    SSAUp.Initialize(V.getType());
-    SSAUp.AddAvailableValue(OrigBB, V);
-    SILValue NewVal = remapValue(V);
-    SSAUp.AddAvailableValue(BBMap[OrigBB], NewVal);
-    for (auto U : UseList) {
-      Operand *Use = U;
-      SSAUp.RewriteUse(*Use);
-    }
-  }
-
-  void updateSSAForm() {
-    SILSSAUpdater SSAUp;
-    for (auto Entry : BBMap) {
-      // Ignore exit blocks.
-      if (Entry.first == Entry.second)
-        continue;
-      auto *OrigBB = Entry.first;
-
-      // Update outside used phi values.
-      for (auto *Arg : OrigBB->getBBArgs())
-        updateSSAForValue(OrigBB, Arg, SSAUp);
-
-      // Update outside used instruction values.
-      for (auto &Inst : *OrigBB) {
-        for (unsigned i = 0, e = Inst.getNumTypes(); i != e; ++i) {
-          SILValue V(&Inst, i);
-          updateSSAForValue(OrigBB, V, SSAUp);
-        }
-      }
-    }
-  }
-};
-} // End anonymous namespace.
-
 namespace {
 /// This class transforms a hoistable loop nest into a speculatively specialized
 /// loop based on array.props calls.
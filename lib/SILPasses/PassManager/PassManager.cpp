@@ -13,15 +13,25 @@
 #define DEBUG_TYPE "sil-passmanager"
 
 #include "swift/SILPasses/PassManager.h"
+#include "swift/Basic/TraceEvents.h"
 #include "swift/SIL/SILFunction.h"
 #include "swift/SIL/SILModule.h"
+#include "swift/SILAnalysis/BasicCalleeAnalysis.h"
+#include "swift/SILAnalysis/FunctionOrder.h"
 #include "swift/SILPasses/PrettyStackTrace.h"
 #include "swift/SILPasses/Transforms.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/TimeValue.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace swift;
 
@@ -156,7 +166,290 @@ SILPassManager::SILPassManager(SILModule *M, llvm::StringRef Stage) :
   }
 }
 
+namespace {
+/// The state of a thread running function passes in parallel.
+struct PassThread {
+  /// The thread's own instances of the passes.
+  SmallVector<SILFunctionTransform *, 16> Transforms;
+
+  /// Set to true when the pass running on the thread invalidates an analysis.
+  bool PassHasInvalidated = false;
+
+  /// The invalidations of functions which still have to be passed on to the
+  /// analyses other than function analyses.
+  SmallVector<std::pair<SILFunction *, SILAnalysis::InvalidationKind>, 16>
+    DeferredInvalidations;
+
+  /// The number of passes the thread has run.
+  unsigned NumPassesRun = 0;
+};
+
+/// Hands out the strongly connected components of the call graph to the
+/// threads running function passes, in bottom-up order: a component is ready
+/// once the components of all the functions it calls are done.
+class BottomUpScheduler {
+  ArrayRef<BottomUpFunctionOrder::SCC> SCCs;
+
+  /// For each component, the components which call into it.
+  std::vector<SmallVector<unsigned, 4>> Callers;
+
+  /// For each component, the number of components it calls which aren't
+  /// done yet.
+  std::vector<unsigned> NumPendingCallees;
+
+  /// The components which are ready, in bottom-up order.
+  std::deque<unsigned> Ready;
+
+  /// The number of components which aren't done yet.
+  unsigned NumRemaining;
+
+  std::mutex Lock;
+  std::condition_variable ReadyOrDone;
+
+public:
+  BottomUpScheduler(ArrayRef<BottomUpFunctionOrder::SCC> SCCs,
+                    BasicCalleeAnalysis *BCA)
+    : SCCs(SCCs), Callers(SCCs.size()), NumPendingCallees(SCCs.size()),
+      NumRemaining(SCCs.size()) {
+    llvm::DenseMap<SILFunction *, unsigned> SCCOfFunction;
+    for (unsigned Index = 0, e = SCCs.size(); Index != e; ++Index)
+      for (SILFunction *F : SCCs[Index])
+        SCCOfFunction[F] = Index;
+
+    for (unsigned Index = 0, e = SCCs.size(); Index != e; ++Index) {
+      llvm::SmallDenseSet<unsigned, 8> Callees;
+      for (SILFunction *F : SCCs[Index]) {
+        for (auto &BB : *F) {
+          for (auto &I : BB) {
+            auto FAS = FullApplySite::isa(&I);
+            if (!FAS)
+              continue;
+
+            for (SILFunction *Callee : BCA->getCalleeList(FAS)) {
+              auto It = SCCOfFunction.find(Callee);
+              if (It == SCCOfFunction.end() || It->second == Index)
+                continue;
+              if (Callees.insert(It->second).second) {
+                Callers[It->second].push_back(Index);
+                ++NumPendingCallees[Index];
+              }
+            }
+          }
+        }
+      }
+      if (NumPendingCallees[Index] == 0)
+        Ready.push_back(Index);
+    }
+  }
+
+  /// Waits for a component to become ready and sets \p Index to it.
+  ///
+  /// \returns false once all components are done
+  bool next(unsigned &Index) {
+    std::unique_lock<std::mutex> Locked(Lock);
+    ReadyOrDone.wait(Locked, [&] { return !Ready.empty() || !NumRemaining; });
+    if (Ready.empty())
+      return false;
+    Index = Ready.front();
+    Ready.pop_front();
+    return true;
+  }
+
+  /// Returns the functions of the component \p Index.
+  ArrayRef<SILFunction *> getFunctions(unsigned Index) const {
+    return SCCs[Index];
+  }
+
+  /// Marks the component \p Index as done, which may make its callers ready.
+  void finished(unsigned Index) {
+    std::lock_guard<std::mutex> Locked(Lock);
+    --NumRemaining;
+    for (unsigned Caller : Callers[Index])
+      if (--NumPendingCallees[Caller] == 0)
+        Ready.push_back(Caller);
+    ReadyOrDone.notify_all();
+  }
+};
+} // end anonymous namespace
+
+/// The state of the current thread while function passes run in parallel.
+static LLVM_THREAD_LOCAL PassThread *CurrentPassThread = nullptr;
+
+/// Creates a new instance of the pass \p Kind.
+static SILTransform *createTransform(PassKind Kind) {
+  SILTransform *T = nullptr;
+  switch (Kind) {
+#define PASS(ID, NAME, DESCRIPTION)        \
+  case PassKind::ID:                       \
+    T = swift::create##ID();               \
+    break;
+#include "swift/SILPasses/Passes.def"
+  case PassKind::invalidPassKind:
+    llvm_unreachable("invalid pass kind");
+  }
+  T->setPassKind(Kind);
+  return T;
+}
+
+bool SILPassManager::canRunFunctionPassesInParallel() const {
+  const SILOptions &Options = getOptions();
+  if (!Options.ParallelFunctionPasses || Options.NumThreads < 2)
+    return false;
+
+  // These options print or count the passes in the order in which they run,
+  // which is only defined on one thread.
+  return !SILPrintAll && !SILPrintPassName && !SILPrintPassTime &&
+         SILPrintBefore.empty() && SILPrintAfter.empty() &&
+         SILPrintAround.empty() && SILNumOptPassesToRun == UINT_MAX;
+}
+
 bool SILPassManager::runFunctionPasses(PassList FuncTransforms) {
+  if (!canRunFunctionPassesInParallel())
+    return runFunctionPassesSerially(FuncTransforms);
+
+  // Run each sequence of function-local passes on several threads, and the
+  // passes between them on one.
+  while (!FuncTransforms.empty()) {
+    bool IsFunctionLocal = FuncTransforms.front()->isFunctionLocal();
+    unsigned Length = 1;
+    while (Length != FuncTransforms.size() &&
+           FuncTransforms[Length]->isFunctionLocal() == IsFunctionLocal)
+      ++Length;
+
+    if (IsFunctionLocal)
+      runFunctionPassesInParallel(FuncTransforms.slice(0, Length));
+    else
+      runFunctionPassesSerially(FuncTransforms.slice(0, Length));
+    FuncTransforms = FuncTransforms.slice(Length);
+  }
+  return false;
+}
+
+void SILPassManager::runFunctionPassesInParallel(PassList FuncTransforms) {
+  auto *BCA = getAnalysis<BasicCalleeAnalysis>();
+  BottomUpFunctionOrder Order(*Mod, BCA);
+  BottomUpScheduler Scheduler(Order.getSCCs(), BCA);
+
+  // Create the entries of all functions up front, so that the map doesn't
+  // change while the threads look up their functions.
+  for (auto &F : *Mod)
+    CompletedPassesMap[&F];
+
+  // Each thread runs its own instances of the passes. The main thread uses
+  // the pass manager's.
+  std::vector<PassThread> Threads(getOptions().NumThreads);
+  for (unsigned ThreadIdx = 0, e = Threads.size(); ThreadIdx != e;
+       ++ThreadIdx) {
+    for (SILFunctionTransform *SFT : FuncTransforms) {
+      if (ThreadIdx != 0)
+        SFT = llvm::cast<SILFunctionTransform>(
+          createTransform(SFT->getPassKind()));
+      SFT->injectPassManager(this);
+      Threads[ThreadIdx].Transforms.push_back(SFT);
+    }
+  }
+
+  auto RunThread = [&](PassThread &Thread) {
+    CurrentPassThread = &Thread;
+    unsigned Index;
+    while (Scheduler.next(Index)) {
+      for (SILFunction *F : Scheduler.getFunctions(Index))
+        runFunctionPassesOnThread(*F);
+      Scheduler.finished(Index);
+    }
+    CurrentPassThread = nullptr;
+  };
+
+  Mod->setMultithreaded(true);
+  RunningInParallel = true;
+
+  std::vector<std::thread> Workers;
+  for (unsigned ThreadIdx = 1, e = Threads.size(); ThreadIdx != e; ++ThreadIdx)
+    Workers.push_back(std::thread(RunThread, std::ref(Threads[ThreadIdx])));
+  RunThread(Threads[0]);
+  for (std::thread &Worker : Workers)
+    Worker.join();
+
+  RunningInParallel = false;
+  Mod->setMultithreaded(false);
+
+  // Now pass on the invalidations to the other analyses.
+  for (unsigned ThreadIdx = 0, e = Threads.size(); ThreadIdx != e;
+       ++ThreadIdx) {
+    PassThread &Thread = Threads[ThreadIdx];
+    for (auto &Invalidation : Thread.DeferredInvalidations)
+      for (auto AP : Analysis)
+        if (!AP->isLocked() && !AP->isFunctionAnalysis())
+          AP->invalidate(Invalidation.first, Invalidation.second);
+
+    NumPassesRun += Thread.NumPassesRun;
+    if (ThreadIdx != 0)
+      for (SILFunctionTransform *SFT : Thread.Transforms)
+        delete SFT;
+  }
+}
+
+void SILPassManager::runFunctionPassesOnThread(SILFunction &F) {
+  if (F.empty())
+    return;
+
+  // Don't optimize functions that are marked with the opt.never attribute.
+  if (!F.shouldOptimize())
+    return;
+
+  const SILOptions &Options = getOptions();
+  PassThread &Thread = *CurrentPassThread;
+  CompletedPasses &completedPasses = CompletedPassesMap.find(&F)->second;
+
+  for (SILFunctionTransform *SFT : Thread.Transforms) {
+    PrettyStackTraceSILFunctionTransform X(SFT);
+    SFT->injectFunction(&F);
+
+    if (completedPasses.test((size_t)SFT->getPassKind()))
+      continue;
+
+    if (isDisabled(SFT))
+      continue;
+
+    Thread.PassHasInvalidated = false;
+
+    {
+      trace::Scope TracePass("SIL pass", SFT->getName(), F.getName());
+      SFT->run();
+    }
+
+    if (!Thread.PassHasInvalidated)
+      completedPasses.set((size_t)SFT->getPassKind());
+
+    if (Options.VerifyAll &&
+        (Thread.PassHasInvalidated || SILVerifyWithoutInvalidation)) {
+      F.verify();
+      for (auto *A : Analysis)
+        if (A->isFunctionAnalysis())
+          A->verify(&F);
+    }
+
+    ++Thread.NumPassesRun;
+  }
+}
+
+void SILPassManager::invalidateAnalysisInParallel(
+    SILFunction *F, SILAnalysis::InvalidationKind K) {
+  PassThread *Thread = CurrentPassThread;
+  assert(Thread && "invalidation from outside of a pass thread");
+
+  for (auto AP : Analysis)
+    if (!AP->isLocked() && AP->isFunctionAnalysis())
+      AP->invalidate(F, K);
+
+  Thread->DeferredInvalidations.push_back({F, K});
+  Thread->PassHasInvalidated = true;
+
+  // Any change let all passes run again. Only this thread works on F.
+  CompletedPassesMap.find(F)->second.reset();
+}
+
+bool SILPassManager::runFunctionPassesSerially(PassList FuncTransforms) {
   const SILOptions &Options = getOptions();
 
   for (auto &F : *Mod) {
@@ -197,7 +490,10 @@ bool SILPassManager::runFunctionPasses(PassList FuncTransforms) {
       }
 
       llvm::sys::TimeValue StartTime = llvm::sys::TimeValue::now();
-      SFT->run();
+      {
+        trace::Scope TracePass("SIL pass", SFT->getName(), F.getName());
+        SFT->run();
+      }
 
       if (SILPrintPassTime) {
         auto Delta = llvm::sys::TimeValue::now().nanoseconds() -
@@ -298,7 +594,10 @@ void SILPassManager::runOneIteration() {
       }
 
       llvm::sys::TimeValue StartTime = llvm::sys::TimeValue::now();
-      SMT->run();
+      {
+        trace::Scope TracePass("SIL pass", SMT->getName());
+        SMT->run();
+      }
 
       if (SILPrintPassTime) {
         auto Delta = llvm::sys::TimeValue::now().nanoseconds() -
@@ -161,6 +161,7 @@ void AddHighLevelLoopOptPasses(SILPassManager &PM) {
   // Cleanup.
   PM.addDCE();
   PM.addSwiftArrayOpts();
+  PM.addArrayLoopVersioning();
 }
 
 void AddSSAPasses(SILPassManager &PM, OptimizationLevelKind OpLevel) {
@@ -357,6 +358,12 @@ void swift::runSILOptimizationPasses(SILModule &Module) {
   PM.addDCE();
   // Clean-up after DCE.
   PM.addSimplifyCFG();
+
+  // Mark reference counting of thread-local objects as non-atomic. This runs
+  // late because ARC code motion re-creates retains and releases without the
+  // flag.
+  PM.addUpdateEscapeAnalysis();
+  PM.addNonAtomicRC();
   PM.runOneIteration();
 
   // Call the CFG viewer.
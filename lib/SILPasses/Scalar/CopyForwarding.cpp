@@ -1101,6 +1101,8 @@ class CopyForwardingPass : public SILFunctionTransform
   }
 
   StringRef getName() override { return "Copy Forwarding"; }
+
+  bool isFunctionLocal() override { return true; }
 };
 } // anonymous
 
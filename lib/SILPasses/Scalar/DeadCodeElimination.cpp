@@ -170,6 +170,8 @@ class DCE : public SILFunctionTransform {
   void replaceBranchWithJump(SILInstruction *Inst, SILBasicBlock *Block);
 
   StringRef getName() override { return "Dead Code Elimination"; }
+
+  bool isFunctionLocal() override { return true; }
 };
 
 // Keep track of the fact that V is live and add it to our worklist
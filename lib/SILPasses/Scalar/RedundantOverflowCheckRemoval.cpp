@@ -633,6 +633,8 @@ public:
   StringRef getName() override {
     return "Removes overflow checks that are proven to be redundant";
   }
+
+  bool isFunctionLocal() override { return true; }
 };
 }
 
@@ -908,6 +908,8 @@ class SILMem2Reg : public SILFunctionTransform {
   }
 
   StringRef getName() override { return "SIL Mem2Reg"; }
+
+  bool isFunctionLocal() override { return true; }
 };
 } // end anonymous namespace
 
@@ -292,6 +292,17 @@ static bool isDefaultCaseKnown(ClassHierarchyAnalysis *CHA,
   return true;
 }
 
+/// \brief Returns how many times the implementation of \p Member in \p CD was
+/// called according to the profile, or 0 if that is unknown.
+static uint64_t getProfiledCallCount(SILModule &M, ClassDecl *CD,
+                                     SILDeclRef Member) {
+  SILFunction *F = M.lookUpFunctionInVTable(CD, Member);
+  if (!F)
+    return 0;
+  auto Count = F->getEntryCount();
+  return Count ? *Count : 0;
+}
+
 /// \brief Try to speculate the call target for the call \p AI. This function
 /// returns true if a change was made.
 static bool tryToSpeculateTarget(FullApplySite AI,
@@ -377,6 +388,15 @@ static bool tryToSpeculateTarget(FullApplySite AI,
     Subs.erase(RemovedIt, Subs.end());
   }
 
+  // If there is a profile, check for the subclasses whose implementations
+  // were called most often first. These are also the ones kept if there are
+  // too many subclasses.
+  std::stable_sort(Subs.begin(), Subs.end(),
+                   [&](ClassDecl *LHS, ClassDecl *RHS) {
+    return getProfiledCallCount(M, LHS, CMI->getMember()) >
+           getProfiledCallCount(M, RHS, CMI->getMember());
+  });
+
   if (Subs.size() > MaxNumSpeculativeTargets) {
     DEBUG(llvm::dbgs() << "Class " << CD->getName() << " has too many ("
                        << Subs.size() << ") subclasses. Performing speculative "
@@ -427,12 +447,9 @@ static bool tryToSpeculateTarget(FullApplySite AI,
   // Remark: With the current implementation of a speculative devirtualization,
   // if devirtualization of the "default" case is possible, then it would
   // by construction directly invoke the implementation of the method
-  // corresponding to the static type of the instance. This may change
-  // in the future, if we start using PGO for ordering of checked_cast_br
-  // checks.
-
-  // TODO: The ordering of checks may benefit from using a PGO, because
-  // the most probable alternatives could be checked first.
+  // corresponding to the static type of the instance. The subclasses are
+  // checked in the order of their profiled counts, but the static type is
+  // always checked first.
 
   // Number of subclasses which cannot be handled by checked_cast_br checks.
   int NotHandledSubsNum = 0;
@@ -515,6 +532,10 @@ namespace {
       // Collect virtual calls that may be specialized.
       SmallVector<FullApplySite, 16> ToSpecialize;
       for (auto &BB : *getFunction()) {
+        // Don't grow code which the profile says never ran.
+        auto Count = BB.getExecutionCount();
+        if (Count && *Count == 0)
+          continue;
         for (auto II = BB.begin(), IE = BB.end(); II != IE; ++II) {
           FullApplySite AI = FullApplySite::isa(&*II);
           if (AI && isa<ClassMethodInst>(AI.getCallee()))
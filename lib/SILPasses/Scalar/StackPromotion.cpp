@@ -15,6 +15,7 @@
 #include "swift/SILPasses/Transforms.h"
 #include "swift/SILAnalysis/EscapeAnalysis.h"
 #include "swift/SILAnalysis/DominanceAnalysis.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SIL/SILArgument.h"
 #include "swift/SIL/SILBuilder.h"
 #include "llvm/ADT/Statistic.h"
@@ -49,6 +50,8 @@ class StackPromoter {
   DominanceInfo *DT;
   PostDominanceInfo *PDT;
 
+  OptRemark::Emitter &ORE;
+
   // Pseudo-functions for (de-)allocating array buffers on the stack.
 
   SILFunction *BufferAllocFunc = nullptr;
@@ -101,6 +104,9 @@ class StackPromoter {
   /// Tries to promote the allocation \p AI.
   void tryPromoteAlloc(SILInstruction *AI);
 
+  /// Returns why the allocation \p AI couldn't be promoted.
+  StringRef getReasonNotPromoted(SILInstruction *AI);
+
   /// Creates the external declaration for swift_bufferAllocateOnStack.
   SILFunction *getBufferAllocFunc(SILFunction *OrigFunc,
                                   SILLocation Loc);
@@ -139,8 +145,9 @@ class StackPromoter {
 public:
 
   StackPromoter(EscapeAnalysis::ConnectionGraph *ConGraph,
-                DominanceInfo *DT, PostDominanceInfo *PDT) :
-    ConGraph(ConGraph), DT(DT), PDT(PDT) { }
+                DominanceInfo *DT, PostDominanceInfo *PDT,
+                OptRemark::Emitter &ORE) :
+    ConGraph(ConGraph), DT(DT), PDT(PDT), ORE(ORE) { }
 
   /// What did the optimization change?
   enum class ChangeState {
@@ -195,12 +202,24 @@ StackPromoter::ChangeState StackPromoter::promote() {
 void StackPromoter::tryPromoteAlloc(SILInstruction *I) {
   SILInstruction *AllocInsertionPoint = nullptr;
   SILInstruction *DeallocInsertionPoint = nullptr;
-  if (!canPromoteAlloc(I, AllocInsertionPoint, DeallocInsertionPoint))
+  if (!canPromoteAlloc(I, AllocInsertionPoint, DeallocInsertionPoint)) {
+    ORE.emit([&] {
+      return OptRemark::RemarkMissed("NotPromoted", *I)
+             << "allocation of " << OptRemark::Argument("Type", I->getType(0))
+             << " was not promoted to the stack: "
+             << OptRemark::Argument("Reason", getReasonNotPromoted(I));
+    });
     return;
+  }
 
   DEBUG(llvm::dbgs() << "Promoted " << *I);
   DEBUG(llvm::dbgs() << "    in " << I->getFunction()->getName() << '\n');
   NumStackPromoted++;
+  ORE.emit([&] {
+    return OptRemark::RemarkPassed("Promoted", *I)
+           << "allocation of " << OptRemark::Argument("Type", I->getType(0))
+           << " was promoted to the stack";
+  });
 
   SILBuilder B(DeallocInsertionPoint);
   if (auto *ARI = dyn_cast<AllocRefInst>(I)) {
@@ -292,6 +311,18 @@ static void dumpUsePoints(const llvm::SmallPtrSetImpl<ValueBase *> &UsePoints) {
 }
 #endif
 
+StringRef StackPromoter::getReasonNotPromoted(SILInstruction *AI) {
+  auto *Node = ConGraph->getNodeOrNull(AI);
+  if (!Node)
+    return "it is not tracked by escape analysis";
+  if (Node->escapesGlobally())
+    return "it escapes to global memory or to a function which is not known";
+  if (Node->escapes())
+    return "it escapes to the caller through an argument or the return value";
+  return "its lifetime doesn't fit into the loops and stack allocations "
+         "around it";
+}
+
 bool StackPromoter::canPromoteAlloc(SILInstruction *AI,
                                     SILInstruction *&AllocInsertionPoint,
                                     SILInstruction *&DeallocInsertionPoint) {
@@ -481,7 +512,8 @@ private:
 
     SILFunction *F = getFunction();
     if (auto *ConGraph = EA->getConnectionGraph(F)) {
-      StackPromoter promoter(ConGraph, DA->get(F), PDA->get(F));
+      OptRemark::Emitter ORE(DEBUG_TYPE, F->getModule());
+      StackPromoter promoter(ConGraph, DA->get(F), PDA->get(F), ORE);
       switch (promoter.promote()) {
         case StackPromoter::ChangeState::None:
           break;
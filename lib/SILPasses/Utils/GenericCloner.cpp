@@ -27,14 +27,14 @@ using namespace swift;
 /// Create a new empty function with the correct arguments and a unique name.
 SILFunction *GenericCloner::initCloned(SILFunction *Orig,
                                        TypeSubstitutionMap &InterfaceSubs,
-                                       StringRef NewName) {
+                                       StringRef NewName, bool KeepGenerics) {
   SILModule &M = Orig->getModule();
   Module *SM = M.getSwiftModule();
 
   CanSILFunctionType FTy =
     SILType::substFuncType(M, SM, InterfaceSubs,
                            Orig->getLoweredFunctionType(),
-                           /*dropGenerics = */ true);
+                           /*dropGenerics = */ !KeepGenerics);
 
   assert((Orig->isTransparent() || Orig->isBare() || Orig->getLocation())
          && "SILFunction missing location");
@@ -44,7 +44,8 @@ SILFunction *GenericCloner::initCloned(SILFunction *Orig,
 
   // Create a new empty function.
   SILFunction *NewF = SILFunction::create(
-      M, getSpecializedLinkage(Orig, Orig->getLinkage()), NewName, FTy, nullptr,
+      M, getSpecializedLinkage(Orig, Orig->getLinkage()), NewName, FTy,
+      KeepGenerics ? Orig->getContextGenericParams() : nullptr,
       Orig->getLocation(), Orig->isBare(), Orig->isTransparent(),
       Orig->isFragile(), Orig->isThunk(), Orig->getClassVisibility(),
       Orig->getInlineStrategy(), Orig->getEffectsKind(), Orig,
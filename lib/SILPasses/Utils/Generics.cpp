@@ -15,9 +15,50 @@
 #include "swift/Strings.h"
 #include "swift/SILPasses/Utils/Generics.h"
 #include "swift/SILPasses/Utils/GenericCloner.h"
+#include "swift/AST/ASTContext.h"
+#include "swift/SIL/OptimizationRemark.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 using namespace swift;
 
+static StringRef getFailureDescription(SpecializationFailure Reason) {
+  switch (Reason) {
+  case SpecializationFailure::NotOptimized:
+    return "the callee is excluded from optimization";
+  case SpecializationFailure::NoBody:
+    return "the body of the callee is not available";
+  case SpecializationFailure::DynamicSelf:
+    return "a generic parameter is bound to the dynamic Self type";
+  case SpecializationFailure::NoConcreteParameter:
+    return "no generic parameter is bound to a concrete type";
+  case SpecializationFailure::RecursivePartialSpecialization:
+    return "the callee is recursive and only some generic parameters are "
+           "bound to concrete types";
+  case SpecializationFailure::AlreadyPartiallySpecialized:
+    return "the callee is already a partial specialization and only some "
+           "generic parameters are bound to concrete types";
+  case SpecializationFailure::OptimizationDisabled:
+    return "optimization is disabled";
+  }
+  llvm_unreachable("unhandled SpecializationFailure");
+}
+
+void swift::remarkMissedSpecialization(ApplySite Apply,
+                                       SpecializationFailure Reason) {
+  auto *FRI = dyn_cast<FunctionRefInst>(Apply.getCallee());
+  if (!FRI)
+    return;
+
+  OptRemark::Emitter ORE(DEBUG_TYPE, Apply.getModule());
+  ORE.emit([&] {
+    return OptRemark::RemarkMissed("NotSpecialized", *Apply.getInstruction())
+           << "generic call to '"
+           << OptRemark::Argument("Callee", FRI->getReferencedFunction())
+           << "' was not specialized: "
+           << OptRemark::Argument("Reason", getFailureDescription(Reason));
+  });
+}
+
 // Create a new apply based on an old one, but with a different
 // function being applied.
 ApplySite swift::replaceWithSpecializedFunction(ApplySite AI,
@@ -51,6 +92,38 @@ ApplySite swift::replaceWithSpecializedFunction(ApplySite AI,
   llvm_unreachable("unhandled kind of apply");
 }
 
+/// Like replaceWithSpecializedFunction, but for a partial specialization
+/// \p NewF, which takes the same substitutions as the original callee.
+static ApplySite replaceWithPartialSpecialization(ApplySite AI,
+                                                  SILFunction *NewF) {
+  SILLocation Loc = AI.getLoc();
+
+  SmallVector<SILValue, 4> Arguments;
+  for (auto &Op : AI.getArgumentOperands()) {
+    Arguments.push_back(Op.get());
+  }
+
+  SILBuilderWithScope Builder(AI.getInstruction());
+  FunctionRefInst *FRI = Builder.createFunctionRef(Loc, NewF);
+
+  if (auto *TAI = dyn_cast<TryApplyInst>(AI))
+    return Builder.createTryApply(Loc, FRI, TAI->getSubstCalleeSILType(),
+                                  TAI->getSubstitutions(), Arguments,
+                                  TAI->getNormalBB(), TAI->getErrorBB());
+
+  if (auto *A = dyn_cast<ApplyInst>(AI))
+    return Builder.createApply(Loc, FRI, A->getSubstCalleeSILType(),
+                               A->getType(), A->getSubstitutions(), Arguments,
+                               A->isNonThrowing());
+
+  if (auto *PAI = dyn_cast<PartialApplyInst>(AI))
+    return Builder.createPartialApply(Loc, FRI, PAI->getSubstCalleeSILType(),
+                                      PAI->getSubstitutions(), Arguments,
+                                      PAI->getType());
+
+  llvm_unreachable("unhandled kind of apply");
+}
+
 
 /// Try to convert definition into declaration.
 static bool convertExtenralDefinitionIntoDeclaration(SILFunction *F) {
@@ -230,6 +303,139 @@ SILFunction *swift::getExistingSpecialization(SILModule &M,
   return Specialization;
 }
 
+/// Returns the generic parameter which \p DepTy is a member of, or \p DepTy
+/// itself.
+static CanType getRootGenericParam(Type DepTy) {
+  while (auto *DMT = DepTy->getAs<DependentMemberType>())
+    DepTy = DMT->getBase();
+  return DepTy->getCanonicalType();
+}
+
+/// Returns true if \p F is a partial specialization. A full specialization
+/// drops the generic signature of the function it was cloned from, so a
+/// generic specialization which is still generic is a partial one.
+static bool isPartialSpecialization(SILFunction *F) {
+  return F->getName().startswith("_TTSg") &&
+         F->getLoweredFunctionType()->isPolymorphic();
+}
+
+/// Specializes \p Apply of \p F, only some of whose substitutions are
+/// concrete, for the generic parameters which are bound to concrete types.
+static ApplySite trySpecializeApplyPartially(ApplySite Apply, SILFunction *F,
+                                             SILFunction *&NewFunction,
+                                             CloneCollector &Collector) {
+  auto &M = Apply.getInstruction()->getModule();
+  auto FnTy = F->getLoweredFunctionType();
+  auto Sig = FnTy->getGenericSignature();
+  auto *ContextParams = F->getContextGenericParams();
+  if (!Sig || !ContextParams) {
+    remarkMissedSpecialization(Apply,
+                               SpecializationFailure::NoConcreteParameter);
+    return ApplySite();
+  }
+
+  // A partial specialization keeps the full signature of F, so a call of it
+  // still binds the parameters it substituted, and specializing it for them
+  // again would clone it forever. It is only specialized fully.
+  if (isPartialSpecialization(F)) {
+    DEBUG(llvm::dbgs() << "    Already partially specialized.\n");
+    remarkMissedSpecialization(
+        Apply, SpecializationFailure::AlreadyPartiallySpecialized);
+    return ApplySite();
+  }
+
+  ArrayRef<Substitution> Subs = Apply.getSubstitutions();
+  auto DepTypeRange = Sig->getAllDependentTypes();
+  SmallVector<Type, 8> DepTypes(DepTypeRange.begin(), DepTypeRange.end());
+  auto ArchetypeRange = ContextParams->getAllNestedArchetypes();
+  SmallVector<ArchetypeType *, 8> Archetypes(ArchetypeRange.begin(),
+                                             ArchetypeRange.end());
+  assert(DepTypes.size() == Subs.size() && Archetypes.size() == Subs.size() &&
+         "substitutions don't match the generic signature");
+
+  // Bind every parameter which is concrete, whether or not it appears in
+  // the type of F. The body may still use one which doesn't, e.g. after its
+  // metatype argument was removed as dead.
+  llvm::SmallPtrSet<TypeBase *, 4> BoundParams;
+  for (unsigned i : indices(Subs)) {
+    auto *Param = DepTypes[i]->getAs<GenericTypeParamType>();
+    if (Param && !Subs[i].getReplacement()->hasArchetype())
+      BoundParams.insert(Param->getCanonicalType().getPointer());
+  }
+  if (BoundParams.empty()) {
+    DEBUG(llvm::dbgs() << "    No concrete generic parameters.\n");
+    remarkMissedSpecialization(Apply,
+                               SpecializationFailure::NoConcreteParameter);
+    return ApplySite();
+  }
+
+  // A recursive call in F is only redirected to the clone if it has the same
+  // substitutions, which the call in a partial specialization doesn't.
+  for (auto &BB : *F)
+    for (auto &I : BB)
+      if (auto *FRI = dyn_cast<FunctionRefInst>(&I))
+        if (FRI->getReferencedFunction() == F) {
+          DEBUG(llvm::dbgs() << "    Cannot partially specialize recursive "
+                                "function.\n");
+          remarkMissedSpecialization(
+              Apply, SpecializationFailure::RecursivePartialSpecialization);
+          return ApplySite();
+        }
+
+  // Substitute the bound parameters and their members. The others are
+  // mapped to themselves, both in the body of the clone and in its name, so
+  // that all calls binding the same parameters to the same types share it.
+  TypeSubstitutionMap InterfaceSubs;
+  TypeSubstitutionMap ContextSubs;
+  SmallVector<Substitution, 8> CloneSubs;
+  SmallVector<Substitution, 8> NameSubs;
+  auto &Ctx = M.getASTContext();
+  for (unsigned i : indices(Subs)) {
+    const Substitution &Sub = Subs[i];
+    if (BoundParams.count(getRootGenericParam(DepTypes[i]).getPointer())) {
+      InterfaceSubs[Sub.getArchetype()] = Sub.getReplacement();
+      if (auto *SubTy = DepTypes[i]->getAs<SubstitutableType>())
+        InterfaceSubs[SubTy] = Sub.getReplacement();
+      else if (auto *DMT = DepTypes[i]->getAs<DependentMemberType>())
+        InterfaceSubs[DMT] = Sub.getReplacement();
+      ContextSubs[Archetypes[i]] = Sub.getReplacement();
+      CloneSubs.push_back(Sub);
+      NameSubs.push_back(Sub);
+      continue;
+    }
+    auto Conformances = Ctx.Allocate<ProtocolConformance *>(
+        Sub.getConformances().size());
+    CloneSubs.push_back(
+        Substitution(Sub.getArchetype(), Archetypes[i], Conformances));
+    NameSubs.push_back(
+        Substitution(Sub.getArchetype(), DepTypes[i], Conformances));
+  }
+
+  llvm::SmallString<64> ClonedName;
+  {
+    llvm::raw_svector_ostream buffer(ClonedName);
+    Mangle::Mangler Mangler(buffer);
+    Mangle::GenericSpecializationMangler SpecMangler(Mangler, F, NameSubs);
+    SpecMangler.mangle();
+  }
+  DEBUG(llvm::dbgs() << "    Partially specialized function " << ClonedName
+                     << '\n');
+
+  auto NewF = M.lookUpFunction(ClonedName);
+  if (!NewF) {
+    if (M.getOptions().Optimization <= SILOptions::SILOptMode::None) {
+      remarkMissedSpecialization(Apply,
+                                 SpecializationFailure::OptimizationDisabled);
+      return ApplySite();
+    }
+    NewF = GenericCloner::clonePartially(F, InterfaceSubs, ContextSubs,
+                                         ClonedName, CloneSubs,
+                                         Collector.getCallback());
+    NewFunction = NewF;
+  }
+  return replaceWithPartialSpecialization(Apply, NewF);
+}
+
 ApplySite swift::trySpecializeApplyOfGeneric(ApplySite Apply,
                                              SILFunction *&NewFunction,
                                              CloneCollector &Collector) {
@@ -243,6 +449,7 @@ ApplySite swift::trySpecializeApplyOfGeneric(ApplySite Apply,
   if (!F->shouldOptimize()) {
     DEBUG(llvm::dbgs() << "    Cannot specialize function " << F->getName()
                        << " marked to be excluded from optimizations.\n");
+    remarkMissedSpecialization(Apply, SpecializationFailure::NotOptimized);
     return ApplySite();
   }
 
@@ -261,15 +468,15 @@ ApplySite swift::trySpecializeApplyOfGeneric(ApplySite Apply,
     ContextSubs = F->getContextGenericParams()
       ->getSubstitutionMap(Apply.getSubstitutions());
 
-  // We do not support partial specialization.
-  if (hasUnboundGenericTypes(InterfaceSubs)) {
-    DEBUG(llvm::dbgs() << "    Can not specialize with interface subs.\n");
-    return ApplySite();
-  }
   if (hasDynamicSelfTypes(InterfaceSubs)) {
     DEBUG(llvm::dbgs() << "    Cannot specialize with dynamic self.\n");
+    remarkMissedSpecialization(Apply, SpecializationFailure::DynamicSelf);
     return ApplySite();
   }
+  if (hasUnboundGenericTypes(InterfaceSubs)) {
+    DEBUG(llvm::dbgs() << "    Specializing partially.\n");
+    return trySpecializeApplyPartially(Apply, F, NewFunction, Collector);
+  }
 
   llvm::SmallString<64> ClonedName;
   {
@@ -299,8 +506,11 @@ ApplySite swift::trySpecializeApplyOfGeneric(ApplySite Apply,
   } else {
 
     // Do not create any new specializations at Onone.
-    if (M.getOptions().Optimization <= SILOptions::SILOptMode::None)
+    if (M.getOptions().Optimization <= SILOptions::SILOptMode::None) {
+      remarkMissedSpecialization(Apply,
+                                 SpecializationFailure::OptimizationDisabled);
       return ApplySite();
+    }
 
     DEBUG(
       if (M.getOptions().Optimization <= SILOptions::SILOptMode::Debug) {
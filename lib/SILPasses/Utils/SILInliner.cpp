@@ -13,6 +13,7 @@
 #define DEBUG_TYPE "sil-inliner"
 #include "swift/SILPasses/Utils/SILInliner.h"
 #include "swift/SIL/SILDebugScope.h"
+#include "llvm/ADT/APInt.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/Debug.h"
 using namespace swift;
@@ -50,6 +51,9 @@ bool SILInliner::inlineFunction(FullApplySite AI, ArrayRef<SILValue> Args) {
 
   CalleeEntryBB = &*CalleeFunction->begin();
 
+  // The caller's block is split below, so get the call's count first.
+  Optional<uint64_t> CallCount = AI.getParent()->getExecutionCount();
+
   // Compute the SILLocation which should be used by all the inlined
   // instructions.
   if (IKind == InlineKind::PerformanceInline) {
@@ -113,6 +117,7 @@ bool SILInliner::inlineFunction(FullApplySite AI, ArrayRef<SILValue> Args) {
       // Replace all uses of the apply instruction with the operands of the
       // return instruction, appropriately mapped.
       SILValue(nonTryAI).replaceAllUsesWith(remapValue(RI->getOperand()));
+      scaleProfileCounts(CallCount, nullptr);
       return true;
     }
   }
@@ -181,9 +186,48 @@ bool SILInliner::inlineFunction(FullApplySite AI, ArrayRef<SILValue> Args) {
     visit(BI->first->getTerminator());
   }
 
+  scaleProfileCounts(CallCount,
+                     isa<TryApplyInst>(AI) ? nullptr : ReturnToBB);
   return true;
 }
 
+/// Returns \p Count * \p Numerator / \p Denominator, without overflowing.
+static uint64_t scaleCount(uint64_t Count, uint64_t Numerator,
+                           uint64_t Denominator) {
+  APInt Product = APInt(128, Count) * APInt(128, Numerator);
+  return Product.udiv(APInt(128, Denominator)).getLimitedValue();
+}
+
+void SILInliner::scaleProfileCounts(Optional<uint64_t> CallCount,
+                                    SILBasicBlock *ReturnToBB) {
+  if (!CallCount)
+    return;
+
+  // The code after the call ran as often as the call.
+  if (ReturnToBB)
+    ReturnToBB->setExecutionCount(*CallCount);
+
+  auto EntryCount = CalleeFunction->getEntryCount();
+  if (!EntryCount || *EntryCount == 0)
+    return;
+
+  // Each block of the callee ran for this call in proportion to how many of
+  // the callee's calls this one was.
+  uint64_t InlinedCount = std::min(*CallCount, *EntryCount);
+  for (auto &Mapping : BBMap) {
+    auto Count = Mapping.first->getExecutionCount();
+    if (Count && Mapping.first != CalleeEntryBB)
+      Mapping.second->setExecutionCount(scaleCount(*Count, InlinedCount,
+                                                   *EntryCount));
+  }
+
+  // The callee's counts now only cover the calls which remain.
+  for (SILBasicBlock &BB : *CalleeFunction)
+    if (auto Count = BB.getExecutionCount())
+      BB.setExecutionCount(*Count - scaleCount(*Count, InlinedCount,
+                                               *EntryCount));
+}
+
 void SILInliner::visitDebugValueInst(DebugValueInst *Inst) {
   // The mandatory inliner drops debug_value instructions when inlining, as if
   // it were a "nodebug" function in C.
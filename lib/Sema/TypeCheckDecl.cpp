@@ -40,10 +40,15 @@
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Twine.h"
 using namespace swift;
 
+#define DEBUG_TYPE "Decl validation"
+
+STATISTIC(NumValidatedDecls, "# of declarations validated");
+
 namespace {
 
 /// Used during enum raw value checking to identify duplicate raw values.
@@ -5682,6 +5687,9 @@ void TypeChecker::validateDecl(ValueDecl *D, bool resolveTypeParams) {
   if (hasEnabledForbiddenTypecheckPrefix())
     checkForForbiddenPrefix(D);
 
+  if (!D->hasType())
+    ++NumValidatedDecls;
+
   validateAccessibility(D);
 
   // Validate the context. We don't do this for generic parameters,
@@ -35,6 +35,7 @@
 #include "llvm/ADT/PointerUnion.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/ADT/Twine.h"
@@ -42,6 +43,11 @@
 
 using namespace swift;
 
+#define DEBUG_TYPE "Decl validation"
+
+STATISTIC(NumMembersValidatedOnDemand,
+          "# of members of used types left to be validated on demand");
+
 TypeChecker::TypeChecker(ASTContext &Ctx, DiagnosticEngine &Diags)
   : Context(Ctx), Diags(Diags)
 {
@@ -359,6 +365,29 @@ static void bindExtensionDecl(ExtensionDecl *ED, TypeChecker &TC) {
   extendedNominal->addExtension(ED);
 }
 
+/// Returns true if \p member of \p nominal, a type from another file, has to
+/// be validated before SIL lowers the type, because the layout of the type or
+/// the vtable of a class depends on it.
+static bool isNeededUpFront(NominalTypeDecl *nominal, ValueDecl *member) {
+  if (isa<EnumElementDecl>(member))
+    return true;
+  if (auto *var = dyn_cast<VarDecl>(member))
+    if (!var->isStatic() &&
+        (var->hasStorage() || var->getAttrs().hasAttribute<LazyAttr>()))
+      return true;
+  if (!isa<ClassDecl>(nominal) || isa<TypeDecl>(member))
+    return false;
+
+  // The vtables of subclasses in this file have an entry for every member of
+  // the class which can be overridden.
+  if (nominal->getAttrs().hasAttribute<FinalAttr>() ||
+      member->getAttrs().hasAttribute<FinalAttr>())
+    return false;
+  if (auto *func = dyn_cast<FuncDecl>(member))
+    return func->getStaticSpelling() != StaticSpellingKind::KeywordStatic;
+  return true;
+}
+
 static void typeCheckFunctionsAndExternalDecls(TypeChecker &TC) {
   unsigned currentFunctionIdx = 0;
   unsigned currentExternalDef = TC.Context.LastCheckedExternalDefinition;
@@ -411,10 +440,24 @@ static void typeCheckFunctionsAndExternalDecls(TypeChecker &TC) {
 
       Optional<bool> lazyVarsAlreadyHaveImplementation;
 
+      // The members of a type from a source file are type-checked with the
+      // file if it is being compiled. Otherwise only those its layout or
+      // vtable depends on are needed here; the others are validated when
+      // something refers to them. Every member of a protocol is a
+      // requirement with an entry in the witness tables, so protocols are
+      // validated completely.
+      bool onlyUpFront = TC.Context.LangOpts.LazyMemberValidation &&
+                         !isa<ProtocolDecl>(nominal) &&
+                         isa<SourceFile>(nominal->getModuleScopeContext());
+
       for (auto *D : nominal->getMembers()) {
         auto VD = dyn_cast<ValueDecl>(D);
         if (!VD)
           continue;
+        if (onlyUpFront && !isNeededUpFront(nominal, VD)) {
+          ++NumMembersValidatedOnDemand;
+          continue;
+        }
         TC.validateDecl(VD);
 
         // The only thing left to do is synthesize storage for lazy variables.
@@ -1066,6 +1066,24 @@ bool SILDeserializer::readSILInstruction(SILFunction *Fn, SILBasicBlock *BB,
                       getSILType(Ty, (SILValueCategory)TyCategory)), OnStack);
     break;
   }
+  case ValueKind::StrongRetainInst: {
+    auto Ty = MF->getType(TyID);
+    bool NonAtomic = (bool)Attr;
+    ResultVal = Builder.createStrongRetain(Loc,
+        getLocalValue(ValID, ValResNum,
+                      getSILType(Ty, (SILValueCategory)TyCategory)),
+        NonAtomic);
+    break;
+  }
+  case ValueKind::StrongReleaseInst: {
+    auto Ty = MF->getType(TyID);
+    bool NonAtomic = (bool)Attr;
+    ResultVal = Builder.createStrongRelease(Loc,
+        getLocalValue(ValID, ValResNum,
+                      getSILType(Ty, (SILValueCategory)TyCategory)),
+        NonAtomic);
+    break;
+  }
   case ValueKind::DeallocPartialRefInst: {
     auto Ty = MF->getType(TyID);
     auto Ty2 = MF->getType(TyID2);
@@ -1193,8 +1211,6 @@ bool SILDeserializer::readSILInstruction(SILFunction *Fn, SILBasicBlock *BB,
   UNARY_INSTRUCTION(CopyBlock)
   UNARY_INSTRUCTION(StrongPin)
   UNARY_INSTRUCTION(StrongUnpin)
-  UNARY_INSTRUCTION(StrongRetain)
-  UNARY_INSTRUCTION(StrongRelease)
   UNARY_INSTRUCTION(StrongRetainAutoreleased)
   UNARY_INSTRUCTION(AutoreleaseReturn)
   UNARY_INSTRUCTION(StrongRetainUnowned)
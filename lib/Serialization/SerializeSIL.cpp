@@ -916,6 +916,10 @@ void SILSerializer::writeSILInstruction(const SILInstruction &SI) {
       Attr = (unsigned)MUI->getKind();
     else if (auto *DRI = dyn_cast<DeallocRefInst>(&SI))
       Attr = (unsigned)DRI->canAllocOnStack();
+    else if (auto *SRI = dyn_cast<StrongRetainInst>(&SI))
+      Attr = (unsigned)SRI->isNonAtomic();
+    else if (auto *SRI = dyn_cast<StrongReleaseInst>(&SI))
+      Attr = (unsigned)SRI->isNonAtomic();
     writeOneOperandLayout(SI.getKind(), Attr, SI.getOperand(0));
     break;
   }
@@ -90,6 +90,12 @@ class StrongRefCount {
     refCount = RC_ONE;
   }
 
+  // Initialize the shared count of an object whose initial reference is
+  // counted by its owning thread. See BiasedRefCount.
+  void initShared() {
+    refCount = 0;
+  }
+
   // Increment the reference count.
   void increment() {
     __atomic_fetch_add(&refCount, RC_ONE, __ATOMIC_RELAXED);
@@ -100,6 +106,13 @@ class StrongRefCount {
     __atomic_fetch_add(&refCount, n << RC_FLAGS_COUNT, __ATOMIC_RELAXED);
   }
 
+  // Increment the reference count by n without an atomic read-modify-write.
+  // Only valid if no other thread can access the object.
+  void incrementNonAtomic(uint32_t n) {
+    uint32_t val = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    __atomic_store_n(&refCount, val + (n << RC_FLAGS_COUNT), __ATOMIC_RELAXED);
+  }
+
   // Try to simultaneously set the pinned flag and increment the
   // reference count.  If the flag is already set, don't increment the
   // reference count.
@@ -158,6 +171,26 @@ class StrongRefCount {
     return doDecrementShouldDeallocateN<false>(n);
   }
 
+  // Decrement the reference count by n without an atomic read-modify-write.
+  // Return true if the caller should now deallocate the object.
+  // Only valid if no other thread can access the object.
+  bool decrementShouldDeallocateNonAtomic(uint32_t n) {
+    uint32_t delta = n << RC_FLAGS_COUNT;
+    uint32_t oldval = __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+    assert(oldval >= delta && "releasing reference with a refcount of zero");
+    uint32_t newval = oldval - delta;
+
+    // See doDecrementShouldDeallocate. Nobody else can observe the object,
+    // so there is no need to race for the deallocating flag.
+    if ((newval & (RC_COUNT_MASK | RC_PINNED_FLAG | RC_DEALLOCATING_FLAG))
+          != 0) {
+      __atomic_store_n(&refCount, newval, __ATOMIC_RELAXED);
+      return false;
+    }
+    __atomic_store_n(&refCount, RC_DEALLOCATING_FLAG, __ATOMIC_RELAXED);
+    return true;
+  }
+
   // Return the reference count.
   // During deallocation the reference count is undefined.
   uint32_t getCount() const {
@@ -192,6 +225,52 @@ class StrongRefCount {
     return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_DEALLOCATING_FLAG;
   }
 
+  // Biased reference counting.
+  //
+  // For an object that has a BiasedRefCount, this count only holds the
+  // references taken by threads other than the owner. It goes negative when
+  // such a thread releases a reference the owner retained, so the operations
+  // below treat the count as signed, and they are sequentially consistent
+  // because they synchronize with the flags in BiasedRefCount.
+
+  // Decrement the shared count by n, optionally clearing the pinned flag.
+  // Return the resulting signed count; a pinned or deallocating object
+  // reports a positive count.
+  int32_t decrementShared(uint32_t n, bool clearPinnedFlag) {
+    uint32_t delta =
+      (n << RC_FLAGS_COUNT) + (clearPinnedFlag ? RC_PINNED_FLAG : 0);
+    uint32_t newval = __atomic_sub_fetch(&refCount, delta, __ATOMIC_SEQ_CST);
+    if (newval & (RC_PINNED_FLAG | RC_DEALLOCATING_FLAG))
+      return 1;
+    return (int32_t)newval >> RC_FLAGS_COUNT;
+  }
+
+  // Add a signed biased count into the shared count.
+  void addShared(int32_t n) {
+    __atomic_add_fetch(&refCount, (uint32_t)n << RC_FLAGS_COUNT,
+                       __ATOMIC_SEQ_CST);
+  }
+
+  // Return the shared count, which may be negative.
+  int32_t getSharedCount() const {
+    return (int32_t)__atomic_load_n(&refCount, __ATOMIC_SEQ_CST)
+      >> RC_FLAGS_COUNT;
+  }
+
+  // Return whether the pinned flag is set.
+  bool isPinned() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_PINNED_FLAG;
+  }
+
+  // If the shared count is zero and no flags are set, set the deallocating
+  // flag. Return true if the caller should now deallocate the object.
+  bool trySetDeallocating() {
+    uint32_t oldval = 0;
+    uint32_t newval = RC_DEALLOCATING_FLAG;
+    return __atomic_compare_exchange(&refCount, &oldval, &newval, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+  }
+
 private:
   template <bool ClearPinnedFlag>
   bool doDecrementShouldDeallocate() {
@@ -274,13 +353,23 @@ class WeakRefCount {
   uint32_t refCount;
 
   enum : uint32_t {
-    // There isn't really a flag here.
+    // Set for objects allocated with a BiasedRefCount in front of them.
+    // Without biased reference counting there isn't really a flag here.
     // Making weak RC_ONE == strong RC_ONE saves an
     // instruction in allocation on arm64.
-    RC_UNUSED_FLAG = 1,
+    RC_BIASED_FLAG = 1,
+
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+    // Set once weak references to the object go through a side-table
+    // entry.
+    RC_WEAK_SIDE_TABLE_FLAG = 2,
 
+    RC_FLAGS_COUNT = 2,
+    RC_FLAGS_MASK = 3,
+#else
     RC_FLAGS_COUNT = 1,
     RC_FLAGS_MASK = 1,
+#endif
     RC_COUNT_MASK = ~RC_FLAGS_MASK,
 
     RC_ONE = RC_FLAGS_MASK + 1
@@ -313,6 +402,31 @@ class WeakRefCount {
     refCount = RC_ONE + RC_ONE;
   }
 
+  /// Initialize for an object that is preceded by a BiasedRefCount.
+  void initWithBiasedRefCount() {
+    refCount = RC_ONE | RC_BIASED_FLAG;
+  }
+
+  /// Return whether the object is preceded by a BiasedRefCount. The flag
+  /// never changes after initialization.
+  bool hasBiasedRefCount() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED) & RC_BIASED_FLAG;
+  }
+
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+  /// Record that the object has a weak reference side-table entry. The flag
+  /// is never cleared.
+  void setHasWeakSideTable() {
+    __atomic_fetch_or(&refCount, RC_WEAK_SIDE_TABLE_FLAG, __ATOMIC_RELAXED);
+  }
+
+  /// Return whether the object has a weak reference side-table entry.
+  bool hasWeakSideTable() const {
+    return __atomic_load_n(&refCount, __ATOMIC_RELAXED)
+      & RC_WEAK_SIDE_TABLE_FLAG;
+  }
+#endif
+
   // Increment the weak reference count.
   void increment() {
     uint32_t newval = __atomic_add_fetch(&refCount, RC_ONE, __ATOMIC_RELAXED);
@@ -356,6 +470,134 @@ class WeakRefCount {
   }
 };
 
+
+// Biased reference count.
+//
+// With SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT, swift_allocObject places a
+// BiasedRefCount immediately before the object and records the allocating
+// thread as its owner. The owner counts its references in Count with plain
+// loads and stores; other threads use the object's StrongRefCount, which then
+// holds the "shared" count. The object is dead once the owner has merged its
+// count into the shared count (because it dropped to zero, or because another
+// thread asked it to) and the shared count drops to zero.
+
+class BiasedRefCount {
+  // MERGED_FLAG and QUEUED_FLAG. Updated atomically by any thread.
+  uint32_t State;
+  uint32_t Reserved;
+
+  // The owning thread's index, or 0 if the object was never biased.
+  // Never changes after initialization.
+  uint32_t Owner;
+
+  // The owner's references. Only the owner writes this, so it is updated
+  // with relaxed loads and stores rather than read-modify-write operations.
+  // COUNT_MERGED once the count has been merged into the shared count.
+  uint32_t Count;
+
+  enum : uint32_t {
+    // The biased count has been merged into the shared count.
+    MERGED_FLAG = 0x1,
+
+    // A non-owner drove the shared count negative and queued the object for
+    // its owner to merge. Only the owner's merge may deallocate it.
+    QUEUED_FLAG = 0x2,
+
+    COUNT_MERGED = 0x80000000
+  };
+
+ public:
+  BiasedRefCount() = default;
+
+  // An owner of 0 produces an object that uses the shared count only.
+  void init(uint32_t owner) {
+    State = owner ? 0 : MERGED_FLAG;
+    Reserved = 0;
+    Owner = owner;
+    Count = owner ? 1 : COUNT_MERGED;
+  }
+
+  uint32_t getOwner() const {
+    return __atomic_load_n(&Owner, __ATOMIC_RELAXED);
+  }
+
+  // Return whether the thread with the given index may use the biased count.
+  // Count is only read once Owner matches, i.e. by the owner itself.
+  bool isOwnedBy(uint32_t thread) const {
+    return getOwner() == thread &&
+           !(__atomic_load_n(&Count, __ATOMIC_RELAXED) & COUNT_MERGED);
+  }
+
+  // Owner only.
+  void increment(uint32_t n) {
+    uint32_t count = __atomic_load_n(&Count, __ATOMIC_RELAXED);
+    assert(count + n < COUNT_MERGED && "biased refcount overflow");
+    __atomic_store_n(&Count, count + n, __ATOMIC_RELAXED);
+  }
+
+  // Owner only. Decrement the count by n and return the result. If it is not
+  // positive, the count is left unchanged and the caller must merge.
+  int32_t decrement(uint32_t n) {
+    int32_t count = (int32_t)__atomic_load_n(&Count, __ATOMIC_RELAXED) - n;
+    if (count > 0)
+      __atomic_store_n(&Count, (uint32_t)count, __ATOMIC_RELAXED);
+    return count;
+  }
+
+  // Owner only. Stop using the biased count and return its value, which the
+  // caller must add to the shared count before calling setMerged().
+  int32_t takeForMerge() {
+    int32_t count = (int32_t)__atomic_load_n(&Count, __ATOMIC_RELAXED);
+    __atomic_store_n(&Count, COUNT_MERGED, __ATOMIC_RELAXED);
+    return count;
+  }
+
+  // Owner only, after takeForMerge(). Return true if the object had been
+  // queued, in which case the queue's owner decides whether to deallocate.
+  bool setMerged() {
+    uint32_t oldState =
+      __atomic_fetch_or(&State, MERGED_FLAG, __ATOMIC_SEQ_CST);
+    return oldState & QUEUED_FLAG;
+  }
+
+  // Owner only, while draining its queue. Mark the object merged and no
+  // longer queued.
+  void setMergedAndDequeued() {
+    __atomic_store_n(&State, MERGED_FLAG, __ATOMIC_SEQ_CST);
+  }
+
+  // Return whether the biased count has been merged, after which the shared
+  // count holds every reference to the object.
+  bool isMerged() const {
+    return __atomic_load_n(&State, __ATOMIC_SEQ_CST) & MERGED_FLAG;
+  }
+
+  // Return whether a thread that dropped the shared count to zero may
+  // deallocate the object.
+  bool isMergedAndNotQueued() const {
+    return __atomic_load_n(&State, __ATOMIC_SEQ_CST) == MERGED_FLAG;
+  }
+
+  // Called by a non-owner that drove the shared count negative. Return true
+  // if the caller must queue the object for its owner to merge.
+  bool tryMarkQueued() {
+    uint32_t oldState = __atomic_load_n(&State, __ATOMIC_SEQ_CST);
+    while (!(oldState & (MERGED_FLAG | QUEUED_FLAG))) {
+      uint32_t newState = oldState | QUEUED_FLAG;
+      if (__atomic_compare_exchange(&State, &oldState, &newState, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        return true;
+    }
+    return false;
+  }
+
+  // Return the biased count. Racy unless called by the owner.
+  uint32_t getCount() const {
+    uint32_t count = __atomic_load_n(&Count, __ATOMIC_RELAXED);
+    return (count & COUNT_MERGED) ? 0 : count;
+  }
+};
+
 static_assert(swift::IsTriviallyConstructible<StrongRefCount>::value,
               "StrongRefCount must be trivially initializable");
 static_assert(swift::IsTriviallyConstructible<WeakRefCount>::value,
@@ -364,6 +606,8 @@ static_assert(std::is_trivially_destructible<StrongRefCount>::value,
               "StrongRefCount must be trivially destructible");
 static_assert(std::is_trivially_destructible<WeakRefCount>::value,
               "WeakRefCount must be trivially destructible");
+static_assert(sizeof(BiasedRefCount) == 16,
+              "BiasedRefCount must preserve 16-byte alignment");
 
 // __cplusplus
 #endif
@@ -18,17 +18,16 @@
 #include "swift/Basic/Demangle.h"
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/Lazy.h"
-#include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Config.h"
 #include "swift/Runtime/Enum.h"
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/PointerIntPair.h"
 #include "swift/Runtime/Debug.h"
 #include "ErrorObject.h"
 #include "ExistentialMetadataImpl.h"
+#include "MetadataCache.h"
 #include "Private.h"
+#include "RuntimeStats.h"
 #include "../SwiftShims/RuntimeShims.h"
 #include "stddef.h"
 
@@ -351,47 +350,54 @@ std::string swift::nameForMetadata(const Metadata *type,
   return result;
 }
 
+namespace {
+  /// An entry in the type name cache, keyed on the type and whether the name
+  /// is qualified. The NUL-terminated name is stored inline after the entry,
+  /// so the cache's allocator doubles as the arena for demangled names.
+  class TypeNameCacheEntry : public CacheEntry<TypeNameCacheEntry> {
+    size_t Length;
+
+  public:
+    static const char *getName() { return "TypeNameCache"; }
+
+    TypeNameCacheEntry(size_t numArguments) : Length(0) {
+      assert(numArguments == 2);
+    }
+
+    static constexpr size_t getNumArguments() {
+      return 2;
+    }
+
+    size_t getLength() const { return Length; }
+    void setLength(size_t length) { Length = length; }
+  };
+}
+
+static Lazy<MetadataCache<TypeNameCacheEntry>> TypeNameCache;
+
 extern "C"
 TwoWordPair<const char *, uintptr_t>::Return
 swift_getTypeName(const Metadata *type, bool qualified) {
   using Pair = TwoWordPair<const char *, uintptr_t>;
-  using Key = llvm::PointerIntPair<const Metadata *, 1, bool>;
-  
-  static pthread_rwlock_t TypeNameCacheLock = PTHREAD_RWLOCK_INITIALIZER;
-  static Lazy<llvm::DenseMap<Key, std::pair<const char *, size_t>>>
-    TypeNameCache;
-  
-  Key key(type, qualified);
+
+  // Once a name has been built, looking it up again is a lock-free probe.
+  const void *args[] = { type, (const void *)(uintptr_t)qualified };
   auto &cache = TypeNameCache.get();
-  
-  pthread_rwlock_rdlock(&TypeNameCacheLock);
-  auto found = cache.find(key);
-  if (found != cache.end()) {
-    auto result = found->second;
-    pthread_rwlock_unlock(&TypeNameCacheLock);
-    return Pair{result.first, result.second};
-  }
-  
-  pthread_rwlock_unlock(&TypeNameCacheLock);
-  pthread_rwlock_wrlock(&TypeNameCacheLock);
-  // Someone may have beaten us to the write lock.
-  found = cache.find(key);
-  if (found != cache.end()) {
-    auto result = found->second;
-    pthread_rwlock_unlock(&TypeNameCacheLock);
-    return Pair{result.first, result.second};
-  }
-  
-  // Build the metadata name.
-  auto name = nameForMetadata(type, qualified);
-  // Copy it to memory we can reference forever.
-  auto size = name.size();
-  auto result = (char*)malloc(size + 1);
-  memcpy(result, name.data(), size);
-  result[size] = 0;
-  cache.insert({key, {result, size}});
-  pthread_rwlock_unlock(&TypeNameCacheLock);
-  return Pair{result, size};
+  auto entry = cache.findOrAdd(args, 2, [&]() -> TypeNameCacheEntry* {
+    // Build the metadata name.
+    auto name = nameForMetadata(type, qualified);
+    // Copy it to memory we can reference forever.
+    auto size = name.size();
+    auto entry = TypeNameCacheEntry::allocate(cache.getAllocator(),
+                                              args, 2, size + 1);
+    auto result = entry->getData<char>();
+    memcpy(result, name.data(), size);
+    result[size] = 0;
+    entry->setLength(size);
+    return entry;
+  });
+
+  return Pair{entry->getData<char>(), entry->getLength()};
 }
 
 /// Report a dynamic cast failure.
@@ -505,6 +511,7 @@ _dynamicCastClassMetatype(const ClassMetadata *sourceType,
 const void *
 swift::swift_dynamicCastClass(const void *object,
                               const ClassMetadata *targetType) {
+  SWIFT_STATS_COUNT(DynamicCastClass);
 #if SWIFT_OBJC_INTEROP
   assert(!targetType->isPureObjC());
 
@@ -1177,6 +1184,7 @@ swift::swift_dynamicCastUnknownClassUnconditional(const void *object,
 const Metadata *
 swift::swift_dynamicCastMetatype(const Metadata *sourceType,
                                  const Metadata *targetType) {
+  SWIFT_STATS_COUNT(DynamicCastMetatypeObject);
   auto origSourceType = sourceType;
 
   switch (targetType->getKind()) {
@@ -1970,12 +1978,39 @@ static id dynamicCastValueToNSError(OpaqueValue *src,
 }
 #endif
 
+#if SWIFT_RUNTIME_ENABLE_STATS
+/// Count a dynamic cast by the kind of its target type.
+static void countDynamicCast(const Metadata *targetType) {
+  switch (targetType->getKind()) {
+  case MetadataKind::Class:
+  case MetadataKind::ObjCClassWrapper:
+  case MetadataKind::ForeignClass:
+    SWIFT_STATS_COUNT(DynamicCastToClass);
+    return;
+  case MetadataKind::Existential:
+    SWIFT_STATS_COUNT(DynamicCastToExistential);
+    return;
+  case MetadataKind::Metatype:
+  case MetadataKind::ExistentialMetatype:
+    SWIFT_STATS_COUNT(DynamicCastToMetatype);
+    return;
+  default:
+    SWIFT_STATS_COUNT(DynamicCastToValue);
+    return;
+  }
+}
+#endif
+
 /// Perform a dynamic cast to an arbitrary type.
 bool swift::swift_dynamicCast(OpaqueValue *dest,
                               OpaqueValue *src,
                               const Metadata *srcType,
                               const Metadata *targetType,
                               DynamicCastFlags flags) {
+#if SWIFT_RUNTIME_ENABLE_STATS
+  countDynamicCast(targetType);
+#endif
+
   switch (targetType->getKind()) {
 
   // Casts to class type.
@@ -2237,129 +2272,243 @@ const {
 static std::once_flag InstallProtocolConformanceAddImageCallbackOnce;
 
 namespace {
-  struct ConformanceSection {
-    const ProtocolConformanceRecord *Begin, *End;
-    const ProtocolConformanceRecord *begin() const {
-      return Begin;
+  /// An entry in the conformance index, keyed on a (type, protocol) pair.
+  ///
+  /// The type is a type metadata, a class object or a generic pattern,
+  /// depending on how the conformance record refers to the conforming type;
+  /// see getConformanceIndexKey.
+  class ConformanceIndexEntry : public CacheEntry<ConformanceIndexEntry> {
+    /// The conformance record that provides the witness table.
+    const ProtocolConformanceRecord *Record;
+
+    /// The resolved witness table, or null if it has not been resolved yet.
+    mutable std::atomic<const WitnessTable *> Witness;
+
+  public:
+    static const char *getName() { return "ConformanceIndex"; }
+
+    ConformanceIndexEntry(size_t numArguments)
+      : Record(nullptr), Witness(nullptr) {
+      assert(numArguments == 2);
     }
-    const ProtocolConformanceRecord *end() const {
-      return End;
+
+    static constexpr size_t getNumArguments() {
+      return 2;
     }
-  };
 
-  struct ConformanceCacheEntry {
-  private:
-    const void *Type; 
-    const ProtocolDescriptor *Proto;
-    uintptr_t Data;
-    // All Darwin 64-bit platforms reserve the low 2^32 of address space, which
-    // is more than enough invalid pointer values for any realistic generation
-    // number. It's a little easier to overflow on 32-bit, so we need an extra
-    // bit there.
-#if !__LP64__
-    bool Success;
-#endif
+    void setRecord(const ProtocolConformanceRecord *record) {
+      Record = record;
+    }
 
-    ConformanceCacheEntry(const void *type,
-                          const ProtocolDescriptor *proto,
-                          uintptr_t Data, bool Success)
-      : Type(type), Proto(proto), Data(Data)
-#if !__LP64__
-        , Success(Success)
-#endif
-    {
-#if __LP64__
-#  if __APPLE__
-      assert((!Success && Data <= 0xFFFFFFFFU) ||
-             (Success && Data > 0xFFFFFFFFU));
-#  elif __linux__
-      assert((!Success && Data <= 0x0FFFU) ||
-             (Success && Data > 0x0FFFU));
-#  else
-#    error "port me"
-#  endif
-#endif
-  }
+    void setWitnessTable(const WitnessTable *witness) {
+      Witness.store(witness, std::memory_order_release);
+    }
+
+    /// Get the witness table for the conformance, calling the record's
+    /// accessor the first time if it has one. Returns null if the accessor
+    /// says the type does not conform after all.
+    const WitnessTable *getWitnessTable() const {
+      if (auto witness = Witness.load(std::memory_order_acquire))
+        return witness;
+
+      // Racing threads resolve the same witness table, so there is no need
+      // to synchronize beyond the atomic store.
+      auto witness = Record->getWitnessTable(Record->getCanonicalTypeMetadata());
+      if (witness)
+        Witness.store(witness, std::memory_order_release);
+      return witness;
+    }
+  };
+
+  /// A (type, protocol) pair that was found not to conform, keyed like the
+  /// conformance index.
+  class ConformanceFailureEntry : public CacheEntry<ConformanceFailureEntry> {
+    /// The registration generation at which the failure was seen. The
+    /// failure is stale once another image has been registered.
+    mutable std::atomic<size_t> Generation;
 
   public:
-    ConformanceCacheEntry() = default;
-
-    static ConformanceCacheEntry createSuccess(
-        const void *type, const ProtocolDescriptor *proto,
-        const swift::WitnessTable *witness) {
-      return ConformanceCacheEntry(type, proto, (uintptr_t) witness, true);
-    }
-
-    static ConformanceCacheEntry createFailure(
-        const void *type, const ProtocolDescriptor *proto,
-        unsigned failureGeneration) {
-      return ConformanceCacheEntry(type, proto, (uintptr_t) failureGeneration,
-          false);
-    }
-
-    /// \returns true if the entry represents an entry for the pair \p type
-    /// and \p proto.
-    bool matches(const void *type, const ProtocolDescriptor *proto) {
-      return type == Type && Proto == proto;
-    }
-   
-    bool isSuccessful() const {
-#if __LP64__
-#  if __APPLE__
-      return Data > 0xFFFFFFFFU;
-#  elif __linux__
-      return Data > 0x0FFFU;
-#  else
-#    error "port me"
-#  endif
-#else
-      return Success;
-#endif
+    static const char *getName() { return "ConformanceFailure"; }
+
+    ConformanceFailureEntry(size_t numArguments) : Generation(0) {
+      assert(numArguments == 2);
     }
-    
-    /// Get the cached witness table, if successful.
-    const WitnessTable *getWitnessTable() const {
-      assert(isSuccessful());
-      return (const WitnessTable *)Data;
+
+    static constexpr size_t getNumArguments() {
+      return 2;
     }
-    
-    /// Get the generation number under which this lookup failed.
-    unsigned getFailureGeneration() const {
-      assert(!isSuccessful());
-      return Data;
+
+    size_t getGeneration() const {
+      return Generation.load(std::memory_order_acquire);
+    }
+
+    void setGeneration(size_t generation) const {
+      Generation.store(generation, std::memory_order_release);
     }
   };
 }
 
 // Conformance Cache.
 
+/// The conformance index maps (type, protocol) pairs to the conformance
+/// records that apply to them. Records are added to the index as the images
+/// containing them are registered, and loading an image only ever adds to
+/// the index, so lookups never need to rescan records or take a lock.
+///
+/// Records whose key can only be found by instantiating foreign metadata or
+/// by reading an indirect class reference are not indexed in the image-load
+/// callback, but by the first lookup that misses after their image was
+/// registered.
+///
+/// The index also memoizes conformances that were found through a
+/// superclass or a generic pattern, so that repeated queries for the same
+/// type are a single probe. Failed queries are memoized separately, together
+/// with the registration generation they were made at.
 struct ConformanceState {
-  ConcurrentMap<size_t, ConformanceCacheEntry> Cache;
-  std::vector<ConformanceSection> SectionsToScan;
-  pthread_mutex_t SectionsToScanLock;
-  
-  ConformanceState() {
-    SectionsToScan.reserve(16);
-    pthread_mutex_init(&SectionsToScanLock, nullptr);
-  }
+  MetadataCache<ConformanceIndexEntry> Index;
+  MetadataCache<ConformanceFailureEntry> Failures;
+
+  /// The number of images registered so far.
+  std::atomic<size_t> Generation{0};
+
+  /// Records waiting to be indexed, guarded by PendingLock.
+  std::vector<const ProtocolConformanceRecord *> Pending;
+  std::mutex PendingLock;
+  std::atomic<bool> HasPending{false};
 };
 
 static Lazy<ConformanceState> Conformances;
 
-// This variable is used to signal when a cache was generated and
-// it is correct to avoid a new scan.
-static unsigned ConformanceCacheGeneration = 0;
+/// Get the key under which conformances of the given type are indexed.
+/// Classes are indexed by their class object, so that Objective-C classes
+/// don't need a metadata wrapper to be instantiated to index them.
+static const void *getConformanceIndexKey(const Metadata *type) {
+  if (auto classObject = type->getClassObject())
+    return classObject;
+  return type;
+}
+
+/// Get the key under which the given record is indexed, or null if the
+/// record should not be indexed.
+static const void *
+getConformanceIndexKey(const ProtocolConformanceRecord &record) {
+  switch (record.getTypeKind()) {
+  case ProtocolConformanceTypeKind::UniqueDirectType:
+    return getConformanceIndexKey(record.getDirectType());
+
+  case ProtocolConformanceTypeKind::NonuniqueDirectType:
+    return getConformanceIndexKey(record.getCanonicalTypeMetadata());
+
+  case ProtocolConformanceTypeKind::UniqueDirectClass:
+    return record.getDirectClass();
+
+  case ProtocolConformanceTypeKind::UniqueIndirectClass:
+    // The class may be weak-linked, in which case it has no conformances.
+    return *record.getIndirectClass();
+
+  case ProtocolConformanceTypeKind::UniqueGenericPattern:
+    // Only nondependent witness tables can be shared by all instances of
+    // a generic type.
+    // TODO: "Nondependent witness table" probably deserves its own flag.
+    // An accessor function might still be necessary even if the witness table
+    // can be shared.
+    if (record.getConformanceKind()
+          != ProtocolConformanceReferenceKind::WitnessTable)
+      return nullptr;
+    return record.getGenericPattern();
+
+  case ProtocolConformanceTypeKind::Universal:
+    // The record does not apply to a single type.
+    return nullptr;
+  }
+  crash("invalid protocol conformance type kind");
+}
+
+/// Does finding the key of the record instantiate metadata or read through
+/// an indirect reference? Such records are indexed at lookup time rather
+/// than in the image-load callback.
+static bool isConformanceIndexKeyDeferred(
+                                     const ProtocolConformanceRecord &record) {
+  switch (record.getTypeKind()) {
+  case ProtocolConformanceTypeKind::NonuniqueDirectType:
+  case ProtocolConformanceTypeKind::UniqueIndirectClass:
+    return true;
+  case ProtocolConformanceTypeKind::UniqueDirectType:
+  case ProtocolConformanceTypeKind::UniqueDirectClass:
+  case ProtocolConformanceTypeKind::UniqueGenericPattern:
+  case ProtocolConformanceTypeKind::Universal:
+    return false;
+  }
+  crash("invalid protocol conformance type kind");
+}
+
+/// Add the given records to the conformance index, taking the index lock
+/// only once.
+static void
+indexConformances(ConformanceState &C,
+                  ArrayRef<const ProtocolConformanceRecord *> records) {
+  std::vector<const void *> keys;
+  std::vector<const ProtocolConformanceRecord *> indexed;
+  keys.reserve(records.size() * 2);
+  indexed.reserve(records.size());
+  for (auto record : records) {
+    auto key = getConformanceIndexKey(*record);
+    if (!key)
+      continue;
+    keys.push_back(key);
+    keys.push_back(record->getProtocol());
+    indexed.push_back(record);
+  }
+
+  // If several records describe the same conformance, the first one to be
+  // registered wins.
+  C.Index.addEntries(keys.data(), indexed.size(), 2,
+                     [&](size_t i) -> ConformanceIndexEntry* {
+    auto entry = ConformanceIndexEntry::allocate(C.Index.getAllocator(),
+                                                 &keys[i * 2], 2, 0);
+    entry->setRecord(indexed[i]);
+    return entry;
+  });
+}
+
+/// Index the records whose indexing was deferred until a lookup.
+static void indexPendingConformances(ConformanceState &C) {
+  if (LLVM_LIKELY(!C.HasPending.load(std::memory_order_acquire)))
+    return;
+
+  // Hold the lock until the records are in the index, so that no lookup
+  // can miss them in between.
+  std::lock_guard<std::mutex> guard(C.PendingLock);
+  if (C.Pending.empty())
+    return;
+  indexConformances(C, C.Pending);
+  C.Pending.clear();
+  C.HasPending.store(false, std::memory_order_release);
+}
 
 void
 swift::swift_registerProtocolConformances(const ProtocolConformanceRecord *begin,
                                           const ProtocolConformanceRecord *end){
   auto &C = Conformances.get();
 
-  pthread_mutex_lock(&C.SectionsToScanLock);
+  std::vector<const ProtocolConformanceRecord *> records;
+  std::vector<const ProtocolConformanceRecord *> deferred;
+  for (auto record = begin; record != end; ++record) {
+    if (isConformanceIndexKeyDeferred(*record))
+      deferred.push_back(record);
+    else
+      records.push_back(record);
+  }
 
-  C.SectionsToScan.push_back(ConformanceSection{begin, end});
+  indexConformances(C, records);
+  if (!deferred.empty()) {
+    std::lock_guard<std::mutex> guard(C.PendingLock);
+    C.Pending.insert(C.Pending.end(), deferred.begin(), deferred.end());
+    C.HasPending.store(true, std::memory_order_release);
+  }
 
-  pthread_mutex_unlock(&C.SectionsToScanLock);
+  // Memoized failures from before this image are stale now.
+  C.Generation.fetch_add(1, std::memory_order_release);
 }
 
 static void _addImageProtocolConformancesBlock(const uint8_t *conformances,
@@ -2448,101 +2597,25 @@ static void installCallbacksToInspectDylib() {
   SWIFT_ONCE_F(token, callback, nullptr);
 }
 
-static size_t hashTypeProtocolPair(const void *type,
-                                   const ProtocolDescriptor *protocol) {
-  // A simple hash function for the conformance pair.
-  return (size_t)type + ((size_t)protocol >> 2);
-}
-
-/// Search the witness table in the ConformanceCache. \returns a pair of the
-/// WitnessTable pointer and a boolean value True if a definitive value is
-/// found. \returns false if the type or its superclasses were not found in
-/// the cache.
-static
-std::pair<const WitnessTable *, bool>
-searchInConformanceCache(const Metadata *type,
-                         const ProtocolDescriptor *protocol,
-                         ConformanceCacheEntry *&foundEntry) {
+/// Search the conformance index for the type itself, its generic pattern and
+/// its superclasses, in that order.
+static const ConformanceIndexEntry *
+searchConformanceIndex(const Metadata *type,
+                       const ProtocolDescriptor *protocol) {
   auto &C = Conformances.get();
-  auto origType = type;
-
-  foundEntry = nullptr;
-
-recur_inside_cache_lock:
-
-  // See if we have a cached conformance. Try the specific type first.
-
-  // Hash and lookup the type-protocol pair in the cache.
-  size_t hash = hashTypeProtocolPair(type, protocol);
-  ConcurrentList<ConformanceCacheEntry> &Bucket =
-    C.Cache.findOrAllocateNode(hash);
-
-  // Check if the type-protocol entry exists in the cache entry that we found.
-  for (auto &Entry : Bucket) {
-    if (!Entry.matches(type, protocol)) continue;
-
-    if (Entry.isSuccessful()) {
-      return std::make_pair(Entry.getWitnessTable(), true);
-    }
-
-    if (type == origType)
-      foundEntry = &Entry;
-
-    // If we got a cached negative response, check the generation number.
-    if (Entry.getFailureGeneration() == C.SectionsToScan.size()) {
-      // We found an entry with a negative value.
-      return std::make_pair(nullptr, true);
-    }
-  }
-
-  // If the type is generic, see if there's a shared nondependent witness table
-  // for its instances.
-  if (auto generic = type->getGenericPattern()) {
-    // Hash and lookup the type-protocol pair in the cache.
-    size_t hash = hashTypeProtocolPair(generic, protocol);
-    ConcurrentList<ConformanceCacheEntry> &Bucket =
-      C.Cache.findOrAllocateNode(hash);
-
-    for (auto &Entry : Bucket) {
-      if (!Entry.matches(generic, protocol)) continue;
-      if (Entry.isSuccessful()) {
-        return std::make_pair(Entry.getWitnessTable(), true);
-      }
-      // We don't try to cache negative responses for generic
-      // patterns.
-    }
-  }
-
-  // If the type is a class, try its superclass.
-  if (const ClassMetadata *classType = type->getClassObject()) {
-    if (auto super = classType->SuperClass) {
-      if (super != getRootSuperclass()) {
-        type = swift_getObjCClassMetadata(super);
-        goto recur_inside_cache_lock;
-      }
-    }
-  }
-
-  // We did not find an entry.
-  return std::make_pair(nullptr, false);
-}
-
-/// Checks if a given candidate is a type itself, one of its
-/// superclasses or a related generic type.
-/// This check is supposed to use the same logic that is used
-/// by searchInConformanceCache.
-static
-bool isRelatedType(const Metadata *type, const void *candidate) {
 
   while (true) {
-    if (type == candidate)
-      return true;
+    // Try the specific type first.
+    const void *args[] = { getConformanceIndexKey(type), protocol };
+    if (auto entry = C.Index.find(args, 2))
+      return entry;
 
-    // If the type is generic, see if there's a shared nondependent witness table
-    // for its instances.
+    // If the type is generic, see if there's a shared nondependent witness
+    // table for its instances.
     if (auto generic = type->getGenericPattern()) {
-      if (generic == candidate)
-        return true;
+      const void *args[] = { generic, protocol };
+      if (auto entry = C.Index.find(args, 2))
+        return entry;
     }
 
     // If the type is a class, try its superclass.
@@ -2550,145 +2623,72 @@ bool isRelatedType(const Metadata *type, const void *candidate) {
       if (auto super = classType->SuperClass) {
         if (super != getRootSuperclass()) {
           type = swift_getObjCClassMetadata(super);
-          if (type == candidate)
-            return true;
           continue;
         }
       }
     }
 
-    break;
+    // We did not find an entry.
+    return nullptr;
   }
-
-  return false;
 }
 
 const WitnessTable *
 swift::swift_conformsToProtocol(const Metadata *type,
                                 const ProtocolDescriptor *protocol) {
   auto &C = Conformances.get();
-  
+
   // Install callbacks for tracking when a new dylib is loaded so we can
-  // scan it.
+  // index it.
   installCallbacksToInspectDylib();
-  auto origType = type;
-  
-  unsigned numSections = 0;
-
-  ConformanceCacheEntry *foundEntry;
-
-recur:
-  // See if we have a cached conformance. The ConcurrentMap data structure
-  // allows us to insert and search the map concurrently without locking.
-  // We do lock the slow path because the SectionsToScan data structure is not
-  // concurrent.
-  auto FoundConformance = searchInConformanceCache(type, protocol, foundEntry);
-  // The negative answer does not always mean that there is no conformance,
-  // unless it is an exact match on the type. If it is not an exact match,
-  // it may mean that all of the superclasses do not have this conformance,
-  // but the actual type may still have this conformance.
-  if (FoundConformance.second) {
-    if (FoundConformance.first || foundEntry)
-      return FoundConformance.first;
-  }
-
-  unsigned failedGeneration = ConformanceCacheGeneration;
-
-  // If we didn't have an up-to-date cache entry, scan the conformance records.
-  pthread_mutex_lock(&C.SectionsToScanLock);
-
-  // If we have no new information to pull in (and nobody else pulled in
-  // new information while we waited on the lock), we're done.
-  if (C.SectionsToScan.size() == numSections) {
-    if (failedGeneration != ConformanceCacheGeneration) {
-      // Someone else pulled in new conformances while we were waiting.
-      // Start over with our newly-populated cache.
-      pthread_mutex_unlock(&C.SectionsToScanLock);
-      type = origType;
-      goto recur;
-    }
-
-
-    // Hash and lookup the type-protocol pair in the cache.
-    size_t hash = hashTypeProtocolPair(type, protocol);
-    ConcurrentList<ConformanceCacheEntry> &Bucket =
-      C.Cache.findOrAllocateNode(hash);
-    Bucket.push_front(ConformanceCacheEntry::createFailure(
-        type, protocol, C.SectionsToScan.size()));
-    pthread_mutex_unlock(&C.SectionsToScanLock);
-    return nullptr;
-  }
-
-  // Update the last known number of sections to scan.
-  numSections = C.SectionsToScan.size();
-
-  // Scan only sections that were not scanned yet.
-  unsigned sectionIdx = foundEntry ? foundEntry->getFailureGeneration() : 0;
-  unsigned endSectionIdx = C.SectionsToScan.size();
-
-  for (; sectionIdx < endSectionIdx; ++sectionIdx) {
-    auto &section = C.SectionsToScan[sectionIdx];
-    // Eagerly pull records for nondependent witnesses into our cache.
-    for (const auto &record : section) {
-      // If the record applies to a specific type, cache it.
-      if (auto metadata = record.getCanonicalTypeMetadata()) {
-        auto P = record.getProtocol();
-
-        // Look for an exact match.
-        if (protocol != P)
-          continue;
 
-        if (!isRelatedType(type, metadata))
-          continue;
-
-        // Hash and lookup the type-protocol pair in the cache.
-        size_t hash = hashTypeProtocolPair(metadata, P);
-        ConcurrentList<ConformanceCacheEntry> &Bucket =
-          C.Cache.findOrAllocateNode(hash);
-
-        auto witness = record.getWitnessTable(metadata);
-        if (witness)
-          Bucket.push_front(
-              ConformanceCacheEntry::createSuccess(metadata, P, witness));
-        else
-          Bucket.push_front(ConformanceCacheEntry::createFailure(
-              metadata, P, C.SectionsToScan.size()));
-
-      // If the record provides a nondependent witness table for all instances
-      // of a generic type, cache it for the generic pattern.
-      // TODO: "Nondependent witness table" probably deserves its own flag.
-      // An accessor function might still be necessary even if the witness table
-      // can be shared.
-      } else if (record.getTypeKind()
-                   == ProtocolConformanceTypeKind::UniqueGenericPattern
-                 && record.getConformanceKind()
-                   == ProtocolConformanceReferenceKind::WitnessTable) {
-
-        auto R = record.getGenericPattern();
-        auto P = record.getProtocol();
-
-        // Look for an exact match.
-        if (protocol != P)
-          continue;
-
-        if (!isRelatedType(type, R))
-          continue;
+  SWIFT_STATS_COUNT(ConformanceLookup);
+
+  // Fast path: the conformance is indexed under the type itself, either
+  // because a record names it directly or because an earlier query
+  // memoized it.
+  const void *key = getConformanceIndexKey(type);
+  const void *args[] = { key, protocol };
+  if (auto entry = C.Index.find(args, 2))
+    return entry->getWitnessTable();
+
+  // Read the generation before searching, so that a failure is recorded as
+  // stale if an image is registered during the search.
+  size_t generation = C.Generation.load(std::memory_order_acquire);
+  auto failure = C.Failures.find(args, 2);
+  if (failure && failure->getGeneration() == generation)
+    return nullptr;
 
-        // Hash and lookup the type-protocol pair in the cache.
-        size_t hash = hashTypeProtocolPair(R, P);
-        ConcurrentList<ConformanceCacheEntry> &Bucket =
-          C.Cache.findOrAllocateNode(hash);
-          Bucket.push_front(ConformanceCacheEntry::createSuccess(
-              R, P, record.getStaticWitnessTable()));
-      }
-    }
+  SWIFT_STATS_COUNT(ConformanceCacheMiss);
+  const ConformanceIndexEntry *found;
+  {
+    SWIFT_STATS_TIME(ConformanceSearch);
+    indexPendingConformances(C);
+    found = searchConformanceIndex(type, protocol);
+  }
+  auto witness = found ? found->getWitnessTable() : nullptr;
+  if (!witness) {
+    if (!failure)
+      failure = C.Failures.findOrAdd(args, 2,
+                                     [&]() -> ConformanceFailureEntry* {
+        return ConformanceFailureEntry::allocate(C.Failures.getAllocator(),
+                                                 args, 2, 0);
+      });
+    // Racing lookups store generations that were all current when they
+    // started; whichever lands last is at worst stale and gets rechecked.
+    failure->setGeneration(generation);
+    return nullptr;
   }
-  ++ConformanceCacheGeneration;
 
-  pthread_mutex_unlock(&C.SectionsToScanLock);
-  // Start over with our newly-populated cache.
-  type = origType;
-  goto recur;
+  // Memoize the conformance under the type itself. Conformances are never
+  // removed, so this entry stays valid as more images are loaded.
+  C.Index.findOrAdd(args, 2, [&]() -> ConformanceIndexEntry* {
+    auto entry = ConformanceIndexEntry::allocate(C.Index.getAllocator(),
+                                                 args, 2, 0);
+    entry->setWitnessTable(witness);
+    return entry;
+  });
+  return witness;
 }
 
 // The return type is incorrect.  It is only important that it is
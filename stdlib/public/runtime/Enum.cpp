@@ -291,23 +291,40 @@ swift::swift_initEnumMetadataMultiPayload(ValueWitnessTable *vwtable,
 }
 
 namespace {
+/// Describes how to access the tag of a multi-payload enum value. Everything
+/// here is read out of the enum metadata once per runtime call, so that the
+/// tag accessors below don't have to go back to the metadata.
 struct MultiPayloadLayout {
+  /// The size of the payload area. The tag is stored right after it.
   size_t payloadSize;
+  /// The number of tag bytes, which is always 1, 2 or 4.
   size_t numTagBytes;
+  /// The number of payload cases. Tag values at or above this number are
+  /// used for empty cases.
+  unsigned numPayloads;
 };
+
+/// The integer type which holds a tag of the given size in bytes.
+template <unsigned numTagBytes> struct MultiPayloadTag;
+template <> struct MultiPayloadTag<1> { typedef uint8_t type; };
+template <> struct MultiPayloadTag<2> { typedef uint16_t type; };
+template <> struct MultiPayloadTag<4> { typedef uint32_t type; };
 }
 
 static MultiPayloadLayout getMultiPayloadLayout(const EnumMetadata *enumType) {
   size_t payloadSize = enumType->getPayloadSize();
   size_t totalSize = enumType->getValueWitnesses()->size;
-  return {payloadSize, totalSize - payloadSize};
+  return {payloadSize, totalSize - payloadSize,
+          enumType->Description->Enum.getNumPayloadCases()};
 }
 
+template <unsigned numTagBytes>
 static void storeMultiPayloadTag(OpaqueValue *value,
                                  MultiPayloadLayout layout,
                                  unsigned tag) {
   auto tagBytes = reinterpret_cast<char *>(value) + layout.payloadSize;
-  small_memcpy(tagBytes, &tag, layout.numTagBytes);
+  typename MultiPayloadTag<numTagBytes>::type tagValue = tag;
+  small_memcpy<numTagBytes>(tagBytes, &tagValue);
 }
 
 static void storeMultiPayloadValue(OpaqueValue *value,
@@ -324,12 +341,13 @@ static void storeMultiPayloadValue(OpaqueValue *value,
            layout.payloadSize - sizeof(payloadValue));
 }
 
+template <unsigned numTagBytes>
 static unsigned loadMultiPayloadTag(const OpaqueValue *value,
                                     MultiPayloadLayout layout) {
   auto tagBytes = reinterpret_cast<const char *>(value) + layout.payloadSize;
 
-  unsigned tag = 0;
-  small_memcpy(&tag, tagBytes, layout.numTagBytes);
+  typename MultiPayloadTag<numTagBytes>::type tag;
+  small_memcpy<numTagBytes>(&tag, tagBytes);
 
   return tag;
 }
@@ -343,15 +361,14 @@ static unsigned loadMultiPayloadValue(const OpaqueValue *value,
   return payloadValue;
 }
 
-void
-swift::swift_storeEnumTagMultiPayload(OpaqueValue *value,
-                                      const EnumMetadata *enumType,
-                                      unsigned whichCase) {
-  auto layout = getMultiPayloadLayout(enumType);
-  unsigned numPayloads = enumType->Description->Enum.getNumPayloadCases();
+template <unsigned numTagBytes>
+static void storeEnumTagMultiPayloadImpl(OpaqueValue *value,
+                                         MultiPayloadLayout layout,
+                                         unsigned whichCase) {
+  unsigned numPayloads = layout.numPayloads;
   if (whichCase < numPayloads) {
     // For a payload case, store the tag after the payload area.
-    storeMultiPayloadTag(value, layout, whichCase);
+    storeMultiPayloadTag<numTagBytes>(value, layout, whichCase);
   } else {
     // For an empty case, factor out the parts that go in the payload and
     // tag areas.
@@ -363,20 +380,19 @@ swift::swift_storeEnumTagMultiPayload(OpaqueValue *value,
     } else {
       unsigned numPayloadBits = layout.payloadSize * CHAR_BIT;
       whichTag = numPayloads + (whichEmptyCase >> numPayloadBits);
-      whichPayloadValue = whichEmptyCase & ((1U << numPayloads) - 1U);
+      whichPayloadValue = whichEmptyCase & ((1U << numPayloadBits) - 1U);
     }
-    storeMultiPayloadTag(value, layout, whichTag);
+    storeMultiPayloadTag<numTagBytes>(value, layout, whichTag);
     storeMultiPayloadValue(value, layout, whichPayloadValue);
   }
 }
 
-unsigned
-swift::swift_getEnumCaseMultiPayload(const OpaqueValue *value,
-                                     const EnumMetadata *enumType) {
-  auto layout = getMultiPayloadLayout(enumType);
-  unsigned numPayloads = enumType->Description->Enum.getNumPayloadCases();
+template <unsigned numTagBytes>
+static unsigned getEnumCaseMultiPayloadImpl(const OpaqueValue *value,
+                                            MultiPayloadLayout layout) {
+  unsigned numPayloads = layout.numPayloads;
 
-  unsigned tag = loadMultiPayloadTag(value, layout);
+  unsigned tag = loadMultiPayloadTag<numTagBytes>(value, layout);
   if (tag < numPayloads) {
     // If the tag indicates a payload, then we're done.
     return tag;
@@ -393,3 +409,38 @@ swift::swift_getEnumCaseMultiPayload(const OpaqueValue *value,
     }
   }
 }
+
+void
+swift::swift_storeEnumTagMultiPayload(OpaqueValue *value,
+                                      const EnumMetadata *enumType,
+                                      unsigned whichCase) {
+  // Dispatch on the tag size once, so that the tag is accessed with a single
+  // load or store of the right width.
+  auto layout = getMultiPayloadLayout(enumType);
+  switch (layout.numTagBytes) {
+  case 1:
+    return storeEnumTagMultiPayloadImpl<1>(value, layout, whichCase);
+  case 2:
+    return storeEnumTagMultiPayloadImpl<2>(value, layout, whichCase);
+  case 4:
+    return storeEnumTagMultiPayloadImpl<4>(value, layout, whichCase);
+  default:
+    crash("Tagbyte values should be 1, 2 or 4.");
+  }
+}
+
+unsigned
+swift::swift_getEnumCaseMultiPayload(const OpaqueValue *value,
+                                     const EnumMetadata *enumType) {
+  auto layout = getMultiPayloadLayout(enumType);
+  switch (layout.numTagBytes) {
+  case 1:
+    return getEnumCaseMultiPayloadImpl<1>(value, layout);
+  case 2:
+    return getEnumCaseMultiPayloadImpl<2>(value, layout);
+  case 4:
+    return getEnumCaseMultiPayloadImpl<4>(value, layout);
+  default:
+    crash("Tagbyte values should be 1, 2 or 4.");
+  }
+}
@@ -16,13 +16,311 @@
 
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Heap.h"
+#include "swift/Runtime/InstrumentsSupport.h"
 #include "Private.h"
 #include "swift/Runtime/Debug.h"
 #include <stdlib.h>
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+#include "swift/Basic/Lazy.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
 
 using namespace swift;
 
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+
+// The size-class allocator.
+//
+// Small allocations are rounded up to a multiple of SizeClassGranularity and
+// served from per-thread free lists, one per size class, so that the common
+// allocation and deallocation paths touch no shared state.
+//
+// Blocks move between threads in batches: a thread whose free list grows past
+// twice the batch size hands a batch back to the size class's central list,
+// and a thread whose free list is empty takes a whole batch from it. This
+// bounds the memory a thread can hoard when objects allocated on one thread
+// are freed on another, and amortizes the central lock over a batch.
+//
+// All size-class blocks are carved out of one reserved virtual region, in
+// spans that each hold a single size class. That lets swift_slowDealloc
+// recognize our blocks, and find their size class, from the address alone.
+
+namespace {
+
+enum : size_t {
+  /// Size classes are this many bytes apart.
+  SizeClassGranularity = 16,
+
+  /// The largest size served by a size class. Larger requests use malloc.
+  MaxSizeClassSize = 512,
+
+  NumSizeClasses = MaxSizeClassSize / SizeClassGranularity,
+
+  /// The number of blocks moved between a thread and the central list at once.
+  BatchSize = 64,
+
+  /// The unit in which the region is committed and assigned to size classes.
+  SpanSize = 256 * 1024,
+
+  /// The amount of address space reserved for size-class blocks.
+  RegionSize = sizeof(void*) == 8 ? size_t(32) << 30 : size_t(256) << 20,
+
+  NumSpans = RegionSize / SpanSize,
+};
+
+/// A free block. Only the first block of a batch uses NextBatch.
+struct FreeBlock {
+  FreeBlock *Next;
+  FreeBlock *NextBatch;
+};
+
+/// A thread-local free list for one size class.
+struct FreeList {
+  FreeBlock *Head;
+  size_t Count;
+};
+
+/// The free lists of a single thread.
+struct ThreadCache {
+  FreeList Lists[NumSizeClasses];
+};
+
+/// The shared state of a size class.
+struct CentralList {
+  std::mutex Lock;
+
+  /// A stack of batches of free blocks.
+  FreeBlock *Batches = nullptr;
+
+  /// The part of the current span that has not been handed out yet.
+  char *SpanNext = nullptr;
+  char *SpanEnd = nullptr;
+};
+
+struct SizeClassZone {
+  /// The reserved region. Null if the reservation failed, in which case all
+  /// allocations go to malloc.
+  char *Base = nullptr;
+
+  /// The size class index plus one of each span, or zero if the span has not
+  /// been handed out.
+  uint8_t SpanClasses[NumSpans] = {};
+
+  /// The number of spans handed out so far.
+  std::atomic<size_t> NumUsedSpans{0};
+
+  CentralList Central[NumSizeClasses];
+
+  /// Frees the thread caches of exiting threads.
+  pthread_key_t ThreadCacheKey;
+
+  SizeClassZone();
+};
+
+} // end anonymous namespace
+
+static Lazy<SizeClassZone> Zone;
+
+/// The bounds of the reserved region, readable without forcing the zone to
+/// be initialized.
+static std::atomic<uintptr_t> ZoneBase{0};
+static std::atomic<uintptr_t> ZoneEnd{0};
+
+/// The current thread's cache, or null if it has not allocated yet.
+static __thread ThreadCache *CurrentThreadCache;
+
+static void destroyThreadCache(void *cache);
+
+SizeClassZone::SizeClassZone() {
+  pthread_key_create(&ThreadCacheKey, destroyThreadCache);
+
+  // Reserve address space without committing memory; spans are made
+  // accessible as they are handed out.
+  void *base = mmap(nullptr, RegionSize, PROT_NONE,
+                    MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED)
+    return;
+
+  Base = (char *)base;
+  ZoneEnd.store((uintptr_t)Base + RegionSize, std::memory_order_relaxed);
+  ZoneBase.store((uintptr_t)Base, std::memory_order_release);
+}
+
+static bool isSizeClassAllocation(const void *ptr) {
+  uintptr_t address = (uintptr_t)ptr;
+  return address >= ZoneBase.load(std::memory_order_relaxed) &&
+         address < ZoneEnd.load(std::memory_order_relaxed);
+}
+
+static AllocIndex getSizeClassOfAllocation(const void *ptr) {
+  auto &zone = Zone.unsafeGetAlreadyInitialized();
+  size_t span = ((const char *)ptr - zone.Base) / SpanSize;
+  assert(zone.SpanClasses[span] && "freeing a block from an unused span");
+  return zone.SpanClasses[span] - 1;
+}
+
+/// Refill an empty thread-local free list from the central list, carving
+/// new blocks out of the region if there are no free batches.
+/// Returns false if the region is exhausted.
+static bool refillFreeList(FreeList &list, AllocIndex idx) {
+  auto &zone = Zone.get();
+  if (!zone.Base)
+    return false;
+
+  auto &central = zone.Central[idx];
+  std::lock_guard<std::mutex> guard(central.Lock);
+
+  // Take a batch that another thread returned.
+  if (FreeBlock *batch = central.Batches) {
+    central.Batches = batch->NextBatch;
+    size_t count = 0;
+    for (FreeBlock *block = batch; block; block = block->Next)
+      ++count;
+    list.Head = batch;
+    list.Count = count;
+    return true;
+  }
+
+  // Otherwise carve a batch out of the current span.
+  size_t size = _swift_indexToSize(idx);
+  if (central.SpanNext + size > central.SpanEnd) {
+    size_t span = zone.NumUsedSpans.fetch_add(1, std::memory_order_relaxed);
+    if (span >= NumSpans)
+      return false;
+
+    char *spanStart = zone.Base + span * SpanSize;
+    if (mprotect(spanStart, SpanSize, PROT_READ | PROT_WRITE) != 0)
+      return false;
+    zone.SpanClasses[span] = idx + 1;
+    central.SpanNext = spanStart;
+    central.SpanEnd = spanStart + SpanSize;
+  }
+
+  FreeBlock *head = nullptr;
+  size_t count = 0;
+  while (count < BatchSize && central.SpanNext + size <= central.SpanEnd) {
+    auto block = reinterpret_cast<FreeBlock *>(central.SpanNext);
+    central.SpanNext += size;
+    block->Next = head;
+    head = block;
+    ++count;
+  }
+  list.Head = head;
+  list.Count = count;
+  return true;
+}
+
+/// Hand a batch of blocks from a thread-local free list back to the central
+/// list.
+static void releaseBatch(FreeList &list, AllocIndex idx, size_t count) {
+  FreeBlock *batch = list.Head;
+  FreeBlock *last = batch;
+  for (size_t i = 1; i < count; ++i)
+    last = last->Next;
+  list.Head = last->Next;
+  list.Count -= count;
+  last->Next = nullptr;
+
+  auto &central = Zone.unsafeGetAlreadyInitialized().Central[idx];
+  std::lock_guard<std::mutex> guard(central.Lock);
+  batch->NextBatch = central.Batches;
+  central.Batches = batch;
+}
+
+static void destroyThreadCache(void *cache) {
+  auto threadCache = static_cast<ThreadCache *>(cache);
+  for (AllocIndex idx = 0; idx != NumSizeClasses; ++idx) {
+    auto &list = threadCache->Lists[idx];
+    while (list.Count)
+      releaseBatch(list, idx, std::min<size_t>(list.Count, BatchSize));
+  }
+  CurrentThreadCache = nullptr;
+  free(threadCache);
+}
+
+static ThreadCache &getThreadCache() {
+  if (LLVM_LIKELY(CurrentThreadCache != nullptr))
+    return *CurrentThreadCache;
+
+  auto cache = static_cast<ThreadCache *>(calloc(1, sizeof(ThreadCache)));
+  if (!cache)
+    swift::crash("Could not allocate memory.");
+  pthread_setspecific(Zone.get().ThreadCacheKey, cache);
+  CurrentThreadCache = cache;
+  return *cache;
+}
+
+int swift::_swift_sizeToIndex(size_t size) {
+  if (size == 0 || size > MaxSizeClassSize)
+    return -1;
+  return (size - 1) / SizeClassGranularity;
+}
+
+size_t swift::_swift_indexToSize(AllocIndex idx) {
+  assert(idx < NumSizeClasses);
+  return (idx + 1) * SizeClassGranularity;
+}
+
+void swift::_swift_zone_init(void) {
+  (void)Zone.get();
+}
+
+static void *_swift_tryAlloc_(AllocIndex idx) {
+  auto &list = getThreadCache().Lists[idx];
+  if (LLVM_UNLIKELY(!list.Head) && !refillFreeList(list, idx))
+    return nullptr;
+
+  FreeBlock *block = list.Head;
+  list.Head = block->Next;
+  --list.Count;
+  return block;
+}
+
+static void *_swift_alloc_(AllocIndex idx) {
+  if (void *p = _swift_tryAlloc_(idx))
+    return p;
+  void *p = malloc(_swift_indexToSize(idx));
+  if (!p) swift::crash("Could not allocate memory.");
+  return p;
+}
+
+static void _swift_dealloc_(void *ptr, AllocIndex idx) {
+  if (!isSizeClassAllocation(ptr)) {
+    // _swift_alloc fell back to malloc.
+    free(ptr);
+    return;
+  }
+  assert(getSizeClassOfAllocation(ptr) == idx && "freeing with wrong size");
+
+  auto &list = getThreadCache().Lists[idx];
+  auto block = static_cast<FreeBlock *>(ptr);
+  block->Next = list.Head;
+  list.Head = block;
+  if (LLVM_UNLIKELY(++list.Count >= 2 * BatchSize))
+    releaseBatch(list, idx, BatchSize);
+}
+
+void *(*swift::_swift_alloc)(AllocIndex idx) = _swift_alloc_;
+void *(*swift::_swift_tryAlloc)(AllocIndex idx) = _swift_tryAlloc_;
+void (*swift::_swift_dealloc)(void *ptr, AllocIndex idx) = _swift_dealloc_;
+
+#endif // SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+
 void *swift::swift_slowAlloc(size_t size, size_t alignMask) {
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+  // Size-class blocks are only guaranteed the size-class granularity's
+  // alignment.
+  if (alignMask < SizeClassGranularity) {
+    int idx = _swift_sizeToIndex(size);
+    if (idx >= 0)
+      if (void *p = _swift_tryAlloc(idx))
+        return p;
+  }
+#endif
   // FIXME: use posix_memalign if alignMask is larger than the system guarantee.
   void *p = malloc(size);
   if (!p) swift::crash("Could not allocate memory.");
@@ -30,5 +328,13 @@ void *swift::swift_slowAlloc(size_t size, size_t alignMask) {
 }
 
 void swift::swift_slowDealloc(void *ptr, size_t bytes, size_t alignMask) {
+#if SWIFT_RUNTIME_ENABLE_SIZE_CLASS_ALLOCATOR
+  // Look up the size class from the address rather than trusting \p bytes,
+  // so that blocks that came from malloc are still freed correctly.
+  if (isSizeClassAllocation(ptr)) {
+    _swift_dealloc(ptr, getSizeClassOfAllocation(ptr));
+    return;
+  }
+#endif
   free(ptr);
 }
@@ -47,26 +47,301 @@
 # define SWIFT_RETAIN()
 #endif
 #include "Leaks.h"
+#include "RuntimeStats.h"
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <pthread.h>
+#endif
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+#include "llvm/ADT/DenseMap.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT && SWIFT_OBJC_INTEROP
+// Objective-C deallocates instances of classes with Objective-C ancestry
+// through object_dispose, which frees the object's address rather than the
+// start of its allocation, in front of which the biased count lives.
+#error "biased reference counting is not supported with ObjC interop"
+#endif
+
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE && SWIFT_OBJC_INTEROP
+// swift_unknownWeak* decide how to handle a weak reference by looking at the
+// object it holds, which a side-table entry is not.
+#error "weak reference side tables are not supported with ObjC interop"
+#endif
 
 using namespace swift;
 
+// Forward-declare this, but define it after swift_release.
+extern "C" LLVM_LIBRARY_VISIBILITY
+void _swift_release_dealloc(HeapObject *object)
+  __attribute__((noinline,used));
+
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+// Defined with the weak reference entry points.
+static void clearWeakReferenceEntry(HeapObject *object);
+#endif
+
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+
+// Biased reference counting.
+//
+// Most objects are only ever retained and released by the thread that
+// allocated them. swift_allocObject gives each object a BiasedRefCount that
+// records the allocating thread, and that thread counts its references there
+// without atomic read-modify-write operations. Other threads use the
+// object's strong reference count as a shared count. See RefCount.h.
+//
+// When the owner's count drops to zero it merges it into the shared count,
+// after which the object is reference-counted atomically like any other.
+// When another thread drives the shared count negative, it releases a
+// reference that the owner counted, and the object may already be dead; it
+// queues the object so that the owner merges it. The owner checks its queue
+// whenever it allocates an object or releases one with a biased count, and
+// drains it when it exits.
+//
+// Threads are identified by a small index that is recycled when a thread
+// exits. The next thread to take the index inherits the exited thread's
+// objects and its queue, so objects still biased towards an exited thread
+// are only reclaimed once its index is reused.
+
+namespace {
+
+enum : uint32_t {
+  /// The number of threads that can own objects at once. Objects allocated
+  /// by further threads use the shared count only.
+  MaxBiasedThreads = 1024,
+
+  /// The current thread's index if no index was available for it.
+  NoBiasedThread = MaxBiasedThreads + 1,
+};
+
+/// Objects queued for their owner to merge.
+struct BiasedThreadQueue {
+  std::mutex Lock;
+  std::vector<HeapObject *> Objects;
+
+  /// Whether Objects may be non-empty. Polled by the owner without the lock.
+  std::atomic<bool> NonEmpty{false};
+};
+
+struct BiasedThreadRegistry {
+  std::mutex Lock;
+  std::vector<uint32_t> FreeIndices;
+  uint32_t NextIndex = 1;
+
+  /// Releases the index of an exiting thread.
+  pthread_key_t ThreadKey;
+
+  /// Indexed by thread index; entry 0 is unused.
+  BiasedThreadQueue Queues[MaxBiasedThreads + 1];
+
+  BiasedThreadRegistry();
+};
+
+} // end anonymous namespace
+
+static Lazy<BiasedThreadRegistry> BiasedThreads;
+
+/// The current thread's index, 0 if it has not allocated an object yet, or
+/// NoBiasedThread.
+static __thread uint32_t CurrentBiasedThread
+  __attribute__((tls_model("initial-exec")));
+
+static void releaseBiasedThread(void *index);
+
+BiasedThreadRegistry::BiasedThreadRegistry() {
+  pthread_key_create(&ThreadKey, releaseBiasedThread);
+}
+
+/// Merge the biased count of an object owned by the current thread into its
+/// shared count. Return true if the caller should deallocate the object.
+static bool mergeBiasedRefCount(HeapObject *object, int32_t remainder) {
+  auto biased = getBiasedRefCount(object);
+  biased->takeForMerge();
+  if (remainder)
+    object->refCount.addShared(remainder);
+  if (biased->setMerged())
+    return false;
+  return object->refCount.trySetDeallocating();
+}
+
+/// Merge the objects that other threads queued for the given thread.
+static void drainBiasedThreadQueue(uint32_t index) {
+  auto &queue = BiasedThreads.unsafeGetAlreadyInitialized().Queues[index];
+  std::vector<HeapObject *> objects;
+  {
+    std::lock_guard<std::mutex> guard(queue.Lock);
+    objects.swap(queue.Objects);
+    queue.NonEmpty.store(false, std::memory_order_relaxed);
+  }
+
+  for (auto object : objects) {
+    auto biased = getBiasedRefCount(object);
+    // The owner may already have merged the object when its own count
+    // dropped to zero.
+    if (biased->isOwnedBy(index)) {
+      if (int32_t count = biased->takeForMerge())
+        object->refCount.addShared(count);
+    }
+    biased->setMergedAndDequeued();
+    if (object->refCount.trySetDeallocating())
+      _swift_release_dealloc(object);
+  }
+}
+
+/// Merge the objects queued for the current thread, if there are any.
+static void drainCurrentBiasedThreadQueue() {
+  uint32_t index = CurrentBiasedThread;
+  if (index != 0 && index != NoBiasedThread &&
+      LLVM_UNLIKELY(BiasedThreads.unsafeGetAlreadyInitialized()
+                      .Queues[index].NonEmpty
+                      .load(std::memory_order_relaxed)))
+    drainBiasedThreadQueue(index);
+}
+
+static void queueForBiasedThread(HeapObject *object, uint32_t index) {
+  auto &queue = BiasedThreads.unsafeGetAlreadyInitialized().Queues[index];
+  std::lock_guard<std::mutex> guard(queue.Lock);
+  queue.Objects.push_back(object);
+  queue.NonEmpty.store(true, std::memory_order_relaxed);
+}
+
+static void releaseBiasedThread(void *value) {
+  uint32_t index = (uint32_t)(uintptr_t)value;
+  drainBiasedThreadQueue(index);
+
+  // Anything this thread does from here on uses the shared count.
+  CurrentBiasedThread = NoBiasedThread;
+
+  auto &registry = BiasedThreads.unsafeGetAlreadyInitialized();
+  std::lock_guard<std::mutex> guard(registry.Lock);
+  registry.FreeIndices.push_back(index);
+}
+
+/// Return the current thread's index, assigning one if necessary, and merge
+/// any objects queued for it.
+static uint32_t getBiasedThreadForAllocation() {
+  uint32_t index = CurrentBiasedThread;
+  if (LLVM_LIKELY(index != 0)) {
+    drainCurrentBiasedThreadQueue();
+    return index;
+  }
+
+  auto &registry = BiasedThreads.get();
+  {
+    std::lock_guard<std::mutex> guard(registry.Lock);
+    if (!registry.FreeIndices.empty()) {
+      index = registry.FreeIndices.back();
+      registry.FreeIndices.pop_back();
+    } else if (registry.NextIndex <= MaxBiasedThreads) {
+      index = registry.NextIndex++;
+    } else {
+      index = NoBiasedThread;
+    }
+  }
+  CurrentBiasedThread = index;
+  if (index == NoBiasedThread)
+    return index;
+
+  pthread_setspecific(registry.ThreadKey, (void *)(uintptr_t)index);
+  // Pick up whatever was queued for the previous owner of this index.
+  drainBiasedThreadQueue(index);
+  return index;
+}
+
+/// Return the offset of an object from the start of its allocation.
+static size_t getBiasedRefCountOffset(size_t alignMask) {
+  return (sizeof(BiasedRefCount) + alignMask) & ~alignMask;
+}
+
+/// Decrement the strong reference count of an object that has a biased
+/// reference count. Return true if the caller should deallocate it.
+static bool biasedDecrementShouldDeallocate(HeapObject *object, uint32_t n,
+                                            bool clearPinnedFlag = false) {
+  auto biased = getBiasedRefCount(object);
+  if (!clearPinnedFlag && biased->isOwnedBy(CurrentBiasedThread)) {
+    int32_t count = biased->decrement(n);
+    if (LLVM_LIKELY(count > 0))
+      return false;
+    return mergeBiasedRefCount(object, count);
+  }
+
+  int32_t count = object->refCount.decrementShared(n, clearPinnedFlag);
+  if (count > 0)
+    return false;
+  if (count == 0)
+    return biased->isMergedAndNotQueued() &&
+           object->refCount.trySetDeallocating();
+
+  // We released a reference that the owner counted.
+  if (biased->tryMarkQueued())
+    queueForBiasedThread(object, biased->getOwner());
+  return false;
+}
+
+/// Release an object that has a biased reference count, then merge the
+/// objects queued for the current thread. The queue is only looked at after
+/// the release, since draining it may deallocate the object.
+static void biasedRelease(HeapObject *object, uint32_t n) {
+  if (biasedDecrementShouldDeallocate(object, n))
+    _swift_release_dealloc(object);
+  drainCurrentBiasedThreadQueue();
+}
+
+bool swift::isUniquelyReferencedBiased(const HeapObject *object) {
+  if (!object->weakRefCount.hasBiasedRefCount())
+    return object->refCount.isUniquelyReferenced();
+
+  auto biased = getBiasedRefCount(object);
+  if (biased->isOwnedBy(CurrentBiasedThread))
+    return int32_t(biased->getCount()) + object->refCount.getSharedCount()
+             == 1;
+  return biased->isMerged() && object->refCount.getSharedCount() == 1;
+}
+
+#endif // SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+
 HeapObject *
 swift::swift_allocObject(HeapMetadata const *metadata,
                          size_t requiredSize,
                          size_t requiredAlignmentMask) {
   SWIFT_ALLOCATEOBJECT();
+  SWIFT_STATS_COUNT(AllocObject);
   return _swift_allocObject(metadata, requiredSize, requiredAlignmentMask);
 }
 static HeapObject *
 _swift_allocObject_(HeapMetadata const *metadata, size_t requiredSize,
                     size_t requiredAlignmentMask) {
   assert(isAlignmentMask(requiredAlignmentMask));
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  uint32_t owner = getBiasedThreadForAllocation();
+  size_t offset = getBiasedRefCountOffset(requiredAlignmentMask);
+  auto object = reinterpret_cast<HeapObject *>(
+                  (char *)swift_slowAlloc(offset + requiredSize,
+                                          requiredAlignmentMask) + offset);
+  if (owner == NoBiasedThread) {
+    getBiasedRefCount(object)->init(0);
+    object->refCount.init();
+  } else {
+    // The initial reference belongs to the owner.
+    getBiasedRefCount(object)->init(owner);
+    object->refCount.initShared();
+  }
+  object->metadata = metadata;
+  object->weakRefCount.initWithBiasedRefCount();
+#else
   auto object = reinterpret_cast<HeapObject *>(
                   swift_slowAlloc(requiredSize, requiredAlignmentMask));
   // FIXME: this should be a placement new but that adds a null check
   object->metadata = metadata;
   object->refCount.init();
   object->weakRefCount.init();
+#endif
 
   // If leak tracking is enabled, start tracking this object.
   SWIFT_LEAKS_START_TRACKING_OBJECT(object);
@@ -91,7 +366,11 @@ swift::swift_verifyEndOfLifetime(HeapObject *object) {
   if (object->refCount.getCount() != 0)
     swift::fatalError("fatal error: stack object escaped\n");
 
-  if (object->weakRefCount.getCount() != 1)
+  if (object->weakRefCount.getCount() != 1
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+      || object->weakRefCount.hasWeakSideTable()
+#endif
+      )
     swift::fatalError("fatal error: weak/unowned reference to stack object\n");
 }
 
@@ -273,7 +552,7 @@ static BoxPair::Return _swift_allocBox_(const Metadata *type) {
   // Get the heap metadata for the box.
   auto &B = Boxes.get();
   const void *typeArg = type;
-  auto entry = B.findOrAdd(&typeArg, 1, [&]() -> BoxCacheEntry* {
+  auto entry = findOrAddMetadata(B, &typeArg, 1, [&]() -> BoxCacheEntry* {
     // Create a new entry for the box.
     auto entry = BoxCacheEntry::allocate(B.getAllocator(), &typeArg, 1, 0);
 
@@ -311,25 +590,40 @@ OpaqueValue *swift::swift_projectBox(HeapObject *o) {
   return metadata->project(o);
 }
 
-// Forward-declare this, but define it after swift_release.
-extern "C" LLVM_LIBRARY_VISIBILITY
-void _swift_release_dealloc(HeapObject *object)
-  __attribute__((noinline,used));
-
 void swift::swift_retain(HeapObject *object) {
   SWIFT_RETAIN();
+  SWIFT_STATS_COUNT(Retain);
   _swift_retain(object);
 }
 static void _swift_retain_(HeapObject *object) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    auto biased = getBiasedRefCount(object);
+    if (LLVM_LIKELY(biased->isOwnedBy(CurrentBiasedThread))) {
+      biased->increment(1);
+      return;
+    }
+  }
+#endif
   _swift_retain_inlined(object);
 }
 auto swift::_swift_retain = _swift_retain_;
 
 void swift::swift_retain_n(HeapObject *object, uint32_t n) {
   SWIFT_RETAIN();
+  SWIFT_STATS_COUNT(Retain);
   _swift_retain_n(object, n);
 }
 static void _swift_retain_n_(HeapObject *object, uint32_t n) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    auto biased = getBiasedRefCount(object);
+    if (LLVM_LIKELY(biased->isOwnedBy(CurrentBiasedThread))) {
+      biased->increment(n);
+      return;
+    }
+  }
+#endif
   if (object) {
     object->refCount.increment(n);
   }
@@ -338,9 +632,16 @@ auto swift::_swift_retain_n = _swift_retain_n_;
 
 void swift::swift_release(HeapObject *object) {
   SWIFT_RELEASE();
+  SWIFT_STATS_COUNT(Release);
   return _swift_release(object);
 }
 static void _swift_release_(HeapObject *object) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    biasedRelease(object, 1);
+    return;
+  }
+#endif
   if (object  &&  object->refCount.decrementShouldDeallocate()) {
     _swift_release_dealloc(object);
   }
@@ -349,17 +650,79 @@ auto swift::_swift_release = _swift_release_;
 
 void swift::swift_release_n(HeapObject *object, uint32_t n) {
   SWIFT_RELEASE();
+  SWIFT_STATS_COUNT(Release);
   return _swift_release_n(object, n);
 }
 static void _swift_release_n_(HeapObject *object, uint32_t n) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    biasedRelease(object, n);
+    return;
+  }
+#endif
   if (object && object->refCount.decrementShouldDeallocateN(n)) {
     _swift_release_dealloc(object);
   }
 }
 auto swift::_swift_release_n = _swift_release_n_;
 
+void swift::swift_nonatomic_retain(HeapObject *object) {
+  swift_nonatomic_retain_n(object, 1);
+}
+
+void swift::swift_nonatomic_retain_n(HeapObject *object, uint32_t n) {
+  SWIFT_RETAIN();
+  SWIFT_STATS_COUNT(NonAtomicRetain);
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  // The owner of a biased object already counts without atomics.
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    _swift_retain_n(object, n);
+    return;
+  }
+#endif
+  if (object) {
+    object->refCount.incrementNonAtomic(n);
+  }
+}
+
+void swift::swift_nonatomic_release(HeapObject *object) {
+  swift_nonatomic_release_n(object, 1);
+}
+
+void swift::swift_nonatomic_release_n(HeapObject *object, uint32_t n) {
+  SWIFT_RELEASE();
+  SWIFT_STATS_COUNT(NonAtomicRelease);
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    _swift_release_n(object, n);
+    return;
+  }
+#endif
+  if (object && object->refCount.decrementShouldDeallocateNonAtomic(n)) {
+    _swift_release_dealloc(object);
+  }
+}
+
 size_t swift::swift_retainCount(HeapObject *object) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  return getStrongRefCount(object);
+#else
   return object->refCount.getCount();
+#endif
+}
+
+/// Free the memory of an object allocated with swift_allocObject.
+static void deallocObjectStorage(HeapObject *object, size_t allocatedSize,
+                                 size_t allocatedAlignMask) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  if (object->weakRefCount.hasBiasedRefCount()) {
+    size_t offset = getBiasedRefCountOffset(allocatedAlignMask);
+    swift_slowDealloc((char *)object - offset, offset + allocatedSize,
+                      allocatedAlignMask);
+    return;
+  }
+#endif
+  swift_slowDealloc(object, allocatedSize, allocatedAlignMask);
 }
 
 size_t swift::swift_weakRetainCount(HeapObject *object) {
@@ -381,8 +744,8 @@ void swift::swift_weakRelease(HeapObject *object) {
     assert(metadata->isClassObject());
     auto classMetadata = static_cast<const ClassMetadata*>(metadata);
     assert(classMetadata->isTypeMetadata());
-    swift_slowDealloc(object, classMetadata->getInstanceSize(),
-                      classMetadata->getInstanceAlignMask());
+    deallocObjectStorage(object, classMetadata->getInstanceSize(),
+                         classMetadata->getInstanceAlignMask());
   }
 }
 
@@ -401,8 +764,8 @@ void swift::swift_weakRelease_n(HeapObject *object, int n) {
     assert(metadata->isClassObject());
     auto classMetadata = static_cast<const ClassMetadata*>(metadata);
     assert(classMetadata->isTypeMetadata());
-    swift_slowDealloc(object, classMetadata->getInstanceSize(),
-                      classMetadata->getInstanceAlignMask());
+    deallocObjectStorage(object, classMetadata->getInstanceSize(),
+                         classMetadata->getInstanceAlignMask());
   }
 }
 
@@ -421,6 +784,14 @@ HeapObject *swift::swift_tryPin(HeapObject *object) {
 }
 
 void swift::swift_unpin(HeapObject *object) {
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  // The pinning reference is always counted in the shared count.
+  if (object && object->weakRefCount.hasBiasedRefCount()) {
+    if (biasedDecrementShouldDeallocate(object, 1, /*clearPinnedFlag*/ true))
+      _swift_release_dealloc(object);
+    return;
+  }
+#endif
   if (object && object->refCount.decrementAndUnpinShouldDeallocate()) {
     _swift_release_dealloc(object);
   }
@@ -512,7 +883,13 @@ extern "C" void swift_deallocPartialClassInstance(HeapObject *object,
   }
 
   // The strong reference count should be +1 -- tear down the object
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  bool shouldDeallocate = object->weakRefCount.hasBiasedRefCount()
+    ? biasedDecrementShouldDeallocate(object, 1)
+    : object->refCount.decrementShouldDeallocate();
+#else
   bool shouldDeallocate = object->refCount.decrementShouldDeallocate();
+#endif
   assert(shouldDeallocate);
   (void) shouldDeallocate;
   swift_deallocClassInstance(object, allocatedSize, allocatedAlignMask);
@@ -533,6 +910,7 @@ static inline void memset_pattern8(void *b, const void *pattern8, size_t len) {
 void swift::swift_deallocObject(HeapObject *object, size_t allocatedSize,
                                 size_t allocatedAlignMask) {
   SWIFT_DEALLOCATEOBJECT();
+  SWIFT_STATS_COUNT(DeallocObject);
   assert(isAlignmentMask(allocatedAlignMask));
   assert(object->refCount.isDeallocating());
 #ifdef SWIFT_RUNTIME_CLOBBER_FREED_OBJECTS
@@ -544,6 +922,12 @@ void swift::swift_deallocObject(HeapObject *object, size_t allocatedSize,
   // If we are tracking leaks, stop tracking this object.
   SWIFT_LEAKS_STOP_TRACKING_OBJECT(object);
 
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+  // Detach the object from its weak references before its memory goes away.
+  if (object->weakRefCount.hasWeakSideTable())
+    clearWeakReferenceEntry(object);
+#endif
+
   // Drop the initial weak retain of the object.
   //
   // If the outstanding weak retain count is 1 (i.e. only the initial
@@ -610,7 +994,7 @@ void swift::swift_deallocObject(HeapObject *object, size_t allocatedSize,
   // atomic decrement (and has the ability to reconstruct
   // allocatedSize and allocatedAlignMask).
   if (object->weakRefCount.getCount() == 1) {
-    swift_slowDealloc(object, allocatedSize, allocatedAlignMask);
+    deallocObjectStorage(object, allocatedSize, allocatedAlignMask);
   } else {
     swift_weakRelease(object);
   }
@@ -621,6 +1005,195 @@ void swift::swift_deallocObject(HeapObject *object, size_t allocatedSize,
 extern "C" void swift_fixLifetime(OpaqueValue *value) {
 }
 
+#if SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+
+// Weak reference side table.
+//
+// A weak reference to an object points to the object's WeakReferenceEntry
+// instead of to the object, and does not hold a weak retain of the object.
+// The entry is created the first time the object is weakly referenced and
+// outlives the object: swift_deallocObject clears the entry's object pointer,
+// and the object's memory can be freed even though weak references to it
+// remain. Only the small entry lives on until the last weak reference to it
+// is destroyed or finds it cleared.
+
+/// The out-of-line entry that weak references to an object point to.
+struct swift::WeakReferenceEntry {
+  /// The object, or null once it has been deallocated.
+  std::atomic<HeapObject *> Object;
+
+  /// The number of weak loads that may be retaining Object right now.
+  /// Deallocation waits for this to drop to zero before freeing the object.
+  std::atomic<uint32_t> Readers;
+
+  /// The number of weak references to the entry, plus one until the object
+  /// has been deallocated.
+  std::atomic<uint32_t> RefCount;
+
+  explicit WeakReferenceEntry(HeapObject *object)
+    : Object(object), Readers(0), RefCount(1) {}
+};
+
+namespace {
+/// The entries of all live objects with weak references. The table is split
+/// into shards by object address, each with its own lock, so that weak
+/// references to different objects rarely contend.
+struct WeakReferenceTable {
+  enum : unsigned { NumShards = 64 };
+
+  struct alignas(64) Shard {
+    std::mutex Lock;
+    llvm::DenseMap<HeapObject *, WeakReferenceEntry *> Entries;
+  };
+
+  Shard Shards[NumShards];
+
+  Shard &getShard(HeapObject *object) {
+    // Drop the bits that are zero for every allocation, and fold in higher
+    // bits so that objects of the same size class spread across shards.
+    auto bits = reinterpret_cast<uintptr_t>(object) >> 4;
+    return Shards[(bits ^ (bits >> 6) ^ (bits >> 12)) % NumShards];
+  }
+};
+} // end anonymous namespace
+
+static Lazy<WeakReferenceTable> WeakReferences;
+
+/// Return the side-table entry of \p object with an additional reference,
+/// creating the entry if the object does not have one yet.
+static WeakReferenceEntry *retainWeakReferenceEntry(HeapObject *object) {
+  auto &shard = WeakReferences.get().getShard(object);
+  std::lock_guard<std::mutex> guard(shard.Lock);
+  auto &entry = shard.Entries[object];
+  if (!entry) {
+    entry = new WeakReferenceEntry(object);
+    object->weakRefCount.setHasWeakSideTable();
+  }
+  entry->RefCount.fetch_add(1, std::memory_order_relaxed);
+  return entry;
+}
+
+static void retainWeakReferenceEntry(WeakReferenceEntry *entry) {
+  entry->RefCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void releaseWeakReferenceEntry(WeakReferenceEntry *entry) {
+  if (entry && entry->RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete entry;
+}
+
+/// Return the object a weak reference entry refers to, retained, or null if
+/// the object has been deallocated or is being deinitialized.
+static HeapObject *loadStrongFromWeakReferenceEntry(WeakReferenceEntry *entry) {
+  // Announce the read before looking at the object. clearWeakReferenceEntry
+  // clears the object before checking for readers, so with sequentially
+  // consistent accesses on both sides either we see null or it waits for us.
+  entry->Readers.fetch_add(1, std::memory_order_seq_cst);
+  HeapObject *object = entry->Object.load(std::memory_order_seq_cst);
+  HeapObject *result = object ? swift_tryRetain(object) : nullptr;
+  entry->Readers.fetch_sub(1, std::memory_order_release);
+  return result;
+}
+
+static bool isWeakReferenceEntryCleared(WeakReferenceEntry *entry) {
+  return entry->Object.load(std::memory_order_acquire) == nullptr;
+}
+
+/// Detach a deallocating object from its side-table entry.
+static void clearWeakReferenceEntry(HeapObject *object) {
+  WeakReferenceEntry *entry;
+  {
+    auto &shard =
+      WeakReferences.unsafeGetAlreadyInitialized().getShard(object);
+    std::lock_guard<std::mutex> guard(shard.Lock);
+    auto it = shard.Entries.find(object);
+    assert(it != shard.Entries.end() && "object has no side-table entry");
+    entry = it->second;
+    shard.Entries.erase(it);
+  }
+
+  entry->Object.store(nullptr, std::memory_order_seq_cst);
+
+  // A concurrent weak load may still be trying to retain the object. It will
+  // fail because the object is deallocating, but it must not touch freed
+  // memory.
+  while (entry->Readers.load(std::memory_order_seq_cst) != 0)
+    std::this_thread::yield();
+
+  releaseWeakReferenceEntry(entry);
+}
+
+void swift::swift_weakInit(WeakReference *ref, HeapObject *value) {
+  ref->Entry = value ? retainWeakReferenceEntry(value) : nullptr;
+}
+
+void swift::swift_weakAssign(WeakReference *ref, HeapObject *newValue) {
+  auto newEntry = newValue ? retainWeakReferenceEntry(newValue) : nullptr;
+  auto oldEntry = ref->Entry;
+  ref->Entry = newEntry;
+  releaseWeakReferenceEntry(oldEntry);
+}
+
+HeapObject *swift::swift_weakLoadStrong(WeakReference *ref) {
+  auto entry = ref->Entry;
+  if (entry == nullptr) return nullptr;
+  if (auto result = loadStrongFromWeakReferenceEntry(entry))
+    return result;
+  // Drop our reference to the entry as soon as the object is gone.
+  if (isWeakReferenceEntryCleared(entry)) {
+    ref->Entry = nullptr;
+    releaseWeakReferenceEntry(entry);
+  }
+  return nullptr;
+}
+
+HeapObject *swift::swift_weakTakeStrong(WeakReference *ref) {
+  auto result = swift_weakLoadStrong(ref);
+  swift_weakDestroy(ref);
+  return result;
+}
+
+void swift::swift_weakDestroy(WeakReference *ref) {
+  auto tmp = ref->Entry;
+  ref->Entry = nullptr;
+  releaseWeakReferenceEntry(tmp);
+}
+
+void swift::swift_weakCopyInit(WeakReference *dest, WeakReference *src) {
+  auto entry = src->Entry;
+  if (entry == nullptr) {
+    dest->Entry = nullptr;
+  } else if (isWeakReferenceEntryCleared(entry)) {
+    src->Entry = nullptr;
+    dest->Entry = nullptr;
+    releaseWeakReferenceEntry(entry);
+  } else {
+    dest->Entry = entry;
+    retainWeakReferenceEntry(entry);
+  }
+}
+
+void swift::swift_weakTakeInit(WeakReference *dest, WeakReference *src) {
+  auto entry = src->Entry;
+  dest->Entry = entry;
+  if (entry != nullptr && isWeakReferenceEntryCleared(entry)) {
+    dest->Entry = nullptr;
+    releaseWeakReferenceEntry(entry);
+  }
+}
+
+void swift::swift_weakCopyAssign(WeakReference *dest, WeakReference *src) {
+  releaseWeakReferenceEntry(dest->Entry);
+  swift_weakCopyInit(dest, src);
+}
+
+void swift::swift_weakTakeAssign(WeakReference *dest, WeakReference *src) {
+  releaseWeakReferenceEntry(dest->Entry);
+  swift_weakTakeInit(dest, src);
+}
+
+#else
+
 void swift::swift_weakInit(WeakReference *ref, HeapObject *value) {
   ref->Value = value;
   swift_weakRetain(value);
@@ -693,6 +1266,8 @@ void swift::swift_weakTakeAssign(WeakReference *dest, WeakReference *src) {
   swift_weakTakeInit(dest, src);
 }
 
+#endif // SWIFT_RUNTIME_ENABLE_WEAK_SIDE_TABLE
+
 void swift::_swift_abortRetainUnowned(const void *object) {
   (void)object;
   swift::crash("attempted to retain deallocated object");
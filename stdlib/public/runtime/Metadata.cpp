@@ -25,12 +25,15 @@
 #include "MetadataCache.h"
 #include <algorithm>
 #include <condition_variable>
+#include <functional>
 #include <new>
+#include <vector>
 #include <cctype>
 #include <sys/mman.h>
 #include <pthread.h>
 #include <unistd.h>
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Hashing.h"
 #include "ErrorObject.h"
 #include "ExistentialMetadataImpl.h"
@@ -41,6 +44,15 @@
 #include <mach/vm_page_size.h>
 #endif
 
+#if defined(__APPLE__) && defined(__MACH__)
+#include <mach-o/dyld.h>
+#include <mach-o/getsect.h>
+#elif defined(__ELF__)
+#include <elf.h>
+#include <link.h>
+#endif
+#include <dlfcn.h>
+
 #if SWIFT_OBJC_INTEROP
 #include <objc/runtime.h>
 #endif
@@ -60,6 +72,10 @@ void *MetadataAllocator::alloc(size_t size) {
 #else
   static const uintptr_t pagesizeMask = sysconf(_SC_PAGESIZE) - 1;
 #endif
+  // Round the size up so that the next allocation stays pointer-aligned.
+  // Metadata caches rely on this to tag entry pointers in their low bits.
+  size = (size + alignof(void*) - 1) & ~(alignof(void*) - 1);
+
   // If the requested size is a page or larger, map page(s) for it
   // specifically.
   if (LLVM_UNLIKELY(size > pagesizeMask)) {
@@ -71,23 +87,37 @@ void *MetadataAllocator::alloc(size_t size) {
     return mem;
   }
   
-  char *end = next + size;
-  
-  // Allocate a new page if we need one.
-  if (LLVM_UNLIKELY(((uintptr_t)next & ~pagesizeMask)
-                      != (((uintptr_t)end & ~pagesizeMask)))){
-    next = (char*)
+  // Acquire ordering pairs with the release when a new page is installed,
+  // so that the page mapping happens-before any allocation from it.
+  char *cur = next.load(std::memory_order_acquire);
+  while (true) {
+    char *end = cur + size;
+
+    // Bump the pointer if the allocation fits in the current page.
+    if (LLVM_LIKELY(((uintptr_t)cur & ~pagesizeMask)
+                      == (((uintptr_t)end & ~pagesizeMask)))) {
+      if (next.compare_exchange_weak(cur, end, std::memory_order_acquire,
+                                     std::memory_order_acquire))
+        return cur;
+      continue;
+    }
+
+    // Allocate a new page and try to install it.
+    char *page = (char*)
       mmap(nullptr, pagesizeMask+1, PROT_READ|PROT_WRITE,
            MAP_ANON|MAP_PRIVATE, VM_TAG_FOR_SWIFT_METADATA, 0);
 
-    if (next == MAP_FAILED)
+    if (page == MAP_FAILED)
       crash("unable to allocate memory for metadata cache");
-    end = next + size;
+
+    if (next.compare_exchange_strong(cur, page + size,
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_acquire))
+      return page;
+
+    // Another thread installed a new page first; allocate from that one.
+    munmap(page, pagesizeMask+1);
   }
-  
-  char *addr = next;
-  next = end;
-  return addr;
 }
 
 namespace {
@@ -228,12 +258,240 @@ swift::swift_allocateGenericValueMetadata(GenericMetadata *pattern,
   return metadata;
 }
 
+/*** Prespecialized metadata **********************************************/
+
+#if defined(__APPLE__) && defined(__MACH__)
+#define SWIFT_PRESPECIALIZED_METADATA_SECTION "__swift2_prespec"
+#elif defined(__ELF__)
+#define SWIFT_PRESPECIALIZED_METADATA_SECTION \
+  ".swift2_prespecialized_metadata_start"
+#endif
+
+namespace {
+  /// A block of prespecialized metadata records from one image.
+  struct PrespecializedMetadataBlock {
+    const PrespecializedMetadataRecord *Begin, *End;
+  };
+
+  struct PrespecializedMetadataState {
+    /// Blocks whose records are not in their patterns' caches yet, guarded
+    /// by Lock.
+    std::vector<PrespecializedMetadataBlock> Pending;
+    std::mutex Lock;
+    std::atomic<bool> HasPending{false};
+
+#if defined(__ELF__)
+    /// The dlpi_adds count when the loaded images were last scanned.
+    std::atomic<unsigned long long> ScannedAdds{0};
+    /// The images scanned so far, guarded by Lock.
+    llvm::DenseSet<ElfW(Addr)> ScannedImages;
+#endif
+  };
+}
+
+static Lazy<PrespecializedMetadataState> PrespecializedMetadata;
+
+/// Queue a block of records without taking the lock; the caller holds it.
+static void queuePrespecializedMetadata(PrespecializedMetadataState &S,
+                                     const PrespecializedMetadataRecord *begin,
+                                     const PrespecializedMetadataRecord *end) {
+  if (begin == end)
+    return;
+  S.Pending.push_back({begin, end});
+  S.HasPending.store(true, std::memory_order_release);
+}
+
+void swift::swift_registerPrespecializedMetadata(
+                                     const PrespecializedMetadataRecord *begin,
+                                     const PrespecializedMetadataRecord *end) {
+  auto &S = PrespecializedMetadata.get();
+  std::lock_guard<std::mutex> guard(S.Lock);
+  queuePrespecializedMetadata(S, begin, end);
+}
+
+static void _addImagePrespecializedMetadataBlock(
+                                             PrespecializedMetadataState &S,
+                                             const uint8_t *records,
+                                             size_t recordsSize) {
+  assert(recordsSize % sizeof(PrespecializedMetadataRecord) == 0
+         && "weird-sized prespecialized metadata section?!");
+
+  auto recordsBegin
+    = reinterpret_cast<const PrespecializedMetadataRecord*>(records);
+  auto recordsEnd
+    = reinterpret_cast<const PrespecializedMetadataRecord*>
+                                                  (records + recordsSize);
+  queuePrespecializedMetadata(S, recordsBegin, recordsEnd);
+}
+
+#if defined(__APPLE__) && defined(__MACH__)
+static void _addImagePrespecializedMetadata(const mach_header *mh,
+                                            intptr_t vmaddr_slide) {
+#ifdef __LP64__
+  using mach_header_platform = mach_header_64;
+  assert(mh->magic == MH_MAGIC_64 && "loaded non-64-bit image?!");
+#else
+  using mach_header_platform = mach_header;
+#endif
+
+  // Look for a __swift2_prespec section.
+  unsigned long recordsSize;
+  const uint8_t *records =
+    getsectiondata(reinterpret_cast<const mach_header_platform *>(mh),
+                   SEG_DATA, SWIFT_PRESPECIALIZED_METADATA_SECTION,
+                   &recordsSize);
+
+  if (!records)
+    return;
+
+  auto &S = PrespecializedMetadata.get();
+  std::lock_guard<std::mutex> guard(S.Lock);
+  _addImagePrespecializedMetadataBlock(S, records, recordsSize);
+}
+#elif defined(__ELF__)
+/// The dlpi_adds count of a loader which doesn't report one.
+static const unsigned long long UnknownAdds = ~0ULL;
+
+/// Reads the dlpi_adds count, which counts the images loaded so far, from
+/// the first image, and stops.
+static int _getLoadedImageAdds(struct dl_phdr_info *info,
+                               size_t size, void *data) {
+  if (size >= offsetof(dl_phdr_info, dlpi_adds) + sizeof(info->dlpi_adds))
+    *static_cast<unsigned long long *>(data) = info->dlpi_adds;
+  return 1;
+}
+
+/// Called with the state's lock held for every loaded image.
+static int _addImagePrespecializedMetadata(struct dl_phdr_info *info,
+                                           size_t size, void *data) {
+  auto &S = *static_cast<PrespecializedMetadataState *>(data);
+
+  if (!S.ScannedImages.insert(info->dlpi_addr).second)
+    return 0;
+
+  void *handle;
+  if (!info->dlpi_name || info->dlpi_name[0] == '\0') {
+    handle = dlopen(nullptr, RTLD_LAZY);
+  } else
+    handle = dlopen(info->dlpi_name, RTLD_LAZY | RTLD_NOLOAD);
+  auto records = reinterpret_cast<const uint8_t*>(
+      dlsym(handle, SWIFT_PRESPECIALIZED_METADATA_SECTION));
+
+  if (!records) {
+    dlclose(handle);
+    return 0;
+  }
+
+  // Extract the size of the records block from the head of the section.
+  auto recordsSize = *reinterpret_cast<const uint64_t*>(records);
+  records += sizeof(recordsSize);
+
+  _addImagePrespecializedMetadataBlock(S, records, recordsSize);
+
+  dlclose(handle);
+  return 0;
+}
+#endif
+
+/// Queue the prespecialized metadata of the images loaded since the last
+/// call.
+///
+/// Dyld tells us about every image as it is loaded, so on Darwin this only
+/// installs the callback. The ELF loader has no such hook, so there we scan
+/// the loaded images again, but only if dlpi_adds shows that one was added.
+static void scanImagesForPrespecializedMetadata(
+                                              PrespecializedMetadataState &S) {
+#if defined(__APPLE__) && defined(__MACH__)
+  static OnceToken_t token;
+  auto callback = [](void*) {
+    // Dyld will invoke this on our behalf for all images that have already
+    // been loaded.
+    _dyld_register_func_for_add_image(_addImagePrespecializedMetadata);
+  };
+  SWIFT_ONCE_F(token, callback, nullptr);
+#elif defined(__ELF__)
+  // Every image reports the same count, so reading it stops at the first
+  // one, and doesn't need the lock.
+  unsigned long long adds = UnknownAdds;
+  dl_iterate_phdr(_getLoadedImageAdds, &adds);
+  if (adds != UnknownAdds &&
+      adds == S.ScannedAdds.load(std::memory_order_acquire))
+    return;
+
+  // Images which were already scanned are skipped. An image loaded after
+  // the count was read makes the next call scan again.
+  std::lock_guard<std::mutex> guard(S.Lock);
+  dl_iterate_phdr(_addImagePrespecializedMetadata, &S);
+  S.ScannedAdds.store(adds, std::memory_order_release);
+#else
+# error No known mechanism to inspect dynamic libraries on this platform.
+#endif
+}
+
+/// Add the queued prespecialized metadata to the caches of its patterns.
+///
+/// This is called when a generic metadata lookup misses, before the runtime
+/// builds its own copy of metadata which an image may have prebuilt. Lookups
+/// which hit never get here, so images are only looked at once a pattern
+/// needs an instance it doesn't have.
+static void registerPendingPrespecializedMetadata() {
+  auto &S = PrespecializedMetadata.get();
+  scanImagesForPrespecializedMetadata(S);
+  if (LLVM_LIKELY(!S.HasPending.load(std::memory_order_acquire)))
+    return;
+
+  // Hold the lock until the records are in the caches, so that no lookup
+  // can miss them in between.
+  std::lock_guard<std::mutex> guard(S.Lock);
+  std::vector<const PrespecializedMetadataRecord *> records;
+  for (auto &block : S.Pending)
+    for (auto record = block.Begin; record != block.End; ++record)
+      records.push_back(record);
+  S.Pending.clear();
+  S.HasPending.store(false, std::memory_order_release);
+
+  // Group the records by pattern, so that each cache is locked only once.
+  std::stable_sort(records.begin(), records.end(),
+                   [](const PrespecializedMetadataRecord *lhs,
+                      const PrespecializedMetadataRecord *rhs) {
+    return std::less<GenericMetadata *>()(lhs->Pattern, rhs->Pattern);
+  });
+
+  std::vector<const void *> keys;
+  std::vector<GenericCacheEntry *> entries;
+  for (size_t i = 0, e = records.size(); i != e; ) {
+    auto pattern = records[i]->Pattern;
+    size_t numArguments = pattern->NumKeyArguments;
+    keys.clear();
+    entries.clear();
+    for (; i != e && records[i]->Pattern == pattern; ++i) {
+      auto entry = GenericCacheEntry::getFromMetadata(pattern,
+                                                      records[i]->Instance);
+      assert(entry->getNumArguments() == numArguments &&
+             "prespecialized metadata does not match its pattern");
+      assert(entry->Value == records[i]->Instance &&
+             "prespecialized metadata entry does not point to its metadata");
+      auto arguments = entry->getArgumentsBuffer();
+      keys.insert(keys.end(), arguments, arguments + numArguments);
+      entries.push_back(entry);
+    }
+
+    // The entries are used in place. If the cache already has metadata for
+    // the same arguments, the existing metadata wins, so that metadata
+    // stays unique.
+    getCache(pattern).addEntries(keys.data(), entries.size(), numArguments,
+      [&](size_t j) -> GenericCacheEntry* {
+        return entries[j];
+      });
+  }
+}
+
 /// Entrypoint for non-generic types with resilient layout.
 const Metadata *
 swift::swift_getResilientMetadata(GenericMetadata *pattern) {
   assert(pattern->NumKeyArguments == 0);
 
-  auto entry = getCache(pattern).findOrAdd(nullptr, 0,
+  auto entry = findOrAddMetadata(getCache(pattern), nullptr, 0,
     [&]() -> GenericCacheEntry* {
       // Create new metadata to cache.
       auto metadata = pattern->CreateFunction(pattern, nullptr);
@@ -252,7 +510,17 @@ swift::swift_getGenericMetadata(GenericMetadata *pattern,
   auto genericArgs = (const void * const *) arguments;
   size_t numGenericArgs = pattern->NumKeyArguments;
 
-  auto entry = getCache(pattern).findOrAdd(genericArgs, numGenericArgs,
+  auto &cache = getCache(pattern);
+  if (auto entry = cache.find(genericArgs, numGenericArgs)) {
+    SWIFT_STATS_COUNT(MetadataCacheHit);
+    return entry->Value;
+  }
+
+  // An image may have prebuilt this metadata; if so, it has to be in the
+  // cache before the runtime builds a copy of its own.
+  registerPendingPrespecializedMetadata();
+
+  auto entry = findOrAddMetadata(cache, genericArgs, numGenericArgs,
     [&]() -> GenericCacheEntry* {
       // Create new metadata to cache.
       auto metadata = pattern->CreateFunction(pattern, arguments);
@@ -338,7 +606,7 @@ swift::swift_getObjCClassMetadata(const ClassMetadata *theClass) {
   const size_t numGenericArgs = 1;
   const void *args[] = { theClass };
   auto &Wrappers = ObjCClassWrappers.get();
-  auto entry = Wrappers.findOrAdd(args, numGenericArgs,
+  auto entry = findOrAddMetadata(Wrappers, args, numGenericArgs,
     [&]() -> ObjCClassCacheEntry* {
       // Create a new entry for the cache.
       auto entry = ObjCClassCacheEntry::allocate(Wrappers.getAllocator(),
@@ -476,7 +744,7 @@ swift::swift_getFunctionTypeMetadata(const void *flagsArgsAndResult[]) {
     1;
   auto &Types = FunctionTypes.get();
   
-  auto entry = Types.findOrAdd(flagsArgsAndResult, numKeyArguments,
+  auto entry = findOrAddMetadata(Types, flagsArgsAndResult, numKeyArguments,
     [&]() -> FunctionCacheEntry* {
       // Create a new entry for the cache.
       auto entry = FunctionCacheEntry::allocate(
@@ -1010,7 +1278,7 @@ swift::swift_getTupleTypeMetadata(size_t numElements,
   // FIXME: include labels when uniquing!
   auto genericArgs = (const void * const *) elements;
   auto &Types = TupleTypes.get();
-  auto entry = Types.findOrAdd(genericArgs, numElements,
+  auto entry = findOrAddMetadata(Types, genericArgs, numElements,
     [&]() -> TupleCacheEntry* {
       // Create a new entry for the cache.
 
@@ -1686,7 +1954,7 @@ swift::swift_getMetatypeMetadata(const Metadata *instanceMetadata) {
   const size_t numGenericArgs = 1;
   const void *args[] = { instanceMetadata };
   auto &Types = MetatypeTypes.get();
-  auto entry = Types.findOrAdd(args, numGenericArgs,
+  auto entry = findOrAddMetadata(Types, args, numGenericArgs,
     [&]() -> MetatypeCacheEntry* {
       // Create a new entry for the cache.
       auto entry = MetatypeCacheEntry::allocate(Types.getAllocator(),
@@ -1797,7 +2065,7 @@ swift::swift_getExistentialMetatypeMetadata(const Metadata *instanceMetadata) {
   const size_t numGenericArgs = 1;
   const void *args[] = { instanceMetadata };
   auto &EM = ExistentialMetatypes.get();
-  auto entry = EM.Types.findOrAdd(args, numGenericArgs,
+  auto entry = findOrAddMetadata(EM.Types, args, numGenericArgs,
     [&]() -> ExistentialMetatypeCacheEntry* {
       // Create a new entry for the cache.
       auto entry =
@@ -2170,7 +2438,7 @@ swift::swift_getExistentialTypeMetadata(size_t numProtocols,
   auto protocolArgs = reinterpret_cast<const void * const *>(protocols);
 
   auto &E = Existentials.get();
-  auto entry = E.Types.findOrAdd(protocolArgs, numProtocols,
+  auto entry = findOrAddMetadata(E.Types, protocolArgs, numProtocols,
     [&]() -> ExistentialCacheEntry* {
       // Create a new entry for the cache.
       auto entry = ExistentialCacheEntry::allocate(E.Types.getAllocator(),
@@ -14,8 +14,12 @@
 
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/STLExtras.h"
-#include "swift/Runtime/Concurrent.h"
 #include "swift/Runtime/Metadata.h"
+#include "swift/Basic/Malloc.h"
+#include "RuntimeStats.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 
@@ -138,26 +142,97 @@ public:
   }
 };
 
-/// The implementation of a metadata cache.  Note that all-zero must
-/// be a valid state for the cache.
+/// The implementation of a metadata cache.
+///
+/// Entries live in an open-addressed hash table with linear probing.  Each
+/// slot stores the hash and the length of its key, and short keys are stored
+/// inline in the slot, so a successful lookup is a single probe sequence over
+/// adjacent cache lines that never needs to take a lock.
+///
+/// Misses take a short lock to claim a slot, but the entry itself is built
+/// outside of the lock.  While an entry is under construction its slot points
+/// to a ConstructionRecord; threads that look up the same key wait for it to
+/// be completed, while threads that miss on different keys proceed
+/// concurrently.  Records are only looked into under the lock, which lets
+/// them be freed as soon as their entry is published.
+///
+/// The table is never shrunk and superseded tables are not freed until the
+/// cache is destroyed, because lock-free readers may still be scanning them.
+/// Every key present in an old table is also present in its replacement, so
+/// a reader on an old table at worst misses a recent insertion and retries
+/// under the lock.
 template <class Entry> class MetadataCache {
+  /// The number of key arguments that are stored directly in a slot.
+  enum : unsigned { InlineKeyCapacity = 2 };
 
-  /// This pair ties an EntryRef Key and an Entry Value.
-  struct EntryPair {
-    EntryPair(EntryRef<Entry> K, Entry* V) : Key(K), Value(V) {}
-    EntryRef<Entry> Key;
-    Entry* Value;
+  /// The state of an entry whose construction has been started.
+  struct ConstructionRecord {
+    /// The key arguments, if they don't fit inline in the slot.
+    std::unique_ptr<const void *[]> Arguments;
   };
 
-  /// This collection maps hash codes to a list of entry pairs.
-  typedef ConcurrentMap<size_t, EntryPair> MDMapTy;
+  /// A slot in the hash table.  All the fields except Value are written
+  /// before Value is published and never change afterwards.
+  struct Slot {
+    /// Null if the slot is empty. Otherwise, either a pointer to the Entry
+    /// or a pointer to a ConstructionRecord tagged with ConstructionTag.
+    std::atomic<uintptr_t> Value;
 
-  /// This map hash codes of entry refs to a list of entry pairs.
-  MDMapTy *Map;
+    /// The high bits of the key's hash.
+    uint32_t HashFragment;
+
+    /// The number of key arguments.
+    uint32_t NumArguments;
+
+    /// The key arguments, if there are at most InlineKeyCapacity of them.
+    const void *InlineArguments[InlineKeyCapacity];
+  };
+
+  enum : uintptr_t { ConstructionTag = 1 };
+
+  /// A power-of-two sized array of slots.
+  struct Table {
+    /// The number of slots in the table.
+    size_t Capacity;
+
+    /// The number of non-empty slots in the table.
+    size_t Count;
+
+    /// The table that this table replaced, kept alive for readers.
+    Table *Previous;
+
+    Slot *getSlots() { return reinterpret_cast<Slot *>(this + 1); }
+
+    static Table *allocate(size_t capacity, Table *previous) {
+      size_t size = sizeof(Table) + capacity * sizeof(Slot);
+      // Align the table to a cache line so that slots don't straddle lines.
+      void *buffer = AlignedAlloc(size, 64);
+      memset(buffer, 0, size);
+      auto table = reinterpret_cast<Table *>(buffer);
+      table->Capacity = capacity;
+      table->Previous = previous;
+      return table;
+    }
+  };
+
+  static_assert(sizeof(Table) % alignof(Slot) == 0,
+                "slots must be aligned after the table header");
+
+  /// The synchronization state used on the slow path.
+  struct Synchronization {
+    /// Guards slot claims, table growth and entry publication.
+    std::mutex Lock;
+
+    /// Signalled whenever an entry finishes construction.
+    std::condition_variable Completion;
+  };
+
+  /// The current table, or null if nothing has been added yet.
+  std::atomic<Table *> Current;
 
   /// Synchronization of metadata creation.
-  std::mutex *Lock;
-  
+  Synchronization *Sync;
+
   /// The head of a linked list connecting all the metadata cache entries.
   /// TODO: Remove this when LLDB is able to understand the final data
   /// structure for the metadata cache.
@@ -165,60 +240,242 @@ template <class Entry> class MetadataCache {
 
   /// Allocator for entries of this cache.
   MetadataAllocator Allocator;
-  
+
+  static uint32_t getHashFragment(size_t hash) {
+    return uint32_t(uint64_t(hash) >> (sizeof(size_t) * 8 - 32));
+  }
+
+  static ConstructionRecord *getRecord(uintptr_t value) {
+    if (!(value & ConstructionTag)) return nullptr;
+    return reinterpret_cast<ConstructionRecord *>(value & ~ConstructionTag);
+  }
+
+  /// Does the slot hold the given key?  Must be called with the lock held
+  /// if \p value is a construction record.
+  static bool matches(Slot &slot, uintptr_t value, uint32_t fragment,
+                      EntryRef<Entry> key) {
+    if (slot.HashFragment != fragment || slot.NumArguments != key.size())
+      return false;
+
+    const void * const *arguments;
+    if (key.size() <= InlineKeyCapacity)
+      arguments = slot.InlineArguments;
+    else if (auto record = getRecord(value))
+      arguments = record->Arguments.get();
+    else
+      arguments = reinterpret_cast<const Entry *>(value)->getArgumentsBuffer();
+
+    auto keyArguments = key.begin();
+    for (unsigned i = 0, e = key.size(); i != e; ++i)
+      if (arguments[i] != keyArguments[i]) return false;
+    return true;
+  }
+
+  /// Probe the table for the given key.  Returns the matching slot, or the
+  /// empty slot that ends the probe sequence if there is no match.
+  ///
+  /// Without the lock, a record may be freed while it is being looked at, so
+  /// the probe stops at the first record that could hold the key and leaves
+  /// it to the caller to check again under the lock.
+  template <bool Locked>
+  static Slot &probe(Table *table, EntryRef<Entry> key, size_t hash,
+                     uintptr_t &value) {
+    uint32_t fragment = getHashFragment(hash);
+    size_t mask = table->Capacity - 1;
+    Slot *slots = table->getSlots();
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+      Slot &slot = slots[i];
+      value = slot.Value.load(std::memory_order_acquire);
+      if (!value)
+        return slot;
+      if (!Locked && getRecord(value)) {
+        if (slot.HashFragment == fragment && slot.NumArguments == key.size())
+          return slot;
+        continue;
+      }
+      if (matches(slot, value, fragment, key))
+        return slot;
+    }
+  }
+
+  /// Look for an existing entry without taking any locks.  Returns null if
+  /// there is none, or if it may still be under construction.
+  const Entry *lookup(EntryRef<Entry> key, size_t hash) {
+    Table *table = Current.load(std::memory_order_acquire);
+    if (!table)
+      return nullptr;
+
+    uintptr_t value;
+    probe<false>(table, key, hash, value);
+    if (LLVM_LIKELY(value && !getRecord(value)))
+      return reinterpret_cast<const Entry *>(value);
+    return nullptr;
+  }
+
+  /// Return the table to insert into, growing the current one if it would
+  /// go over a 3/4 load factor.  Must be called with the lock held.
+  Table *getTableForInsertion() {
+    Table *table = Current.load(std::memory_order_relaxed);
+    if (table && (table->Count + 1) * 4 <= table->Capacity * 3)
+      return table;
+
+    size_t capacity = table ? table->Capacity * 2 : 16;
+    Table *newTable = Table::allocate(capacity, table);
+    if (table) {
+      // Rehash the existing slots. Slots are immutable apart from Value, and
+      // Value only changes under the lock, so they can be copied wholesale.
+      size_t mask = capacity - 1;
+      Slot *oldSlots = table->getSlots();
+      Slot *newSlots = newTable->getSlots();
+      for (size_t i = 0; i != table->Capacity; ++i) {
+        Slot &oldSlot = oldSlots[i];
+        uintptr_t value = oldSlot.Value.load(std::memory_order_relaxed);
+        if (!value) continue;
+
+        size_t hash = getHashForSlot(oldSlot, value);
+        size_t j = hash & mask;
+        while (newSlots[j].Value.load(std::memory_order_relaxed))
+          j = (j + 1) & mask;
+
+        Slot &newSlot = newSlots[j];
+        newSlot.HashFragment = oldSlot.HashFragment;
+        newSlot.NumArguments = oldSlot.NumArguments;
+        memcpy(newSlot.InlineArguments, oldSlot.InlineArguments,
+               sizeof(oldSlot.InlineArguments));
+        newSlot.Value.store(value, std::memory_order_relaxed);
+      }
+      newTable->Count = table->Count;
+    }
+
+    Current.store(newTable, std::memory_order_release);
+    return newTable;
+  }
+
+  /// Fill in the immutable fields of a newly claimed slot for \p key.
+  static void initSlot(Slot &slot, EntryRef<Entry> key, size_t hash) {
+    slot.HashFragment = getHashFragment(hash);
+    slot.NumArguments = key.size();
+    if (key.size() <= InlineKeyCapacity)
+      std::copy(key.begin(), key.end(), slot.InlineArguments);
+  }
+
+  /// Recompute the full hash of the key stored in a slot.
+  static size_t getHashForSlot(Slot &slot, uintptr_t value) {
+    const void * const *arguments;
+    if (slot.NumArguments <= InlineKeyCapacity)
+      arguments = slot.InlineArguments;
+    else if (auto record = getRecord(value))
+      arguments = record->Arguments.get();
+    else
+      arguments = reinterpret_cast<const Entry *>(value)->getArgumentsBuffer();
+    return EntryRef<Entry>::forArguments(arguments, slot.NumArguments).hash();
+  }
+
 public:
-  MetadataCache() : Map(new MDMapTy()), Lock(new std::mutex()) {}
-  ~MetadataCache() { delete Map; delete Lock; }
+  MetadataCache()
+    : Current(nullptr), Sync(new Synchronization()), Head(nullptr) {}
+  ~MetadataCache() {
+    Table *table = Current.load(std::memory_order_relaxed);
+    while (table) {
+      Table *previous = table->Previous;
+      AlignedFree(table);
+      table = previous;
+    }
+    delete Sync;
+  }
 
   /// Caches are not copyable.
   MetadataCache(const MetadataCache &other) = delete;
   MetadataCache &operator=(const MetadataCache &other) = delete;
 
   /// Get the allocator for metadata in this cache.
-  /// The allocator can only be safely used while the cache is locked during
-  /// an addMetadataEntry call.
+  /// The allocator is thread-safe, so it can be used by concurrent
+  /// entryBuilder calls for different keys.
   MetadataAllocator &getAllocator() { return Allocator; }
 
-  /// Call entryBuilder() and add the generated metadata to the cache.
-  /// \p key is the key used by the cache and \p Bucket is the cache
-  /// entry to place the new metadata entry.
+  /// Claim a slot for \p key, call entryBuilder() and publish the generated
+  /// metadata in the cache.
   /// This method is marked as 'noinline' because it is infrequently executed
   /// and marking it as such generates better code that is easier to analyze
   /// and profile.
   __attribute__ ((noinline))
-  const Entry *addMetadataEntry(EntryRef<Entry> key,
-                                ConcurrentList<EntryPair> &Bucket,
+  const Entry *addMetadataEntry(EntryRef<Entry> key, size_t hash,
                                 llvm::function_ref<Entry *()> entryBuilder) {
-    // Hold a lock to prevent the modification of the cache by multiple threads.
-    std::unique_lock<std::mutex> ConstructionGuard(*Lock);
-
-    // Some other thread may have setup the value we are about to construct
-    // while we were asleep so do a search before constructing a new value.
-    for (auto &A : Bucket) {
-      if (A.Key == key) return A.Value;
+    ConstructionRecord *record;
+    {
+      // Hold the lock only long enough to claim a slot.
+      std::unique_lock<std::mutex> guard(Sync->Lock);
+
+      // Some other thread may have claimed the slot for this key while we
+      // were waiting for the lock, so do a search before claiming it.  If
+      // the entry is still being constructed, wait for it; its record is
+      // freed once it is published, so search again after every wakeup.
+      while (Table *table = Current.load(std::memory_order_relaxed)) {
+        uintptr_t value;
+        probe<true>(table, key, hash, value);
+        if (!value)
+          break;
+        if (!getRecord(value))
+          return reinterpret_cast<const Entry *>(value);
+        Sync->Completion.wait(guard);
+      }
+
+      Table *table = getTableForInsertion();
+
+      record = new ConstructionRecord();
+
+      uintptr_t value;
+      Slot &slot = probe<true>(table, key, hash, value);
+      assert(!value && "found a key that we just failed to find");
+      initSlot(slot, key, hash);
+      if (key.size() > InlineKeyCapacity) {
+        // Keep a copy of the key for the lookups that race with the
+        // construction; the caller's buffer may not outlive this call.
+        record->Arguments.reset(new const void *[key.size()]);
+        std::copy(key.begin(), key.end(), record->Arguments.get());
+      }
+      slot.Value.store(reinterpret_cast<uintptr_t>(record) | ConstructionTag,
+                       std::memory_order_release);
+      ++table->Count;
     }
 
     // Build the new cache entry.
     // For some cache types this call may re-entrantly perform additional
-    // cache lookups.
-    // Notice that the entry is completly constructed before it is inserted
-    // into the map, and that only one entry can be constructed at once
-    // because of the lock above.
+    // cache lookups, which are free to claim slots for other keys.
     Entry *entry = entryBuilder();
     assert(entry);
-
-    // Update the linked list.
-    entry->Next = Head;
-    Head = entry;
-
-    key = EntryRef<Entry>::forEntry(entry, entry->getNumArguments());
-    Bucket.push_front(EntryPair(key, entry));
+    assert(!(reinterpret_cast<uintptr_t>(entry) & ConstructionTag) &&
+           "cache entries must be pointer-aligned");
+
+    {
+      std::unique_lock<std::mutex> guard(Sync->Lock);
+
+      // Update the linked list.
+      entry->Next = Head;
+      Head = entry;
+
+      // Replace the record with the entry in every table that has it,
+      // including the superseded ones that lock-free readers may still be
+      // scanning, so that nothing points at the record any more.
+      uintptr_t recordValue =
+        reinterpret_cast<uintptr_t>(record) | ConstructionTag;
+      for (Table *table = Current.load(std::memory_order_relaxed); table;
+           table = table->Previous) {
+        uintptr_t value;
+        Slot &slot = probe<true>(table, key, hash, value);
+        if (value == recordValue)
+          slot.Value.store(reinterpret_cast<uintptr_t>(entry),
+                           std::memory_order_release);
+      }
+    }
+    Sync->Completion.notify_all();
+    delete record;
 
 #if SWIFT_DEBUG_RUNTIME
     printf("%s(%p): created %p\n",
            Entry::getName(), this, entry);
 #endif
-    return key.getEntry();
+    return entry;
   }
 
   /// Look up a cached metadata entry. If a cache match exists, return it.
@@ -242,19 +499,87 @@ public:
            Entry::getName(), this, hash);
 #endif
 
-    // Look for an existing entry.
-    // Find the bucket for the metadata entry.
-    ConcurrentList<EntryPair> &Bucket = Map->findOrAllocateNode(hash);
-    // Scan the bucket and return the value if we found the key.
-    for (auto &A : Bucket) {
-      if (A.Key == key) return A.Value;
-    }
+    // Look for an existing entry without taking any locks.
+    if (auto entry = lookup(key, hash))
+      return entry;
 
     // We did not find a key so we will need to create one and store it.
-    return addMetadataEntry(key, Bucket, entryBuilder);
+    return addMetadataEntry(key, hash, entryBuilder);
+  }
+
+  /// Add entries for several keys, taking the lock only once.  The keys are
+  /// laid out one after the other in \p keys, each \p numArguments long.
+  /// Keys that are already in the cache keep their entry.
+  ///
+  /// entryBuilder(i) builds the entry for the i-th key.  It is called with
+  /// the lock held, so it must not use this cache.
+  void addEntries(const void * const *keys, size_t numKeys,
+                  size_t numArguments,
+                  llvm::function_ref<Entry *(size_t)> entryBuilder) {
+    std::unique_lock<std::mutex> guard(Sync->Lock);
+    for (size_t i = 0; i != numKeys; ++i) {
+      EntryRef<Entry> key =
+        EntryRef<Entry>::forArguments(keys + i * numArguments, numArguments);
+      size_t hash = key.hash();
+
+      uintptr_t value;
+      if (Table *table = Current.load(std::memory_order_relaxed)) {
+        probe<true>(table, key, hash, value);
+        if (value)
+          continue;
+      }
+
+      Table *table = getTableForInsertion();
+      Entry *entry = entryBuilder(i);
+      assert(entry);
+      entry->Next = Head;
+      Head = entry;
+
+      Slot &slot = probe<true>(table, key, hash, value);
+      initSlot(slot, key, hash);
+      slot.Value.store(reinterpret_cast<uintptr_t>(entry),
+                       std::memory_order_release);
+      ++table->Count;
+    }
+  }
+
+  /// Look up a cached metadata entry without adding one. Returns null if
+  /// the cache has no entry for the key.
+  const Entry *find(const void * const *arguments, size_t numArguments) {
+    EntryRef<Entry> key = EntryRef<Entry>::forArguments(arguments,numArguments);
+    return lookup(key, key.hash());
   }
 };
 
+/// Look up a type metadata entry, calling entryBuilder() to build it if it's
+/// missing, and record the metadata cache statistics.
+///
+/// The metadata entry points use this instead of findOrAdd, so that the
+/// other caches built on MetadataCache, such as the conformance index and
+/// the type name cache, don't count towards those statistics.
+template <class Entry, class EntryBuilder>
+static inline const Entry *
+findOrAddMetadata(MetadataCache<Entry> &cache,
+                  const void * const *arguments, size_t numArguments,
+                  EntryBuilder &&entryBuilder) {
+#if SWIFT_RUNTIME_ENABLE_STATS
+  bool built = false;
+  auto entry = cache.findOrAdd(arguments, numArguments, [&]() -> Entry* {
+    built = true;
+    // Metadata built re-entrantly for other keys is included in this time.
+    SWIFT_STATS_TIME(MetadataInstantiation);
+    return entryBuilder();
+  });
+  if (built)
+    SWIFT_STATS_COUNT(MetadataCacheMiss);
+  else
+    SWIFT_STATS_COUNT(MetadataCacheHit);
+  return entry;
+#else
+  return cache.findOrAdd(arguments, numArguments, entryBuilder);
+#endif
+}
+
 } // namespace swift
 
 #endif // SWIFT_RUNTIME_METADATACACHE_H
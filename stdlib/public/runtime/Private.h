@@ -18,6 +18,7 @@
 #define SWIFT_RUNTIME_PRIVATE_H
 
 #include "swift/Runtime/Config.h"
+#include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
 #include "llvm/Support/Compiler.h"
 
@@ -91,6 +92,30 @@ namespace swift {
   LLVM_LIBRARY_VISIBILITY
   bool usesNativeSwiftReferenceCounting(const ClassMetadata *theClass);
 
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  /// Return the biased reference count in front of an object allocated by
+  /// swift_allocObject. Only valid if weakRefCount.hasBiasedRefCount().
+  static inline BiasedRefCount *getBiasedRefCount(const HeapObject *object) {
+    return reinterpret_cast<BiasedRefCount *>(
+             const_cast<HeapObject *>(object)) - 1;
+  }
+
+  /// Return the strong reference count of an object, including references
+  /// counted by its owning thread.
+  static inline uint32_t getStrongRefCount(const HeapObject *object) {
+    if (!object->weakRefCount.hasBiasedRefCount())
+      return object->refCount.getCount();
+    return getBiasedRefCount(object)->getCount() +
+           object->refCount.getSharedCount();
+  }
+
+  /// Return whether an object has a strong reference count of 1. Only the
+  /// owning thread can read an object's biased count, so other threads
+  /// answer false until the biased count has been merged.
+  LLVM_LIBRARY_VISIBILITY
+  bool isUniquelyReferencedBiased(const HeapObject *object);
+#endif
+
   /// Get the superclass pointer value used for Swift root classes.
   /// Note that this function may return a nullptr on non-objc platforms,
   /// where there is no common root class. rdar://problem/18987058
@@ -0,0 +1,102 @@
+//===--- RuntimeStats.h - Runtime statistics --------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Macros for recording runtime statistics. They expand to nothing unless the
+// runtime is built with SWIFT_RUNTIME_ENABLE_STATS.
+//
+// Each thread records into its own block of counters, so recording an event
+// is a thread-local load and store without any atomic read-modify-write.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SWIFT_STDLIB_RUNTIME_RUNTIMESTATS_H
+#define SWIFT_STDLIB_RUNTIME_RUNTIMESTATS_H
+
+#if SWIFT_RUNTIME_ENABLE_STATS
+
+#include "swift/Runtime/Stats.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <chrono>
+
+namespace swift {
+
+/// The statistics recorded by one thread. Only the owning thread writes to
+/// them, but any thread may read them.
+struct RuntimeThreadStats {
+  std::atomic<uint64_t> Counters[NumRuntimeCounters];
+  std::atomic<uint64_t> TimerBuckets[NumRuntimeTimers][NumRuntimeTimerBuckets];
+
+  /// The list of all live threads' statistics.
+  RuntimeThreadStats *Next;
+  RuntimeThreadStats *Prev;
+};
+
+/// The statistics of the current thread, or null if it has not recorded
+/// anything yet.
+extern LLVM_LIBRARY_VISIBILITY __thread RuntimeThreadStats *
+_swift_currentThreadStats;
+
+/// Create and register the statistics of the current thread.
+LLVM_LIBRARY_VISIBILITY RuntimeThreadStats *_swift_createThreadStats();
+
+static inline RuntimeThreadStats &getRuntimeThreadStats() {
+  auto stats = _swift_currentThreadStats;
+  if (LLVM_UNLIKELY(!stats))
+    stats = _swift_createThreadStats();
+  return *stats;
+}
+
+/// Bump a counter of the current thread. Only this thread writes to the
+/// counter, so a relaxed load and store is enough.
+static inline void countRuntimeEvent(RuntimeCounter counter, uint64_t n = 1) {
+  auto &value = getRuntimeThreadStats().Counters[unsigned(counter)];
+  value.store(value.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+}
+
+/// Record the duration of an operation in a timer's histogram.
+LLVM_LIBRARY_VISIBILITY void recordRuntimeTime(RuntimeTimer timer,
+                                               uint64_t nanoseconds);
+
+/// Times the scope it is declared in.
+class RuntimeTimerScope {
+  RuntimeTimer Timer;
+  std::chrono::steady_clock::time_point Start;
+
+public:
+  explicit RuntimeTimerScope(RuntimeTimer timer)
+    : Timer(timer), Start(std::chrono::steady_clock::now()) {}
+
+  RuntimeTimerScope(const RuntimeTimerScope &) = delete;
+  RuntimeTimerScope &operator=(const RuntimeTimerScope &) = delete;
+
+  ~RuntimeTimerScope() {
+    auto elapsed = std::chrono::steady_clock::now() - Start;
+    recordRuntimeTime(Timer,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+};
+
+} // end namespace swift
+
+#define SWIFT_STATS_COUNT(Name)                                                \
+  ::swift::countRuntimeEvent(::swift::RuntimeCounter::Name)
+#define SWIFT_STATS_TIME(Name)                                                 \
+  ::swift::RuntimeTimerScope _swift_stats_timer_##Name(                        \
+    ::swift::RuntimeTimer::Name)
+#else
+#define SWIFT_STATS_COUNT(Name)
+#define SWIFT_STATS_TIME(Name)
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+//===--- Stats.cpp - Runtime statistics -----------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Implementation of the per-thread runtime counters and timers, and of the
+// C API for reading them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/Stats.h"
+#include "RuntimeStats.h"
+#include <cstdio>
+
+#if SWIFT_RUNTIME_ENABLE_STATS
+#include "swift/Basic/Lazy.h"
+#include "llvm/Support/MathExtras.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#endif
+
+using namespace swift;
+
+static const char * const CounterNames[] = {
+#define RUNTIME_COUNTER(Name, Description) #Name,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+static const char * const CounterDescriptions[] = {
+#define RUNTIME_COUNTER(Name, Description) Description,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+static const char * const TimerNames[] = {
+#define RUNTIME_TIMER(Name, Description) #Name,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+static const char * const TimerDescriptions[] = {
+#define RUNTIME_TIMER(Name, Description) Description,
+#include "swift/Runtime/RuntimeStats.def"
+};
+
+#if SWIFT_RUNTIME_ENABLE_STATS
+
+namespace {
+
+struct StatsRegistry {
+  std::mutex Lock;
+
+  /// The statistics of all live threads which have recorded anything.
+  RuntimeThreadStats *Threads;
+
+  /// The accumulated statistics of threads which have exited.
+  RuntimeThreadStats Exited;
+
+  /// Folds the statistics of exiting threads into Exited.
+  pthread_key_t ThreadKey;
+
+  StatsRegistry();
+};
+
+} // end anonymous namespace
+
+static Lazy<StatsRegistry> Registry;
+
+__thread RuntimeThreadStats *swift::_swift_currentThreadStats;
+
+static void destroyThreadStats(void *stats);
+
+static void dumpStatsAtExit() {
+  swift_stats_dump();
+}
+
+StatsRegistry::StatsRegistry() : Threads(nullptr), Exited() {
+  pthread_key_create(&ThreadKey, destroyThreadStats);
+
+  const char *dump = getenv("SWIFT_RUNTIME_STATS");
+  if (dump && *dump && strcmp(dump, "0") != 0)
+    atexit(dumpStatsAtExit);
+}
+
+RuntimeThreadStats *swift::_swift_createThreadStats() {
+  auto &registry = Registry.get();
+  // Value-initialize so that all counters start out as zero.
+  auto stats = new RuntimeThreadStats();
+  {
+    std::lock_guard<std::mutex> guard(registry.Lock);
+    stats->Next = registry.Threads;
+    if (registry.Threads)
+      registry.Threads->Prev = stats;
+    registry.Threads = stats;
+  }
+  pthread_setspecific(registry.ThreadKey, stats);
+  _swift_currentThreadStats = stats;
+  return stats;
+}
+
+static void destroyThreadStats(void *_stats) {
+  auto stats = static_cast<RuntimeThreadStats *>(_stats);
+  auto &registry = Registry.unsafeGetAlreadyInitialized();
+  {
+    std::lock_guard<std::mutex> guard(registry.Lock);
+    auto &exited = registry.Exited;
+    for (unsigned i = 0; i < NumRuntimeCounters; ++i)
+      exited.Counters[i].fetch_add(
+        stats->Counters[i].load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    for (unsigned i = 0; i < NumRuntimeTimers; ++i)
+      for (unsigned j = 0; j < NumRuntimeTimerBuckets; ++j)
+        exited.TimerBuckets[i][j].fetch_add(
+          stats->TimerBuckets[i][j].load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+
+    if (stats->Prev)
+      stats->Prev->Next = stats->Next;
+    else
+      registry.Threads = stats->Next;
+    if (stats->Next)
+      stats->Next->Prev = stats->Prev;
+  }
+
+  // Events recorded by later thread-specific destructors start a new block.
+  if (_swift_currentThreadStats == stats)
+    _swift_currentThreadStats = nullptr;
+  delete stats;
+}
+
+void swift::recordRuntimeTime(RuntimeTimer timer, uint64_t nanoseconds) {
+  unsigned bucket = nanoseconds < 2 ? 0 : llvm::Log2_64(nanoseconds);
+  if (bucket >= NumRuntimeTimerBuckets)
+    bucket = NumRuntimeTimerBuckets - 1;
+  auto &value = getRuntimeThreadStats().TimerBuckets[unsigned(timer)][bucket];
+  value.store(value.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+/// Calls \p fn on the statistics of every thread, including the ones which
+/// have exited, while holding the registry lock.
+template <class Fn>
+static void forEachThreadStats(Fn fn) {
+  auto &registry = Registry.get();
+  std::lock_guard<std::mutex> guard(registry.Lock);
+  fn(registry.Exited);
+  for (auto stats = registry.Threads; stats; stats = stats->Next)
+    fn(*stats);
+}
+
+#endif // SWIFT_RUNTIME_ENABLE_STATS
+
+bool swift::swift_stats_isEnabled() {
+#if SWIFT_RUNTIME_ENABLE_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+unsigned swift::swift_stats_getNumCounters() {
+  return NumRuntimeCounters;
+}
+
+const char *swift::swift_stats_getCounterName(unsigned counter) {
+  if (counter >= NumRuntimeCounters)
+    return nullptr;
+  return CounterNames[counter];
+}
+
+uint64_t swift::swift_stats_getCounter(unsigned counter) {
+  uint64_t total = 0;
+#if SWIFT_RUNTIME_ENABLE_STATS
+  if (counter < NumRuntimeCounters)
+    forEachThreadStats([&](RuntimeThreadStats &stats) {
+      total += stats.Counters[counter].load(std::memory_order_relaxed);
+    });
+#endif
+  return total;
+}
+
+unsigned swift::swift_stats_getNumTimers() {
+  return NumRuntimeTimers;
+}
+
+const char *swift::swift_stats_getTimerName(unsigned timer) {
+  if (timer >= NumRuntimeTimers)
+    return nullptr;
+  return TimerNames[timer];
+}
+
+unsigned swift::swift_stats_getNumTimerBuckets() {
+  return NumRuntimeTimerBuckets;
+}
+
+uint64_t swift::swift_stats_getTimerBucket(unsigned timer, unsigned bucket) {
+  uint64_t total = 0;
+#if SWIFT_RUNTIME_ENABLE_STATS
+  if (timer < NumRuntimeTimers && bucket < NumRuntimeTimerBuckets)
+    forEachThreadStats([&](RuntimeThreadStats &stats) {
+      total += stats.TimerBuckets[timer][bucket].load(
+        std::memory_order_relaxed);
+    });
+#endif
+  return total;
+}
+
+void swift::swift_stats_reset() {
+#if SWIFT_RUNTIME_ENABLE_STATS
+  forEachThreadStats([&](RuntimeThreadStats &stats) {
+    for (auto &counter : stats.Counters)
+      counter.store(0, std::memory_order_relaxed);
+    for (auto &buckets : stats.TimerBuckets)
+      for (auto &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+  });
+#endif
+}
+
+void swift::swift_stats_dump() {
+  if (!swift_stats_isEnabled()) {
+    fprintf(stderr, "Swift runtime statistics are not enabled in this "
+                    "build.\n");
+    return;
+  }
+
+  fprintf(stderr, "Swift runtime statistics:\n");
+  for (unsigned i = 0; i < NumRuntimeCounters; ++i) {
+    if (uint64_t value = swift_stats_getCounter(i))
+      fprintf(stderr, "%14llu %s - %s\n", (unsigned long long)value,
+              CounterNames[i], CounterDescriptions[i]);
+  }
+
+  for (unsigned i = 0; i < NumRuntimeTimers; ++i) {
+    uint64_t buckets[NumRuntimeTimerBuckets];
+    uint64_t total = 0;
+    for (unsigned j = 0; j < NumRuntimeTimerBuckets; ++j)
+      total += buckets[j] = swift_stats_getTimerBucket(i, j);
+    if (!total)
+      continue;
+
+    fprintf(stderr, "%14llu %s - %s\n", (unsigned long long)total,
+            TimerNames[i], TimerDescriptions[i]);
+    for (unsigned j = 0; j < NumRuntimeTimerBuckets; ++j) {
+      if (!buckets[j])
+        continue;
+      if (j == NumRuntimeTimerBuckets - 1)
+        fprintf(stderr, "%14llu   >= %llu ns\n",
+                (unsigned long long)buckets[j], 1ULL << j);
+      else
+        fprintf(stderr, "%14llu   <  %llu ns\n",
+                (unsigned long long)buckets[j], 2ULL << j);
+    }
+  }
+}
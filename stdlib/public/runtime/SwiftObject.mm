@@ -1341,7 +1341,11 @@ bool swift::swift_isUniquelyReferenced_nonNull_native(
   assert(object != nullptr);
   assert(!object->refCount.isDeallocating());
   SWIFT_ISUNIQUELYREFERENCED();
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  return isUniquelyReferencedBiased(object);
+#else
   return object->refCount.isUniquelyReferenced();
+#endif
 }
 
 bool swift::swift_isUniquelyReferenced_native(const HeapObject* object) {
@@ -1447,7 +1451,11 @@ bool swift::swift_isUniquelyReferencedOrPinned_nonNull_native(
   SWIFT_ISUNIQUELYREFERENCEDORPINNED();
   assert(object != nullptr);
   assert(!object->refCount.isDeallocating());
+#if SWIFT_RUNTIME_ENABLE_BIASED_REFCOUNT
+  return object->refCount.isPinned() || isUniquelyReferencedBiased(object);
+#else
   return object->refCount.isUniquelyReferencedOrPinned();
+#endif
 }
 
 #if SWIFT_OBJC_INTEROP
@@ -0,0 +1,4 @@
+# Dependencies after compilation:
+provides-top-level: [bad]
+fingerprints: [[bad, "bad-after"]]
+interface-hash: "after"
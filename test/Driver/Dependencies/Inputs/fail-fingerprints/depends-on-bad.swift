@@ -0,0 +1,5 @@
+# Dependencies after compilation:
+depends-top-level: [bad]
+provides-top-level: [other]
+fingerprints: [[other, "other-same"]]
+interface-hash: "same"
@@ -0,0 +1,4 @@
+# Dependencies after compilation:
+provides-top-level: [a, b]
+fingerprints: [[a, "a-after"], [b, "b-same"]]
+interface-hash: "after"
@@ -0,0 +1,5 @@
+# Dependencies after compilation:
+depends-top-level: [a]
+provides-top-level: [c]
+fingerprints: [[c, "c-same"]]
+interface-hash: "same"
@@ -0,0 +1,5 @@
+# Dependencies after compilation:
+depends-top-level: [b]
+provides-top-level: [d]
+fingerprints: [[d, "d-same"]]
+interface-hash: "same"
@@ -0,0 +1,47 @@
+/// bad ==> depends-on-bad
+/// The fingerprint of 'bad' changes in an edit whose build fails. Once the
+/// file is fixed, depends-on-bad has to be rebuilt.
+
+// RUN: rm -rf %t && cp -r %S/Inputs/fail-fingerprints/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-FIRST %s
+
+// CHECK-FIRST-NOT: warning
+// CHECK-FIRST: Handled bad.swift
+// CHECK-FIRST: Handled depends-on-bad.swift
+
+// Reset the .swiftdeps files, then edit bad.swift and fail to build it. Like
+// the frontend, update-dependencies-bad.py doesn't write the dependencies of a
+// failed build.
+// RUN: cp -r %S/Inputs/fail-fingerprints/*.swiftdeps %t
+// RUN: touch -t 201401240006 %t/bad.swift
+// RUN: cd %t && not %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies-bad.py -output-file-map %t/output.json -incremental ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-SECOND %s
+
+// CHECK-SECOND: Handled bad.swift
+// CHECK-SECOND-NOT: Handled depends-on-bad.swift
+
+// RUN: touch -t 201401240007 %t/bad.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-FIXED %s
+
+// CHECK-FIXED: Handled bad.swift
+// CHECK-FIXED: Handled depends-on-bad.swift
+
+
+// A file whose last build failed while it was to cascade has its dependents
+// rebuilt up front, even if its dependencies were written before it failed
+// and so show no change.
+// RUN: rm -rf %t && cp -r %S/Inputs/fail-fingerprints/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-FIRST %s
+
+// RUN: cp -r %S/Inputs/fail-fingerprints/*.swiftdeps %t
+// RUN: touch -t 201401240006 %t/bad.swift
+// RUN: cd %t && not %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies-bad.py -output-file-map %t/output.json -incremental -driver-always-rebuild-dependents ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-SECOND %s
+// RUN: FileCheck -check-prefix=CHECK-RECORD %s < %t/main~buildrecord.swiftdeps
+
+// CHECK-RECORD: "./bad.swift": !dirty [
+
+// RUN: cp %t/bad.swift %t/bad.swiftdeps
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./bad.swift ./depends-on-bad.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-FIXED %s
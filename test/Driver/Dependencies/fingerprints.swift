@@ -0,0 +1,48 @@
+/// changed ==> uses-a
+/// changed ==> uses-b
+/// Only the fingerprint of 'a' changes, so uses-b doesn't need rebuilding.
+
+// RUN: rm -rf %t && cp -r %S/Inputs/fingerprints/ %t
+// RUN: touch -t 201401240005 %t/*
+
+// Generate the build record...
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./changed.swift ./uses-a.swift ./uses-b.swift -module-name main -j1 -v
+
+// ...then reset the .swiftdeps files.
+// RUN: cp -r %S/Inputs/fingerprints/*.swiftdeps %t
+
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./changed.swift ./uses-a.swift ./uses-b.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-CLEAN %s
+
+// CHECK-CLEAN-NOT: Handled
+
+// RUN: touch -t 201401240006 %t/changed.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./changed.swift ./uses-a.swift ./uses-b.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-CHANGED %s
+
+// CHECK-CHANGED-NOT: Handled uses-b.swift
+// CHECK-CHANGED: Handled changed.swift
+// CHECK-CHANGED-NOT: Handled uses-b.swift
+// CHECK-CHANGED: Handled uses-a.swift
+// CHECK-CHANGED-NOT: Handled uses-b.swift
+
+
+// If no fingerprint changes, nothing else is rebuilt, even though the
+// interface hash did change.
+// RUN: cp -r %S/Inputs/fingerprints/*.swiftdeps %t
+// RUN: sed -e 's/a-after/a-before/' -i.prev %t/changed.swift
+// RUN: touch -t 201401240007 %t/changed.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./changed.swift ./uses-a.swift ./uses-b.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-SAME-FINGERPRINTS %s
+
+// CHECK-SAME-FINGERPRINTS-NOT: Handled uses
+// CHECK-SAME-FINGERPRINTS: Handled changed.swift
+// CHECK-SAME-FINGERPRINTS-NOT: Handled uses
+
+
+// Without fingerprints, every dependent is rebuilt.
+// RUN: cp -r %S/Inputs/fingerprints/*.swiftdeps %t
+// RUN: sed -e '/fingerprints/d' -i.prev %t/changed.swift %t/changed.swiftdeps
+// RUN: touch -t 201401240008 %t/changed.swift
+// RUN: cd %t && %swiftc_driver -c -driver-use-frontend-path %S/Inputs/update-dependencies.py -output-file-map %t/output.json -incremental ./changed.swift ./uses-a.swift ./uses-b.swift -module-name main -j1 -v 2>&1 | FileCheck -check-prefix=CHECK-NO-FINGERPRINTS %s
+
+// CHECK-NO-FINGERPRINTS-DAG: Handled changed.swift
+// CHECK-NO-FINGERPRINTS-DAG: Handled uses-a.swift
+// CHECK-NO-FINGERPRINTS-DAG: Handled uses-b.swift
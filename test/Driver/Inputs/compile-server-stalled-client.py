@@ -0,0 +1,12 @@
+#!/usr/bin/env python
+
+# Connects to the compile server socket given as the argument and then sends
+# nothing, like a client which stalls before it sends its request.
+
+import socket
+import sys
+import time
+
+client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+client.connect(sys.argv[1])
+time.sleep(60)
@@ -0,0 +1,29 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: %swiftc_driver -driver-print-jobs -module-name main -enable-batch-mode -j 2 %S/Inputs/main.swift %S/Inputs/lib.swift %s %S/Inputs/single_int.swift -c 2>&1 | FileCheck -check-prefix=TWO-JOBS %s
+// RUN: %swiftc_driver -driver-print-jobs -module-name main -enable-batch-mode -driver-batch-count 1 -j 4 %S/Inputs/main.swift %S/Inputs/lib.swift %s -c 2>&1 | FileCheck -check-prefix=ONE-JOB %s
+// RUN: %swiftc_driver -driver-print-bindings -module-name mod -enable-batch-mode -j 2 %S/Inputs/main.swift %S/Inputs/lib.swift %s %S/Inputs/single_int.swift -emit-module -emit-dependencies -c 2>&1 | FileCheck -check-prefix=BINDINGS %s
+// RUN: mkdir -p %t/tmp && touch %t/tmp/dummy
+// RUN: env TMPDIR=%t/tmp/ %swiftc_driver -driver-print-jobs -module-name main -enable-batch-mode -j 2 %S/Inputs/main.swift %S/Inputs/lib.swift %s %S/Inputs/single_int.swift -emit-dependencies -c 2>&1 | FileCheck -check-prefix=MAP %s
+// RUN: ls %t/tmp | FileCheck -check-prefix=NO-MAP %s
+// RUN: %swiftc_driver -driver-print-jobs -module-name main -enable-batch-mode -incremental %S/Inputs/main.swift %S/Inputs/lib.swift -c 2>&1 | FileCheck -check-prefix=INCREMENTAL %s
+// RUN: not %swiftc_driver -driver-print-jobs -module-name main -enable-batch-mode -driver-batch-count 0 %S/Inputs/main.swift %S/Inputs/lib.swift -c 2>&1 | FileCheck -check-prefix=BAD-COUNT %s
+
+// TWO-JOBS: bin/swift{{c?}} -frontend -c -primary-file {{[^ ]*}}/Inputs/main.swift -primary-file {{[^ ]*}}/Inputs/lib.swift {{[^ ]*}}/batch-mode.swift {{[^ ]*}}/Inputs/single_int.swift {{.*}} -o main.o -o lib.o
+// TWO-JOBS: bin/swift{{c?}} -frontend -c {{[^ ]*}}/Inputs/main.swift {{[^ ]*}}/Inputs/lib.swift -primary-file {{[^ ]*}}/batch-mode.swift -primary-file {{[^ ]*}}/Inputs/single_int.swift {{.*}} -o batch-mode.o -o single_int.o
+// TWO-JOBS-NOT: -frontend
+
+// ONE-JOB: bin/swift{{c?}} -frontend -c -primary-file {{[^ ]*}}/Inputs/main.swift -primary-file {{[^ ]*}}/Inputs/lib.swift -primary-file {{[^ ]*}}/batch-mode.swift {{.*}} -o main.o -o lib.o -o batch-mode.o
+// ONE-JOB-NOT: -frontend
+
+// MAP: -supplementary-output-file-map {{[^ ]*}}/tmp/main-{{[^ ]*}}.json
+// NO-MAP-NOT: .json
+
+// BINDINGS-DAG: # "{{.*}}" - "swift{{c?}}", inputs: ["{{.*}}/Inputs/main.swift", "{{.*}}/Inputs/lib.swift"], output: {object: "main.o", object: "lib.o", dependencies: "main.d", dependencies: "lib.d", swiftmodule: "main.swiftmodule", swiftmodule: "lib.swiftmodule", swiftdoc: "main.swiftdoc", swiftdoc: "lib.swiftdoc"}
+// BINDINGS-DAG: # "{{.*}}" - "swift{{c?}}", inputs: ["{{.*}}/batch-mode.swift", "{{.*}}/Inputs/single_int.swift"], output: {object: "batch-mode.o", object: "single_int.o", dependencies: "batch-mode.d", dependencies: "single_int.d", swiftmodule: "batch-mode.swiftmodule", swiftmodule: "single_int.swiftmodule", swiftdoc: "batch-mode.swiftdoc", swiftdoc: "single_int.swiftdoc"}
+// BINDINGS-DAG: # "{{.*}}" - "swift{{c?}}", inputs: ["main.o", "lib.o", "batch-mode.o", "single_int.o"], output: {swiftmodule: "mod.swiftmodule", swiftdoc: "mod.swiftdoc"}
+
+// INCREMENTAL: warning: ignoring -enable-batch-mode (not supported with '-incremental')
+// INCREMENTAL: bin/swift{{c?}} -frontend -c -primary-file {{[^ ]*}}/Inputs/main.swift {{[^ ]*}}/Inputs/lib.swift
+// INCREMENTAL: bin/swift{{c?}} -frontend -c {{[^ ]*}}/Inputs/main.swift -primary-file {{[^ ]*}}/Inputs/lib.swift
+
+// BAD-COUNT: error: invalid value '0' in '-driver-batch-count 0'
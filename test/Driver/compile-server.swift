@@ -0,0 +1,51 @@
+// RUN: rm -rf %t && mkdir -p %t
+
+// Jobs run locally if there is no server listening on the socket.
+// RUN: %target-swiftc_driver -compile-server-socket %t/no-server.sock -c %s -o %t/compile-server.o
+// RUN: ls %t/compile-server.o
+
+// RUN: not %swift_driver_plain -compile-server 2>&1 | FileCheck -check-prefix=USAGE %s
+// USAGE: usage: swift -compile-server [-v] <socket-path>
+
+// RUN: not %swift_driver_plain -compile-server %t/no-such-directory/server.sock 2>&1 | FileCheck -check-prefix=BAD-SOCKET %s
+// BAD-SOCKET: error: cannot listen on {{.*}}/no-such-directory/server.sock
+
+// A file which isn't a socket is never replaced by the server's socket.
+// RUN: echo keep > %t/not-a-socket.sock
+// RUN: not %swift_driver_plain -compile-server %t/not-a-socket.sock 2>&1 | FileCheck -check-prefix=NOT-A-SOCKET %s
+// RUN: grep keep %t/not-a-socket.sock
+// NOT-A-SOCKET: error: cannot listen on {{.*}}/not-a-socket.sock: the path exists and is not a socket of this user
+
+// Compile through a live server. Jobs with the same configuration share an
+// instance; a different environment needs an instance of its own.
+// RUN: (%swift_driver_plain -compile-server -v %t/server.sock 2>%t/server.log & echo $! > %t/server.pid)
+// RUN: for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do test -S %t/server.sock && break; sleep 0.5; done
+// RUN: %target-swiftc_driver -compile-server-socket %t/server.sock -c %s -o %t/served-1.o
+// RUN: %target-swiftc_driver -compile-server-socket %t/server.sock -c %s -o %t/served-2.o
+// RUN: env COMPILE_SERVER_TEST=1 %target-swiftc_driver -compile-server-socket %t/server.sock -c %s -o %t/served-3.o
+// RUN: kill `cat %t/server.pid`
+// RUN: ls %t/served-1.o %t/served-2.o %t/served-3.o
+// RUN: FileCheck -check-prefix=SERVED %s < %t/server.log
+// SERVED: setting up an instance in
+// SERVED-NEXT: started job
+// SERVED-NEXT: started job
+// SERVED-NEXT: setting up an instance in
+// SERVED-NEXT: started job
+// SERVED-NOT: declined
+
+// The socket is only accessible to the user who started the server.
+// RUN: ls -l %t/server.sock | FileCheck -check-prefix=PERMISSIONS %s
+// PERMISSIONS: srw-------
+
+// A client which connects and sends nothing doesn't hold up the others: the
+// job is served while the stalled client is still connected.
+// RUN: (%swift_driver_plain -compile-server %t/stalled.sock & echo $! > %t/stalled-server.pid)
+// RUN: for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do test -S %t/stalled.sock && break; sleep 0.5; done
+// RUN: (%S/Inputs/compile-server-stalled-client.py %t/stalled.sock & echo $! > %t/stalled-client.pid)
+// RUN: sleep 1
+// RUN: %target-swiftc_driver -compile-server-socket %t/stalled.sock -c %s -o %t/served-4.o
+// RUN: kill -0 `cat %t/stalled-client.pid`
+// RUN: kill `cat %t/stalled-server.pid` `cat %t/stalled-client.pid`
+// RUN: ls %t/served-4.o
+
+func foo() -> Int { return 1 }
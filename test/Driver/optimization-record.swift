@@ -0,0 +1,40 @@
+// RUN: %swiftc_driver -driver-print-jobs -c -O %s -save-optimization-record -Rpass=sil-inliner -Rpass-missed='sil-.*' | FileCheck -check-prefix=JOBS %s
+
+// JOBS: swift
+// JOBS-DAG: -save-optimization-record-path {{[^ ]*}}optimization-record{{[^ ]*}}.opt.yaml
+// JOBS-DAG: -Rpass=sil-inliner
+// JOBS-DAG: -Rpass-missed=sil-.*
+
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: %target-swift-frontend -c -O %s -o %t/optimization-record.o -module-name main -save-optimization-record-path %t/record.opt.yaml
+// RUN: FileCheck -check-prefix=RECORD %s < %t/record.opt.yaml
+
+// RECORD: --- !Passed
+// RECORD: Pass:            sil-inliner
+// RECORD: Name:            Inlined
+// RECORD: DebugLoc:        { File: '{{.*}}optimization-record.swift', Line: {{[0-9]+}}, Column: {{[0-9]+}} }
+// RECORD: - Callee:          'main.add
+// RECORD: ...
+
+// In batch mode each primary file gets its own record.
+// RUN: %swiftc_driver -driver-print-bindings -module-name main -enable-batch-mode -driver-batch-count 1 -c -O %s %S/Inputs/lib.swift -save-optimization-record 2>&1 | FileCheck -check-prefix=BATCH-BINDINGS %s
+// BATCH-BINDINGS: # "{{.*}}" - "swift{{c?}}", inputs: ["{{.*}}optimization-record.swift", "{{.*}}/Inputs/lib.swift"], output: {object: "optimization-record.o", object: "lib.o", opt-record: "optimization-record.opt.yaml", opt-record: "lib.opt.yaml"}
+
+// RUN: echo "{\"%s\": {\"opt-record\": \"%t/main.opt.yaml\"}, \"%S/Inputs/lib.swift\": {\"opt-record\": \"%t/lib.opt.yaml\"}}" > %t/supplementary.json
+// RUN: %target-swift-frontend -c -O -primary-file %s -primary-file %S/Inputs/lib.swift -module-name main -supplementary-output-file-map %t/supplementary.json -o %t/main.o -o %t/lib.o
+// RUN: FileCheck -check-prefix=RECORD %s < %t/main.opt.yaml
+// RUN: ls %t/lib.opt.yaml
+
+// RUN: not %target-swift-frontend -c -O %s -o %t/bad.o -Rpass='(' 2>&1 | FileCheck -check-prefix=BADREGEX %s
+// BADREGEX: error: invalid value '(' in '-Rpass='
+
+@inline(__always)
+func add(a: Int, _ b: Int) -> Int { return a &+ b }
+
+public func sum(xs: [Int]) -> Int {
+  var s = 0
+  for x in xs {
+    s = add(s, x)
+  }
+  return s
+}
@@ -0,0 +1,42 @@
+// RUN: rm -rf %t && mkdir -p %t
+
+// Jobs without a dependencies output aren't cached.
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %s -o %t/no-deps.o
+// RUN: not ls %t/cache
+
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %s -emit-dependencies -o %t/output-cache.o
+// RUN: ls %t/cache/*.manifest
+
+// A restored job is reported as if it had run, with a pid of 0.
+// RUN: rm %t/output-cache.o %t/output-cache.d
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %s -emit-dependencies -o %t/output-cache.o -parseable-output 2>&1 | FileCheck -check-prefix=RESTORED %s
+// RUN: ls %t/output-cache.o %t/output-cache.d
+// RESTORED: "kind": "finished",
+// RESTORED-NEXT: "name": "compile",
+// RESTORED-NEXT: "pid": 0,
+
+// Changing the contents of a source file at the same path misses the cache,
+// whatever its modification time.
+// RUN: cp %s %t/main.swift
+// RUN: touch -r %s %t/main.swift
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o
+// RUN: rm %t/main.o
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o -parseable-output 2>&1 | FileCheck -check-prefix=RESTORED %s
+// RUN: echo 'func bar() {}' >> %t/main.swift
+// RUN: touch -r %s %t/main.swift
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o -parseable-output 2>&1 | FileCheck -check-prefix=MISSED %s
+// MISSED: "kind": "finished",
+// MISSED-NEXT: "name": "compile",
+// MISSED-NEXT: "pid": {{[1-9][0-9]*}},
+
+// Entries are only shared by builds in the same directory.
+// RUN: mkdir -p %t/elsewhere
+// RUN: cd %t/elsewhere && %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o -parseable-output 2>&1 | FileCheck -check-prefix=MISSED %s
+
+// The trace of a job doesn't get in the way of a hit, though it isn't
+// restored.
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o -trace-output %t/trace.json
+// RUN: rm %t/main.o
+// RUN: %target-swiftc_driver -output-cache-path %t/cache -c %t/main.swift -emit-dependencies -o %t/main.o -trace-output %t/trace.json -parseable-output 2>&1 | FileCheck -check-prefix=RESTORED %s
+
+func foo() -> Int { return 1 }
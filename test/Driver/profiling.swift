@@ -8,6 +8,8 @@
 
 // RUN: %swiftc_driver -driver-print-jobs -profile-generate -target x86_64-unknown-linux-gnu %s | FileCheck -check-prefix=CHECK -check-prefix=LINUX %s
 
+// RUN: %swiftc_driver -driver-print-jobs -profile-use=%t.profdata -target x86_64-unknown-linux-gnu %s | FileCheck -check-prefix=USE %s
+
 // CHECK: swift
 // CHECK: -profile-generate
 
@@ -26,5 +28,9 @@
 // LINUX: clang++{{"? }}
 // LINUX: lib/swift/clang/{{[^ ]*}}/lib/linux/libclang_rt.profile-x86_64.a
 
+// USE: swift
+// USE: -profile-use={{.*}}.profdata
+// USE-NOT: libclang_rt.profile
+
 // REQUIRES: enable_target_appletvos
 
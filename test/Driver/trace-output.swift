@@ -0,0 +1,22 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: %target-swiftc_driver -c %s -o %t/trace-output.o -trace-output %t/trace.json
+// RUN: FileCheck %s < %t/trace.json
+
+// The driver's own events, then those of the frontend it ran.
+// CHECK: [
+// CHECK-DAG: {"name":"process_name","ph":"M","pid":{{[0-9]+}},"args":{"name":"driver"}}
+// CHECK-DAG: {"name":"plan build","cat":"driver","ph":"X",
+// CHECK-DAG: {"name":"compile","cat":"job","ph":"X",
+// CHECK-DAG: {"name":"process_name","ph":"M","pid":{{[0-9]+}},"args":{"name":"frontend
+// CHECK-DAG: {"name":"parse","cat":"frontend","ph":"X",{{.*}}"args":{"detail":"{{.*}}trace-output.swift"}}
+// CHECK-DAG: {"name":"SILGen",
+// CHECK-DAG: {"name":"LLVM code generation",
+// CHECK: ]
+
+// The frontend accepts -trace-output too.
+// RUN: %target-swift-frontend -parse %s -trace-output %t/frontend.json
+// RUN: FileCheck -check-prefix=FRONTEND %s < %t/frontend.json
+// FRONTEND: {"name":"process_name","ph":"M",
+// FRONTEND: {"name":"parse","cat":"frontend",
+
+func foo() -> Int { return 1 }
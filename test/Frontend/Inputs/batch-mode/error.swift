@@ -0,0 +1 @@
+let notAnInt: Int = "not an int"
@@ -0,0 +1 @@
+func otherFunc() -> Int { return 42 }
@@ -0,0 +1,54 @@
+// RUN: rm -rf %t && mkdir %t
+
+// RUN: %target-swift-frontend -c -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -module-name batch -o %t/main.o -o %t/other.o
+// RUN: ls %t/main.o %t/other.o
+
+// RUN: echo "{\"%s\": {\"swiftmodule\": \"%t/main.swiftmodule\", \"dependencies\": \"%t/main.d\", \"swift-dependencies\": \"%t/main.swiftdeps\"}, \"%S/Inputs/batch-mode/other.swift\": {\"swiftmodule\": \"%t/other.swiftmodule\", \"dependencies\": \"%t/other.d\", \"swift-dependencies\": \"%t/other.swiftdeps\"}}" > %t/supplementary.json
+// RUN: %target-swift-frontend -c -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -module-name batch -supplementary-output-file-map %t/supplementary.json -o %t/main.o -o %t/other.o
+// RUN: ls %t/main.swiftmodule %t/other.swiftmodule
+// RUN: FileCheck -check-prefix=MAIN-SWIFTDEPS %s < %t/main.swiftdeps
+// RUN: FileCheck -check-prefix=OTHER-SWIFTDEPS %s < %t/other.swiftdeps
+// RUN: FileCheck -check-prefix=MAIN-DEPS %s < %t/main.d
+// RUN: FileCheck -check-prefix=OTHER-DEPS %s < %t/other.d
+
+// An error in one primary file doesn't stop the outputs of the others.
+// RUN: not %target-swift-frontend -c -primary-file %S/Inputs/batch-mode/error.swift -primary-file %S/Inputs/batch-mode/other.swift -module-name batch -o %t/error.o -o %t/other-after-error.o 2>&1 | FileCheck -check-prefix=ERROR %s
+// RUN: ls %t/other-after-error.o
+// RUN: not ls %t/error.o
+
+// Each primary file gets a fresh LLVM context, so its types are not renamed
+// to avoid the names of an earlier file's types.
+// RUN: %target-swift-frontend -emit-ir -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -module-name batch -o %t/main.ll -o %t/other.ll
+// RUN: FileCheck -check-prefix=IR %s < %t/main.ll
+// RUN: FileCheck -check-prefix=IR %s < %t/other.ll
+
+// RUN: not %target-swift-frontend -c -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -o %t/main.o 2>&1 | FileCheck -check-prefix=OUTPUT-COUNT %s
+// RUN: not %target-swift-frontend -c -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -emit-module-path %t/batch.swiftmodule -o %t/main.o -o %t/other.o 2>&1 | FileCheck -check-prefix=OUTPUT-PATH %s
+// RUN: not %target-swift-frontend -c -primary-file %s -primary-file %S/Inputs/batch-mode/other.swift -supplementary-output-file-map %t/missing.json -o %t/main.o -o %t/other.o 2>&1 | FileCheck -check-prefix=MISSING-MAP %s
+
+// MAIN-DEPS: main.o :
+// MAIN-DEPS-SAME: batch-mode.swift
+
+// OTHER-DEPS: other.o :
+// OTHER-DEPS-SAME: other.swift
+
+// MAIN-SWIFTDEPS-LABEL: provides-top-level:
+// MAIN-SWIFTDEPS-NOT: otherFunc
+// MAIN-SWIFTDEPS-LABEL: depends-top-level:
+// MAIN-SWIFTDEPS: "otherFunc"
+
+// OTHER-SWIFTDEPS-LABEL: provides-top-level:
+// OTHER-SWIFTDEPS: "otherFunc"
+
+// ERROR: error.swift:1:{{[0-9]+}}: error:
+// ERROR-NOT: other.swift{{.*}} error:
+
+// IR-NOT: %swift.type.{{[0-9]+}} = type
+// IR: %swift.type = type
+// IR-NOT: %swift.type.{{[0-9]+}} = type
+
+// OUTPUT-COUNT: error: -o must be given once for each -primary-file
+// OUTPUT-PATH: error: '-emit-module-path' cannot be used with more than one -primary-file
+// MISSING-MAP: error: cannot load supplementary output file map '{{.*}}missing.json'
+
+print(otherFunc())
@@ -19,6 +19,11 @@
 // CHECK-BASIC-YAML: "{{.*}}/Swift.swiftmodule"
 // CHECK-BASIC-YAML-NOT: {{:$}}
 
+// RUN: %target-swift-frontend -emit-reference-dependencies-path %t.bin.swiftdeps -binary-reference-dependencies -parse -primary-file %S/../Inputs/empty.swift
+// RUN: head -c 4 %t.bin.swiftdeps | FileCheck -check-prefix=CHECK-BINARY %s
+
+// CHECK-BINARY: SWDB
+
 
 // RUN: %target-swift-frontend -emit-dependencies-path %t.d -emit-reference-dependencies-path %t.swiftdeps -parse %S/../Inputs/empty.swift 2>&1 | FileCheck -check-prefix=NO-PRIMARY-FILE %s
 
@@ -65,6 +70,9 @@
 // CHECK-IMPORT-YAML-DAG: "{{.*}}Inputs/dependencies/module.modulemap"
 // CHECK-IMPORT-YAML-NOT: {{^-}}
 // CHECK-IMPORT-YAML-NOT: {{:$}}
+// CHECK-IMPORT-YAML: {{^fingerprints:$}}
+// CHECK-IMPORT-YAML-NEXT: - ["Test", "{{[0-9a-f]+}}"]
+// CHECK-IMPORT-YAML-NOT: {{:$}}
 
 // RUN: not %target-swift-frontend(mock-sdk: %clang-importer-sdk) -DERROR -import-objc-header %S/Inputs/dependencies/extra-header.h -emit-dependencies-path - -parse %s | FileCheck -check-prefix=CHECK-IMPORT %s
 // RUN: not %target-swift-frontend(mock-sdk: %clang-importer-sdk) -DERROR -import-objc-header %S/Inputs/dependencies/extra-header.h -emit-reference-dependencies-path - -parse -primary-file %s | FileCheck -check-prefix=CHECK-IMPORT-YAML %s
@@ -0,0 +1,20 @@
+// RUN: %target-swift-frontend -disable-func-sig-opts -O -emit-ir %s | FileCheck %s
+// RUN: %target-swift-frontend -disable-func-sig-opts -O -emit-object %s -o /dev/null
+
+// A partial specialization keeps the full generic signature of the function
+// it was cloned from, so it is still passed the metadata of the parameters
+// it binds, and is emitted like any other generic function.
+
+@inline(never)
+func pair<T, U>(t: T, _ u: U) -> Int {
+  return sizeofValue(t) + sizeofValue(u)
+}
+
+// CHECK-LABEL: define {{.*}} @_TF22partial_specialization6caller
+// CHECK: call {{.*}} @_TTSg5Vs5Int32_{{.*}}4pair
+public func caller<U>(u: U) -> Int {
+  return pair(Int32(0), u)
+}
+
+// CHECK-LABEL: define {{.*}} @_TTSg5Vs5Int32_{{.*}}4pair
+// CHECK: ret
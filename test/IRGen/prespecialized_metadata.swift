@@ -0,0 +1,38 @@
+// RUN: %target-swift-frontend -O -emit-ir %s | FileCheck %s
+// RUN: %target-swift-frontend -emit-ir %s | FileCheck %s --check-prefix=ONONE
+
+// REQUIRES: CPU=x86_64
+
+// The layout of Key does not depend on T, so the metadata of Key<Int> can be
+// built ahead of time.
+struct Key<T: Hashable> {
+  var raw: Int
+}
+
+// The layout of Pair does depend on T, so it is always built at runtime.
+struct Pair<T> {
+  var first: T
+  var second: T
+}
+
+// The cache entry: the key arguments, the entry header and the metadata with
+// the generic arguments filled in.
+// CHECK: @prespecialized_metadata_Key = private global { [2 x i8*], { i8*, %swift.type*, i64 }, {{.*}} } { [2 x i8*] [i8* bitcast ({{.*}} @_TMSi to i8*), i8* bitcast ({{.*}} @_TWPSis8HashableS_ to i8*)], { i8*, %swift.type*, i64 } { i8* null, %swift.type* bitcast (i8* getelementptr inbounds (i8, i8* bitcast ({{.*}} @prespecialized_metadata_Key to i8*), i32 48) to %swift.type*), i64 2 }, {{.*}}@_TMSi{{.*}}@_TWPSis8HashableS_{{.*}} }, align 8
+// CHECK-NOT: @prespecialized_metadata_Pair
+
+// CHECK: @prespecialized_metadata_records = private global [1 x { %swift.type_pattern*, %swift.type* }] [{ %swift.type_pattern*, %swift.type* } { %swift.type_pattern* @_TMPV{{[0-9]+}}prespecialized_metadata3Key, %swift.type* {{.*}}@prespecialized_metadata_Key{{.*}} }], section "{{[^"]*}}swift2_prespec{{[^"]*}}", align 8
+
+// ONONE-NOT: swift2_prespec
+
+@inline(never)
+func keyType() -> Any.Type {
+  return Key<Int>.self
+}
+
+@inline(never)
+func pairType() -> Any.Type {
+  return Pair<Int>.self
+}
+
+print(keyType())
+print(pairType())
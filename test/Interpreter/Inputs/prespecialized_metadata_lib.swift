@@ -0,0 +1,10 @@
+// Built with -O, so that this library carries a prespecialized metadata
+// record for Key<Int>.
+public struct Key<T: Hashable> {
+  public var raw: Int
+}
+
+@_silgen_name("prespecializedKeyMetadata")
+public func prespecializedKeyMetadata() -> UnsafePointer<Void> {
+  return unsafeBitCast(Key<Int>.self as Any.Type, UnsafePointer<Void>.self)
+}
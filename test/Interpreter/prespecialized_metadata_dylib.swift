@@ -0,0 +1,32 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: %target-build-swift -O -emit-library -module-name PrespecializedMetadata %S/Inputs/prespecialized_metadata_lib.swift -o %t/libPrespecializedMetadata.dylib
+// RUN: %target-build-swift %s -o %t/main
+// RUN: %target-run %t/main %t/libPrespecializedMetadata.dylib | FileCheck %s
+
+// The records of a library loaded after the runtime has looked at the images
+// are used too: the metadata of Key<Int> is the library's prebuilt copy.
+
+#if os(Linux)
+import Glibc
+#else
+import Darwin
+#endif
+
+struct Local<T> {
+  var value: T
+}
+
+// Look up some generic metadata first, so that the images loaded so far
+// have been scanned.
+// CHECK: Local<Int>
+print(Local<Int>.self)
+
+let handle = dlopen(Process.arguments[1], RTLD_NOW)
+let symbol = dlsym(handle, "prespecializedKeyMetadata")
+typealias MetadataAccessor = @convention(c) () -> UnsafePointer<Void>
+let metadata = unsafeBitCast(symbol, MetadataAccessor.self)()
+
+var info = Dl_info()
+dladdr(metadata, &info)
+// CHECK: {{.*}}/libPrespecializedMetadata.dylib
+print(String.fromCString(info.dli_fname)!)
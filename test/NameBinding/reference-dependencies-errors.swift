@@ -2,4 +2,9 @@
 // RUN: cp %s %t/main.swift
 // RUN: not %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path - > %t.swiftdeps
 
+// The dependencies of a file with errors aren't written, so that the driver
+// still compares the next build with those of the last successful one.
+// RUN: not %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/main.swiftdeps
+// RUN: not ls %t/main.swiftdeps
+
 extension Foo {}
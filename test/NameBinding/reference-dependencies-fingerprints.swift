@@ -0,0 +1,68 @@
+// RUN: rm -rf %t && mkdir %t
+// RUN: cp %s %t/main.swift
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -emit-reference-dependencies-path %t/before.swiftdeps
+// RUN: %target-swift-frontend -parse -primary-file %t/main.swift -D CHANGED -emit-reference-dependencies-path %t/after.swiftdeps
+// RUN: cat %t/before.swiftdeps %t/after.swiftdeps | FileCheck %s
+
+// Changing a function body changes neither the fingerprint of the function
+// nor those of other declarations; changing a signature changes the
+// fingerprint of that declaration, and of the declarations of the file which
+// refer to it.
+
+// CHECK-LABEL: {{^fingerprints:$}}
+// CHECK-DAG: - ["changing", "[[CHANGING:[0-9a-f]+]]"]
+// CHECK-DAG: - ["stable", "[[STABLE:[0-9a-f]+]]"]
+// CHECK-DAG: - ["Wrapper", "[[WRAPPER:[0-9a-f]+]]"]
+// CHECK-DAG: - ["overloaded", "[[OVERLOADED:[0-9a-f]+]]"]
+// CHECK-DAG: - ["{{.*}}7Wrapper", "", "[[WRAPPER]]"]
+// CHECK-DAG: - ["usesAlias", "[[USES_ALIAS:[0-9a-f]+]]"]
+// CHECK-DAG: - ["usesAliasIndirectly", "[[USES_ALIAS_INDIRECTLY:[0-9a-f]+]]"]
+
+// CHECK-LABEL: {{^fingerprints:$}}
+// CHECK-DAG: - ["stable", "[[STABLE]]"]
+// CHECK-DAG: - ["Wrapper", "[[WRAPPER]]"]
+// CHECK-DAG: - ["overloaded", "[[OVERLOADED]]"]
+// CHECK-NOT: - ["changing", "[[CHANGING]]"]
+// CHECK-NOT: - ["usesAlias", "[[USES_ALIAS]]"]
+// CHECK-NOT: - ["usesAliasIndirectly", "[[USES_ALIAS_INDIRECTLY]]"]
+
+#if CHANGED
+func changing(x: Int) -> String { return "" }
+#else
+func changing(x: Int) -> Int { return x }
+#endif
+
+func stable(x: Int) -> Int {
+#if CHANGED
+  return x + 1
+#else
+  return x
+#endif
+}
+
+struct Wrapper {
+  var value: Int
+  func get() -> Int {
+#if CHANGED
+    return value * 2
+#else
+    return value
+#endif
+  }
+}
+
+#if CHANGED
+typealias Alias = String
+#else
+typealias Alias = Int
+#endif
+
+func usesAlias(x: Alias) {}
+let usesAliasIndirectly = usesAlias
+
+func overloaded(x: Int) {}
+func overloaded(x: String) {}
+
+// Private declarations don't provide anything.
+// CHECK-NOT: "hidden"
+private func hidden() {}
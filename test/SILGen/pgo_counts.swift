@@ -0,0 +1,27 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: llvm-profdata merge %S/Inputs/pgo_counts.proftext -o %t/pgo_counts.profdata
+// RUN: %target-swift-frontend -parse-as-library -module-name pgo_counts -emit-silgen -profile-use=%t/pgo_counts.profdata %s | FileCheck %s
+// RUN: not %target-swift-frontend -parse-as-library -emit-silgen -profile-use=%t/missing.profdata %s 2>&1 | FileCheck %s -check-prefix=MISSING
+
+// MISSING: error: cannot read profile data '{{.*}}missing.profdata'
+
+// CHECK-LABEL: sil hidden @_TF10pgo_counts7guardedFSiSi
+// CHECK: bb0(%0 : $Int): {{ *}}// Count: 1000
+// CHECK-NOT: builtin "int_instrprof_increment"
+// CHECK: // Preds: {{.*}} Count: 3
+// CHECK: return
+func guarded(x: Int) -> Int {
+  if x < 0 {
+    return 0
+  }
+  return x
+}
+
+// The profile of this function has a hash which doesn't match its control
+// flow, so it is ignored and the function gets no counts.
+// CHECK-LABEL: sil hidden @_TF10pgo_counts10unprofiledFSiSi
+// CHECK-NOT: Count:
+// CHECK: return
+func unprofiled(x: Int) -> Int {
+  return x
+}
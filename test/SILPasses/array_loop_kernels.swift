@@ -0,0 +1,62 @@
+// RUN: %target-swift-frontend -O -emit-sil -primary-file %s -Rpass=sil-abcopts -o /dev/null 2>&1 | FileCheck -check-prefix=REMARK %s
+// RUN: %target-swift-frontend -O -emit-ir -primary-file %s | FileCheck %s
+// RUN: %target-swift-frontend -O -emit-ir -primary-file %s -Xllvm -enable-array-loop-versioning=false | FileCheck -check-prefix=NOVERSION %s
+// REQUIRES: CPU=x86_64
+// REQUIRES: optimized_stdlib
+// REQUIRES: swift_stdlib_no_asserts
+
+// Array loop kernels which should be vectorized once the bounds checks are
+// out of the loop body. They are also timed in utils/benchmark/ArrayLoops.
+
+// The check on "a[i]" is removed and the one on "b[i]" is hoisted, so the loop
+// has no checks left and is vectorized.
+// CHECK-LABEL: define {{.*}}dotProduct
+// CHECK: <{{[0-9]+}} x i32>
+// CHECK: ret i32
+public func dotProduct(a: [Int32], _ b: [Int32]) -> Int32 {
+  precondition(a.count == b.count)
+  var sum: Int32 = 0
+  for i in 0..<a.count {
+    sum = sum &+ a[i] &* b[i]
+  }
+  return sum
+}
+
+// The check on "a[i - 1]" stays in the loop until the loop is versioned. The
+// loop carries a dependence from one iteration to the next and isn't
+// vectorized.
+public func prefixSum(inout a: [Int]) {
+  for i in 1..<a.count {
+    // REMARK: array_loop_kernels.swift:[[@LINE+1]]:{{[0-9]+}}: remark: loop versioned without its bounds checks
+    a[i] = a[i] &+ a[i - 1]
+  }
+}
+
+// The index is a byte, so the check on "counts[Int(b)]" can't fail if there
+// are at least 256 counts. The stores may collide and the loop isn't
+// vectorized.
+public func histogram(bytes: [UInt8], inout _ counts: [Int]) {
+  precondition(counts.count >= 256)
+  for b in bytes {
+    // REMARK: array_loop_kernels.swift:[[@LINE+1]]:{{[0-9]+}}: remark: loop versioned without its bounds checks
+    counts[Int(b)] = counts[Int(b)] &+ 1
+  }
+}
+
+// The check on "a[i]" is hoisted, but the one on "a[i - 1]" stays in the loop
+// until the loop is versioned. The versioned loop has no checks left and is
+// vectorized, the original one isn't.
+// CHECK-LABEL: define {{.*}}sumOfDifferences
+// CHECK: <{{[0-9]+}} x i32>
+// CHECK: ret i32
+// NOVERSION-LABEL: define {{.*}}sumOfDifferences
+// NOVERSION-NOT: x i32>
+// NOVERSION: {{^}}}
+public func sumOfDifferences(a: [Int32]) -> Int32 {
+  var sum: Int32 = 0
+  for i in 1..<a.count {
+    // REMARK: array_loop_kernels.swift:[[@LINE+1]]:{{[0-9]+}}: remark: loop versioned without its bounds checks
+    sum = sum &+ (a[i] &- a[i - 1])
+  }
+  return sum
+}
@@ -0,0 +1,28 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: llvm-profdata merge %S/Inputs/profile_use_inlining.proftext -o %t/profile_use_inlining.profdata
+// RUN: %target-swift-frontend -parse-as-library -module-name profile_use_inlining -O -emit-sil -Xllvm -sil-inline-test-threshold=100 %s | FileCheck %s -check-prefix=NO-PROFILE
+// RUN: %target-swift-frontend -parse-as-library -module-name profile_use_inlining -O -emit-sil -Xllvm -sil-inline-test-threshold=100 -profile-use=%t/profile_use_inlining.profdata %s | FileCheck %s -check-prefix=PROFILE
+
+// The profile says that the call to scale never ran, so it is in a cold
+// block, and nothing but always-inline functions is inlined into cold blocks
+// in test mode. Without the profile the call is inlined.
+
+func scale(x: Int) -> Int {
+  return x &* 3 &+ 1
+}
+
+// NO-PROFILE-LABEL: sil @_TF20profile_use_inlining6callerFSiSi
+// NO-PROFILE-NOT: function_ref @_TF20profile_use_inlining5scaleFSiSi
+// NO-PROFILE: return
+
+// PROFILE-LABEL: sil @_TF20profile_use_inlining6callerFSiSi
+// PROFILE: bb0({{.*}}): {{ *}}// Count: 1000
+// PROFILE: [[SCALE:%.*]] = function_ref @_TF20profile_use_inlining5scaleFSiSi
+// PROFILE: apply [[SCALE]]
+// PROFILE: return
+public func caller(x: Int) -> Int {
+  if x < 0 {
+    return scale(x)
+  }
+  return x
+}
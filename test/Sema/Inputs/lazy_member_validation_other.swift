@@ -0,0 +1,25 @@
+struct StructSec {
+  var member: Int
+  func NOTYPECHECK_method() -> Int { return member }
+  static func NOTYPECHECK_staticMethod() {}
+  var NOTYPECHECK_computed: Int { return member }
+}
+
+enum EnumSec {
+  case A
+  case B(Int)
+  func NOTYPECHECK_method() {}
+}
+
+class ClassSec {
+  var member: Int = 0
+  func overridable() -> Int { return member }
+  final func NOTYPECHECK_finalMethod() -> Int { return member }
+  static func NOTYPECHECK_staticMethod() {}
+  final var NOTYPECHECK_finalComputed: Int { return member }
+}
+
+final class FinalClassSec {
+  var member: Int = 0
+  func NOTYPECHECK_method() -> Int { return member }
+}
@@ -0,0 +1,33 @@
+// Members of types from a secondary file which neither their layout nor
+// their vtable depends on are only validated if the primary file uses them.
+// Overridable members of a class are in its vtable, and so are validated.
+
+// RUN: %target-swift-frontend -emit-sil -primary-file %s %S/Inputs/lazy_member_validation_other.swift -debug-forbid-typecheck-prefix NOTYPECHECK | FileCheck %s
+// RUN: %target-swift-frontend -emit-sil -primary-file %s %S/Inputs/lazy_member_validation_other.swift -print-stats 2>&1 | FileCheck %s -check-prefix=STATS
+// RUN: %target-swift-frontend -emit-sil -primary-file %s %S/Inputs/lazy_member_validation_other.swift -disable-lazy-member-validation -print-stats 2>&1 | FileCheck %s -check-prefix=DISABLED
+
+// REQUIRES: asserts
+
+// CHECK-LABEL: sil hidden @{{.*}}primFn
+func primFn(s: StructSec, e: EnumSec) -> Int {
+  switch e {
+  case .A: return s.member
+  case .B(let x): return x
+  }
+}
+
+// CHECK-LABEL: sil hidden @{{.*}}classFn
+func classFn(c: ClassSec, f: FinalClassSec) -> Int {
+  return c.member + f.member
+}
+
+class SubclassPrim : ClassSec {
+  override func overridable() -> Int { return 1 }
+}
+
+// STATS: Statistics Collected
+// STATS: {{[0-9]+}} Decl validation - # of members of used types left to be validated on demand
+// STATS: {{[0-9]+}} Decl validation - # of declarations validated
+
+// DISABLED: Statistics Collected
+// DISABLED-NOT: members of used types left to be validated on demand
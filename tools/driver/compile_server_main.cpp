@@ -0,0 +1,831 @@
+//===-- compile_server_main.cpp - Swift compile server --------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// A long-running server which runs frontend jobs for the driver, started as
+// 'swift -compile-server <socket>' and used with 'swiftc -compile-server-socket
+// <socket>'. See swift/Basic/CompileServerProtocol.h for the protocol.
+//
+// Most of the time of a small frontend job goes into setting up the
+// ASTContext and the Clang importer and loading the standard library and the
+// other imported modules. The server does this once for each distinct
+// configuration (the command line apart from inputs and outputs) and keeps
+// the result warm. Each job then runs in a forked copy of the warm instance,
+// which shares all the loaded state copy-on-write, and can't disturb it for
+// later jobs. After a job succeeds, the server loads the modules it imported
+// into the warm instance too. A warm instance is thrown away once any file
+// it loaded has changed on disk.
+//
+// Jobs run in the client's working directory and environment, which are
+// part of the configuration as well. Only processes of the user running the
+// server can connect to it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/AST/ASTContext.h"
+#include "swift/AST/ModuleLoader.h"
+#include "swift/Basic/CompileServerProtocol.h"
+#include "swift/Frontend/Frontend.h"
+#include "swift/Frontend/PrintingDiagnosticConsumer.h"
+#include "swift/Option/Options.h"
+#include "swift/Strings.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Config/config.h"
+#include "llvm/Option/ArgList.h"
+#include "llvm/Option/Option.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if LLVM_ON_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if __APPLE__
+#include <crt_externs.h>
+#endif
+
+using namespace swift;
+
+extern int frontend_main(ArrayRef<const char *> Args, const char *Argv0,
+                         void *MainAddr, CompilerInstance *WarmInstance);
+
+#if LLVM_ON_UNIX
+
+namespace {
+
+/// How long the server waits for a request before it exits.
+const int IdleTimeoutMS = 30 * 60 * 1000;
+
+/// How long the server waits for a client to send the whole of its request.
+const int RequestTimeoutMS = 10 * 1000;
+
+/// The number of differently configured warm instances to keep.
+const unsigned MaxWarmInstances = 4;
+
+/// A CompilerInstance whose context has been set up, with the modules which
+/// earlier jobs imported already loaded. Jobs run in forked copies of it, so
+/// it is only ever changed by the server.
+struct WarmInstance {
+  CompilerInstance Instance;
+  PrintingDiagnosticConsumer PDC;
+  DependencyTracker Dependencies;
+
+  /// The directory the instance was set up in, against which relative paths
+  /// in its options are resolved.
+  std::string WorkingDirectory;
+
+  /// The environment the instance was set up in.
+  std::vector<std::string> Environment;
+
+  /// The modification times of the files in Dependencies when they were
+  /// loaded.
+  llvm::StringMap<llvm::sys::TimeValue> ModTimes;
+
+  /// The names of the modules loaded into the instance.
+  llvm::StringSet<> LoadedModules;
+
+  /// When the instance was last used, for evicting the least recently used
+  /// instance.
+  uint64_t LastUse = 0;
+};
+
+/// A job running in a child process.
+struct RunningJob {
+  pid_t Pid;
+
+  /// The connection to the client, which is sent the job's wait status.
+  int Client;
+
+  /// The read end of a pipe on which the job reports the modules it loaded.
+  int Report;
+
+  /// The key of the warm instance the job was forked from.
+  std::string Key;
+
+  /// The names of the modules the job loaded, each followed by a newline.
+  std::string ReportedModules;
+};
+
+/// A connection whose request has not been received in full yet. Clients are
+/// read without blocking as their data arrives, so that one which is slow to
+/// send its request doesn't hold up the others.
+struct PendingRequest {
+  int Client;
+
+  /// The descriptor the client passed for the job's output, or -1.
+  int OutputFd = -1;
+
+  /// When the server gives up on the request.
+  std::chrono::steady_clock::time_point Deadline;
+
+  /// The header, and then the payload, as far as they have been received.
+  uint32_t Header[3];
+  size_t HeaderReceived = 0;
+  std::string Payload;
+  size_t PayloadReceived = 0;
+
+  bool isComplete() const {
+    return HeaderReceived == sizeof(Header) &&
+           PayloadReceived == Payload.size();
+  }
+};
+
+class CompileServer {
+  const char *Argv0;
+  void *MainAddr;
+  std::string MainExecutablePath;
+  std::string SocketPath;
+  int ListenFd = -1;
+  bool Verbose;
+
+  /// The strings the process environment currently points into.
+  std::vector<std::string> CurrentEnvironment;
+  std::vector<char *> CurrentEnvironmentPointers;
+
+  llvm::StringMap<std::unique_ptr<WarmInstance>> WarmInstances;
+  uint64_t UseCount = 0;
+
+  std::vector<RunningJob> Jobs;
+  std::vector<PendingRequest> Requests;
+
+  void acceptClient();
+  bool readRequest(PendingRequest &Request);
+  bool parseRequest(const PendingRequest &Request,
+                    std::vector<std::string> &Strings,
+                    std::vector<std::string> &Environment);
+  void handleRequest(PendingRequest &Request, bool Failed);
+  bool startJob(int Client, int OutputFd, std::vector<std::string> &Strings,
+                std::vector<std::string> &Environment);
+  void setEnvironment(const std::vector<std::string> &Environment);
+  void finishJob(RunningJob &Job);
+  LLVM_ATTRIBUTE_NORETURN
+  void runJob(WarmInstance &Warm, ArrayRef<const char *> Args, int OutputFd,
+              int ReportFd);
+
+  WarmInstance *getWarmInstance(StringRef Key, StringRef WorkingDirectory,
+                                const std::vector<std::string> &Environment,
+                                const CompilerInvocation &Invocation);
+  bool isStale(const WarmInstance &Warm);
+  void loadModules(WarmInstance &Warm, ArrayRef<StringRef> Names);
+
+public:
+  CompileServer(const char *Argv0, void *MainAddr, bool Verbose)
+    : Argv0(Argv0), MainAddr(MainAddr),
+      MainExecutablePath(llvm::sys::fs::getMainExecutable(Argv0, MainAddr)),
+      Verbose(Verbose) {}
+
+  ~CompileServer() {
+    if (ListenFd >= 0) {
+      close(ListenFd);
+      unlink(SocketPath.c_str());
+    }
+  }
+
+  /// Starts listening on the socket at \p Path.
+  /// \returns true on error, false on success
+  bool listen(StringRef Path);
+
+  /// Serves requests until the server has been idle for IdleTimeoutMS.
+  int run();
+};
+
+} // end anonymous namespace
+
+/// Writes all of \p Size bytes of \p Data to \p Fd.
+/// \returns true on error, false on success
+static bool writeAll(int Fd, const void *Data, size_t Size) {
+  const char *Bytes = static_cast<const char *>(Data);
+  while (Size > 0) {
+    ssize_t Written = write(Fd, Bytes, Size);
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      return true;
+    }
+    Bytes += Written;
+    Size -= Written;
+  }
+  return false;
+}
+
+/// Returns true if the process on the other end of \p Client runs as the
+/// same user as the server.
+static bool isSameUser(int Client) {
+#if defined(SO_PEERCRED)
+  struct ucred Credentials;
+  socklen_t Size = sizeof(Credentials);
+  if (getsockopt(Client, SOL_SOCKET, SO_PEERCRED, &Credentials, &Size) != 0)
+    return false;
+  return Credentials.uid == geteuid();
+#else
+  uid_t User;
+  gid_t Group;
+  if (getpeereid(Client, &User, &Group) != 0)
+    return false;
+  return User == geteuid();
+#endif
+}
+
+static void declineRequest(int Client) {
+  int32_t Pid = compile_server::DeclinedPid;
+  (void)writeAll(Client, &Pid, sizeof(Pid));
+  close(Client);
+}
+
+/// Returns a key for everything in a frontend command line which affects the
+/// warm instance set up for it, i.e. everything but the inputs and the
+/// outputs. Relative paths are resolved against \p WorkingDirectory, and
+/// the Clang importer and module search read \p Environment, so both are
+/// part of the key too.
+static std::string computeKey(StringRef WorkingDirectory,
+                              std::vector<std::string> Environment,
+                              ArrayRef<const char *> Args) {
+  using namespace options;
+
+  std::unique_ptr<llvm::opt::OptTable> Table = createSwiftOptTable();
+  unsigned MissingIndex;
+  unsigned MissingCount;
+  llvm::opt::InputArgList ParsedArgs =
+    Table->ParseArgs(Args, MissingIndex, MissingCount, FrontendOption);
+
+  std::string Key = WorkingDirectory.str();
+  std::sort(Environment.begin(), Environment.end());
+  for (const std::string &Var : Environment) {
+    Key.push_back('\0');
+    Key += Var;
+  }
+  // Separates the environment from the arguments.
+  Key.push_back('\0');
+
+  for (const llvm::opt::Arg *A : ParsedArgs) {
+    const llvm::opt::Option &Opt = A->getOption();
+    if (Opt.matches(OPT_INPUT) || Opt.matches(OPT_primary_file))
+      continue;
+
+    Key.push_back('\0');
+    Key += A->getSpelling();
+
+    // Where the outputs go doesn't matter, only which ones are requested
+    // (e.g. module documentation needs comments to be kept).
+    if (Opt.matches(OPT_o) ||
+        Opt.matches(OPT_emit_module_path) ||
+        Opt.matches(OPT_emit_module_doc_path) ||
+        Opt.matches(OPT_emit_objc_header_path) ||
+        Opt.matches(OPT_emit_dependencies_path) ||
+        Opt.matches(OPT_emit_reference_dependencies_path) ||
+        Opt.matches(OPT_serialize_diagnostics_path) ||
+        Opt.matches(OPT_emit_fixits_path) ||
+        Opt.matches(OPT_trace_output) ||
+        Opt.matches(OPT_supplementary_output_file_map))
+      continue;
+
+    for (const char *Value : A->getValues()) {
+      Key.push_back('\0');
+      Key += Value;
+    }
+  }
+  return Key;
+}
+
+bool CompileServer::listen(StringRef Path) {
+  struct sockaddr_un Addr;
+  if (Path.size() >= sizeof(Addr.sun_path)) {
+    llvm::errs() << "error: compile server socket path is too long: " << Path
+                 << "\n";
+    return true;
+  }
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  memcpy(Addr.sun_path, Path.data(), Path.size());
+  auto *SockAddr = reinterpret_cast<struct sockaddr *>(&Addr);
+
+  int Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Fd < 0) {
+    llvm::errs() << "error: cannot create socket: " << strerror(errno) << "\n";
+    return true;
+  }
+
+  // A socket which nobody answers on is left over from a server which didn't
+  // shut down cleanly.
+  if (connect(Fd, SockAddr, sizeof(Addr)) == 0) {
+    llvm::errs() << "error: a compile server is already listening on " << Path
+                 << "\n";
+    close(Fd);
+    return true;
+  }
+  close(Fd);
+
+  // Only a socket of this user is replaced, not whatever else may be at the
+  // path.
+  struct stat Status;
+  if (lstat(Addr.sun_path, &Status) == 0) {
+    if (!S_ISSOCK(Status.st_mode) || Status.st_uid != getuid()) {
+      llvm::errs() << "error: cannot listen on " << Path
+                   << ": the path exists and is not a socket of this user\n";
+      return true;
+    }
+    unlink(Addr.sun_path);
+  }
+
+  // Jobs run with the server's privileges, so only its user may connect.
+  // The socket is created without permissions for anyone else, rather than
+  // restricted after the fact.
+  Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t OldMask = umask(S_IRWXG | S_IRWXO);
+  bool Bound = Fd >= 0 && bind(Fd, SockAddr, sizeof(Addr)) == 0;
+  umask(OldMask);
+  if (!Bound || chmod(Addr.sun_path, S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(Fd, SOMAXCONN) != 0) {
+    llvm::errs() << "error: cannot listen on " << Path << ": "
+                 << strerror(errno) << "\n";
+    if (Fd >= 0)
+      close(Fd);
+    if (Bound)
+      unlink(Addr.sun_path);
+    return true;
+  }
+
+  ListenFd = Fd;
+  SocketPath = Path.str();
+  return false;
+}
+
+/// Accepts a connection, whose request is then read as it arrives.
+void CompileServer::acceptClient() {
+  int Client = accept(ListenFd, nullptr, nullptr);
+  if (Client < 0)
+    return;
+  int Flags = fcntl(Client, F_GETFL);
+  if (!isSameUser(Client) || Flags < 0 ||
+      fcntl(Client, F_SETFL, Flags | O_NONBLOCK) != 0) {
+    close(Client);
+    return;
+  }
+
+  PendingRequest Request;
+  Request.Client = Client;
+  Request.Deadline = std::chrono::steady_clock::now() +
+                     std::chrono::milliseconds(RequestTimeoutMS);
+  Requests.push_back(std::move(Request));
+}
+
+/// Reads as much of \p Request as the client has sent so far, without
+/// blocking.
+/// \returns true on error, false on success
+bool CompileServer::readRequest(PendingRequest &Request) {
+  // The output descriptor comes with the header.
+  while (Request.HeaderReceived < sizeof(Request.Header)) {
+    struct iovec IOV = {
+      reinterpret_cast<char *>(Request.Header) + Request.HeaderReceived,
+      sizeof(Request.Header) - Request.HeaderReceived
+    };
+    char Control[CMSG_SPACE(sizeof(int))];
+    struct msghdr Message;
+    memset(&Message, 0, sizeof(Message));
+    Message.msg_iov = &IOV;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = sizeof(Control);
+
+    ssize_t Received = recvmsg(Request.Client, &Message, 0);
+    if (Received < 0 && errno == EINTR)
+      continue;
+    if (Received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    if (Received <= 0)
+      return true;
+
+    struct cmsghdr *ControlMessage = CMSG_FIRSTHDR(&Message);
+    if (ControlMessage && ControlMessage->cmsg_level == SOL_SOCKET &&
+        ControlMessage->cmsg_type == SCM_RIGHTS) {
+      int Fd;
+      memcpy(&Fd, CMSG_DATA(ControlMessage), sizeof(int));
+      if (Request.OutputFd >= 0) {
+        close(Fd);
+        return true;
+      }
+      Request.OutputFd = Fd;
+    }
+
+    Request.HeaderReceived += Received;
+    if (Request.HeaderReceived < sizeof(Request.Header))
+      continue;
+    if (Request.OutputFd < 0 ||
+        Request.Header[0] != compile_server::RequestSignature ||
+        Request.Header[1] > compile_server::MaxPayloadSize)
+      return true;
+    Request.Payload.resize(Request.Header[1]);
+  }
+
+  while (Request.PayloadReceived < Request.Payload.size()) {
+    ssize_t ReadBytes = read(Request.Client,
+                             &Request.Payload[Request.PayloadReceived],
+                             Request.Payload.size() - Request.PayloadReceived);
+    if (ReadBytes < 0 && errno == EINTR)
+      continue;
+    if (ReadBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    if (ReadBytes <= 0)
+      return true;
+    Request.PayloadReceived += ReadBytes;
+  }
+  return false;
+}
+
+/// Splits the payload of a complete request into the command line and the
+/// environment.
+/// \returns true on error, false on success
+bool CompileServer::parseRequest(const PendingRequest &Request,
+                                 std::vector<std::string> &Strings,
+                                 std::vector<std::string> &Environment) {
+  // The command line comes first, then the environment.
+  StringRef Rest = Request.Payload;
+  while (!Rest.empty()) {
+    size_t End = Rest.find('\0');
+    if (End == StringRef::npos)
+      return true;
+    if (Strings.size() < Request.Header[2])
+      Strings.push_back(Rest.substr(0, End).str());
+    else
+      Environment.push_back(Rest.substr(0, End).str());
+    Rest = Rest.substr(End + 1);
+  }
+  return Strings.size() != Request.Header[2];
+}
+
+/// Starts the job \p Request asks for, or declines it if it \p Failed or
+/// the job can't run here.
+void CompileServer::handleRequest(PendingRequest &Request, bool Failed) {
+  // The replies are a few bytes each, which the client waits for.
+  int Flags = fcntl(Request.Client, F_GETFL);
+  if (Flags >= 0)
+    fcntl(Request.Client, F_SETFL, Flags & ~O_NONBLOCK);
+
+  std::vector<std::string> Strings;
+  std::vector<std::string> Environment;
+  bool Started =
+    !Failed && !parseRequest(Request, Strings, Environment) &&
+    startJob(Request.Client, Request.OutputFd, Strings, Environment);
+  if (!Started) {
+    if (Verbose)
+      llvm::errs() << "compile server: declined a job\n";
+    declineRequest(Request.Client);
+  }
+  if (Request.OutputFd >= 0)
+    close(Request.OutputFd);
+}
+
+/// Makes \p Environment the environment of the server process. Warm
+/// instances are set up and jobs forked in the environment of their client.
+void
+CompileServer::setEnvironment(const std::vector<std::string> &Environment) {
+  CurrentEnvironment = Environment;
+  CurrentEnvironmentPointers.clear();
+  for (std::string &Var : CurrentEnvironment)
+    CurrentEnvironmentPointers.push_back(&Var[0]);
+  CurrentEnvironmentPointers.push_back(nullptr);
+#if __APPLE__
+  *_NSGetEnviron() = CurrentEnvironmentPointers.data();
+#else
+  environ = CurrentEnvironmentPointers.data();
+#endif
+}
+
+bool CompileServer::isStale(const WarmInstance &Warm) {
+  for (const std::string &Path : Warm.Dependencies.getDependencies()) {
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(Path, Status))
+      return true;
+    auto Known = Warm.ModTimes.find(Path);
+    if (Known == Warm.ModTimes.end() ||
+        Known->second != Status.getLastModificationTime())
+      return true;
+  }
+  return false;
+}
+
+void CompileServer::loadModules(WarmInstance &Warm, ArrayRef<StringRef> Names) {
+  ASTContext &Context = Warm.Instance.getASTContext();
+  for (StringRef Name : Names) {
+    if (!Warm.LoadedModules.insert(Name).second)
+      continue;
+    Context.getModule({ std::make_pair(Context.getIdentifier(Name),
+                                       SourceLoc()) });
+  }
+
+  for (const std::string &Path : Warm.Dependencies.getDependencies()) {
+    if (Warm.ModTimes.count(Path))
+      continue;
+    llvm::sys::fs::file_status Status;
+    if (!llvm::sys::fs::status(Path, Status))
+      Warm.ModTimes[Path] = Status.getLastModificationTime();
+  }
+}
+
+WarmInstance *
+CompileServer::getWarmInstance(StringRef Key, StringRef WorkingDirectory,
+                               const std::vector<std::string> &Environment,
+                               const CompilerInvocation &Invocation) {
+  auto Existing = WarmInstances.find(Key);
+  if (Existing != WarmInstances.end() && isStale(*Existing->second))
+    WarmInstances.erase(Existing);
+
+  if (!WarmInstances.count(Key)) {
+    if (WarmInstances.size() >= MaxWarmInstances) {
+      auto Oldest = WarmInstances.begin();
+      for (auto I = WarmInstances.begin(), E = WarmInstances.end(); I != E; ++I)
+        if (I->second->LastUse < Oldest->second->LastUse)
+          Oldest = I;
+      WarmInstances.erase(Oldest);
+    }
+
+    std::unique_ptr<WarmInstance> Warm(new WarmInstance());
+    Warm->Instance.addDiagnosticConsumer(&Warm->PDC);
+    if (Invocation.getDiagnosticOptions().UseColor)
+      Warm->PDC.forceColors();
+    Warm->Instance.setDependencyTracker(&Warm->Dependencies);
+    Warm->WorkingDirectory = WorkingDirectory.str();
+    Warm->Environment = Environment;
+    if (Verbose)
+      llvm::errs() << "compile server: setting up an instance in "
+                   << WorkingDirectory << "\n";
+    if (Warm->Instance.setupContext(Invocation))
+      return nullptr;
+
+    SmallVector<StringRef, 1> InitialModules;
+    if (!Invocation.getParseStdlib())
+      InitialModules.push_back(STDLIB_NAME);
+    loadModules(*Warm, InitialModules);
+    if (Warm->Instance.getASTContext().hadError())
+      return nullptr;
+
+    WarmInstances[Key] = std::move(Warm);
+  }
+
+  WarmInstance *Warm = WarmInstances[Key].get();
+  Warm->LastUse = ++UseCount;
+  return Warm;
+}
+
+void CompileServer::runJob(WarmInstance &Warm, ArrayRef<const char *> Args,
+                           int OutputFd, int ReportFd) {
+  close(ListenFd);
+  for (const RunningJob &Job : Jobs) {
+    close(Job.Client);
+    close(Job.Report);
+  }
+  signal(SIGPIPE, SIG_DFL);
+
+  dup2(OutputFd, STDOUT_FILENO);
+  dup2(OutputFd, STDERR_FILENO);
+  close(OutputFd);
+
+  int Result = frontend_main(Args, Argv0, MainAddr, &Warm.Instance);
+  llvm::outs().flush();
+
+  // Report the modules this job needed, so that later jobs find them loaded.
+  if (Result == 0) {
+    ASTContext &Context = Warm.Instance.getASTContext();
+    Identifier MainModuleName = Warm.Instance.getMainModule()->getName();
+    std::string Names;
+    for (auto &Entry : Context.LoadedModules) {
+      if (Entry.first == MainModuleName ||
+          Warm.LoadedModules.count(Entry.first.str()))
+        continue;
+      Names += Entry.first.str();
+      Names += '\n';
+    }
+    (void)writeAll(ReportFd, Names.data(), Names.size());
+  }
+
+  // Skip the destructors of everything we share with the server.
+  _exit(Result);
+}
+
+bool CompileServer::startJob(int Client, int OutputFd,
+                             std::vector<std::string> &Strings,
+                             std::vector<std::string> &Environment) {
+  // The payload is the working directory, the executable, "-frontend" and
+  // the frontend arguments.
+  if (Strings.size() < 3 || Strings[2] != "-frontend")
+    return false;
+  StringRef WorkingDirectory = Strings[0];
+
+  // Only run jobs meant for this compiler.
+  bool SameExecutable = false;
+  if (llvm::sys::fs::equivalent(Strings[1], MainExecutablePath,
+                                SameExecutable) || !SameExecutable)
+    return false;
+
+  if (chdir(Strings[0].c_str()) != 0)
+    return false;
+  setEnvironment(Environment);
+
+  std::vector<const char *> Args;
+  for (unsigned i = 3, e = Strings.size(); i != e; ++i)
+    Args.push_back(Strings[i].c_str());
+
+  // If the arguments are bad, the client runs the job itself to report it.
+  CompilerInvocation Invocation;
+  Invocation.setMainExecutablePath(MainExecutablePath);
+  SourceManager SM;
+  DiagnosticEngine Diags(SM);
+  if (Invocation.parseArgs(Args, Diags, WorkingDirectory))
+    return false;
+
+  // -Xllvm options are global to the process, and interactive modes can't
+  // run here.
+  const FrontendOptions &Opts = Invocation.getFrontendOptions();
+  if (!Opts.LLVMArgs.empty() || Opts.PrintHelp || Opts.PrintHelpHidden ||
+      Opts.RequestedAction == FrontendOptions::NoneAction ||
+      Opts.actionIsImmediate())
+    return false;
+
+  std::string Key = computeKey(WorkingDirectory, Environment, Args);
+  WarmInstance *Warm = getWarmInstance(Key, WorkingDirectory, Environment,
+                                       Invocation);
+  if (!Warm)
+    return false;
+
+  int ReportPipe[2];
+  if (pipe(ReportPipe) != 0)
+    return false;
+
+  pid_t Pid = fork();
+  if (Pid < 0) {
+    close(ReportPipe[0]);
+    close(ReportPipe[1]);
+    return false;
+  }
+  if (Pid == 0) {
+    close(Client);
+    close(ReportPipe[0]);
+    runJob(*Warm, Args, OutputFd, ReportPipe[1]);
+  }
+
+  close(ReportPipe[1]);
+  if (Verbose)
+    llvm::errs() << "compile server: started job " << Pid << "\n";
+
+  // If the client has gone away, the job still runs to completion.
+  int32_t JobPid = Pid;
+  (void)writeAll(Client, &JobPid, sizeof(JobPid));
+  Jobs.push_back({ Pid, Client, ReportPipe[0], Key, std::string() });
+  return true;
+}
+
+void CompileServer::finishJob(RunningJob &Job) {
+  int Status = 0;
+  while (waitpid(Job.Pid, &Status, 0) < 0 && errno == EINTR)
+    ;
+
+  int32_t ClientStatus = Status;
+  (void)writeAll(Job.Client, &ClientStatus, sizeof(ClientStatus));
+  close(Job.Client);
+  close(Job.Report);
+
+  if (!WIFEXITED(Status) || WEXITSTATUS(Status) != 0 ||
+      Job.ReportedModules.empty())
+    return;
+
+  auto Found = WarmInstances.find(Job.Key);
+  if (Found == WarmInstances.end())
+    return;
+  WarmInstance &Warm = *Found->second;
+
+  SmallVector<StringRef, 8> Names;
+  StringRef(Job.ReportedModules).split(Names, "\n", /*MaxSplit*/-1,
+                                       /*KeepEmpty*/false);
+  if (chdir(Warm.WorkingDirectory.c_str()) != 0)
+    return;
+  setEnvironment(Warm.Environment);
+  loadModules(Warm, Names);
+
+  // A module which fails to load here would make every later job fail.
+  if (Warm.Instance.getASTContext().hadError())
+    WarmInstances.erase(Found);
+}
+
+int CompileServer::run() {
+  while (true) {
+    std::vector<struct pollfd> PollFds;
+    PollFds.push_back({ ListenFd, POLLIN, 0 });
+    for (const RunningJob &Job : Jobs)
+      PollFds.push_back({ Job.Report, POLLIN | POLLHUP, 0 });
+    for (const PendingRequest &Request : Requests)
+      PollFds.push_back({ Request.Client, POLLIN, 0 });
+    size_t FirstRequestFd = 1 + Jobs.size();
+
+    // Wake up for the first request to time out, if any. Otherwise exit
+    // once the server has been idle for long enough.
+    int TimeoutMS = Jobs.empty() ? IdleTimeoutMS : -1;
+    if (!Requests.empty()) {
+      auto Now = std::chrono::steady_clock::now();
+      auto FirstDeadline = Requests.front().Deadline;
+      for (const PendingRequest &Request : Requests)
+        FirstDeadline = std::min(FirstDeadline, Request.Deadline);
+      TimeoutMS = std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+          FirstDeadline - Now).count());
+    }
+
+    int ReadyFdCount = poll(PollFds.data(), PollFds.size(), TimeoutMS);
+    if (ReadyFdCount == -1) {
+      if (errno == EAGAIN || errno == EINTR)
+        continue;
+      llvm::errs() << "error: poll failed: " << strerror(errno) << "\n";
+      return 1;
+    }
+    if (ReadyFdCount == 0 && Jobs.empty() && Requests.empty())
+      return 0;
+
+    // A job has finished once its end of the report pipe is closed. Walk
+    // backwards so that finished jobs can be removed as we go.
+    for (size_t i = Jobs.size(); i-- > 0;) {
+      if (!(PollFds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      char Buffer[1024];
+      ssize_t ReadBytes = read(Jobs[i].Report, Buffer, sizeof(Buffer));
+      if (ReadBytes < 0 && errno == EINTR)
+        continue;
+      if (ReadBytes > 0) {
+        Jobs[i].ReportedModules.append(Buffer, ReadBytes);
+        continue;
+      }
+      finishJob(Jobs[i]);
+      Jobs.erase(Jobs.begin() + i);
+    }
+
+    // Handle the requests which are complete, broken or out of time.
+    auto Now = std::chrono::steady_clock::now();
+    for (size_t i = Requests.size(); i-- > 0;) {
+      PendingRequest &Request = Requests[i];
+      bool Failed = false;
+      if (PollFds[FirstRequestFd + i].revents & (POLLIN | POLLHUP | POLLERR))
+        Failed = readRequest(Request);
+      if (!Failed && !Request.isComplete() && Now < Request.Deadline)
+        continue;
+      handleRequest(Request, Failed || !Request.isComplete());
+      Requests.erase(Requests.begin() + i);
+    }
+
+    if (PollFds[0].revents & POLLIN)
+      acceptClient();
+  }
+}
+
+int compile_server_main(ArrayRef<const char *> Args, const char *Argv0,
+                        void *MainAddr) {
+  // With -v, the server logs what it does to stderr.
+  bool Verbose = !Args.empty() && StringRef(Args[0]) == "-v";
+  if (Verbose)
+    Args = Args.slice(1);
+  if (Args.size() != 1) {
+    llvm::errs() << "usage: swift -compile-server [-v] <socket-path>\n";
+    return 1;
+  }
+
+  // Clients which go away must not take the server down with them.
+  signal(SIGPIPE, SIG_IGN);
+
+  CompileServer Server(Argv0, MainAddr, Verbose);
+  if (Server.listen(Args[0]))
+    return 1;
+  return Server.run();
+}
+
+#else
+
+int compile_server_main(ArrayRef<const char *> Args, const char *Argv0,
+                        void *MainAddr) {
+  llvm::errs() << "error: the compile server is not supported on this "
+                  "platform\n";
+  return 1;
+}
+
+#endif
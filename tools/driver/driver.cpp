@@ -50,7 +50,12 @@ std::string getExecutablePath(const char *FirstArg) {
 }
 
 extern int frontend_main(ArrayRef<const char *> Args, const char *Argv0,
-                         void *MainAddr);
+                         void *MainAddr,
+                         CompilerInstance *WarmInstance = nullptr);
+
+/// Run as a compile server, which runs frontend jobs for the driver.
+extern int compile_server_main(ArrayRef<const char *> Args, const char *Argv0,
+                               void *MainAddr);
 
 /// Run 'swift-autolink-extract'.
 extern int autolink_extract_main(ArrayRef<const char *> Args, const char *Argv0,
@@ -157,6 +162,11 @@ int main(int argc_, const char **argv_) {
                                               argv.data()+argv.size()),
                            argv[0], (void *)(intptr_t)getExecutablePath);
     }
+    if (FirstArg == "-compile-server") {
+      return compile_server_main(llvm::makeArrayRef(argv.data()+2,
+                                                    argv.data()+argv.size()),
+                                 argv[0], (void *)(intptr_t)getExecutablePath);
+    }
     if (FirstArg == "-modulewrap") {
       return modulewrap_main(llvm::makeArrayRef(argv.data()+2,
                                                 argv.data()+argv.size()),
@@ -18,6 +18,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "swift/Subsystems.h"
+#include "swift/Strings.h"
 #include "swift/AST/DiagnosticsFrontend.h"
 #include "swift/AST/DiagnosticsSema.h"
 #include "swift/AST/IRGenOptions.h"
@@ -25,9 +26,13 @@
 #include "swift/AST/NameLookup.h"
 #include "swift/AST/ReferencedNameTracker.h"
 #include "swift/AST/TypeRefinementContext.h"
+#include "swift/Basic/Defer.h"
 #include "swift/Basic/Fallthrough.h"
 #include "swift/Basic/FileSystem.h"
 #include "swift/Basic/SourceManager.h"
+#include "swift/Basic/TraceEvents.h"
+#include "swift/Driver/DependencyFile.h"
+#include "swift/Driver/OutputFileMap.h"
 #include "swift/Frontend/DiagnosticVerifier.h"
 #include "swift/Frontend/Frontend.h"
 #include "swift/Frontend/PrintingDiagnosticConsumer.h"
@@ -36,23 +41,26 @@
 #include "swift/Option/Options.h"
 #include "swift/PrintAsObjC/PrintAsObjC.h"
 #include "swift/Serialization/SerializationOptions.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SILPasses/Passes.h"
 
 // FIXME: We're just using CompilerInstance::createOutputFile.
 // This API should be sunk down to LLVM.
 #include "clang/Frontend/CompilerInstance.h"
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Option/Option.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
-#include "llvm/Support/YAMLParser.h"
 
 #include <memory>
 
@@ -116,14 +124,22 @@ static bool emitMakeDependencies(DiagnosticEngine &diags,
   return false;
 }
 
+/// The fingerprints of the top-level declarations which contribute to each
+/// nominal type a file provides.
+using NominalFingerprintMap =
+  llvm::DenseMap<const NominalTypeDecl *, SmallVector<std::string, 2>>;
+
 static void findNominals(llvm::MapVector<const NominalTypeDecl *, bool> &found,
-                         DeclRange members) {
+                         NominalFingerprintMap &fingerprints,
+                         StringRef fingerprint, DeclRange members) {
   for (const Decl *D : members) {
     auto nominal = dyn_cast<NominalTypeDecl>(D);
     if (!nominal)
       continue;
     found[nominal] |= true;
-    findNominals(found, nominal->getMembers(/*forceDelayed=*/false));
+    fingerprints[nominal].push_back(fingerprint.str());
+    findNominals(found, fingerprints, fingerprint,
+                 nominal->getMembers(/*forceDelayed=*/false));
   }
 }
 
@@ -193,17 +209,114 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
     return true;
   }
 
-  auto escape = [](Identifier name) -> std::string {
-    return llvm::yaml::escape(name.str());
+  using Section = DependencySection;
+  DependencyFileWriter writer;
+
+  auto mangledName = [](const NominalTypeDecl *NTD) -> std::string {
+    std::string result;
+    llvm::raw_string_ostream nameOut(result);
+    mangleTypeAsContext(nameOut, NTD);
+    return nameOut.str();
   };
 
-  out << "### Swift dependencies file v0 ###\n";
+  // A change to the imports of the file can change the meaning of any of its
+  // declarations, so they are part of every fingerprint.
+  bool importsHaveFingerprints = true;
+  llvm::MD5 importsHash;
+  for (const Decl *D : SF->Decls) {
+    if (!isa<ImportDecl>(D))
+      continue;
+    StringRef fingerprint = SF->getDeclFingerprint(D);
+    importsHaveFingerprints &= !fingerprint.empty();
+    importsHash.update(fingerprint);
+  }
+
+  // A declaration's meaning also depends on the other declarations of the
+  // file which its interface names, such as a typealias in a signature, or a
+  // function whose result type is inferred for a variable. Since the driver
+  // doesn't follow dependencies within a file, the fingerprints of those
+  // declarations are folded into the declaration's own, transitively.
+  //
+  // Which declarations a name may refer to is decided by the name alone; an
+  // extension stands for its extended type and its members.
+  llvm::StringMap<SmallVector<StringRef, 2>> fingerprintsByName;
+  llvm::StringMap<const Decl *> declsByFingerprint;
+  for (const Decl *D : SF->Decls) {
+    StringRef fingerprint = SF->getDeclFingerprint(D);
+    if (fingerprint.empty())
+      continue;
+    declsByFingerprint[fingerprint] = D;
+
+    auto addName = [&](Identifier name) {
+      if (!name.empty())
+        fingerprintsByName[name.str()].push_back(fingerprint);
+    };
+    if (auto *VD = dyn_cast<ValueDecl>(D)) {
+      addName(VD->getName());
+    } else if (auto *OD = dyn_cast<OperatorDecl>(D)) {
+      addName(OD->getName());
+    } else if (auto *ED = dyn_cast<ExtensionDecl>(D)) {
+      if (auto *NTD = ED->getExtendedType()->getAnyNominal())
+        addName(NTD->getName());
+      for (const Decl *member : ED->getMembers())
+        if (auto *VD = dyn_cast<ValueDecl>(member))
+          addName(VD->getName());
+    }
+  }
+
+  llvm::StringMap<std::string> foldedFingerprints;
+  auto getFingerprint = [&](const Decl *D) -> std::string {
+    StringRef declFingerprint = SF->getDeclFingerprint(D);
+    if (declFingerprint.empty() || !importsHaveFingerprints)
+      return std::string();
+
+    auto known = foldedFingerprints.find(declFingerprint);
+    if (known != foldedFingerprints.end())
+      return known->second;
+
+    // Find the declarations this one refers to, directly or not.
+    llvm::StringSet<> reached;
+    SmallVector<StringRef, 8> worklist;
+    reached.insert(declFingerprint);
+    worklist.push_back(declFingerprint);
+    while (!worklist.empty()) {
+      StringRef next = worklist.pop_back_val();
+      auto *tokens = SF->getDeclInterfaceTokens(declsByFingerprint[next]);
+      if (!tokens)
+        continue;
+      for (auto &token : *tokens) {
+        auto declared = fingerprintsByName.find(token.getKey());
+        if (declared == fingerprintsByName.end())
+          continue;
+        for (StringRef referenced : declared->second)
+          if (reached.insert(referenced).second)
+            worklist.push_back(referenced);
+      }
+    }
+
+    SmallVector<StringRef, 8> referenced;
+    for (auto &entry : reached)
+      referenced.push_back(entry.getKey());
+    std::sort(referenced.begin(), referenced.end());
+
+    llvm::MD5 hash = importsHash;
+    hash.update(declFingerprint);
+    for (StringRef fingerprint : referenced)
+      hash.update(fingerprint);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    SmallString<32> fingerprint;
+    llvm::MD5::stringifyResult(result, fingerprint);
+    return foldedFingerprints[declFingerprint] = fingerprint.str().str();
+  };
 
   llvm::MapVector<const NominalTypeDecl *, bool> extendedNominals;
+  NominalFingerprintMap nominalFingerprints;
   llvm::SmallVector<const ExtensionDecl *, 8> extensionsWithJustMembers;
 
-  out << "provides-top-level:\n";
+  writer.addSection(Section::ProvidesTopLevel);
   for (const Decl *D : SF->Decls) {
+    std::string fingerprint = getFingerprint(D);
     switch (D->getKind()) {
     case DeclKind::Module:
       break;
@@ -234,15 +347,20 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
         }
       }
       extendedNominals[NTD] |= !justMembers;
-      findNominals(extendedNominals, ED->getMembers());
+      nominalFingerprints[NTD].push_back(fingerprint);
+      findNominals(extendedNominals, nominalFingerprints, fingerprint,
+                   ED->getMembers());
       break;
     }
 
     case DeclKind::InfixOperator:
     case DeclKind::PrefixOperator:
-    case DeclKind::PostfixOperator:
-      out << "- \"" << escape(cast<OperatorDecl>(D)->getName()) << "\"\n";
+    case DeclKind::PostfixOperator: {
+      StringRef name = cast<OperatorDecl>(D)->getName().str();
+      writer.addEntry(Section::ProvidesTopLevel, name);
+      writer.addFingerprint(name, fingerprint);
       break;
+    }
 
     case DeclKind::Enum:
     case DeclKind::Struct:
@@ -255,9 +373,12 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           NTD->getFormalAccess() == Accessibility::Private) {
         break;
       }
-      out << "- \"" << escape(NTD->getName()) << "\"\n";
+      writer.addEntry(Section::ProvidesTopLevel, NTD->getName().str());
+      writer.addFingerprint(NTD->getName().str(), fingerprint);
       extendedNominals[NTD] |= true;
-      findNominals(extendedNominals, NTD->getMembers());
+      nominalFingerprints[NTD].push_back(fingerprint);
+      findNominals(extendedNominals, nominalFingerprints, fingerprint,
+                   NTD->getMembers());
       break;
     }
 
@@ -271,7 +392,8 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           VD->getFormalAccess() == Accessibility::Private) {
         break;
       }
-      out << "- \"" << escape(VD->getName()) << "\"\n";
+      writer.addEntry(Section::ProvidesTopLevel, VD->getName().str());
+      writer.addFingerprint(VD->getName().str(), fingerprint);
       break;
     }
 
@@ -293,27 +415,28 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
     }
   }
 
-  out << "provides-nominal:\n";
+  writer.addSection(Section::ProvidesNominal);
   for (auto entry : extendedNominals) {
     if (!entry.second)
       continue;
-    out << "- \"";
-    mangleTypeAsContext(out, entry.first);
-    out << "\"\n";
+    std::string name = mangledName(entry.first);
+    writer.addEntry(Section::ProvidesNominal, name);
+    for (auto &fingerprint : nominalFingerprints[entry.first])
+      writer.addFingerprint(name, fingerprint);
   }
 
-  out << "provides-member:\n";
+  writer.addSection(Section::ProvidesMember);
   for (auto entry : extendedNominals) {
-    out << "- [\"";
-    mangleTypeAsContext(out, entry.first);
-    out << "\", \"\"]\n";
+    std::string name = mangledName(entry.first);
+    writer.addMemberEntry(Section::ProvidesMember, name, "");
+    for (auto &fingerprint : nominalFingerprints[entry.first])
+      writer.addMemberFingerprint(name, "", fingerprint);
   }
 
   // This is also part of "provides-member".
   for (auto *ED : extensionsWithJustMembers) {
-    SmallString<32> mangledName;
-    mangleTypeAsContext(llvm::raw_svector_ostream(mangledName),
-                        ED->getExtendedType()->getAnyNominal());
+    std::string mangledBaseName =
+      mangledName(ED->getExtendedType()->getAnyNominal());
 
     for (auto *member : ED->getMembers()) {
       auto *VD = dyn_cast<ValueDecl>(member);
@@ -321,8 +444,10 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
           VD->getFormalAccess() == Accessibility::Private) {
         continue;
       }
-      out << "- [\"" << mangledName.str() << "\", \""
-          << escape(VD->getName()) << "\"]\n";
+      writer.addMemberEntry(Section::ProvidesMember, mangledBaseName,
+                            VD->getName().str());
+      writer.addMemberFingerprint(mangledBaseName, VD->getName().str(),
+                                  getFingerprint(ED));
     }
   }
 
@@ -330,36 +455,36 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
     // FIXME: This requires a traversal of the whole file to compute.
     // We should (a) see if there's a cheaper way to keep it up to date,
     // and/or (b) see if we can fast-path cases where there's no ObjC involved.
-    out << "provides-dynamic-lookup:\n";
+    writer.addSection(Section::ProvidesDynamicLookup);
     class ValueDeclPrinter : public VisibleDeclConsumer {
     private:
-      raw_ostream &out;
-      std::string (*escape)(Identifier);
+      DependencyFileWriter &writer;
+      llvm::function_ref<std::string(const Decl *)> getFingerprint;
     public:
-      ValueDeclPrinter(raw_ostream &out, decltype(escape) escape)
-        : out(out), escape(escape) {}
+      ValueDeclPrinter(DependencyFileWriter &writer,
+                       llvm::function_ref<std::string(const Decl *)> getFP)
+        : writer(writer), getFingerprint(getFP) {}
 
       void foundDecl(ValueDecl *VD, DeclVisibilityKind Reason) override {
-        out << "- \"" << escape(VD->getName()) << "\"\n";
+        writer.addEntry(Section::ProvidesDynamicLookup, VD->getName().str());
+        writer.addFingerprint(VD->getName().str(), getFingerprint(VD));
       }
     };
-    ValueDeclPrinter printer(out, escape);
+    ValueDeclPrinter printer(writer, getFingerprint);
     SF->lookupClassMembers({}, printer);
   }
 
   ReferencedNameTracker *tracker = SF->getReferencedNameTracker();
 
   // FIXME: Sort these?
-  out << "depends-top-level:\n";
+  writer.addSection(Section::DependsTopLevel);
   for (auto &entry : tracker->getTopLevelNames()) {
     assert(!entry.first.empty());
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "\"" << escape(entry.first) << "\"\n";
+    writer.addEntry(Section::DependsTopLevel, entry.first.str(),
+                    entry.second);
   }
 
-  out << "depends-member:\n";
+  writer.addSection(Section::DependsMember);
   auto &memberLookupTable = tracker->getUsedMembers();
   using TableEntryTy = std::pair<ReferencedNameTracker::MemberPair, bool>;
   std::vector<TableEntryTy> sortedMembers{
@@ -389,18 +514,15 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
         entry.first.first->getFormalAccess() == Accessibility::Private)
       continue;
 
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "[\"";
-    mangleTypeAsContext(out, entry.first.first);
-    out << "\", \"";
+    StringRef memberName;
     if (!entry.first.second.empty())
-      out << escape(entry.first.second);
-    out << "\"]\n";
+      memberName = entry.first.second.str();
+    writer.addMemberEntry(Section::DependsMember,
+                          mangledName(entry.first.first), memberName,
+                          entry.second);
   }
 
-  out << "depends-nominal:\n";
+  writer.addSection(Section::DependsNominal);
   for (auto i = sortedMembers.begin(), e = sortedMembers.end(); i != e; ++i) {
     bool isCascading = i->second;
     while (i+1 != e && i[0].first.first == i[1].first.first) {
@@ -412,32 +534,30 @@ static bool emitReferenceDependencies(DiagnosticEngine &diags,
         i->first.first->getFormalAccess() == Accessibility::Private)
       continue;
 
-    out << "- ";
-    if (!isCascading)
-      out << "!private ";
-    out << "\"";
-    mangleTypeAsContext(out, i->first.first);
-    out << "\"\n";
+    writer.addEntry(Section::DependsNominal, mangledName(i->first.first),
+                    isCascading);
   }
 
   // FIXME: Sort these?
-  out << "depends-dynamic-lookup:\n";
+  writer.addSection(Section::DependsDynamicLookup);
   for (auto &entry : tracker->getDynamicLookupNames()) {
     assert(!entry.first.empty());
-    out << "- ";
-    if (!entry.second)
-      out << "!private ";
-    out << "\"" << escape(entry.first) << "\"\n";
+    writer.addEntry(Section::DependsDynamicLookup, entry.first.str(),
+                    entry.second);
   }
 
-  out << "depends-external:\n";
-  for (auto &entry : depTracker.getDependencies()) {
-    out << "- \"" << llvm::yaml::escape(entry) << "\"\n";
-  }
+  writer.addSection(Section::DependsExternal);
+  for (auto &entry : depTracker.getDependencies())
+    writer.addEntry(Section::DependsExternal, entry);
 
   llvm::SmallString<32> interfaceHash;
   SF->getInterfaceHash(interfaceHash);
-  out << "interface-hash: \"" << interfaceHash << "\"\n";
+  writer.setInterfaceHash(interfaceHash);
+
+  if (opts.BinaryReferenceDependencies)
+    writer.writeBinary(out);
+  else
+    writer.writeYAML(out);
 
   return false;
 }
@@ -608,121 +728,71 @@ static void debugFailWithCrash() {
   LLVM_BUILTIN_TRAP;
 }
 
-/// Performs the compile requested by the user.
-/// \returns true on error
-static bool performCompile(CompilerInstance &Instance,
-                           CompilerInvocation &Invocation,
-                           ArrayRef<const char *> Args,
-                           int &ReturnValue) {
-  FrontendOptions opts = Invocation.getFrontendOptions();
-  FrontendOptions::ActionType Action = opts.RequestedAction;
-
-  IRGenOptions &IRGenOpts = Invocation.getIRGenOptions();
-
-  bool inputIsLLVMIr = Invocation.getInputKind() == InputFileKind::IFK_LLVM_IR;
-  if (inputIsLLVMIr) {
-    auto &LLVMContext = llvm::getGlobalContext();
-
-    // Load in bitcode file.
-    assert(Invocation.getInputFilenames().size() == 1 &&
-           "We expect a single input for bitcode input!");
-    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileBufOrErr =
-      llvm::MemoryBuffer::getFileOrSTDIN(Invocation.getInputFilenames()[0]);
-    if (!FileBufOrErr) {
-      Instance.getASTContext().Diags.diagnose(SourceLoc(),
-                                              diag::error_open_input_file,
-                                              Invocation.getInputFilenames()[0],
-                                              FileBufOrErr.getError().message());
-      return true;
-    }
-    llvm::MemoryBuffer *MainFile = FileBufOrErr.get().get();
-
-    llvm::SMDiagnostic Err;
-    std::unique_ptr<llvm::Module> Module = llvm::parseIR(
-                                             MainFile->getMemBufferRef(),
-                                             Err, LLVMContext);
-    if (!Module) {
-      // TODO: Translate from the diagnostic info to the SourceManager location
-      // if available.
-      Instance.getASTContext().Diags.diagnose(SourceLoc(),
-                                              diag::error_parse_input_file,
-                                              Invocation.getInputFilenames()[0],
-                                              Err.getMessage());
-      return true;
-    }
-
-    // TODO: remove once the frontend understands what action it should perform
-    IRGenOpts.OutputKind = getOutputKind(Action);
-
-    return performLLVM(IRGenOpts, Instance.getASTContext(), Module.get());
-  }
-
-  ReferencedNameTracker nameTracker;
-  bool shouldTrackReferences = !opts.ReferenceDependenciesFilePath.empty();
-  if (shouldTrackReferences)
-    Instance.setReferencedNameTracker(&nameTracker);
-
-  if (Action == FrontendOptions::DumpParse ||
-      Action == FrontendOptions::DumpInterfaceHash)
-    Instance.performParseOnly();
-  else
-    Instance.performSema();
-
-  FrontendOptions::DebugCrashMode CrashMode = opts.CrashMode;
-  if (CrashMode == FrontendOptions::DebugCrashMode::AssertAfterParse)
-    debugFailWithAssertion();
-  else if (CrashMode == FrontendOptions::DebugCrashMode::CrashAfterParse)
-    debugFailWithCrash();
-
-  ASTContext &Context = Instance.getASTContext();
+/// Records the buffers which errors are reported in, so that in batch mode
+/// an error in one primary file doesn't stop the outputs of the others.
+class ErrorBufferTracker : public DiagnosticConsumer {
+  llvm::SmallDenseSet<unsigned, 4> BuffersWithErrors;
+  bool HadErrorWithoutLocation = false;
 
-  if (Action == FrontendOptions::REPL) {
-    runREPL(Instance, ProcessCmdLine(Args.begin(), Args.end()),
-            Invocation.getParseStdlib());
-    return false;
+public:
+  void handleDiagnostic(SourceManager &SM, SourceLoc Loc,
+                        DiagnosticKind Kind, StringRef Text,
+                        const DiagnosticInfo &Info) override {
+    if (Kind != DiagnosticKind::Error)
+      return;
+    if (Loc.isValid())
+      BuffersWithErrors.insert(SM.findBufferContainingLoc(Loc));
+    else
+      HadErrorWithoutLocation = true;
   }
 
-  SourceFile *PrimarySourceFile = Instance.getPrimarySourceFile();
-
-  // We've been told to dump the AST (either after parsing or type-checking,
-  // which is already differentiated in CompilerInstance::performSema()),
-  // so dump or print the main source file and return.
-  if (Action == FrontendOptions::DumpParse ||
-      Action == FrontendOptions::DumpAST ||
-      Action == FrontendOptions::PrintAST ||
-      Action == FrontendOptions::DumpTypeRefinementContexts ||
-      Action == FrontendOptions::DumpInterfaceHash) {
-    SourceFile *SF = PrimarySourceFile;
-    if (!SF) {
-      SourceFileKind Kind = Invocation.getSourceFileKind();
-      SF = &Instance.getMainModule()->getMainSourceFile(Kind);
-    }
-    if (Action == FrontendOptions::PrintAST)
-      SF->print(llvm::outs(), PrintOptions::printEverything());
-    else if (Action == FrontendOptions::DumpTypeRefinementContexts)
-      SF->getTypeRefinementContext()->dump(llvm::errs(), Context.SourceMgr);
-    else if (Action == FrontendOptions::DumpInterfaceHash)
-      SF->dumpInterfaceHash(llvm::errs());
-    else
-      SF->dump();
+  /// Returns true if an error may affect the primary file in \p BufferID:
+  /// one was reported in that file, in a file which is not one of the
+  /// \p PrimaryBufferIDs, or without a location.
+  bool hadErrorAffecting(unsigned BufferID,
+                         ArrayRef<unsigned> PrimaryBufferIDs) const {
+    if (HadErrorWithoutLocation || BuffersWithErrors.count(BufferID))
+      return true;
+    for (unsigned ErrorBufferID : BuffersWithErrors)
+      if (std::find(PrimaryBufferIDs.begin(), PrimaryBufferIDs.end(),
+                    ErrorBufferID) == PrimaryBufferIDs.end())
+        return true;
     return false;
   }
+};
 
-  // If we were asked to print Clang stats, do so.
-  if (opts.PrintClangStats && Context.getClangModuleLoader())
-    Context.getClangModuleLoader()->printStatistics();
+/// Emits the outputs for \p PrimarySourceFile, or for the whole module if it
+/// is null, once the inputs have been type-checked.
+///
+/// \p HadSemaError tells whether type-checking failed in a way which affects
+/// this primary file. In batch mode, the diagnostic engine's error state is
+/// reset before each primary file, so it only reflects this file's steps.
+/// \returns true on error
+static bool performCompileStepsPostSema(CompilerInstance &Instance,
+                                        CompilerInvocation &Invocation,
+                                        const FrontendOptions &opts,
+                                        SourceFile *PrimarySourceFile,
+                                        bool HadSemaError,
+                                        IRGenOptions &IRGenOpts,
+                                        llvm::LLVMContext &LLVMContext,
+                                        int &ReturnValue) {
+  FrontendOptions::ActionType Action = opts.RequestedAction;
+  ASTContext &Context = Instance.getASTContext();
 
   if (!opts.DependenciesFilePath.empty())
     (void)emitMakeDependencies(Context.Diags, *Instance.getDependencyTracker(),
                                opts);
 
-  if (shouldTrackReferences)
-    emitReferenceDependencies(Context.Diags, Instance.getPrimarySourceFile(),
-                              *Instance.getDependencyTracker(), opts);
-
-  if (Context.hadError())
+  if (HadSemaError || Context.hadError())
     return true;
 
+  // Don't replace the dependencies of the last successful build with those of
+  // a failed one: the driver compares the fingerprints of the next build with
+  // them to find the files which need rebuilding.
+  if (!opts.ReferenceDependenciesFilePath.empty())
+    emitReferenceDependencies(Context.Diags, PrimarySourceFile,
+                              *Instance.getDependencyTracker(), opts);
+
   // FIXME: This is still a lousy approximation of whether the module file will
   // be externally consumed.
   bool moduleIsPublic =
@@ -743,6 +813,7 @@ static bool performCompile(CompilerInstance &Instance,
 
   std::unique_ptr<SILModule> SM = Instance.takeSILModule();
   if (!SM) {
+    trace::Scope TraceSILGen("frontend", "SILGen");
     if (opts.PrimaryInput.hasValue() && opts.PrimaryInput.getValue().isFilename()) {
       FileUnit *PrimaryFile = PrimarySourceFile;
       if (!PrimaryFile) {
@@ -785,10 +856,26 @@ static bool performCompile(CompilerInstance &Instance,
     return false;
   }
 
+  // Record the remarks of the SIL passes, if asked to.
+  if (!opts.OptRecordPath.empty()) {
+    std::error_code EC;
+    std::unique_ptr<llvm::raw_fd_ostream> OS(
+        new llvm::raw_fd_ostream(opts.OptRecordPath, EC,
+                                 llvm::sys::fs::F_Text));
+    if (EC) {
+      Context.Diags.diagnose(SourceLoc(), diag::error_opening_output,
+                             opts.OptRecordPath, EC.message());
+      return true;
+    }
+    SM->getRemarkStreamer().setRecordStream(std::move(OS));
+  }
+
   // Perform "stable" optimizations that are invariant across compiler versions.
-  if (!Invocation.getDiagnosticOptions().SkipDiagnosticPasses &&
-      runSILDiagnosticPasses(*SM))
-    return true;
+  if (!Invocation.getDiagnosticOptions().SkipDiagnosticPasses) {
+    trace::Scope TraceDiagnosticPasses("frontend", "SIL diagnostic passes");
+    if (runSILDiagnosticPasses(*SM))
+      return true;
+  }
 
   // Now if we are asked to link all, link all.
   if (Invocation.getSILOptions().LinkMode == SILOptions::LinkAll)
@@ -799,6 +886,7 @@ static bool performCompile(CompilerInstance &Instance,
   // Perform SIL optimization passes if optimizations haven't been disabled.
   // These may change across compiler versions.
   if (IRGenOpts.Optimize) {
+    trace::Scope TraceOptimization("frontend", "SIL optimization");
     StringRef CustomPipelinePath =
       Invocation.getSILOptions().ExternalPassPipelineFilename;
     if (!CustomPipelinePath.empty()) {
@@ -807,6 +895,7 @@ static bool performCompile(CompilerInstance &Instance,
       runSILOptimizationPasses(*SM);
     }
   } else {
+    trace::Scope TraceOnonePasses("frontend", "SIL -Onone passes");
     runSILPassesForOnone(*SM);
   }
   SM->verify();
@@ -865,6 +954,7 @@ static bool performCompile(CompilerInstance &Instance,
       serializationOpts.SerializeOptionsForDebugging =
           !moduleIsPublic || opts.AlwaysSerializeDebuggingOptions;
 
+      trace::Scope TraceSerialize("frontend", "serialize module");
       serialize(DC, serializationOpts, SM.get());
     }
 
@@ -907,9 +997,7 @@ static bool performCompile(CompilerInstance &Instance,
     return false;
   }
 
-  // FIXME: We shouldn't need to use the global context here, but
-  // something is persisting across calls to performIRGeneration.
-  auto &LLVMContext = llvm::getGlobalContext();
+  trace::Scope TraceIRGen("frontend", "IRGen and LLVM");
   if (PrimarySourceFile) {
     performIRGeneration(IRGenOpts, *PrimarySourceFile, SM.get(),
                         opts.getSingleOutputFilename(), LLVMContext);
@@ -921,16 +1009,278 @@ static bool performCompile(CompilerInstance &Instance,
   return false;
 }
 
+/// Computes the options for emitting the outputs of each primary file of a
+/// batch, in the order of \p opts.PrimaryInputs.
+///
+/// Each primary file gets the main output at its position among the -o
+/// options. Its supplementary outputs come from the supplementary output file
+/// map if that names them, and otherwise are put next to its main output if
+/// they were requested for the whole batch.
+/// \returns true on error
+static bool computeBatchOptions(DiagnosticEngine &diags,
+                                const FrontendOptions &opts,
+                                std::vector<FrontendOptions> &batchOptions) {
+  std::unique_ptr<driver::OutputFileMap> outputFileMap;
+  if (!opts.SupplementaryOutputFileMapPath.empty()) {
+    outputFileMap =
+      driver::OutputFileMap::loadFromPath(opts.SupplementaryOutputFileMapPath);
+    if (!outputFileMap) {
+      diags.diagnose(SourceLoc(),
+                     diag::error_cannot_load_supplementary_output_file_map,
+                     opts.SupplementaryOutputFileMapPath);
+      return true;
+    }
+  }
+
+  bool IsSIB = opts.RequestedAction == FrontendOptions::EmitSIB ||
+               opts.RequestedAction == FrontendOptions::EmitSIBGen;
+
+  for (unsigned i = 0, e = opts.PrimaryInputs.size(); i != e; ++i) {
+    const SelectedInput &input = opts.PrimaryInputs[i];
+    batchOptions.push_back(opts);
+    FrontendOptions &primaryOpts = batchOptions.back();
+    primaryOpts.PrimaryInput = input;
+    primaryOpts.PrimaryInputs.assign(1, input);
+    if (opts.actionHasOutput())
+      primaryOpts.setSingleOutputFilename(opts.OutputFilenames[i]);
+
+    const driver::TypeToPathMap *outputMap = nullptr;
+    if (outputFileMap && input.isFilename())
+      outputMap = outputFileMap->getOutputMapForInput(
+        opts.InputFilenames[input.Index]);
+
+    auto routeOutput = [&](std::string &path, driver::types::ID type,
+                           StringRef extension) {
+      if (outputMap) {
+        auto iter = outputMap->find(type);
+        if (iter != outputMap->end()) {
+          path = iter->second;
+          return;
+        }
+      }
+      if (path.empty())
+        return;
+
+      llvm::SmallString<128> derived;
+      if (opts.actionHasOutput() && primaryOpts.getSingleOutputFilename() != "-")
+        derived = primaryOpts.getSingleOutputFilename();
+      else if (input.isFilename())
+        derived = llvm::sys::path::filename(opts.InputFilenames[input.Index]);
+      else
+        derived = opts.ModuleName;
+      llvm::sys::path::replace_extension(derived, extension);
+      path = derived.str();
+    };
+
+    routeOutput(primaryOpts.DependenciesFilePath, driver::types::TY_Dependencies,
+                "d");
+    routeOutput(primaryOpts.ReferenceDependenciesFilePath,
+                driver::types::TY_SwiftDeps, "swiftdeps");
+    routeOutput(primaryOpts.ModuleOutputPath, driver::types::TY_SwiftModuleFile,
+                IsSIB ? SIB_EXTENSION : SERIALIZED_MODULE_EXTENSION);
+    routeOutput(primaryOpts.ModuleDocOutputPath,
+                driver::types::TY_SwiftModuleDocFile,
+                SERIALIZED_MODULE_DOC_EXTENSION);
+    routeOutput(primaryOpts.OptRecordPath, driver::types::TY_OptRecord,
+                "opt.yaml");
+  }
+
+  return false;
+}
+
+/// Performs the compile requested by the user.
+/// \returns true on error
+static bool performCompile(CompilerInstance &Instance,
+                           CompilerInvocation &Invocation,
+                           ArrayRef<const char *> Args,
+                           int &ReturnValue) {
+  FrontendOptions opts = Invocation.getFrontendOptions();
+  FrontendOptions::ActionType Action = opts.RequestedAction;
+
+  IRGenOptions &IRGenOpts = Invocation.getIRGenOptions();
+
+  bool inputIsLLVMIr = Invocation.getInputKind() == InputFileKind::IFK_LLVM_IR;
+  if (inputIsLLVMIr) {
+    auto &LLVMContext = llvm::getGlobalContext();
+
+    // Load in bitcode file.
+    assert(Invocation.getInputFilenames().size() == 1 &&
+           "We expect a single input for bitcode input!");
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileBufOrErr =
+      llvm::MemoryBuffer::getFileOrSTDIN(Invocation.getInputFilenames()[0]);
+    if (!FileBufOrErr) {
+      Instance.getASTContext().Diags.diagnose(SourceLoc(),
+                                              diag::error_open_input_file,
+                                              Invocation.getInputFilenames()[0],
+                                              FileBufOrErr.getError().message());
+      return true;
+    }
+    llvm::MemoryBuffer *MainFile = FileBufOrErr.get().get();
+
+    llvm::SMDiagnostic Err;
+    std::unique_ptr<llvm::Module> Module = llvm::parseIR(
+                                             MainFile->getMemBufferRef(),
+                                             Err, LLVMContext);
+    if (!Module) {
+      // TODO: Translate from the diagnostic info to the SourceManager location
+      // if available.
+      Instance.getASTContext().Diags.diagnose(SourceLoc(),
+                                              diag::error_parse_input_file,
+                                              Invocation.getInputFilenames()[0],
+                                              Err.getMessage());
+      return true;
+    }
+
+    // TODO: remove once the frontend understands what action it should perform
+    IRGenOpts.OutputKind = getOutputKind(Action);
+
+    return performLLVM(IRGenOpts, Instance.getASTContext(), Module.get());
+  }
+
+  std::vector<FrontendOptions> BatchOptions;
+  if (opts.isBatchMode() &&
+      computeBatchOptions(Instance.getDiags(), opts, BatchOptions))
+    return true;
+
+  // Track the names referenced by each primary file which needs a Swift
+  // dependencies file.
+  ArrayRef<FrontendOptions> PrimaryOptions = opts;
+  if (opts.isBatchMode())
+    PrimaryOptions = BatchOptions;
+  std::vector<ReferencedNameTracker> nameTrackers(PrimaryOptions.size());
+  SmallVector<ReferencedNameTracker *, 1> usedNameTrackers;
+  for (unsigned i = 0, e = PrimaryOptions.size(); i != e; ++i) {
+    bool shouldTrackReferences =
+      !PrimaryOptions[i].ReferenceDependenciesFilePath.empty();
+    usedNameTrackers.push_back(shouldTrackReferences ? &nameTrackers[i]
+                                                     : nullptr);
+  }
+  Instance.setReferencedNameTrackers(usedNameTrackers);
+
+  // In batch mode, note where type-checking errors are, to tell which
+  // primary files they affect.
+  ErrorBufferTracker SemaErrors;
+  if (opts.isBatchMode())
+    Instance.addDiagnosticConsumer(&SemaErrors);
+
+  if (Action == FrontendOptions::DumpParse ||
+      Action == FrontendOptions::DumpInterfaceHash)
+    Instance.performParseOnly();
+  else {
+    trace::Scope TraceSema("frontend", "parse and type-check");
+    Instance.performSema();
+  }
+
+  if (opts.isBatchMode()) {
+    DiagnosticEngine &Diags = Instance.getDiags();
+    for (DiagnosticConsumer *Consumer : Diags.takeConsumers())
+      if (Consumer != &SemaErrors)
+        Diags.addConsumer(*Consumer);
+  }
+
+  FrontendOptions::DebugCrashMode CrashMode = opts.CrashMode;
+  if (CrashMode == FrontendOptions::DebugCrashMode::AssertAfterParse)
+    debugFailWithAssertion();
+  else if (CrashMode == FrontendOptions::DebugCrashMode::CrashAfterParse)
+    debugFailWithCrash();
+
+  ASTContext &Context = Instance.getASTContext();
+
+  if (Action == FrontendOptions::REPL) {
+    runREPL(Instance, ProcessCmdLine(Args.begin(), Args.end()),
+            Invocation.getParseStdlib());
+    return false;
+  }
+
+  SourceFile *PrimarySourceFile = Instance.getPrimarySourceFile();
+
+  // We've been told to dump the AST (either after parsing or type-checking,
+  // which is already differentiated in CompilerInstance::performSema()),
+  // so dump or print the main source file and return.
+  if (Action == FrontendOptions::DumpParse ||
+      Action == FrontendOptions::DumpAST ||
+      Action == FrontendOptions::PrintAST ||
+      Action == FrontendOptions::DumpTypeRefinementContexts ||
+      Action == FrontendOptions::DumpInterfaceHash) {
+    SourceFile *SF = PrimarySourceFile;
+    if (!SF) {
+      SourceFileKind Kind = Invocation.getSourceFileKind();
+      SF = &Instance.getMainModule()->getMainSourceFile(Kind);
+    }
+    if (Action == FrontendOptions::PrintAST)
+      SF->print(llvm::outs(), PrintOptions::printEverything());
+    else if (Action == FrontendOptions::DumpTypeRefinementContexts)
+      SF->getTypeRefinementContext()->dump(llvm::errs(), Context.SourceMgr);
+    else if (Action == FrontendOptions::DumpInterfaceHash)
+      SF->dumpInterfaceHash(llvm::errs());
+    else
+      SF->dump();
+    return false;
+  }
+
+  // If we were asked to print Clang stats, do so.
+  if (opts.PrintClangStats && Context.getClangModuleLoader())
+    Context.getClangModuleLoader()->printStatistics();
+
+  // FIXME: We shouldn't need to use the global context here, but
+  // something is persisting across calls to performIRGeneration.
+  if (!opts.isBatchMode())
+    return performCompileStepsPostSema(Instance, Invocation, opts,
+                                       PrimarySourceFile,
+                                       /*HadSemaError=*/false, IRGenOpts,
+                                       llvm::getGlobalContext(), ReturnValue);
+
+  // In batch mode, all primary files have been type-checked together. Emit
+  // the outputs of each one in turn, as a separate frontend job would: each
+  // gets its own SIL module from SILGen and its own LLVM context, and an
+  // error in one primary file only stops the outputs of that file.
+  assert(!Instance.hasSILModule() && "batch mode compiles only Swift files");
+  ArrayRef<SourceFile *> PrimaryFiles = Instance.getPrimarySourceFiles();
+  SmallVector<unsigned, 8> PrimaryBufferIDs;
+  for (SourceFile *SF : PrimaryFiles)
+    PrimaryBufferIDs.push_back(SF->getBufferID().getValue());
+
+  bool HadError = false;
+  for (unsigned i = 0, e = BatchOptions.size(); i != e; ++i) {
+    bool HadSemaError =
+      SemaErrors.hadErrorAffecting(PrimaryBufferIDs[i], PrimaryBufferIDs);
+    Context.Diags.resetHadAnyError();
+
+    // The context is kept as long as the AST, in case something from IRGen
+    // still refers to it; see the FIXME above.
+    auto *PrimaryLLVMContext = new llvm::LLVMContext();
+    Context.addCleanup([PrimaryLLVMContext] { delete PrimaryLLVMContext; });
+
+    IRGenOptions PrimaryIRGenOpts = IRGenOpts;
+    HadError |= performCompileStepsPostSema(Instance, Invocation,
+                                            BatchOptions[i], PrimaryFiles[i],
+                                            HadSemaError, PrimaryIRGenOpts,
+                                            *PrimaryLLVMContext, ReturnValue);
+  }
+  return HadError;
+}
+
+/// Runs a frontend job.
+///
+/// If \p WarmInstance is given, its context has already been set up by the
+/// compile server with an invocation which matches \p Args apart from the
+/// inputs and outputs, and the job reuses it rather than loading everything
+/// afresh. See compile_server_main.cpp.
 int frontend_main(ArrayRef<const char *>Args,
-                  const char *Argv0, void *MainAddr) {
+                  const char *Argv0, void *MainAddr,
+                  CompilerInstance *WarmInstance) {
   llvm::InitializeAllTargets();
   llvm::InitializeAllTargetMCs();
   llvm::InitializeAllAsmPrinters();
   llvm::InitializeAllAsmParsers();
 
-  CompilerInstance Instance;
+  std::unique_ptr<CompilerInstance> OwnedInstance;
   PrintingDiagnosticConsumer PDC;
-  Instance.addDiagnosticConsumer(&PDC);
+  if (!WarmInstance) {
+    OwnedInstance.reset(new CompilerInstance());
+    OwnedInstance->addDiagnosticConsumer(&PDC);
+  }
+  CompilerInstance &Instance = WarmInstance ? *WarmInstance : *OwnedInstance;
 
   if (Args.empty()) {
     Instance.getDiags().diagnose(SourceLoc(), diag::error_no_frontend_args);
@@ -1020,6 +1370,31 @@ int frontend_main(ArrayRef<const char *>Args,
     }
   }
 
+  // The trace is finished on any return from here on.
+  const std::string &TraceOutputPath =
+    Invocation.getFrontendOptions().TraceOutputPath;
+  if (!TraceOutputPath.empty()) {
+    std::string ProcessName = "frontend " + Invocation.getModuleName().str();
+    const FrontendOptions &opts = Invocation.getFrontendOptions();
+    if (opts.PrimaryInput.hasValue() && opts.PrimaryInput->isFilename()) {
+      ProcessName += " ";
+      ProcessName += llvm::sys::path::filename(
+        Invocation.getInputFilenames()[opts.PrimaryInput->Index]);
+      if (opts.isBatchMode())
+        ProcessName += " (batch)";
+    }
+    if (std::error_code EC =
+          trace::startRecording(TraceOutputPath, ProcessName)) {
+      Instance.getDiags().diagnose(SourceLoc(), diag::cannot_open_file,
+                                   TraceOutputPath, EC.message());
+      return 1;
+    }
+  }
+  defer([&] {
+    if (trace::isRecording())
+      trace::stopRecording();
+  });
+
   if (Invocation.getDiagnosticOptions().UseColor)
     PDC.forceColors();
 
@@ -1031,14 +1406,24 @@ int frontend_main(ArrayRef<const char *>Args,
     enableDiagnosticVerifier(Instance.getSourceMgr());
   }
 
+  // In batch mode, the supplementary output file map may ask for dependencies
+  // without any command-line option.
   DependencyTracker depTracker;
-  if (!Invocation.getFrontendOptions().DependenciesFilePath.empty() ||
-      !Invocation.getFrontendOptions().ReferenceDependenciesFilePath.empty()) {
-    Instance.setDependencyTracker(&depTracker);
-  }
+  if (WarmInstance) {
+    // The server always tracks dependencies, to notice stale modules.
+    if (Instance.setupInputs(Invocation))
+      return 1;
+  } else {
+    if (!Invocation.getFrontendOptions().DependenciesFilePath.empty() ||
+        !Invocation.getFrontendOptions().ReferenceDependenciesFilePath.empty() ||
+        Invocation.getFrontendOptions().isBatchMode()) {
+      Instance.setDependencyTracker(&depTracker);
+    }
 
-  if (Instance.setup(Invocation)) {
-    return 1;
+    trace::Scope TraceSetup("frontend", "set up compiler");
+    if (Instance.setup(Invocation)) {
+      return 1;
+    }
   }
 
   int ReturnValue = 0;
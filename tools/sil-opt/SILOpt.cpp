@@ -23,6 +23,7 @@
 #include "swift/Frontend/DiagnosticVerifier.h"
 #include "swift/Frontend/Frontend.h"
 #include "swift/Frontend/PrintingDiagnosticConsumer.h"
+#include "swift/SIL/OptimizationRemark.h"
 #include "swift/SILAnalysis/Analysis.h"
 #include "swift/SILPasses/Passes.h"
 #include "swift/SILPasses/PassManager.h"
@@ -115,6 +116,17 @@ EnableSILVerifyAll("enable-sil-verify-all",
                    llvm::cl::init(true),
                    llvm::cl::desc("Run sil verifications after every pass."));
 
+static llvm::cl::opt<bool>
+ParallelFunctionPasses("sil-parallel-function-passes", llvm::cl::Hidden,
+                       llvm::cl::init(false),
+                       llvm::cl::desc("Run function-local passes on several "
+                                      "functions at once."));
+
+static llvm::cl::opt<int>
+NumThreads("num-threads", llvm::cl::Hidden, llvm::cl::init(0),
+           llvm::cl::desc("The number of threads for "
+                          "-sil-parallel-function-passes."));
+
 static llvm::cl::opt<bool>
 RemoveRuntimeAsserts("remove-runtime-asserts",
                      llvm::cl::Hidden,
@@ -153,6 +165,20 @@ ASTVerifierProcessId("ast-verifier-process-id", llvm::cl::Hidden,
 static llvm::cl::opt<bool>
 PerformWMO("wmo", llvm::cl::desc("Enable whole-module optimizations"));
 
+static llvm::cl::opt<std::string>
+OptRemarkPassed("sil-remarks",
+                llvm::cl::desc("Print the remarks about optimizations done "
+                               "by passes whose name matches the regex"));
+
+static llvm::cl::opt<std::string>
+OptRemarkMissed("sil-remarks-missed",
+                llvm::cl::desc("Print the remarks about optimizations missed "
+                               "by passes whose name matches the regex"));
+
+static llvm::cl::opt<std::string>
+OptRecordPath("save-optimization-record-path",
+              llvm::cl::desc("Write the optimization record to the file"));
+
 static void runCommandLineSelectedPasses(SILModule *Module) {
   SILPassManager PM(Module);
 
@@ -214,10 +240,16 @@ int main(int argc, char **argv) {
   SILOptions &SILOpts = Invocation.getSILOptions();
   SILOpts.InlineThreshold = SILInlineThreshold;
   SILOpts.VerifyAll = EnableSILVerifyAll;
+  SILOpts.ParallelFunctionPasses = ParallelFunctionPasses;
+  SILOpts.NumThreads = NumThreads;
   SILOpts.RemoveRuntimeAsserts = RemoveRuntimeAsserts;
   SILOpts.AssertConfig = AssertConfId;
   if (OptimizationGroup != OptGroup::Diagnostics)
     SILOpts.Optimization = SILOptions::SILOptMode::Optimize;
+  if (!OptRemarkPassed.empty())
+    SILOpts.OptRemarkPassed = std::make_shared<llvm::Regex>(OptRemarkPassed);
+  if (!OptRemarkMissed.empty())
+    SILOpts.OptRemarkMissed = std::make_shared<llvm::Regex>(OptRemarkMissed);
 
 
   // Load the input file.
@@ -289,6 +321,18 @@ int main(int argc, char **argv) {
       SL->getAll();
   }
 
+  if (!OptRecordPath.empty()) {
+    std::error_code EC;
+    std::unique_ptr<llvm::raw_fd_ostream> OS(
+        new llvm::raw_fd_ostream(OptRecordPath, EC, llvm::sys::fs::F_Text));
+    if (EC) {
+      llvm::errs() << "while opening '" << OptRecordPath << "': "
+                   << EC.message() << '\n';
+      return 1;
+    }
+    CI.getSILModule()->getRemarkStreamer().setRecordStream(std::move(OS));
+  }
+
   // If we're in verify mode, install a custom diagnostic handling for
   // SourceMgr.
   if (VerifyMode)
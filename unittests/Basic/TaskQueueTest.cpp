@@ -0,0 +1,146 @@
+//===- TaskQueueTest.cpp - for swift/Basic/TaskQueue.h --------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Basic/TaskQueue.h"
+#include "swift/Basic/LLVM.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#if LLVM_ON_UNIX
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace swift;
+using namespace swift::sys;
+
+namespace {
+
+/// A pipe posing as the jobserver of an enclosing make, named in MAKEFLAGS
+/// for as long as it exists.
+class FakeJobserver {
+  int Fds[2];
+
+public:
+  explicit FakeJobserver(unsigned Tokens) {
+    EXPECT_EQ(0, pipe(Fds));
+    fcntl(Fds[0], F_SETFL, O_NONBLOCK);
+    for (unsigned i = 0; i != Tokens; ++i)
+      EXPECT_EQ(1, write(Fds[1], "+", 1));
+    std::string MakeFlags = " -j --jobserver-auth=" + std::to_string(Fds[0]) +
+                            "," + std::to_string(Fds[1]);
+    setenv("MAKEFLAGS", MakeFlags.c_str(), 1);
+  }
+
+  ~FakeJobserver() {
+    unsetenv("MAKEFLAGS");
+    close(Fds[0]);
+    close(Fds[1]);
+  }
+
+  /// Takes all the tokens out of the pipe and returns how many there were.
+  unsigned drain() {
+    unsigned Count = 0;
+    char Token;
+    while (read(Fds[0], &Token, 1) == 1)
+      ++Count;
+    return Count;
+  }
+};
+
+/// Creates a script which sleeps for a moment, to stand in for a frontend.
+static std::string createSleepScript() {
+  SmallString<128> Path;
+  int FD;
+  EXPECT_FALSE(llvm::sys::fs::createTemporaryFile("TaskQueue-test", "sh", FD,
+                                                  Path));
+  {
+    llvm::raw_fd_ostream Out(FD, /*shouldClose=*/true);
+    Out << "#!/bin/sh\nsleep 0.2\n";
+  }
+  EXPECT_EQ(0, chmod(Path.c_str(), 0755));
+  return Path.str().str();
+}
+
+/// Runs \p NumTasks copies of \p Args on \p TQ and returns the largest
+/// number which ran at once.
+static unsigned runTasks(TaskQueue &TQ, const std::string &ExecPath,
+                         ArrayRef<const char *> Args, unsigned NumTasks) {
+  for (unsigned i = 0; i != NumTasks; ++i)
+    TQ.addTask(ExecPath.c_str(), Args);
+
+  unsigned Running = 0, MaxRunning = 0;
+  auto Began = [&](ProcessId Pid, void *Context) {
+    MaxRunning = std::max(MaxRunning, ++Running);
+  };
+  auto Finished = [&](ProcessId Pid, int ReturnCode, StringRef Output,
+                      void *Context) {
+    EXPECT_EQ(0, ReturnCode);
+    --Running;
+    return TaskFinishedResponse::ContinueExecution;
+  };
+  EXPECT_FALSE(TQ.execute(Began, Finished));
+  return MaxRunning;
+}
+
+TEST(TaskQueue, JobserverBoundsParallelTasks) {
+  std::string Script = createSleepScript();
+  FakeJobserver JS(/*Tokens=*/1);
+
+  TaskQueue TQ(/*NumberOfParallelTasks=*/8);
+  EXPECT_EQ(2u, runTasks(TQ, Script, {}, 4));
+
+  // Every token taken must have been given back.
+  EXPECT_EQ(1u, JS.drain());
+  llvm::sys::fs::remove(Script);
+}
+
+TEST(TaskQueue, JobserverTokensForThreads) {
+  std::string Script = createSleepScript();
+  const char *Args[] = { "-frontend", "-num-threads", "2" };
+
+  {
+    FakeJobserver JS(/*Tokens=*/3);
+    TaskQueue TQ(/*NumberOfParallelTasks=*/8);
+    EXPECT_EQ(4u, runTasks(TQ, Script, Args, 4));
+    EXPECT_EQ(3u, JS.drain());
+  }
+
+  {
+    FakeJobserver JS(/*Tokens=*/3);
+    TaskQueue TQ(/*NumberOfParallelTasks=*/8);
+    TQ.setJobserverTokensForThreads();
+    EXPECT_EQ(2u, runTasks(TQ, Script, Args, 4));
+    EXPECT_EQ(3u, JS.drain());
+  }
+
+  llvm::sys::fs::remove(Script);
+}
+
+TEST(TaskQueue, JobserverNotInherited) {
+  std::string Script = createSleepScript();
+  // make names the pipe even to recipes which don't get it.
+  setenv("MAKEFLAGS", " -j --jobserver-auth=1000,1001", 1);
+
+  TaskQueue TQ(/*NumberOfParallelTasks=*/4);
+  EXPECT_EQ(4u, runTasks(TQ, Script, {}, 4));
+
+  unsetenv("MAKEFLAGS");
+  llvm::sys::fs::remove(Script);
+}
+
+} // end anonymous namespace
+#endif // LLVM_ON_UNIX
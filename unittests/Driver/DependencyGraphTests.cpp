@@ -1,5 +1,11 @@
 #include "swift/Driver/DependencyGraph.h"
+#include "swift/Driver/DependencyFile.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <chrono>
 
 using namespace swift;
 using LoadResult = DependencyGraphImpl::LoadResult;
@@ -790,3 +796,349 @@ TEST(DependencyGraph, ChainedExternalPreMarked) {
   EXPECT_TRUE(graph.isMarked(0));
   EXPECT_FALSE(graph.isMarked(1));
 }
+
+TEST(DependencyGraph, Fingerprints) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a, b]\n"
+                                 "fingerprints: [[a, \"1\"], [b, \"2\"]]\n"
+                                 "interface-hash: \"before\""),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+  EXPECT_TRUE(graph.hasFingerprints(0));
+  EXPECT_FALSE(graph.hasFingerprints(1));
+
+  // Only the fingerprint of 'a' changed.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a, b]\n"
+                                 "fingerprints: [[a, \"3\"], [b, \"2\"]]\n"
+                                 "interface-hash: \"after\""),
+            LoadResult::AffectsDownstream);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_EQ(1u, marked.front());
+  EXPECT_TRUE(graph.isMarked(1));
+  EXPECT_FALSE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsMissing) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a, b]\n"
+                                 "fingerprints: [[a, \"1\"]]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+  EXPECT_FALSE(graph.hasFingerprints(0));
+
+  // A name without a fingerprint is always considered changed.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a, b]\n"
+                                 "fingerprints: [[a, \"1\"]]"),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsRemovedName) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a, b]\n"
+                                 "fingerprints: [[a, \"1\"], [b, \"2\"]]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  // Dependents of a name which has gone away have to be rebuilt.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a]\n"
+                                 "fingerprints: [[a, \"1\"]]"),
+            LoadResult::UpToDate);
+  EXPECT_TRUE(graph.hasFingerprints(0));
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+TEST(DependencyGraph, FingerprintsOnlyAffectStartingNode) {
+  DependencyGraph<uintptr_t> graph;
+
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a]\n"
+                                 "fingerprints: [[a, \"1\"]]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1,
+                                 "depends-top-level: [a]\n"
+                                 "provides-top-level: [b]\n"
+                                 "fingerprints: [[b, \"1\"]]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(1,
+                                 "depends-top-level: [a]\n"
+                                 "provides-top-level: [b]\n"
+                                 "fingerprints: [[b, \"1\"]]"),
+            LoadResult::UpToDate);
+
+  // 1 hasn't been rebuilt yet, so whatever it provides may still change.
+  EXPECT_EQ(graph.loadFromString(0,
+                                 "provides-top-level: [a]\n"
+                                 "fingerprints: [[a, \"2\"]]"),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(2u, marked.size());
+  EXPECT_TRUE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+}
+
+static std::string writeBinary(const DependencyFileWriter &writer) {
+  std::string result;
+  llvm::raw_string_ostream out(result);
+  writer.writeBinary(out);
+  return out.str();
+}
+
+static std::string writeYAML(const DependencyFileWriter &writer) {
+  std::string result;
+  llvm::raw_string_ostream out(result);
+  writer.writeYAML(out);
+  return out.str();
+}
+
+TEST(DependencyGraph, BinaryFormat) {
+  DependencyGraph<uintptr_t> graph;
+
+  DependencyFileWriter provider;
+  provider.addEntry(DependencySection::ProvidesTopLevel, "a");
+  provider.addEntry(DependencySection::ProvidesNominal, "b");
+  provider.addMemberEntry(DependencySection::ProvidesMember, "b", "c");
+  provider.setInterfaceHash("1");
+  EXPECT_EQ(graph.loadFromString(0, writeBinary(provider)),
+            LoadResult::UpToDate);
+
+  DependencyFileWriter cascading;
+  cascading.addMemberEntry(DependencySection::DependsMember, "b", "c");
+  cascading.addEntry(DependencySection::ProvidesTopLevel, "d");
+  EXPECT_EQ(graph.loadFromString(1, writeBinary(cascading)),
+            LoadResult::UpToDate);
+
+  DependencyFileWriter nonCascading;
+  nonCascading.addEntry(DependencySection::DependsTopLevel, "d",
+                        /*isCascading=*/false);
+  EXPECT_EQ(graph.loadFromString(2, writeBinary(nonCascading)),
+            LoadResult::UpToDate);
+
+  DependencyFileWriter unrelated;
+  unrelated.addEntry(DependencySection::DependsTopLevel, "e");
+  EXPECT_EQ(graph.loadFromString(3, writeBinary(unrelated)),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(2u, marked.size());
+  EXPECT_TRUE(graph.isMarked(0));
+  EXPECT_TRUE(graph.isMarked(1));
+  EXPECT_FALSE(graph.isMarked(2));
+  EXPECT_FALSE(graph.isMarked(3));
+
+  // A changed interface hash affects downstream nodes.
+  provider.setInterfaceHash("2");
+  EXPECT_EQ(graph.loadFromString(0, writeBinary(provider)),
+            LoadResult::AffectsDownstream);
+}
+
+TEST(DependencyGraph, BinaryFormatMatchesYAML) {
+  DependencyFileWriter writer;
+  writer.addEntry(DependencySection::ProvidesTopLevel, "a");
+  writer.addEntry(DependencySection::ProvidesTopLevel, "a");
+  writer.addEntry(DependencySection::DependsTopLevel, "b", false);
+  writer.addEntry(DependencySection::DependsTopLevel, "c");
+  writer.addMemberEntry(DependencySection::DependsMember, "d", "", false);
+  writer.addEntry(DependencySection::DependsExternal, "/foo bar");
+
+  DependencyGraph<uintptr_t> yamlGraph;
+  EXPECT_EQ(yamlGraph.loadFromString(0, writeYAML(writer)),
+            LoadResult::UpToDate);
+  EXPECT_EQ(yamlGraph.loadFromString(1, "provides-top-level: [b, c]"),
+            LoadResult::UpToDate);
+
+  DependencyGraph<uintptr_t> binaryGraph;
+  EXPECT_EQ(binaryGraph.loadFromString(0, writeBinary(writer)),
+            LoadResult::UpToDate);
+  EXPECT_EQ(binaryGraph.loadFromString(1, "provides-top-level: [b, c]"),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> yamlMarked, binaryMarked;
+  yamlGraph.markTransitive(yamlMarked, 1);
+  binaryGraph.markTransitive(binaryMarked, 1);
+  EXPECT_EQ(yamlMarked, binaryMarked);
+
+  std::vector<std::string> yamlExternal, binaryExternal;
+  for (StringRef dep : yamlGraph.getExternalDependencies())
+    yamlExternal.push_back(dep.str());
+  for (StringRef dep : binaryGraph.getExternalDependencies())
+    binaryExternal.push_back(dep.str());
+  EXPECT_EQ(yamlExternal, binaryExternal);
+  EXPECT_EQ(1u, binaryExternal.size());
+}
+
+TEST(DependencyGraph, BinaryFormatTruncated) {
+  DependencyFileWriter writer;
+  writer.addEntry(DependencySection::ProvidesTopLevel, "a");
+  writer.addEntry(DependencySection::DependsTopLevel, "b");
+  writer.setInterfaceHash("abc");
+  std::string data = writeBinary(writer);
+
+  for (size_t size = sizeof(binary_swiftdeps::Signature); size < data.size();
+       ++size) {
+    DependencyGraph<uintptr_t> graph;
+    EXPECT_EQ(graph.loadFromString(0, StringRef(data.data(), size)),
+              LoadResult::HadError);
+  }
+}
+
+TEST(DependencyGraph, BinaryFormatFingerprints) {
+  DependencyGraph<uintptr_t> graph;
+
+  DependencyFileWriter provider;
+  provider.addEntry(DependencySection::ProvidesTopLevel, "a");
+  provider.addEntry(DependencySection::ProvidesTopLevel, "b");
+  provider.addFingerprint("a", "1");
+  provider.addFingerprint("b", "2");
+  EXPECT_EQ(graph.loadFromString(0, writeBinary(provider)),
+            LoadResult::UpToDate);
+  EXPECT_TRUE(graph.hasFingerprints(0));
+  EXPECT_EQ(graph.loadFromString(1, "depends-top-level: [a]"),
+            LoadResult::UpToDate);
+  EXPECT_EQ(graph.loadFromString(2, "depends-top-level: [b]"),
+            LoadResult::UpToDate);
+
+  // Another declaration named 'b' changes its combined fingerprint.
+  DependencyFileWriter changed;
+  changed.addEntry(DependencySection::ProvidesTopLevel, "a");
+  changed.addEntry(DependencySection::ProvidesTopLevel, "b");
+  changed.addFingerprint("a", "1");
+  changed.addFingerprint("b", "2");
+  changed.addFingerprint("b", "3");
+  EXPECT_EQ(graph.loadFromString(0, writeBinary(changed)),
+            LoadResult::UpToDate);
+
+  SmallVector<uintptr_t, 4> marked;
+  graph.markTransitive(marked, 0);
+  EXPECT_EQ(1u, marked.size());
+  EXPECT_FALSE(graph.isMarked(1));
+  EXPECT_TRUE(graph.isMarked(2));
+
+  // A declaration without a fingerprint leaves its name without one.
+  DependencyFileWriter partial;
+  partial.addEntry(DependencySection::ProvidesTopLevel, "a");
+  partial.addFingerprint("a", "1");
+  partial.addFingerprint("a", "");
+  EXPECT_EQ(graph.loadFromString(3, writeBinary(partial)),
+            LoadResult::UpToDate);
+  EXPECT_FALSE(graph.hasFingerprints(3));
+}
+
+// Run with --gtest_also_run_disabled_tests to compare how long the driver
+// takes to load the dependencies files of a large module in each format.
+TEST(DependencyGraph, DISABLED_LoadManyFilesBenchmark) {
+  const unsigned NumFiles = 5000;
+
+  SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("swiftdeps-bench", dir));
+
+  auto makeWriter = [](unsigned file) {
+    DependencyFileWriter writer;
+    for (unsigned i = 0; i != NumDependencySections; ++i)
+      writer.addSection(DependencySection(i));
+    for (unsigned i = 0; i != 20; ++i)
+      writer.addEntry(DependencySection::ProvidesTopLevel,
+                      "topLevel" + std::to_string(file) + "_" +
+                      std::to_string(i));
+    for (unsigned i = 0; i != 5; ++i) {
+      std::string type = "V4main4Type" + std::to_string(file) + "_" +
+                         std::to_string(i);
+      writer.addEntry(DependencySection::ProvidesNominal, type);
+      writer.addMemberEntry(DependencySection::ProvidesMember, type, "");
+      writer.addMemberEntry(DependencySection::ProvidesMember, type, "member");
+    }
+    for (unsigned i = 0; i != 50; ++i) {
+      unsigned other = (file * 31 + i * 97) % NumFiles;
+      writer.addEntry(DependencySection::DependsTopLevel,
+                      "topLevel" + std::to_string(other) + "_" +
+                      std::to_string(i % 20), i % 3 != 0);
+      writer.addMemberEntry(DependencySection::DependsMember,
+                            "V4main4Type" + std::to_string(other) + "_" +
+                            std::to_string(i % 5), "member", i % 3 != 0);
+    }
+    for (unsigned i = 0; i != 10; ++i)
+      writer.addEntry(DependencySection::DependsExternal,
+                      "/SDK/Frameworks/Module" + std::to_string(i) +
+                      ".swiftmodule");
+    writer.setInterfaceHash(std::to_string(file * 2654435761U));
+    return writer;
+  };
+
+  std::vector<std::string> yamlPaths, binaryPaths;
+  for (unsigned file = 0; file != NumFiles; ++file) {
+    DependencyFileWriter writer = makeWriter(file);
+    for (bool binary : { false, true }) {
+      SmallString<128> path(dir);
+      llvm::sys::path::append(path, "file" + std::to_string(file) +
+                                    (binary ? ".bin" : ".yaml") +
+                                    ".swiftdeps");
+      std::error_code EC;
+      llvm::raw_fd_ostream out(path, EC, llvm::sys::fs::F_None);
+      ASSERT_FALSE(EC);
+      if (binary) {
+        writer.writeBinary(out);
+        binaryPaths.push_back(path.str().str());
+      } else {
+        writer.writeYAML(out);
+        yamlPaths.push_back(path.str().str());
+      }
+    }
+  }
+
+  auto timeLoad = [](const std::vector<std::string> &paths) -> double {
+    auto start = std::chrono::steady_clock::now();
+    DependencyGraph<uintptr_t> graph;
+    for (uintptr_t i = 0, e = paths.size(); i != e; ++i)
+      EXPECT_EQ(LoadResult::UpToDate, graph.loadFromPath(i, paths[i]));
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+
+  double yamlTime = timeLoad(yamlPaths);
+  double binaryTime = timeLoad(binaryPaths);
+  llvm::outs() << "Loaded " << NumFiles << " dependencies files: YAML "
+               << yamlTime << "s, binary " << binaryTime << "s\n";
+
+  for (auto &path : yamlPaths)
+    llvm::sys::fs::remove(path);
+  for (auto &path : binaryPaths)
+    llvm::sys::fs::remove(path);
+  llvm::sys::fs::remove(dir);
+}
@@ -13,6 +13,9 @@
 #include "swift/Runtime/Metadata.h"
 #include "swift/Runtime/Enum.h"
 #include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <vector>
 
 using namespace swift;
 
@@ -153,3 +156,148 @@ TEST(EnumTest, storeEnumTagSinglePayload) {
   ASSERT_TRUE(test_storeEnumTagSinglePayload({1, 1}, {219, 123},
                                               XI_TMBi8_, 3, 4));
 }
+
+/// Mock up the metadata for a multi-payload enum, with the payload size
+/// stored right after the EnumMetadata fields.
+struct MultiPayloadEnum {
+  NominalTypeDescriptor Description;
+  ValueWitnessTable ValueWitnesses;
+  FullMetadata<EnumMetadata> Metadata;
+  size_t PayloadSize;
+
+  MultiPayloadEnum(const std::vector<const TypeLayout *> &payloads,
+                   unsigned numEmptyCases)
+    : Description(), ValueWitnesses(), Metadata() {
+    Metadata.ValueWitnesses = &ValueWitnesses;
+    Metadata.setKind(MetadataKind::Enum);
+    Metadata.Description = &Description;
+
+    size_t payloadSizeOffset = reinterpret_cast<size_t *>(&PayloadSize)
+      - reinterpret_cast<size_t *>(get());
+    Description.Kind = NominalTypeKind::Enum;
+    Description.Enum.NumPayloadCasesAndPayloadSizeOffset
+      = payloads.size() | (payloadSizeOffset << 24);
+    Description.Enum.NumEmptyCases = numEmptyCases;
+
+    swift_initEnumMetadataMultiPayload(&ValueWitnesses, get(),
+                                       payloads.size(), payloads.data());
+  }
+
+  EnumMetadata *get() { return &Metadata; }
+  unsigned getNumCases() { return Description.Enum.getNumCases(); }
+};
+
+bool test_multiPayloadRoundTrip(MultiPayloadEnum &e, unsigned whichCase) {
+  std::vector<uint8_t> buf(e.ValueWitnesses.size, 0xAB);
+  swift_storeEnumTagMultiPayload(asOpaque(buf.data()), e.get(), whichCase);
+  return swift_getEnumCaseMultiPayload(asOpaque(buf.data()), e.get())
+    == whichCase;
+}
+
+TEST(EnumTest, multiPayloadOneByteTag) {
+  // Two Int8 payloads, with enough empty cases that they need more than one
+  // tag value.
+  MultiPayloadEnum e({_TWVBi8_.getTypeLayout(), _TWVBi8_.getTypeLayout()},
+                     600);
+  ASSERT_EQ(1u, e.get()->getPayloadSize());
+  ASSERT_EQ(2u, e.ValueWitnesses.size);
+
+  for (unsigned whichCase = 0; whichCase < e.getNumCases(); ++whichCase)
+    ASSERT_TRUE(test_multiPayloadRoundTrip(e, whichCase));
+
+  // Only the low payload bits of an empty case go into the payload area.
+  uint8_t buf[2] = {0, 0};
+  swift_storeEnumTagMultiPayload(asOpaque(buf), e.get(), 2 + 300);
+  ASSERT_EQ(300u - 256u, buf[0]);
+  ASSERT_EQ(3u, buf[1]);
+}
+
+TEST(EnumTest, multiPayloadTwoByteTag) {
+  // 300 payload cases need a two-byte tag.
+  MultiPayloadEnum e(std::vector<const TypeLayout *>(
+                       300, _TWVBi32_.getTypeLayout()), 5);
+  ASSERT_EQ(4u, e.get()->getPayloadSize());
+  ASSERT_EQ(6u, e.ValueWitnesses.size);
+
+  for (unsigned whichCase = 0; whichCase < e.getNumCases(); ++whichCase)
+    ASSERT_TRUE(test_multiPayloadRoundTrip(e, whichCase));
+}
+
+TEST(EnumTest, multiPayloadFourByteTag) {
+  // 70000 payload cases need a four-byte tag.
+  MultiPayloadEnum e(std::vector<const TypeLayout *>(
+                       70000, _TWVBi16_.getTypeLayout()), 1);
+  ASSERT_EQ(2u, e.get()->getPayloadSize());
+  ASSERT_EQ(6u, e.ValueWitnesses.size);
+
+  for (unsigned whichCase : {0u, 1u, 255u, 256u, 65535u, 65536u, 69999u,
+                             70000u})
+    ASSERT_TRUE(test_multiPayloadRoundTrip(e, whichCase));
+}
+
+/// Time \p body over \p numIterations and return the average in nanoseconds.
+template <typename Fn>
+static double runEnumBenchmark(unsigned numIterations, Fn body) {
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < numIterations; ++i)
+    body(i);
+  auto elapsed = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count();
+  return elapsed / numIterations;
+}
+
+// Run with --gtest_also_run_disabled_tests to time switching over enums. The
+// nanoseconds per switch are recorded as the tests' switch_ns property.
+TEST(EnumTest, DISABLED_resultSwitch_benchmark) {
+  // enum Result<T, E> { case Success(T), Failure(E) } with T and E both
+  // 64-bit integers.
+  MultiPayloadEnum result({_TWVBi64_.getTypeLayout(),
+                           _TWVBi64_.getTypeLayout()}, 0);
+  const unsigned numValues = 1024;
+  std::vector<uint8_t> values(numValues * result.ValueWitnesses.stride);
+  for (unsigned i = 0; i < numValues; ++i)
+    swift_storeEnumTagMultiPayload(
+      asOpaque(&values[i * result.ValueWitnesses.stride]), result.get(),
+      i % 3 == 0);
+
+  unsigned numFailures = 0;
+  double time = runEnumBenchmark(10000000, [&](unsigned i) {
+    auto value = &values[(i % numValues) * result.ValueWitnesses.stride];
+    numFailures += swift_getEnumCaseMultiPayload(asOpaque(value),
+                                                 result.get());
+  });
+  ASSERT_NE(0u, numFailures);
+  RecordProperty("switch_ns", std::to_string(time));
+}
+
+TEST(EnumTest, DISABLED_optionalOfEnumSwitch_benchmark) {
+  // Optional<E>, where E is an enum with two Int32 payload cases and
+  // an empty case. E has no extra inhabitants, so the optional needs an extra
+  // tag byte of its own.
+  MultiPayloadEnum payload({_TWVBi32_.getTypeLayout(),
+                            _TWVBi32_.getTypeLayout()}, 1);
+  size_t stride = payload.ValueWitnesses.stride + 1;
+  const unsigned numValues = 1024;
+  std::vector<uint8_t> values(numValues * stride);
+  for (unsigned i = 0; i < numValues; ++i) {
+    auto value = asOpaque(&values[i * stride]);
+    if (i % 4 == 0) {
+      swift_storeEnumTagSinglePayload(value, payload.get(), 0, 1);
+    } else {
+      swift_storeEnumTagMultiPayload(value, payload.get(), i % 3);
+      swift_storeEnumTagSinglePayload(value, payload.get(), -1, 1);
+    }
+  }
+
+  unsigned numCases[4] = {0, 0, 0, 0};
+  double time = runEnumBenchmark(10000000, [&](unsigned i) {
+    auto value = asOpaque(&values[(i % numValues) * stride]);
+    if (swift_getEnumCaseSinglePayload(value, payload.get(), 1) == 0)
+      ++numCases[3];
+    else
+      ++numCases[swift_getEnumCaseMultiPayload(value, payload.get())];
+  });
+  ASSERT_NE(0u, numCases[3]);
+  ASSERT_NE(0u, numCases[2]);
+  RecordProperty("switch_ns", std::to_string(time));
+}
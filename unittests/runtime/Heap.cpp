@@ -0,0 +1,105 @@
+//===--- swift/unittests/runtime/Heap.cpp - Heap allocation tests ---------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace swift;
+
+TEST(HeapTest, slowAlloc_sizesAndAlignments) {
+  std::vector<std::pair<void *, size_t>> allocations;
+  for (size_t size = 1; size <= 1024; size += 7) {
+    for (size_t alignMask : { 0, 7, 15, 31 }) {
+      auto p = static_cast<char *>(swift_slowAlloc(size, alignMask));
+      ASSERT_NE(p, nullptr);
+      EXPECT_EQ(uintptr_t(p) & std::min<size_t>(alignMask, 15), 0u);
+      memset(p, 0xA5, size);
+      allocations.push_back({p, size});
+    }
+  }
+
+  // Each allocation must still hold its own contents.
+  for (auto &allocation : allocations) {
+    auto p = static_cast<unsigned char *>(allocation.first);
+    for (size_t i = 0; i < allocation.second; ++i)
+      ASSERT_EQ(0xA5, p[i]);
+  }
+
+  for (auto &allocation : allocations)
+    swift_slowDealloc(allocation.first, allocation.second, 0);
+}
+
+TEST(HeapTest, slowDealloc_onAnotherThread) {
+  const size_t numAllocations = 10000;
+  std::vector<void *> allocations(numAllocations);
+  std::thread producer([&] {
+    for (size_t i = 0; i < numAllocations; ++i)
+      allocations[i] = swift_slowAlloc(16 + (i % 32) * 16, 7);
+  });
+  producer.join();
+
+  std::thread consumer([&] {
+    for (size_t i = 0; i < numAllocations; ++i)
+      swift_slowDealloc(allocations[i], 16 + (i % 32) * 16, 7);
+  });
+  consumer.join();
+
+  // Memory freed by the consumer must be reusable here.
+  for (size_t i = 0; i < numAllocations; ++i)
+    allocations[i] = swift_slowAlloc(48, 7);
+  for (size_t i = 0; i < numAllocations; ++i)
+    swift_slowDealloc(allocations[i], 48, 7);
+}
+
+/// Allocate and free numBatches batches of batchSize blocks of the given
+/// size, and return the average nanoseconds per allocation and deallocation.
+template <class Alloc, class Dealloc>
+static double measureAllocDealloc(size_t size, Alloc alloc, Dealloc dealloc) {
+  const size_t batchSize = 1000;
+  const size_t numBatches = 2000;
+  std::vector<void *> blocks(batchSize);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t batch = 0; batch < numBatches; ++batch) {
+    for (size_t i = 0; i < batchSize; ++i)
+      blocks[i] = alloc(size);
+    for (size_t i = 0; i < batchSize; ++i)
+      dealloc(blocks[i], size);
+  }
+  auto elapsed = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count();
+  return elapsed / (batchSize * numBatches);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare swift_slowAlloc with
+// malloc. The nanoseconds per allocation and deallocation are recorded as
+// test properties.
+TEST(HeapTest, DISABLED_slowAlloc_benchmark) {
+  for (size_t size : { 16, 48, 128, 512 }) {
+    double swiftTime = measureAllocDealloc(size,
+      [](size_t size) { return swift_slowAlloc(size, 7); },
+      [](void *p, size_t size) { swift_slowDealloc(p, size, 7); });
+    double mallocTime = measureAllocDealloc(size,
+      [](size_t size) { return malloc(size); },
+      [](void *p, size_t size) { free(p); });
+    RecordProperty("swift_slowAlloc_ns_" + std::to_string(size),
+                   std::to_string(swiftTime));
+    RecordProperty("malloc_ns_" + std::to_string(size),
+                   std::to_string(mallocTime));
+  }
+}
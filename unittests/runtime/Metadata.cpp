@@ -11,8 +11,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Concurrent.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
 #include <iterator>
 #include <functional>
 #include <sys/mman.h>
@@ -232,6 +235,16 @@ TEST(MetadataAllocator, alloc_firstAllocationMoreThanPageSized) {
   munmap(page, pagesize);
 }
 
+TEST(MetadataAllocator, alloc_oddSizesStayPointerAligned) {
+  using swift::MetadataAllocator;
+  MetadataAllocator allocator;
+
+  for (size_t size : {1, 3, 7, 13, 1, 9}) {
+    void *mem = allocator.alloc(size);
+    EXPECT_EQ(uintptr_t(mem) & (alignof(void*) - 1), uintptr_t(0));
+  }
+}
+
 TEST(MetadataTest, getGenericMetadata) {
   auto metadataTemplate = (GenericMetadata*) &MetadataTest1;
 
@@ -265,6 +278,92 @@ TEST(MetadataTest, getGenericMetadata) {
     });
 }
 
+/// A separate pattern for the stress test, so that its cache starts empty.
+GenericMetadataTest<3> MetadataStressTest = {
+  // Header
+  {
+    // allocation function
+    [](GenericMetadata *pattern, const void *args) {
+      auto metadata = swift_allocateGenericValueMetadata(pattern, args);
+      auto metadataWords = reinterpret_cast<const void**>(metadata);
+      auto argsWords = reinterpret_cast<const void* const*>(args);
+      metadataWords[2] = argsWords[0];
+      return metadata;
+    },
+    3 * sizeof(void*), // metadata size
+    1, // num arguments
+    0, // address point
+    {} // private data
+  },
+
+  // Fields
+  {
+    (void*) MetadataKind::Struct,
+    &Global1,
+    nullptr
+  }
+};
+
+/// Distinct key arguments for the stress test.
+static char StressTestKeys[1024];
+
+/// Looks up the metadata of every stress test key, \p numRounds times over
+/// on each of \p numThreads threads, and checks what comes back.
+///
+/// Every thread starts at a different key, so the first round is mostly
+/// concurrent misses on different keys and the rest are all hits.
+template <unsigned numThreads>
+static void lookUpStressTestKeys(unsigned numRounds) {
+  auto metadataTemplate = (GenericMetadata*) &MetadataStressTest;
+  const unsigned numKeys = sizeof(StressTestKeys);
+
+  std::atomic<unsigned> threadIndex(0);
+  RaceTest<void *, numThreads>(
+    [&]() -> void * {
+      unsigned offset = threadIndex++ * (numKeys / numThreads);
+      for (unsigned round = 0; round < numRounds; ++round) {
+        for (unsigned i = 0; i < numKeys; ++i) {
+          void *args[] = { &StressTestKeys[(i + offset) % numKeys] };
+          auto inst = swift_getGenericMetadata(metadataTemplate, args);
+          auto fields = reinterpret_cast<void * const *>(inst);
+          if (fields[2] != args[0]) {
+            ADD_FAILURE() << "wrong metadata for key " << args[0];
+            return nullptr;
+          }
+        }
+      }
+      return nullptr;
+    });
+}
+
+TEST(MetadataTest, getGenericMetadata_stress) {
+  auto metadataTemplate = (GenericMetadata*) &MetadataStressTest;
+  lookUpStressTestKeys<16>(2);
+
+  // Each key must have been instantiated exactly once.
+  for (unsigned i = 0; i < sizeof(StressTestKeys); ++i) {
+    void *args[] = { &StressTestKeys[i] };
+    auto inst1 = swift_getGenericMetadata(metadataTemplate, args);
+    auto inst2 = swift_getGenericMetadata(metadataTemplate, args);
+    EXPECT_EQ(inst1, inst2);
+  }
+}
+
+// Run with --gtest_also_run_disabled_tests to time concurrent lookups, which
+// mostly hit. The rate is recorded as the test's lookups_per_sec property.
+TEST(MetadataTest, DISABLED_getGenericMetadata_benchmark) {
+  const unsigned numRounds = 200;
+  const unsigned numThreads = 16;
+
+  auto start = std::chrono::steady_clock::now();
+  lookUpStressTestKeys<numThreads>(numRounds);
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  double lookups = double(sizeof(StressTestKeys)) * numRounds * numThreads;
+  RecordProperty("lookups_per_sec", int(lookups / elapsed));
+}
+
 FullMetadata<ClassMetadata> MetadataTest2 = {
   { { nullptr }, { &_TWVBo } },
   { { { MetadataKind::Class } }, nullptr, 0, ClassFlags(), nullptr, nullptr, 0, 0, 0, 0, 0 }
@@ -601,6 +700,363 @@ TEST(MetadataTest, getGenericMetadata_SuperclassWithUnexpectedPrefix) {
     });
 }
 
+/// A separate pattern for the prespecialization test, so that its cache
+/// starts empty.
+GenericMetadataTest<3> PrespecializedTest = {
+  // Header
+  {
+    // allocation function
+    [](GenericMetadata *pattern, const void *args) {
+      auto metadata = swift_allocateGenericValueMetadata(pattern, args);
+      auto metadataWords = reinterpret_cast<const void**>(metadata);
+      auto argsWords = reinterpret_cast<const void* const*>(args);
+      metadataWords[2] = argsWords[0];
+      return metadata;
+    },
+    3 * sizeof(void*), // metadata size
+    1, // num arguments
+    0, // address point
+    {} // private data
+  },
+
+  // Fields
+  {
+    (void*) MetadataKind::Struct,
+    &Global1,
+    nullptr
+  }
+};
+
+/// A cache entry for PrespecializedTest, laid out the way the compiler
+/// emits prespecialized metadata.
+struct PrespecializedTestEntry {
+  const void *Arguments[1];
+  const void *Next;
+  const Metadata *Value;
+  size_t NumArguments;
+  void *Fields[3];
+
+  Metadata *getMetadata() {
+    return reinterpret_cast<Metadata *>(Fields);
+  }
+};
+
+PrespecializedTestEntry PrespecializedTestEntry1 = {
+  { &Global2 }, nullptr,
+  reinterpret_cast<const Metadata *>(PrespecializedTestEntry1.Fields), 1,
+  { (void*) MetadataKind::Struct, &Global1, &Global2 }
+};
+
+PrespecializedTestEntry PrespecializedTestEntry2 = {
+  { &Global3 }, nullptr,
+  reinterpret_cast<const Metadata *>(PrespecializedTestEntry2.Fields), 1,
+  { (void*) MetadataKind::Struct, &Global1, &Global3 }
+};
+
+PrespecializedTestEntry PrespecializedTestEntry3 = {
+  { &Global1 }, nullptr,
+  reinterpret_cast<const Metadata *>(PrespecializedTestEntry3.Fields), 1,
+  { (void*) MetadataKind::Struct, &Global1, &Global1 }
+};
+
+TEST(MetadataTest, registerPrespecializedMetadata) {
+  auto pattern = (GenericMetadata*) &PrespecializedTest;
+  auto prebuilt = PrespecializedTestEntry1.getMetadata();
+
+  PrespecializedMetadataRecord records[] = { { pattern, prebuilt } };
+  swift_registerPrespecializedMetadata(std::begin(records), std::end(records));
+
+  // The prebuilt metadata is used in place.
+  void *args[] = { &Global2 };
+  RaceTest_ExpectEqual<const Metadata *>(
+    [&]() -> const Metadata * {
+      auto inst = swift_getGenericMetadata(pattern, args);
+      EXPECT_EQ(prebuilt, inst);
+      return inst;
+    });
+
+  // Other arguments are still instantiated at runtime.
+  args[0] = &Global3;
+  auto inst = swift_getGenericMetadata(pattern, args);
+  EXPECT_NE(PrespecializedTestEntry2.getMetadata(), inst);
+  auto fields = reinterpret_cast<void * const *>(inst);
+  EXPECT_EQ(&Global3, fields[2]);
+
+  // Metadata which already exists is not replaced.
+  PrespecializedMetadataRecord lateRecords[] = {
+    { pattern, PrespecializedTestEntry2.getMetadata() }
+  };
+  swift_registerPrespecializedMetadata(std::begin(lateRecords),
+                                       std::end(lateRecords));
+  EXPECT_EQ(inst, swift_getGenericMetadata(pattern, args));
+
+  // Records registered after the pattern is in use, as by an image loaded
+  // later, are used for the arguments it has no metadata for yet.
+  PrespecializedMetadataRecord laterImageRecords[] = {
+    { pattern, PrespecializedTestEntry3.getMetadata() }
+  };
+  swift_registerPrespecializedMetadata(std::begin(laterImageRecords),
+                                       std::end(laterImageRecords));
+  args[0] = &Global1;
+  EXPECT_EQ(PrespecializedTestEntry3.getMetadata(),
+            swift_getGenericMetadata(pattern, args));
+}
+
+/// The layout of a ProtocolConformanceRecord, which can't be constructed
+/// directly because it is made of relative pointers.
+struct RawConformanceRecord {
+  int32_t Protocol;
+  int32_t DirectType;
+  int32_t WitnessTable;
+  uint32_t Flags;
+};
+
+static int32_t getRelativeOffset(const void *field, const void *target) {
+  return int32_t((intptr_t)target - (intptr_t)field);
+}
+
+enum : unsigned {
+  NumConformanceTestTypes = 64,
+  NumConformanceTestProtocols = 8,
+};
+
+/// Opaque type metadata: a value witness table pointer and a kind.
+static const void *ConformanceTestTypes[NumConformanceTestTypes][2];
+static char ConformanceTestWitnesses[NumConformanceTestTypes]
+                                    [NumConformanceTestProtocols];
+alignas(ProtocolDescriptor) static char
+  ConformanceTestProtocols[NumConformanceTestProtocols]
+                          [sizeof(ProtocolDescriptor)];
+static RawConformanceRecord
+  ConformanceTestRecords[NumConformanceTestTypes *
+                         NumConformanceTestProtocols];
+
+static const Metadata *getConformanceTestType(unsigned i) {
+  return reinterpret_cast<const Metadata *>(&ConformanceTestTypes[i][1]);
+}
+
+static const ProtocolDescriptor *getConformanceTestProtocol(unsigned j) {
+  return reinterpret_cast<const ProtocolDescriptor *>(
+    ConformanceTestProtocols[j]);
+}
+
+/// Type i conforms to protocol j if i + j is even.
+static bool conformanceTestTypeConforms(unsigned i, unsigned j) {
+  return (i + j) % 2 == 0;
+}
+
+/// Registers the conformance records of the stress test, once.
+static void registerConformanceTestRecords() {
+  static bool registered = false;
+  if (registered)
+    return;
+  registered = true;
+
+  for (unsigned j = 0; j < NumConformanceTestProtocols; ++j) {
+    new (ConformanceTestProtocols[j]) ProtocolDescriptor{
+      "ConformanceTestProtocol", nullptr,
+      ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+    };
+  }
+
+  auto flags = ProtocolConformanceFlags()
+    .withTypeKind(ProtocolConformanceTypeKind::UniqueDirectType)
+    .withConformanceKind(ProtocolConformanceReferenceKind::WitnessTable);
+  unsigned numRecords = 0;
+  for (unsigned i = 0; i < NumConformanceTestTypes; ++i) {
+    ConformanceTestTypes[i][1] = (const void *)MetadataKind::Opaque;
+    for (unsigned j = 0; j < NumConformanceTestProtocols; ++j) {
+      if (!conformanceTestTypeConforms(i, j))
+        continue;
+      auto &record = ConformanceTestRecords[numRecords++];
+      record.Protocol = getRelativeOffset(&record.Protocol,
+                                          getConformanceTestProtocol(j));
+      record.DirectType = getRelativeOffset(&record.DirectType,
+                                            getConformanceTestType(i));
+      record.WitnessTable = getRelativeOffset(&record.WitnessTable,
+                                           &ConformanceTestWitnesses[i][j]);
+      record.Flags = flags.getValue();
+    }
+  }
+
+  auto records = reinterpret_cast<const ProtocolConformanceRecord *>(
+    ConformanceTestRecords);
+  swift_registerProtocolConformances(records, records + numRecords);
+}
+
+/// Looks up every pair of stress test type and protocol, \p numRounds times
+/// over on each of \p numThreads threads, and checks what comes back.
+template <unsigned numThreads>
+static void lookUpConformanceTestRecords(unsigned numRounds) {
+  RaceTest<void *, numThreads>(
+    [&]() -> void * {
+      for (unsigned round = 0; round < numRounds; ++round) {
+        for (unsigned i = 0; i < NumConformanceTestTypes; ++i) {
+          for (unsigned j = 0; j < NumConformanceTestProtocols; ++j) {
+            auto witness = swift_conformsToProtocol(
+              getConformanceTestType(i), getConformanceTestProtocol(j));
+            auto expected = conformanceTestTypeConforms(i, j)
+              ? &ConformanceTestWitnesses[i][j] : nullptr;
+            if ((const void *)witness != (const void *)expected) {
+              ADD_FAILURE() << "wrong conformance for type " << i
+                            << " and protocol " << j;
+              return nullptr;
+            }
+          }
+        }
+      }
+      return nullptr;
+    });
+}
+
+TEST(MetadataTest, conformsToProtocol_stress) {
+  registerConformanceTestRecords();
+  lookUpConformanceTestRecords<16>(2);
+}
+
+// Run with --gtest_also_run_disabled_tests to time concurrent lookups, which
+// mostly hit the cache. The rate is recorded as the test's lookups_per_sec
+// property.
+TEST(MetadataTest, DISABLED_conformsToProtocol_benchmark) {
+  const unsigned numRounds = 2000;
+  const unsigned numThreads = 16;
+
+  registerConformanceTestRecords();
+  auto start = std::chrono::steady_clock::now();
+  lookUpConformanceTestRecords<numThreads>(numRounds);
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  double lookups = double(NumConformanceTestTypes) *
+    NumConformanceTestProtocols * numRounds * numThreads;
+  RecordProperty("lookups_per_sec", int(lookups / elapsed));
+}
+
+static const void *LateConformanceType[2];
+static char LateConformanceWitness;
+alignas(ProtocolDescriptor) static char
+  LateConformanceProtocol[sizeof(ProtocolDescriptor)];
+static RawConformanceRecord LateConformanceRecord;
+
+TEST(MetadataTest, conformsToProtocol_failureForgottenByLaterImage) {
+  auto protocol = new (LateConformanceProtocol) ProtocolDescriptor{
+    "LateConformanceProtocol", nullptr,
+    ProtocolDescriptorFlags().withSwift(true)
+                          .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
+                          .withClassConstraint(ProtocolClassConstraint::Any)
+  };
+  LateConformanceType[1] = (const void *)MetadataKind::Opaque;
+  auto type = reinterpret_cast<const Metadata *>(&LateConformanceType[1]);
+
+  // The failure is memoized.
+  EXPECT_EQ(nullptr, swift_conformsToProtocol(type, protocol));
+  EXPECT_EQ(nullptr, swift_conformsToProtocol(type, protocol));
+
+  // Registering the conformance makes the memoized failure stale.
+  auto &record = LateConformanceRecord;
+  record.Protocol = getRelativeOffset(&record.Protocol, protocol);
+  record.DirectType = getRelativeOffset(&record.DirectType, type);
+  record.WitnessTable = getRelativeOffset(&record.WitnessTable,
+                                          &LateConformanceWitness);
+  record.Flags = ProtocolConformanceFlags()
+    .withTypeKind(ProtocolConformanceTypeKind::UniqueDirectType)
+    .withConformanceKind(ProtocolConformanceReferenceKind::WitnessTable)
+    .getValue();
+  auto records = reinterpret_cast<const ProtocolConformanceRecord *>(&record);
+  swift_registerProtocolConformances(records, records + 1);
+
+  EXPECT_EQ((const void *)&LateConformanceWitness,
+            (const void *)swift_conformsToProtocol(type, protocol));
+}
+
+extern "C" TwoWordPair<const char *, uintptr_t>::Return
+swift_getTypeName(const Metadata *type, bool qualified);
+
+/// Look up the name of the metatype of every builtin integer type, numRounds
+/// times on each of NumThreads threads, and return the lookups per second.
+template <unsigned NumThreads>
+static double measureGetTypeNameThroughput(unsigned numRounds) {
+  const Metadata *types[] = {
+    swift_getMetatypeMetadata(&_TMBi8_.base),
+    swift_getMetatypeMetadata(&_TMBi16_.base),
+    swift_getMetatypeMetadata(&_TMBi32_.base),
+    swift_getMetatypeMetadata(&_TMBi64_.base),
+  };
+  const unsigned numTypes = sizeof(types) / sizeof(types[0]);
+
+  auto start = std::chrono::steady_clock::now();
+  RaceTest<void *, NumThreads>(
+    [&]() -> void * {
+      for (unsigned round = 0; round < numRounds; ++round) {
+        for (unsigned i = 0; i < numTypes; ++i) {
+          TwoWordPair<const char *, uintptr_t> name =
+            swift_getTypeName(types[i], round & 1);
+          if (strlen(name.first) != name.second) {
+            ADD_FAILURE() << "wrong length for type name " << name.first;
+            return nullptr;
+          }
+        }
+      }
+      return nullptr;
+    });
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  return double(numTypes) * numRounds * NumThreads / elapsed;
+}
+
+TEST(MetadataTest, getTypeName) {
+  auto type = swift_getMetatypeMetadata(&_TMBi64_.base);
+  auto results = RaceTest<const char *, 16>(
+    [&]() -> const char * {
+      TwoWordPair<const char *, uintptr_t> name =
+        swift_getTypeName(type, true);
+      EXPECT_EQ(strlen(name.first), name.second);
+      return name.first;
+    });
+
+  // Every thread must see the same cached string.
+  for (auto result : results)
+    EXPECT_EQ(results[0], result);
+}
+
+TEST(MetadataTest, getTypeName_oddLengthsKeepEntriesAligned) {
+  const Metadata *types[] = {
+    swift_getMetatypeMetadata(&_TMBi8_.base),
+    swift_getMetatypeMetadata(&_TMBi16_.base),
+    swift_getMetatypeMetadata(&_TMBi32_.base),
+  };
+
+  // Each name is stored right after its cache entry, so a name is aligned
+  // only if its entry is. Entries allocated after odd-length names must not
+  // be misaligned.
+  for (bool qualified : {true, false}) {
+    for (auto type : types) {
+      TwoWordPair<const char *, uintptr_t> name =
+        swift_getTypeName(type, qualified);
+      EXPECT_EQ(strlen(name.first), name.second);
+      EXPECT_EQ(uintptr_t(name.first) & (alignof(void*) - 1), uintptr_t(0));
+    }
+  }
+}
+
+// Run with --gtest_also_run_disabled_tests to see how lookups scale with the
+// number of threads. The rates are recorded as test properties.
+TEST(MetadataTest, DISABLED_getTypeName_throughput) {
+  const unsigned numRounds = 50000;
+  RecordProperty("lookups_per_sec_1_thread",
+                 int(measureGetTypeNameThroughput<1>(numRounds)));
+  RecordProperty("lookups_per_sec_2_threads",
+                 int(measureGetTypeNameThroughput<2>(numRounds)));
+  RecordProperty("lookups_per_sec_4_threads",
+                 int(measureGetTypeNameThroughput<4>(numRounds)));
+  RecordProperty("lookups_per_sec_8_threads",
+                 int(measureGetTypeNameThroughput<8>(numRounds)));
+  RecordProperty("lookups_per_sec_16_threads",
+                 int(measureGetTypeNameThroughput<16>(numRounds)));
+}
+
 static ProtocolDescriptor OpaqueProto1 = { "OpaqueProto1", nullptr,
   ProtocolDescriptorFlags().withSwift(true)
                           .withDispatchStrategy(ProtocolDispatchStrategy::Swift)
@@ -13,6 +13,11 @@
 #include "swift/Runtime/HeapObject.h"
 #include "swift/Runtime/Metadata.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace swift;
 
@@ -119,6 +124,27 @@ TEST(RefcountingTest, retain_release_n) {
   EXPECT_EQ(1u, value);
 }
 
+TEST(RefcountingTest, nonatomic_retain_release_n) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  EXPECT_EQ(0u, value);
+  swift_nonatomic_retain_n(object, 32);
+  swift_nonatomic_retain(object);
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(34u, swift_retainCount(object));
+  swift_nonatomic_release_n(object, 31);
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(3u, swift_retainCount(object));
+  swift_release(object);
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(2u, swift_retainCount(object));
+  swift_nonatomic_release(object);
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(1u, swift_retainCount(object));
+  swift_nonatomic_release(object);
+  EXPECT_EQ(1u, value);
+}
+
 TEST(RefcountingTest, unknown_retain_release_n) {
   size_t value = 0;
   auto object = allocTestObject(&value, 1);
@@ -156,3 +182,210 @@ TEST(RefcountingTest, unowned_retain_release_n) {
   swift_release(object);
   EXPECT_EQ(1u, value);
 }
+
+TEST(RefcountingTest, release_on_another_thread) {
+  const size_t numObjects = 1000;
+  std::vector<size_t> values(numObjects);
+  std::vector<TestObject *> objects(numObjects);
+  for (size_t i = 0; i < numObjects; ++i) {
+    objects[i] = allocTestObject(&values[i], 1);
+    swift_retain(objects[i]);
+  }
+
+  // Release one reference on another thread, first for the references taken
+  // here and then for the other thread's own retain.
+  std::thread other([&] {
+    for (auto object : objects) {
+      swift_retain(object);
+      swift_release(object);
+      swift_release(object);
+    }
+  });
+  other.join();
+  for (size_t i = 0; i < numObjects; ++i) {
+    EXPECT_EQ(0u, values[i]);
+    EXPECT_EQ(1u, swift_retainCount(objects[i]));
+  }
+
+  // Dropping the last reference on either thread must deallocate.
+  std::thread last([&] {
+    for (size_t i = 0; i < numObjects; i += 2)
+      swift_release(objects[i]);
+  });
+  last.join();
+  for (size_t i = 1; i < numObjects; i += 2)
+    swift_release(objects[i]);
+
+  // Objects whose last reference was dropped on the other thread may wait
+  // for this thread to merge them; allocating gives it the chance.
+  size_t unused = 0;
+  swift_release(allocTestObject(&unused, 1));
+  for (size_t i = 0; i < numObjects; ++i)
+    EXPECT_EQ(1u, values[i]);
+}
+
+TEST(RefcountingTest, release_on_another_thread_drained_by_release) {
+  size_t value = 0;
+  size_t otherValue = 0;
+  auto object = allocTestObject(&value, 1);
+  auto other = allocTestObject(&otherValue, 1);
+
+  // Drop the last reference on another thread.
+  std::thread last([&] { swift_release(object); });
+  last.join();
+
+  // This thread never allocates again. Releasing something it owns must
+  // still merge the object queued for it.
+  swift_retain(other);
+  swift_release(other);
+  EXPECT_EQ(1u, value);
+
+  swift_release(other);
+  EXPECT_EQ(1u, otherValue);
+}
+
+TEST(RefcountingTest, isUniquelyReferenced_after_release_on_another_thread) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  swift_retain(object);
+  EXPECT_FALSE(swift_isUniquelyReferenced_native(object));
+
+  std::thread other([&] { swift_release(object); });
+  other.join();
+  EXPECT_TRUE(swift_isUniquelyReferenced_native(object));
+
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+}
+
+TEST(RefcountingTest, retain_release_contended) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned i = 0; i < 100000; ++i) {
+        swift_retain(object);
+        swift_release(object);
+      }
+    });
+  }
+  for (unsigned i = 0; i < 100000; ++i) {
+    swift_retain_n(object, 2);
+    swift_release_n(object, 2);
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(1u, swift_retainCount(object));
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+}
+
+/// Retain and release an object \p numIterations times on each of NumThreads
+/// threads, and return the average nanoseconds per retain/release pair.
+/// If \p shared is null, each thread uses an object it allocated itself.
+template <unsigned NumThreads>
+static double measureRetainRelease(HeapObject *shared,
+                                   unsigned numIterations) {
+  std::atomic<unsigned> ready(0);
+  std::atomic<bool> go(false);
+  auto body = [&] {
+    size_t value = 0;
+    HeapObject *object = shared ? shared : allocTestObject(&value, 1);
+    ++ready;
+    while (!go) {}
+    for (unsigned i = 0; i < numIterations; ++i) {
+      swift_retain(object);
+      swift_release(object);
+    }
+    if (!shared) {
+      EXPECT_EQ(1u, swift_retainCount(object));
+      swift_release(object);
+      EXPECT_EQ(1u, value);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < NumThreads; ++t)
+    threads.emplace_back(body);
+  while (ready != NumThreads) {}
+
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  for (auto &thread : threads)
+    thread.join();
+  auto elapsed = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count();
+  return elapsed / (numIterations * NumThreads);
+}
+
+TEST(RefcountingTest, retain_release_threads) {
+  measureRetainRelease<4>(nullptr, 10000);
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  measureRetainRelease<8>(object, 10000);
+  EXPECT_EQ(0u, value);
+  EXPECT_EQ(1u, swift_retainCount(object));
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare retains and releases of
+// thread-local and shared objects. The nanoseconds per pair are recorded as
+// test properties.
+TEST(RefcountingTest, DISABLED_retain_release_benchmark) {
+  const unsigned numIterations = 10000000;
+  RecordProperty("local_ns_1_thread", std::to_string(
+    measureRetainRelease<1>(nullptr, numIterations)));
+  RecordProperty("local_ns_4_threads", std::to_string(
+    measureRetainRelease<4>(nullptr, numIterations / 4)));
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  RecordProperty("shared_ns_1_thread", std::to_string(
+    measureRetainRelease<1>(object, numIterations)));
+  RecordProperty("shared_ns_4_threads", std::to_string(
+    measureRetainRelease<4>(object, numIterations / 4)));
+  RecordProperty("shared_ns_8_threads", std::to_string(
+    measureRetainRelease<8>(object, numIterations / 8)));
+  swift_release(object);
+}
+
+/// Retain and release a thread-local object numIterations times, using either
+/// the atomic or the non-atomic entry points, and return the average
+/// nanoseconds per retain/release pair.
+static double measureLocalRetainRelease(bool nonatomic) {
+  const unsigned numIterations = 10000000;
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  auto start = std::chrono::steady_clock::now();
+  if (nonatomic) {
+    for (unsigned i = 0; i < numIterations; ++i) {
+      swift_nonatomic_retain(object);
+      swift_nonatomic_release(object);
+    }
+  } else {
+    for (unsigned i = 0; i < numIterations; ++i) {
+      swift_retain(object);
+      swift_release(object);
+    }
+  }
+  auto elapsed = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count();
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+  return elapsed / numIterations;
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the atomic and the
+// non-atomic entry points. The nanoseconds per pair are recorded as test
+// properties.
+TEST(RefcountingTest, DISABLED_nonatomic_retain_release_benchmark) {
+  RecordProperty("atomic_ns",
+                 std::to_string(measureLocalRetainRelease(false)));
+  RecordProperty("nonatomic_ns",
+                 std::to_string(measureLocalRetainRelease(true)));
+}
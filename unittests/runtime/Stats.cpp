@@ -0,0 +1,144 @@
+//===--- swift/unittests/runtime/Stats.cpp - Runtime statistics -----------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include "swift/Runtime/Stats.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <thread>
+
+using namespace swift;
+
+struct TestObject : HeapObject {
+  size_t *Addr;
+  size_t Value;
+};
+
+static void destroyTestObject(HeapObject *_object) {
+  auto object = static_cast<TestObject*>(_object);
+  assert(object->Addr && "object already deallocated");
+  *object->Addr = object->Value;
+  object->Addr = nullptr;
+  swift_deallocObject(object, sizeof(TestObject), alignof(TestObject) - 1);
+}
+
+static const FullMetadata<ClassMetadata> TestClassObjectMetadata = {
+  { { &destroyTestObject }, { &_TWVBo } },
+  { { { MetadataKind::Class } }, 0, /*rodata*/ 1,
+  ClassFlags::UsesSwift1Refcounting, nullptr, nullptr, 0, 0, 0, 0, 0 }
+};
+
+/// Create an object that, when deallocated, stores the given value to
+/// the given pointer.
+static TestObject *allocTestObject(size_t *addr, size_t value) {
+  auto result =
+    static_cast<TestObject *>(swift_allocObject(&TestClassObjectMetadata,
+                                                sizeof(TestObject),
+                                                alignof(TestObject) - 1));
+  result->Addr = addr;
+  result->Value = value;
+  return result;
+}
+
+static uint64_t getCounter(RuntimeCounter counter) {
+  return swift_stats_getCounter(unsigned(counter));
+}
+
+TEST(StatsTest, names) {
+  ASSERT_EQ(unsigned(NumRuntimeCounters), swift_stats_getNumCounters());
+  ASSERT_EQ(unsigned(NumRuntimeTimers), swift_stats_getNumTimers());
+  EXPECT_STREQ("AllocObject",
+               swift_stats_getCounterName(unsigned(RuntimeCounter::AllocObject)));
+  EXPECT_STREQ("MetadataInstantiation",
+               swift_stats_getTimerName(
+                 unsigned(RuntimeTimer::MetadataInstantiation)));
+  EXPECT_EQ(nullptr, swift_stats_getCounterName(NumRuntimeCounters));
+  EXPECT_EQ(nullptr, swift_stats_getTimerName(NumRuntimeTimers));
+  EXPECT_EQ(0u, swift_stats_getCounter(NumRuntimeCounters));
+}
+
+TEST(StatsTest, retain_release) {
+  uint64_t allocs = getCounter(RuntimeCounter::AllocObject);
+  uint64_t deallocs = getCounter(RuntimeCounter::DeallocObject);
+  uint64_t retains = getCounter(RuntimeCounter::Retain);
+  uint64_t releases = getCounter(RuntimeCounter::Release);
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  swift_retain(object);
+  swift_retain_n(object, 2);
+  swift_release_n(object, 2);
+  swift_release(object);
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+
+  if (!swift_stats_isEnabled()) {
+    EXPECT_EQ(0u, getCounter(RuntimeCounter::Retain));
+    return;
+  }
+  EXPECT_EQ(allocs + 1, getCounter(RuntimeCounter::AllocObject));
+  EXPECT_EQ(deallocs + 1, getCounter(RuntimeCounter::DeallocObject));
+  EXPECT_EQ(retains + 2, getCounter(RuntimeCounter::Retain));
+  EXPECT_EQ(releases + 3, getCounter(RuntimeCounter::Release));
+}
+
+TEST(StatsTest, exited_thread) {
+  uint64_t retains = getCounter(RuntimeCounter::Retain);
+
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  std::thread([&] {
+    for (unsigned i = 0; i < 10; ++i)
+      swift_retain(object);
+    for (unsigned i = 0; i < 10; ++i)
+      swift_release(object);
+  }).join();
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+
+  // The counts of a thread are kept after it exits.
+  if (swift_stats_isEnabled())
+    EXPECT_EQ(retains + 10, getCounter(RuntimeCounter::Retain));
+}
+
+TEST(StatsTest, reset) {
+  size_t value = 0;
+  swift_release(allocTestObject(&value, 1));
+  EXPECT_EQ(1u, value);
+
+  swift_stats_reset();
+  for (unsigned i = 0; i < swift_stats_getNumCounters(); ++i)
+    EXPECT_EQ(0u, swift_stats_getCounter(i));
+  for (unsigned i = 0; i < swift_stats_getNumTimers(); ++i)
+    for (unsigned j = 0; j < swift_stats_getNumTimerBuckets(); ++j)
+      EXPECT_EQ(0u, swift_stats_getTimerBucket(i, j));
+}
+
+extern "C" TwoWordPair<const char *, uintptr_t>::Return
+swift_getTypeName(const Metadata *type, bool qualified);
+
+TEST(StatsTest, metadata_cache) {
+  auto type = swift_getMetatypeMetadata(&_TMBi16_.base);
+  uint64_t hits = getCounter(RuntimeCounter::MetadataCacheHit);
+  uint64_t misses = getCounter(RuntimeCounter::MetadataCacheMiss);
+
+  EXPECT_EQ(type, swift_getMetatypeMetadata(&_TMBi16_.base));
+  // The type name cache shares the cache implementation but is not counted.
+  swift_getTypeName(type, true);
+  swift_getTypeName(type, true);
+
+  if (!swift_stats_isEnabled())
+    return;
+  EXPECT_EQ(hits + 1, getCounter(RuntimeCounter::MetadataCacheHit));
+  EXPECT_EQ(misses, getCounter(RuntimeCounter::MetadataCacheMiss));
+}
@@ -0,0 +1,273 @@
+//===--- swift/unittests/runtime/Weak.cpp - Weak references ---------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "swift/Runtime/HeapObject.h"
+#include "swift/Runtime/Metadata.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace swift;
+
+/// An object with a payload, so that the memory kept alive by weak
+/// references is easy to see.
+struct TestObject : HeapObject {
+  size_t *Addr;
+  size_t Value;
+  char Payload[1024];
+};
+
+static void destroyTestObject(HeapObject *_object) {
+  auto object = static_cast<TestObject*>(_object);
+  assert(object->Addr && "object already deallocated");
+  *object->Addr = object->Value;
+  object->Addr = nullptr;
+  swift_deallocObject(object, sizeof(TestObject), alignof(TestObject) - 1);
+}
+
+static const FullMetadata<ClassMetadata> TestClassObjectMetadata = {
+  { { &destroyTestObject }, { &_TWVBo } },
+  { { { MetadataKind::Class } }, 0, /*rodata*/ 1,
+  ClassFlags::UsesSwift1Refcounting, nullptr, nullptr, 0, 0, 0, 0, 0 }
+};
+
+/// Create an object that, when deinitialized, stores the given value to
+/// the given pointer.
+static TestObject *allocTestObject(size_t *addr, size_t value) {
+  auto result =
+    static_cast<TestObject *>(swift_allocObject(&TestClassObjectMetadata,
+                                                sizeof(TestObject),
+                                                alignof(TestObject) - 1));
+  result->Addr = addr;
+  result->Value = value;
+  return result;
+}
+
+TEST(WeakTest, load_after_release) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object);
+
+  HeapObject *tmp = swift_weakLoadStrong(&ref);
+  EXPECT_EQ(object, tmp);
+  swift_release(tmp);
+  EXPECT_EQ(0u, value);
+
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  swift_weakDestroy(&ref);
+}
+
+TEST(WeakTest, assign) {
+  size_t value1 = 0, value2 = 0;
+  auto object1 = allocTestObject(&value1, 1);
+  auto object2 = allocTestObject(&value2, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object1);
+  swift_weakAssign(&ref, object2);
+
+  HeapObject *tmp = swift_weakLoadStrong(&ref);
+  EXPECT_EQ(object2, tmp);
+  swift_release(tmp);
+
+  swift_release(object1);
+  EXPECT_EQ(1u, value1);
+  tmp = swift_weakLoadStrong(&ref);
+  EXPECT_EQ(object2, tmp);
+  swift_release(tmp);
+
+  swift_weakAssign(&ref, nullptr);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref));
+  swift_release(object2);
+  EXPECT_EQ(1u, value2);
+  swift_weakDestroy(&ref);
+}
+
+TEST(WeakTest, copy_and_take) {
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref1, ref2, ref3;
+  swift_weakInit(&ref1, object);
+  swift_weakCopyInit(&ref2, &ref1);
+  swift_weakTakeInit(&ref3, &ref1);
+
+  HeapObject *tmp = swift_weakTakeStrong(&ref2);
+  EXPECT_EQ(object, tmp);
+  swift_release(tmp);
+
+  swift_weakInit(&ref2, nullptr);
+  swift_weakCopyAssign(&ref2, &ref3);
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+
+  EXPECT_EQ(nullptr, swift_weakTakeStrong(&ref2));
+  swift_weakCopyInit(&ref1, &ref3);
+  EXPECT_EQ(nullptr, swift_weakLoadStrong(&ref1));
+  swift_weakDestroy(&ref1);
+  swift_weakDestroy(&ref3);
+}
+
+TEST(WeakTest, load_while_releasing) {
+  const unsigned numObjects = 1000;
+  const unsigned numThreads = 4;
+  std::vector<size_t> values(numObjects);
+  std::vector<TestObject *> objects(numObjects);
+  std::vector<WeakReference> refs(numObjects);
+  for (unsigned i = 0; i < numObjects; ++i) {
+    objects[i] = allocTestObject(&values[i], 1);
+    swift_weakInit(&refs[i], objects[i]);
+  }
+
+  // Every thread keeps loading from every reference while the objects are
+  // released. Each thread uses its own copies of the references, since weak
+  // references are not safe to update concurrently.
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&] {
+      std::vector<WeakReference> copies(numObjects);
+      for (unsigned i = 0; i < numObjects; ++i)
+        swift_weakCopyInit(&copies[i], &refs[i]);
+      while (!done) {
+        for (auto &copy : copies)
+          if (auto object = swift_weakLoadStrong(&copy))
+            swift_release(object);
+      }
+      for (auto &copy : copies)
+        swift_weakDestroy(&copy);
+    });
+  }
+
+  for (auto object : objects)
+    swift_release(object);
+  done = true;
+  for (auto &thread : threads)
+    thread.join();
+
+  for (unsigned i = 0; i < numObjects; ++i) {
+    EXPECT_EQ(1u, values[i]);
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&refs[i]));
+    swift_weakDestroy(&refs[i]);
+  }
+}
+
+TEST(WeakTest, init_and_destroy_on_several_threads) {
+  const unsigned numObjects = 100;
+  const unsigned numRounds = 1000;
+  const unsigned numThreads = 4;
+
+  // Each thread weakly references its own objects over and over, so the
+  // threads only share the side table.
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&] {
+      std::vector<size_t> values(numObjects);
+      std::vector<TestObject *> objects(numObjects);
+      for (unsigned i = 0; i < numObjects; ++i)
+        objects[i] = allocTestObject(&values[i], 1);
+      for (unsigned round = 0; round < numRounds; ++round) {
+        for (unsigned i = 0; i < numObjects; ++i) {
+          WeakReference ref;
+          swift_weakInit(&ref, objects[i]);
+          swift_weakAssign(&ref, objects[(i + 1) % numObjects]);
+          auto object = swift_weakLoadStrong(&ref);
+          EXPECT_EQ(objects[(i + 1) % numObjects], object);
+          swift_release(object);
+          swift_weakDestroy(&ref);
+        }
+      }
+      for (unsigned i = 0; i < numObjects; ++i) {
+        swift_release(objects[i]);
+        EXPECT_EQ(1u, values[i]);
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+}
+
+/// Return the number of bytes currently allocated with malloc, or 0 if the
+/// platform cannot tell.
+static size_t getMallocBytesInUse() {
+#if defined(__APPLE__)
+  malloc_statistics_t stats;
+  malloc_zone_statistics(nullptr, &stats);
+  return stats.size_in_use;
+#elif defined(__GLIBC__) && \
+      (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+  return mallinfo().uordblks;
+#else
+  return 0;
+#endif
+}
+
+// Run with --gtest_also_run_disabled_tests to see how much memory dead objects
+// with weak references keep allocated. The number of bytes is recorded as the
+// test's bytes_held property.
+TEST(WeakTest, DISABLED_memory_footprint_benchmark) {
+  const unsigned numObjects = 10000;
+  std::vector<size_t> values(numObjects);
+  std::vector<WeakReference> refs(numObjects);
+
+  size_t before = getMallocBytesInUse();
+  for (unsigned i = 0; i < numObjects; ++i) {
+    auto object = allocTestObject(&values[i], 1);
+    swift_weakInit(&refs[i], object);
+    swift_release(object);
+  }
+  size_t after = getMallocBytesInUse();
+
+  for (unsigned i = 0; i < numObjects; ++i) {
+    EXPECT_EQ(1u, values[i]);
+    EXPECT_EQ(nullptr, swift_weakLoadStrong(&refs[i]));
+    swift_weakDestroy(&refs[i]);
+  }
+
+  // Without side-table entries, each weak reference keeps the whole
+  // deinitialized object allocated.
+  RecordProperty("bytes_held", int(after > before ? after - before : 0));
+}
+
+// Run with --gtest_also_run_disabled_tests to time weak loads. The
+// nanoseconds per load and release are recorded as the test's load_ns
+// property.
+TEST(WeakTest, DISABLED_load_benchmark) {
+  const unsigned numIterations = 10000000;
+  size_t value = 0;
+  auto object = allocTestObject(&value, 1);
+  WeakReference ref;
+  swift_weakInit(&ref, object);
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < numIterations; ++i)
+    swift_release(swift_weakLoadStrong(&ref));
+  auto elapsed = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count();
+
+  swift_release(object);
+  EXPECT_EQ(1u, value);
+  swift_weakDestroy(&ref);
+  RecordProperty("load_ns", std::to_string(elapsed / numIterations));
+}
@@ -0,0 +1,131 @@
+#!/usr/bin/env python
+# benchmark-batch-mode.py - Measure the driver's batch mode -*- python -*-
+#
+# This source file is part of the Swift.org open source project
+#
+# Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+# Licensed under Apache License v2.0 with Runtime Library Exception
+#
+# See http://swift.org/LICENSE.txt for license information
+# See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+#
+# ----------------------------------------------------------------------------
+#
+# Generates a synthetic module with many source files and compiles it with and
+# without -enable-batch-mode, reporting the wall time and the total CPU time
+# of all frontend processes.
+#
+# ----------------------------------------------------------------------------
+
+from __future__ import print_function
+
+import argparse
+import os
+import resource
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def generate_module(directory, num_files, decls_per_file):
+    """Write num_files source files which refer to each other's declarations,
+    so that type checking a primary file needs the other files."""
+    paths = []
+    for i in range(num_files):
+        path = os.path.join(directory, 'File%d.swift' % i)
+        with open(path, 'w') as f:
+            other = (i + 1) % num_files
+            for j in range(decls_per_file):
+                f.write('public struct S%d_%d {\n' % (i, j))
+                f.write('  public var x: Int\n')
+                f.write('  public var y: [String: Double]\n')
+                f.write('  public init() { x = %d; y = [:] }\n' % j)
+                f.write('  public func sum(other: S%d_%d) -> Int {\n' %
+                        (other, j))
+                f.write('    return x + other.x + y.count\n')
+                f.write('  }\n')
+                f.write('}\n\n')
+                f.write('public func f%d_%d(values: [Int]) -> Int {\n' % (i, j))
+                f.write('  return values.map { $0 * %d }.reduce(0, combine: +)'
+                        ' + S%d_%d().sum(S%d_%d())\n' % (j, i, j, other, j))
+                f.write('}\n\n')
+        paths.append(path)
+    return paths
+
+
+def run_build(swiftc, sources, output_dir, extra_args):
+    """Compile the sources to object files; return (wall, cpu) seconds."""
+    if os.path.exists(output_dir):
+        shutil.rmtree(output_dir)
+    os.makedirs(output_dir)
+
+    command = [swiftc, '-c', '-module-name', 'BatchBench',
+               '-parse-as-library'] + extra_args + sources
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    start = time.time()
+    subprocess.check_call(command, cwd=output_dir)
+    wall = time.time() - start
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    cpu = ((after.ru_utime - before.ru_utime) +
+           (after.ru_stime - before.ru_stime))
+    return wall, cpu
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare the wall and CPU time of a multi-file build '
+                    'with and without -enable-batch-mode.')
+    parser.add_argument('--swiftc', default='swiftc',
+                        help='the swiftc to benchmark')
+    parser.add_argument('--files', type=int, default=400,
+                        help='the number of source files in the module')
+    parser.add_argument('--decls', type=int, default=10,
+                        help='the number of declarations in each file')
+    parser.add_argument('-j', type=int, default=4, dest='jobs',
+                        help='the number of parallel frontend jobs')
+    parser.add_argument('--iterations', type=int, default=3,
+                        help='the number of builds of each configuration')
+    parser.add_argument('extra_args', nargs='*',
+                        help='more arguments for swiftc (e.g. -O)')
+    args = parser.parse_args()
+
+    work_dir = tempfile.mkdtemp(prefix='batch-bench-')
+    try:
+        source_dir = os.path.join(work_dir, 'src')
+        os.makedirs(source_dir)
+        sources = generate_module(source_dir, args.files, args.decls)
+
+        configurations = [
+            ('single-file', ['-j%d' % args.jobs]),
+            ('batch', ['-j%d' % args.jobs, '-enable-batch-mode']),
+        ]
+        results = {}
+        for name, config_args in configurations:
+            best_wall = best_cpu = None
+            for _ in range(args.iterations):
+                wall, cpu = run_build(args.swiftc, sources,
+                                      os.path.join(work_dir, name),
+                                      config_args + args.extra_args)
+                best_wall = wall if best_wall is None else min(best_wall, wall)
+                best_cpu = cpu if best_cpu is None else min(best_cpu, cpu)
+            results[name] = (best_wall, best_cpu)
+
+        print('%d files, %d declarations per file, -j%d, best of %d' %
+              (args.files, args.decls, args.jobs, args.iterations))
+        print('%-12s %10s %10s' % ('mode', 'wall (s)', 'cpu (s)'))
+        for name, _ in configurations:
+            print('%-12s %10.2f %10.2f' % ((name,) + results[name]))
+
+        base_wall, base_cpu = results['single-file']
+        batch_wall, batch_cpu = results['batch']
+        print('speedup: %.2fx wall, %.2fx cpu' %
+              (base_wall / batch_wall, base_cpu / batch_cpu))
+    finally:
+        shutil.rmtree(work_dir)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,88 @@
+// The array loops of ArrayLoops.swift, as a baseline for the vectorized code.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include <mach/mach_time.h>
+}
+
+static const int Size = 4096;
+static const int Iterations = 10000;
+
+__attribute__((noinline))
+int32_t dotProduct(const std::vector<int32_t> &a,
+                   const std::vector<int32_t> &b) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    sum += uint32_t(a[i]) * uint32_t(b[i]);
+  return int32_t(sum);
+}
+
+__attribute__((noinline))
+int32_t sumOfDifferences(const std::vector<int32_t> &a) {
+  uint32_t sum = 0;
+  for (size_t i = 1; i < a.size(); ++i)
+    sum += uint32_t(a[i]) - uint32_t(a[i - 1]);
+  return int32_t(sum);
+}
+
+__attribute__((noinline))
+void prefixSum(std::vector<int64_t> &a) {
+  for (size_t i = 1; i < a.size(); ++i)
+    a[i] = int64_t(uint64_t(a[i]) + uint64_t(a[i - 1]));
+}
+
+__attribute__((noinline))
+void histogram(const std::vector<uint8_t> &bytes,
+               std::vector<int64_t> &counts) {
+  for (uint8_t b : bytes)
+    counts[b] += 1;
+}
+
+template <typename Body>
+static void time(const char *name, Body body) {
+  uint64_t start = mach_absolute_time();
+  int64_t result = body();
+  uint64_t delta = mach_absolute_time() - start;
+  printf("%s: %llu nanoseconds (%lld).\n", name, delta, (long long)result);
+}
+
+int main() {
+  std::vector<int32_t> ints(Size);
+  std::vector<uint8_t> bytes(Size);
+  for (int i = 0; i < Size; ++i) {
+    ints[i] = int32_t(uint32_t(i) * 7919);
+    bytes[i] = uint8_t(i * 31);
+  }
+
+  time("DotProduct", [&] {
+    uint32_t sum = 0;
+    for (int n = 0; n < Iterations; ++n)
+      sum += uint32_t(dotProduct(ints, ints));
+    return int64_t(int32_t(sum));
+  });
+
+  time("SumOfDifferences", [&] {
+    uint32_t sum = 0;
+    for (int n = 0; n < Iterations; ++n)
+      sum += uint32_t(sumOfDifferences(ints));
+    return int64_t(int32_t(sum));
+  });
+
+  time("PrefixSum", [&] {
+    std::vector<int64_t> sums(Size, 1);
+    for (int n = 0; n < Iterations; ++n)
+      prefixSum(sums);
+    return sums[Size - 1];
+  });
+
+  time("Histogram", [&] {
+    std::vector<int64_t> counts(256, 0);
+    for (int n = 0; n < Iterations; ++n)
+      histogram(bytes, counts);
+    return counts[0];
+  });
+  return 0;
+}
@@ -0,0 +1,98 @@
+//===----------------------------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2015 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See http://swift.org/LICENSE.txt for license information
+// See http://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// Array loops whose bounds checks stay in the loop body unless the loop is
+// versioned. test/SILPasses/array_loop_kernels.swift checks what the compiler
+// makes of the same kernels.
+
+@_silgen_name("mach_absolute_time") func __mach_absolute_time__() -> UInt64
+
+@inline(never)
+func dotProduct(a: [Int32], _ b: [Int32]) -> Int32 {
+  var sum: Int32 = 0
+  for i in 0..<a.count {
+    sum = sum &+ a[i] &* b[i]
+  }
+  return sum
+}
+
+@inline(never)
+func sumOfDifferences(a: [Int32]) -> Int32 {
+  var sum: Int32 = 0
+  for i in 1..<a.count {
+    sum = sum &+ (a[i] &- a[i - 1])
+  }
+  return sum
+}
+
+@inline(never)
+func prefixSum(inout a: [Int]) {
+  for i in 1..<a.count {
+    a[i] = a[i] &+ a[i - 1]
+  }
+}
+
+@inline(never)
+func histogram(bytes: [UInt8], inout _ counts: [Int]) {
+  for b in bytes {
+    counts[Int(b)] = counts[Int(b)] &+ 1
+  }
+}
+
+let Size = 4096
+let Iterations = 10000
+
+var ints = [Int32](count: Size, repeatedValue: 0)
+var bytes = [UInt8](count: Size, repeatedValue: 0)
+for i in 0..<Size {
+  ints[i] = Int32(truncatingBitPattern: i &* 7919)
+  bytes[i] = UInt8(truncatingBitPattern: i &* 31)
+}
+
+func time(name: String, _ body: () -> Int) {
+  let start = __mach_absolute_time__()
+  let result = body()
+  let delta = __mach_absolute_time__() - start
+  print("\(name): \(delta) nanoseconds (\(result)).")
+}
+
+time("DotProduct") {
+  var sum: Int32 = 0
+  for _ in 0..<Iterations {
+    sum = sum &+ dotProduct(ints, ints)
+  }
+  return Int(sum)
+}
+
+time("SumOfDifferences") {
+  var sum: Int32 = 0
+  for _ in 0..<Iterations {
+    sum = sum &+ sumOfDifferences(ints)
+  }
+  return Int(sum)
+}
+
+time("PrefixSum") {
+  var sums = [Int](count: Size, repeatedValue: 1)
+  for _ in 0..<Iterations {
+    prefixSum(&sums)
+  }
+  return sums[Size - 1]
+}
+
+time("Histogram") {
+  var counts = [Int](count: 256, repeatedValue: 0)
+  for _ in 0..<Iterations {
+    histogram(bytes, &counts)
+  }
+  return counts[0]
+}
@@ -46,3 +46,4 @@ benchmark() {
 (cd RC4 && benchmark RC4)
 (cd ObjInst && benchmark ObjInst)
 (cd Ackermann && benchmark Ackermann)
+(cd ArrayLoops && benchmark ArrayLoops)